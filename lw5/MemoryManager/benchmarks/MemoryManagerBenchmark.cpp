@@ -0,0 +1,158 @@
+#include <benchmark/benchmark.h>
+
+#include "MemoryManager.h"
+#include "MemoryManagerResource.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory_resource>
+#include <random>
+#include <unordered_map>
+#include <unistd.h>
+#include <vector>
+
+constexpr size_t ARENA_SIZE = 64 * 1024 * 1024;
+
+template <typename Workload>
+static void RunWithDefaultResource(benchmark::State& state, Workload workload)
+{
+	for (auto _ : state)
+	{
+		workload(state.range(0), std::pmr::new_delete_resource());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Workload>
+static void RunWithMemoryManager(benchmark::State& state, const AllocationMode mode, Workload workload)
+{
+	std::vector<std::max_align_t> arena(ARENA_SIZE / sizeof(std::max_align_t));
+	MemoryManager memoryManager(arena.data(), ARENA_SIZE, mode);
+	MemoryManagerResource resource(memoryManager);
+
+	for (auto _ : state)
+	{
+		workload(state.range(0), &resource);
+		memoryManager.Reset();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void VectorPushBack(const int64_t count, std::pmr::memory_resource* resource)
+{
+	std::pmr::vector<int64_t> values(resource);
+	for (int64_t i = 0; i < count; ++i)
+	{
+		values.push_back(i);
+	}
+	benchmark::DoNotOptimize(values.data());
+}
+
+static void UnorderedMapInsert(const int64_t count, std::pmr::memory_resource* resource)
+{
+	std::pmr::unordered_map<int64_t, int64_t> values(resource);
+	for (int64_t i = 0; i < count; ++i)
+	{
+		values.emplace(i, i);
+	}
+	benchmark::DoNotOptimize(values.size());
+}
+
+static void VectorDefaultResource(benchmark::State& state)
+{
+	RunWithDefaultResource(state, VectorPushBack);
+}
+BENCHMARK(VectorDefaultResource)->RangeMultiplier(10)->Range(1000, 100000);
+
+static void VectorMemoryManagerFreeList(benchmark::State& state)
+{
+	RunWithMemoryManager(state, AllocationMode::FreeList, VectorPushBack);
+}
+BENCHMARK(VectorMemoryManagerFreeList)->RangeMultiplier(10)->Range(1000, 100000);
+
+static void VectorMemoryManagerMonotonic(benchmark::State& state)
+{
+	RunWithMemoryManager(state, AllocationMode::Monotonic, VectorPushBack);
+}
+BENCHMARK(VectorMemoryManagerMonotonic)->RangeMultiplier(10)->Range(1000, 100000);
+
+static void UnorderedMapDefaultResource(benchmark::State& state)
+{
+	RunWithDefaultResource(state, UnorderedMapInsert);
+}
+BENCHMARK(UnorderedMapDefaultResource)->RangeMultiplier(10)->Range(1000, 100000);
+
+static void UnorderedMapMemoryManagerFreeList(benchmark::State& state)
+{
+	RunWithMemoryManager(state, AllocationMode::FreeList, UnorderedMapInsert);
+}
+BENCHMARK(UnorderedMapMemoryManagerFreeList)->RangeMultiplier(10)->Range(1000, 10000);
+
+static void UnorderedMapMemoryManagerMonotonic(benchmark::State& state)
+{
+	RunWithMemoryManager(state, AllocationMode::Monotonic, UnorderedMapInsert);
+}
+BENCHMARK(UnorderedMapMemoryManagerMonotonic)->RangeMultiplier(10)->Range(1000, 100000);
+
+static size_t GetResidentSetKiB()
+{
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0;
+	size_t residentPages = 0;
+	statm >> totalPages >> residentPages;
+	return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+// Всплеск из множества блоков случайного размера, которые затем полностью освобождаются
+template <typename AllocateFn, typename FreeFn>
+static void RunBurstyWorkload(benchmark::State& state, AllocateFn allocate, FreeFn free)
+{
+	std::mt19937 random(42);
+	std::uniform_int_distribution<size_t> sizeDistribution(64, 64 * 1024);
+	std::vector<void*> blocks;
+	blocks.reserve(static_cast<size_t>(state.range(0)));
+
+	size_t peakRss = 0;
+	size_t idleRss = 0;
+	for (auto _ : state)
+	{
+		for (int64_t i = 0; i < state.range(0); ++i)
+		{
+			const size_t size = sizeDistribution(random);
+			void* ptr = allocate(size);
+			std::memset(ptr, 1, size);
+			blocks.push_back(ptr);
+		}
+		peakRss = std::max(peakRss, GetResidentSetKiB());
+
+		for (void* ptr : blocks)
+		{
+			free(ptr);
+		}
+		blocks.clear();
+		idleRss = GetResidentSetKiB();
+	}
+	state.counters["peak_rss_kib"] = static_cast<double>(peakRss);
+	state.counters["idle_rss_kib"] = static_cast<double>(idleRss);
+}
+
+static void BurstyGrowableMemoryManager(benchmark::State& state)
+{
+	MemoryManager memoryManager{ GrowthOptions{} };
+	RunBurstyWorkload(
+		state,
+		[&memoryManager](const size_t size) { return memoryManager.Allocate(size); },
+		[&memoryManager](void* ptr) { memoryManager.Free(ptr); });
+}
+BENCHMARK(BurstyGrowableMemoryManager)->Arg(1000)->Arg(4000);
+
+static void BurstyMalloc(benchmark::State& state)
+{
+	RunBurstyWorkload(
+		state,
+		[](const size_t size) { return std::malloc(size); },
+		[](void* ptr) { std::free(ptr); });
+}
+BENCHMARK(BurstyMalloc)->Arg(1000)->Arg(4000);
+
+BENCHMARK_MAIN();
@@ -1,12 +1,43 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <map>
 #include <mutex>
+#include <unordered_map>
+
+enum class AllocationMode
+{
+	FreeList,
+	Monotonic,
+};
+
+struct GrowthOptions
+{
+	size_t arenaSize = 2 * 1024 * 1024;
+	// Запросы от этого размера получают собственное отображение и сразу возвращаются ОС при Free
+	size_t largeAllocationThreshold = 256 * 1024;
+	// Сколько полностью свободных арен держать отображёнными (их страницы всё равно отдаются через MADV_DONTNEED)
+	size_t retainedFreeArenas = 1;
+	bool useHugePages = true;
+};
+
+struct MemoryManagerStats
+{
+	size_t arenaCount = 0;
+	size_t largeMappingCount = 0;
+	size_t mappedBytes = 0;
+};
 
 class MemoryManager
 {
 public:
-	MemoryManager(void* start, size_t size) noexcept;
+	MemoryManager(void* start, size_t size, AllocationMode mode = AllocationMode::FreeList) noexcept;
+
+	// Растущий менеджер: арены отображаются через mmap по мере необходимости
+	explicit MemoryManager(GrowthOptions growth, AllocationMode mode = AllocationMode::FreeList) noexcept;
+
+	~MemoryManager();
 
 	MemoryManager(const MemoryManager&) = delete;
 
@@ -14,8 +45,16 @@ public:
 
 	void* Allocate(size_t size, size_t align = sizeof(std::max_align_t)) noexcept;
 
+	// В режиме Monotonic ничего не делает: память возвращается только через Reset
 	void Free(void* addr) noexcept;
 
+	// Возвращает все арены в исходное состояние. Все ранее выданные указатели становятся недействительными
+	void Reset() noexcept;
+
+	[[nodiscard]] AllocationMode GetMode() const noexcept;
+
+	[[nodiscard]] MemoryManagerStats GetStats() const noexcept;
+
 private:
 	struct BlockHeader
 	{
@@ -25,10 +64,51 @@ private:
 		bool IsFree;
 	};
 
-	BlockHeader* m_blockHeader;
-	std::mutex m_mutex;
+	struct Arena
+	{
+		char* Begin;
+		size_t Size;
+		BlockHeader* Head;
+		uintptr_t MonotonicCursor;
+		bool IsMapped;
+	};
+
+	struct LargeMapping
+	{
+		void* Base;
+		size_t Size;
+	};
+
+	AllocationMode m_mode;
+	bool m_isGrowable;
+	GrowthOptions m_growth;
+	std::map<uintptr_t, Arena> m_arenas;
+	std::unordered_map<void*, LargeMapping> m_largeMappings;
+	mutable std::mutex m_mutex;
+
+	void AddArena(char* begin, size_t size, bool isMapped) noexcept;
+
+	Arena* MapArena(size_t minSize) noexcept;
+
+	void UnmapArena(const Arena& arena) noexcept;
+
+	void ReleaseFreeArena(Arena& arena) noexcept;
+
+	Arena* FindArena(void* addr) noexcept;
+
+	void* AllocateLarge(size_t size, size_t align) noexcept;
+
+	[[nodiscard]] size_t GetPageSize() const noexcept;
+
+	static void InitializeFreeList(Arena& arena) noexcept;
+
+	static void* AllocateFromFreeList(Arena& arena, size_t size, size_t align) noexcept;
+
+	static void* AllocateMonotonic(Arena& arena, size_t size, size_t align) noexcept;
+
+	static bool IsArenaEmpty(const Arena& arena) noexcept;
 
-	[[nodiscard]] BlockHeader* FindFreeBlock(size_t size, size_t align) const noexcept;
+	[[nodiscard]] static BlockHeader* FindFreeBlock(BlockHeader* head, size_t size, size_t align) noexcept;
 
 	static uintptr_t CalculateAlignedAddress(BlockHeader* block, size_t align) noexcept;
 
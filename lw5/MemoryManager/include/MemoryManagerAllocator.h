@@ -0,0 +1,58 @@
+#pragma once
+
+#include "MemoryManager.h"
+
+#include <cstddef>
+#include <new>
+
+template <typename T>
+class MemoryManagerAllocator
+{
+public:
+	using value_type = T;
+
+	explicit MemoryManagerAllocator(MemoryManager& memoryManager) noexcept
+		: m_memoryManager(&memoryManager)
+	{
+	}
+
+	template <typename U>
+	MemoryManagerAllocator(const MemoryManagerAllocator<U>& other) noexcept
+		: m_memoryManager(&other.GetMemoryManager())
+	{
+	}
+
+	[[nodiscard]] T* allocate(const size_t n)
+	{
+		if (n > static_cast<size_t>(-1) / sizeof(T))
+		{
+			throw std::bad_array_new_length();
+		}
+
+		void* ptr = m_memoryManager->Allocate(n * sizeof(T), alignof(T));
+		if (!ptr)
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(ptr);
+	}
+
+	void deallocate(T* ptr, size_t /*n*/) noexcept
+	{
+		m_memoryManager->Free(ptr);
+	}
+
+	[[nodiscard]] MemoryManager& GetMemoryManager() const noexcept
+	{
+		return *m_memoryManager;
+	}
+
+	template <typename U>
+	bool operator==(const MemoryManagerAllocator<U>& other) const noexcept
+	{
+		return m_memoryManager == &other.GetMemoryManager();
+	}
+
+private:
+	MemoryManager* m_memoryManager;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "MemoryManager.h"
+
+#include <memory_resource>
+
+class MemoryManagerResource final : public std::pmr::memory_resource
+{
+public:
+	explicit MemoryManagerResource(MemoryManager& memoryManager) noexcept;
+
+	[[nodiscard]] MemoryManager& GetMemoryManager() const noexcept;
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+	[[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override;
+
+	MemoryManager& m_memoryManager;
+};
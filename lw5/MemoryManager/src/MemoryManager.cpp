@@ -1,73 +1,354 @@
 #include "MemoryManager.h"
+#include <algorithm>
 #include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
 
-MemoryManager::MemoryManager(void* start, const size_t size) noexcept
+MemoryManager::MemoryManager(void* start, const size_t size, const AllocationMode mode) noexcept
+	: m_mode(mode)
+	, m_isGrowable(false)
 {
-	if (size < sizeof(BlockHeader))
+	AddArena(static_cast<char*>(start), size, false);
+}
+
+MemoryManager::MemoryManager(const GrowthOptions growth, const AllocationMode mode) noexcept
+	: m_mode(mode)
+	, m_isGrowable(true)
+	, m_growth(growth)
+{
+}
+
+MemoryManager::~MemoryManager()
+{
+	for (const auto& [begin, arena] : m_arenas)
+	{
+		UnmapArena(arena);
+	}
+	for (const auto& [ptr, mapping] : m_largeMappings)
+	{
+		munmap(mapping.Base, mapping.Size);
+	}
+}
+
+void* MemoryManager::Allocate(const size_t size, const size_t align) noexcept
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard lock(m_mutex);
+	if (m_isGrowable && size >= m_growth.largeAllocationThreshold)
+	{
+		return AllocateLarge(size, align);
+	}
+
+	const auto allocateFrom = [this, size, align](Arena& arena) {
+		return m_mode == AllocationMode::Monotonic
+			? AllocateMonotonic(arena, size, align)
+			: AllocateFromFreeList(arena, size, align);
+	};
+
+	for (auto& [begin, arena] : m_arenas)
+	{
+		if (void* ptr = allocateFrom(arena))
+		{
+			return ptr;
+		}
+	}
+
+	if (!m_isGrowable)
+	{
+		return nullptr;
+	}
+
+	Arena* arena = MapArena(size + align + sizeof(BlockHeader));
+	return arena ? allocateFrom(*arena) : nullptr;
+}
+
+void MemoryManager::Free(void* addr) noexcept
+{
+	if (!addr || m_mode == AllocationMode::Monotonic)
 	{
-		m_blockHeader = nullptr;
 		return;
 	}
 
-	size_t space = size;
-	void* ptr = start;
-	if (!std::align(alignof(BlockHeader), sizeof(BlockHeader), ptr, space))
+	std::lock_guard lock(m_mutex);
+	Arena* arena = FindArena(addr);
+	if (!arena)
 	{
-		m_blockHeader = nullptr;
+		if (const auto it = m_largeMappings.find(addr); it != m_largeMappings.end())
+		{
+			munmap(it->second.Base, it->second.Size);
+			m_largeMappings.erase(it);
+		}
 		return;
 	}
 
-	m_blockHeader = static_cast<BlockHeader*>(ptr);
-	m_blockHeader->Prev = nullptr;
-	m_blockHeader->Next = nullptr;
-	m_blockHeader->Size = space - sizeof(BlockHeader);
-	m_blockHeader->IsFree = true;
+	BlockHeader* header = GetHeader(addr);
+	header->IsFree = true;
+	Coalesce(header);
+
+	if (arena->IsMapped && IsArenaEmpty(*arena))
+	{
+		ReleaseFreeArena(*arena);
+	}
+}
+
+void MemoryManager::Reset() noexcept
+{
+	std::lock_guard lock(m_mutex);
+	for (const auto& [ptr, mapping] : m_largeMappings)
+	{
+		munmap(mapping.Base, mapping.Size);
+	}
+	m_largeMappings.clear();
+
+	size_t retainedMapped = 0;
+	for (auto it = m_arenas.begin(); it != m_arenas.end();)
+	{
+		Arena& arena = it->second;
+		if (arena.IsMapped && retainedMapped++ >= m_growth.retainedFreeArenas)
+		{
+			UnmapArena(arena);
+			it = m_arenas.erase(it);
+			continue;
+		}
+
+		arena.MonotonicCursor = reinterpret_cast<uintptr_t>(arena.Begin);
+		if (m_mode == AllocationMode::FreeList)
+		{
+			InitializeFreeList(arena);
+		}
+		++it;
+	}
 }
 
-void* MemoryManager::Allocate(const size_t size, const size_t align) noexcept
+AllocationMode MemoryManager::GetMode() const noexcept
+{
+	return m_mode;
+}
+
+MemoryManagerStats MemoryManager::GetStats() const noexcept
+{
+	std::lock_guard lock(m_mutex);
+	MemoryManagerStats stats;
+	for (const auto& [begin, arena] : m_arenas)
+	{
+		if (arena.IsMapped)
+		{
+			++stats.arenaCount;
+			stats.mappedBytes += arena.Size;
+		}
+	}
+	for (const auto& [ptr, mapping] : m_largeMappings)
+	{
+		++stats.largeMappingCount;
+		stats.mappedBytes += mapping.Size;
+	}
+	return stats;
+}
+
+void MemoryManager::AddArena(char* begin, const size_t size, const bool isMapped) noexcept
+{
+	Arena arena{};
+	arena.Begin = begin;
+	arena.Size = size;
+	arena.MonotonicCursor = reinterpret_cast<uintptr_t>(begin);
+	arena.IsMapped = isMapped;
+	if (m_mode == AllocationMode::FreeList)
+	{
+		InitializeFreeList(arena);
+	}
+
+	try
+	{
+		m_arenas.emplace(reinterpret_cast<uintptr_t>(begin), arena);
+	}
+	catch (...)
+	{
+		if (isMapped)
+		{
+			UnmapArena(arena);
+		}
+	}
+}
+
+MemoryManager::Arena* MemoryManager::MapArena(const size_t minSize) noexcept
 {
-	if (!m_blockHeader || size == 0)
+	const size_t pageSize = GetPageSize();
+	const size_t size = std::max(m_growth.arenaSize, (minSize + pageSize - 1) / pageSize * pageSize);
+
+	void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
 	{
 		return nullptr;
 	}
+#ifdef MADV_HUGEPAGE
+	if (m_growth.useHugePages)
+	{
+		madvise(base, size, MADV_HUGEPAGE);
+	}
+#endif
 
-	std::unique_lock lock(m_mutex);
-	BlockHeader* block = FindFreeBlock(size, align);
+	AddArena(static_cast<char*>(base), size, true);
+	const auto it = m_arenas.find(reinterpret_cast<uintptr_t>(base));
+	return it != m_arenas.end() ? &it->second : nullptr;
+}
 
-	if (!block)
+void MemoryManager::UnmapArena(const Arena& arena) noexcept
+{
+	if (arena.IsMapped)
+	{
+		munmap(arena.Begin, arena.Size);
+	}
+}
+
+void MemoryManager::ReleaseFreeArena(Arena& arena) noexcept
+{
+	size_t otherFreeArenas = 0;
+	for (const auto& [begin, other] : m_arenas)
+	{
+		if (&other != &arena && other.IsMapped && IsArenaEmpty(other))
+		{
+			++otherFreeArenas;
+		}
+	}
+
+	if (otherFreeArenas >= m_growth.retainedFreeArenas)
+	{
+		UnmapArena(arena);
+		m_arenas.erase(reinterpret_cast<uintptr_t>(arena.Begin));
+		return;
+	}
+
+	// Первая страница хранит заголовок свободного блока, остальные можно отдать ОС без разрушения арены
+	const size_t pageSize = GetPageSize();
+	if (arena.Size > pageSize)
+	{
+		madvise(arena.Begin + pageSize, arena.Size - pageSize, MADV_DONTNEED);
+	}
+}
+
+MemoryManager::Arena* MemoryManager::FindArena(void* addr) noexcept
+{
+	const auto address = reinterpret_cast<uintptr_t>(addr);
+	auto it = m_arenas.upper_bound(address);
+	if (it == m_arenas.begin())
 	{
 		return nullptr;
 	}
+	--it;
+	Arena& arena = it->second;
+	return address < reinterpret_cast<uintptr_t>(arena.Begin) + arena.Size ? &arena : nullptr;
+}
 
-	const uintptr_t alignedHeader = CalculateAlignedAddress(block, align);
-	BlockHeader* usedBlock = SplitBlock(block, alignedHeader, size);
-	lock.unlock();
-	usedBlock->IsFree = false;
+void* MemoryManager::AllocateLarge(const size_t size, const size_t align) noexcept
+{
+	const size_t pageSize = GetPageSize();
+	const size_t extra = align > pageSize ? align : 0;
+	const size_t mapSize = (size + extra + pageSize - 1) / pageSize * pageSize;
 
-	return reinterpret_cast<char*>(usedBlock) + sizeof(BlockHeader);
+	void* base = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		return nullptr;
+	}
+#ifdef MADV_HUGEPAGE
+	if (m_growth.useHugePages)
+	{
+		madvise(base, mapSize, MADV_HUGEPAGE);
+	}
+#endif
+
+	const uintptr_t mask = align - 1;
+	void* ptr = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(base) + mask & ~mask);
+	try
+	{
+		m_largeMappings.emplace(ptr, LargeMapping{ base, mapSize });
+	}
+	catch (...)
+	{
+		munmap(base, mapSize);
+		return nullptr;
+	}
+	return ptr;
 }
 
-void MemoryManager::Free(void* addr) noexcept
+size_t MemoryManager::GetPageSize() const noexcept
+{
+	static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return pageSize;
+}
+
+void MemoryManager::InitializeFreeList(Arena& arena) noexcept
 {
-	if (!addr)
+	arena.Head = nullptr;
+	if (arena.Size < sizeof(BlockHeader))
 	{
 		return;
 	}
 
-	std::unique_lock lock(m_mutex);
-	BlockHeader* header = GetHeader(addr);
-	if (!header)
+	size_t space = arena.Size;
+	void* ptr = arena.Begin;
+	if (!std::align(alignof(BlockHeader), sizeof(BlockHeader), ptr, space))
 	{
 		return;
 	}
-	header->IsFree = true;
-	Coalesce(header);
-	lock.unlock();
+
+	arena.Head = static_cast<BlockHeader*>(ptr);
+	arena.Head->Prev = nullptr;
+	arena.Head->Next = nullptr;
+	arena.Head->Size = space - sizeof(BlockHeader);
+	arena.Head->IsFree = true;
+}
+
+void* MemoryManager::AllocateFromFreeList(Arena& arena, const size_t size, const size_t align) noexcept
+{
+	if (!arena.Head)
+	{
+		return nullptr;
+	}
+
+	const size_t blockAlign = std::max(align, alignof(BlockHeader));
+	const size_t blockSize = (size + alignof(BlockHeader) - 1) & ~(alignof(BlockHeader) - 1);
+
+	BlockHeader* block = FindFreeBlock(arena.Head, blockSize, blockAlign);
+	if (!block)
+	{
+		return nullptr;
+	}
+
+	const uintptr_t alignedHeader = CalculateAlignedAddress(block, blockAlign);
+	BlockHeader* usedBlock = SplitBlock(block, alignedHeader, blockSize);
+	usedBlock->IsFree = false;
+
+	return reinterpret_cast<char*>(usedBlock) + sizeof(BlockHeader);
+}
+
+void* MemoryManager::AllocateMonotonic(Arena& arena, const size_t size, const size_t align) noexcept
+{
+	const uintptr_t end = reinterpret_cast<uintptr_t>(arena.Begin) + arena.Size;
+	const uintptr_t mask = align - 1;
+
+	const uintptr_t aligned = arena.MonotonicCursor + mask & ~mask;
+	if (aligned < arena.MonotonicCursor || aligned > end || end - aligned < size)
+	{
+		return nullptr;
+	}
+
+	arena.MonotonicCursor = aligned + size;
+	return reinterpret_cast<void*>(aligned);
+}
+
+bool MemoryManager::IsArenaEmpty(const Arena& arena) noexcept
+{
+	return arena.Head && arena.Head->IsFree && !arena.Head->Next;
 }
 
-MemoryManager::BlockHeader* MemoryManager::FindFreeBlock(const size_t size, const size_t align) const noexcept
+MemoryManager::BlockHeader* MemoryManager::FindFreeBlock(BlockHeader* head, const size_t size, const size_t align) noexcept
 {
-	BlockHeader* curr = m_blockHeader;
+	BlockHeader* curr = head;
 	while (curr)
 	{
 		if (curr->IsFree)
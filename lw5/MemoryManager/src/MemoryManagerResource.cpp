@@ -0,0 +1,34 @@
+#include "MemoryManagerResource.h"
+
+#include <new>
+
+MemoryManagerResource::MemoryManagerResource(MemoryManager& memoryManager) noexcept
+	: m_memoryManager(memoryManager)
+{
+}
+
+MemoryManager& MemoryManagerResource::GetMemoryManager() const noexcept
+{
+	return m_memoryManager;
+}
+
+void* MemoryManagerResource::do_allocate(const size_t bytes, const size_t alignment)
+{
+	void* ptr = m_memoryManager.Allocate(bytes == 0 ? 1 : bytes, alignment);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void MemoryManagerResource::do_deallocate(void* p, size_t /*bytes*/, size_t /*alignment*/)
+{
+	m_memoryManager.Free(p);
+}
+
+bool MemoryManagerResource::do_is_equal(const memory_resource& other) const noexcept
+{
+	const auto* otherResource = dynamic_cast<const MemoryManagerResource*>(&other);
+	return otherResource && &otherResource->m_memoryManager == &m_memoryManager;
+}
@@ -0,0 +1,26 @@
+#include "MemoryManager.h"
+#include "MemoryManagerResource.h"
+
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+int main()
+{
+	alignas(std::max_align_t) static char buffer[64 * 1024];
+	MemoryManager memoryManager(buffer, sizeof(buffer));
+	MemoryManagerResource resource(memoryManager);
+
+	std::pmr::vector<std::pmr::string> words(&resource);
+	for (const char* word : { "arena", "backed", "pmr", "strings", "that are long enough to skip SSO" })
+	{
+		words.emplace_back(word);
+	}
+
+	for (const auto& word : words)
+	{
+		std::cout << word << std::endl;
+	}
+	return 0;
+}
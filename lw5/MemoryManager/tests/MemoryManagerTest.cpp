@@ -1,7 +1,12 @@
 #include "MemoryManager.h"
+#include "MemoryManagerAllocator.h"
+#include "MemoryManagerResource.h"
 #include <algorithm>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <map>
 #include <memory>
+#include <memory_resource>
 #include <thread>
 #include <vector>
 
@@ -101,11 +106,165 @@ TEST(MemoryManagerTest, ThreadSafety)
 		t.join();
 	}
 
-	void* pAll = mm.Allocate(sizeof(buffer));
+	void* pAll = mm.Allocate(sizeof(buffer) - sizeof(void*) * 4, alignof(std::max_align_t));
 	EXPECT_NE(pAll, nullptr);
 	mm.Free(pAll);
 }
 
+TEST(MemoryManagerTest, PmrContainersUseArena)
+{
+	alignas(std::max_align_t) char buffer[16 * 1024];
+	MemoryManager mm(buffer, sizeof(buffer));
+	MemoryManagerResource resource(mm);
+
+	std::pmr::vector<int> values(&resource);
+	for (int i = 0; i < 100; ++i)
+	{
+		values.push_back(i);
+	}
+
+	const auto* data = reinterpret_cast<const char*>(values.data());
+	EXPECT_GE(data, buffer);
+	EXPECT_LT(data, buffer + sizeof(buffer));
+	EXPECT_EQ(values[99], 99);
+}
+
+TEST(MemoryManagerTest, PmrResourceThrowsWhenExhausted)
+{
+	alignas(std::max_align_t) char buffer[256];
+	MemoryManager mm(buffer, sizeof(buffer));
+	MemoryManagerResource resource(mm);
+
+	std::pmr::vector<char> values(&resource);
+	EXPECT_THROW(values.resize(1024), std::bad_alloc);
+}
+
+TEST(MemoryManagerTest, PmrResourceEquality)
+{
+	alignas(std::max_align_t) char buffer[256];
+	MemoryManager mm(buffer, sizeof(buffer));
+	MemoryManagerResource first(mm);
+	MemoryManagerResource second(mm);
+
+	EXPECT_TRUE(first.is_equal(second));
+	EXPECT_FALSE(first.is_equal(*std::pmr::new_delete_resource()));
+}
+
+TEST(MemoryManagerTest, AllocatorWithStandardContainers)
+{
+	alignas(std::max_align_t) char buffer[16 * 1024];
+	MemoryManager mm(buffer, sizeof(buffer));
+	MemoryManagerAllocator<std::pair<const int, int>> allocator(mm);
+
+	std::map<int, int, std::less<>, MemoryManagerAllocator<std::pair<const int, int>>> values(allocator);
+	for (int i = 0; i < 50; ++i)
+	{
+		values.emplace(i, i * i);
+	}
+	EXPECT_EQ(values.at(7), 49);
+
+	const MemoryManagerAllocator<int> rebound(allocator);
+	EXPECT_TRUE(rebound == allocator);
+}
+
+TEST(MemoryManagerTest, MonotonicModeIgnoresFreeUntilReset)
+{
+	alignas(std::max_align_t) char buffer[256];
+	MemoryManager mm(buffer, sizeof(buffer), AllocationMode::Monotonic);
+
+	void* p1 = mm.Allocate(100);
+	ASSERT_NE(p1, nullptr);
+	void* p2 = mm.Allocate(100);
+	ASSERT_NE(p2, nullptr);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(p2) % alignof(std::max_align_t), 0);
+
+	mm.Free(p1);
+	mm.Free(p2);
+	EXPECT_EQ(mm.Allocate(100), nullptr);
+
+	mm.Reset();
+	EXPECT_EQ(mm.Allocate(100), p1);
+}
+
+TEST(MemoryManagerTest, ResetRestoresFreeList)
+{
+	alignas(std::max_align_t) char buffer[512];
+	MemoryManager mm(buffer, sizeof(buffer));
+
+	ASSERT_NE(mm.Allocate(150), nullptr);
+	ASSERT_NE(mm.Allocate(150), nullptr);
+	EXPECT_EQ(mm.Allocate(150), nullptr);
+
+	mm.Reset();
+	EXPECT_NE(mm.Allocate(400), nullptr);
+}
+
+TEST(MemoryManagerTest, GrowableMapsNewArenas)
+{
+	GrowthOptions growth;
+	growth.arenaSize = 64 * 1024;
+	growth.largeAllocationThreshold = 32 * 1024;
+	MemoryManager mm(growth);
+	EXPECT_EQ(mm.GetStats().arenaCount, 0);
+
+	std::vector<void*> blocks;
+	for (int i = 0; i < 64; ++i)
+	{
+		void* p = mm.Allocate(4096);
+		ASSERT_NE(p, nullptr);
+		std::memset(p, i, 4096);
+		blocks.push_back(p);
+	}
+	EXPECT_GT(mm.GetStats().arenaCount, 1);
+
+	for (void* p : blocks)
+	{
+		mm.Free(p);
+	}
+	EXPECT_EQ(mm.GetStats().arenaCount, growth.retainedFreeArenas);
+	EXPECT_EQ(mm.GetStats().mappedBytes, growth.arenaSize);
+}
+
+TEST(MemoryManagerTest, LargeAllocationsUseDedicatedMappings)
+{
+	GrowthOptions growth;
+	growth.arenaSize = 64 * 1024;
+	growth.largeAllocationThreshold = 32 * 1024;
+	MemoryManager mm(growth);
+
+	void* large = mm.Allocate(1024 * 1024, 4096);
+	ASSERT_NE(large, nullptr);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 4096, 0);
+	std::memset(large, 0xAB, 1024 * 1024);
+
+	auto stats = mm.GetStats();
+	EXPECT_EQ(stats.arenaCount, 0);
+	EXPECT_EQ(stats.largeMappingCount, 1);
+	EXPECT_GE(stats.mappedBytes, 1024 * 1024);
+
+	mm.Free(large);
+	stats = mm.GetStats();
+	EXPECT_EQ(stats.largeMappingCount, 0);
+	EXPECT_EQ(stats.mappedBytes, 0);
+}
+
+TEST(MemoryManagerTest, GrowableResetReleasesExtraArenas)
+{
+	GrowthOptions growth;
+	growth.arenaSize = 64 * 1024;
+	MemoryManager mm(growth, AllocationMode::Monotonic);
+
+	for (int i = 0; i < 100; ++i)
+	{
+		ASSERT_NE(mm.Allocate(4096), nullptr);
+	}
+	EXPECT_GT(mm.GetStats().arenaCount, 1);
+
+	mm.Reset();
+	EXPECT_EQ(mm.GetStats().arenaCount, 1);
+	EXPECT_NE(mm.Allocate(4096), nullptr);
+}
+
 int main(int argc, char** argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
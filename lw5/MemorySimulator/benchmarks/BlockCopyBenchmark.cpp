@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+#include <vector>
+
+namespace
+{
+constexpr uint32_t BUFFER_SIZE = 1024 * 1024;
+constexpr uint32_t SOURCE_ADDRESS = 0x10000000;
+constexpr uint32_t DESTINATION_ADDRESS = 0x20000000;
+
+class BlockCopyFixture
+{
+public:
+    BlockCopyFixture()
+        : m_physicalMemory(MakeConfig()),
+          m_osHandler(m_physicalMemory),
+          m_virtualMemory(m_physicalMemory, m_osHandler)
+    {
+        m_virtualMemory.SetPageTableAddress(0);
+
+        // Заранее отображаем оба буфера, чтобы в замер не попали page fault'ы
+        const std::vector<uint8_t> pattern(BUFFER_SIZE, 0x5A);
+        m_virtualMemory.WriteBlock(SOURCE_ADDRESS, pattern, Privilege::User);
+        m_virtualMemory.WriteBlock(DESTINATION_ADDRESS, pattern, Privilege::User);
+    }
+
+    VirtualMemory &GetVirtualMemory() { return m_virtualMemory; }
+
+private:
+    static PhysicalMemoryConfig MakeConfig()
+    {
+        PhysicalMemoryConfig config;
+        config.numFrames = 2 * BUFFER_SIZE / 4096 + 16;
+        return config;
+    }
+
+    PhysicalMemory m_physicalMemory;
+    MyOS m_osHandler;
+    VirtualMemory m_virtualMemory;
+};
+}
+
+static void ScalarCopy(benchmark::State &state)
+{
+    BlockCopyFixture fixture;
+    VirtualMemory &virtualMemory = fixture.GetVirtualMemory();
+
+    for (auto _ : state)
+    {
+        for (uint32_t offset = 0; offset < BUFFER_SIZE; offset += sizeof(uint64_t))
+        {
+            const uint64_t value = virtualMemory.Read64(SOURCE_ADDRESS + offset, Privilege::User);
+            virtualMemory.Write64(DESTINATION_ADDRESS + offset, value, Privilege::User);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * BUFFER_SIZE);
+}
+BENCHMARK(ScalarCopy);
+
+static void BlockCopy(benchmark::State &state)
+{
+    BlockCopyFixture fixture;
+    VirtualMemory &virtualMemory = fixture.GetVirtualMemory();
+    std::vector<uint8_t> buffer(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        for (uint32_t offset = 0; offset < BUFFER_SIZE; offset += static_cast<uint32_t>(buffer.size()))
+        {
+            virtualMemory.ReadBlock(SOURCE_ADDRESS + offset, buffer, Privilege::User);
+            virtualMemory.WriteBlock(DESTINATION_ADDRESS + offset, buffer, Privilege::User);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * BUFFER_SIZE);
+}
+BENCHMARK(BlockCopy)->Arg(4096)->Arg(64 * 1024)->Arg(BUFFER_SIZE);
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+#include <vector>
+
+namespace
+{
+constexpr uint32_t ACCESSES_PER_ITERATION = 1u << 20;
+constexpr uint32_t WORKING_SET_PAGES = 16;
+
+std::vector<uint32_t> MakeAddresses()
+{
+    std::vector<uint32_t> addresses(ACCESSES_PER_ITERATION);
+    for (uint32_t i = 0; i < ACCESSES_PER_ITERATION; ++i)
+    {
+        // Шаг 4 КиБ + 4 байта: страницы перебираются по кругу, смещение внутри страницы меняется
+        addresses[i] = (i % WORKING_SET_PAGES) << PTE::FRAME_SHIFT | (i * 4 & 0xFFF);
+    }
+    return addresses;
+}
+
+// OSHandler - виртуальный вызов обработчика и исключения; MyOS - прямой вызов и коды ошибок
+template<typename Handler>
+void RunFastPathBenchmark(benchmark::State &state, const bool useErrorCodes)
+{
+    PhysicalMemoryConfig config;
+    config.numFrames = 64;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    BasicVirtualMemory<Handler> virtualMemory(physicalMemory, osHandler);
+    virtualMemory.SetPageTableAddress(0);
+
+    const auto addresses = MakeAddresses();
+    // Page fault'ы и установка битов A/D происходят до замера
+    for (uint32_t page = 0; page < WORKING_SET_PAGES; ++page)
+    {
+        virtualMemory.Write32(page << PTE::FRAME_SHIFT, page, Privilege::User);
+    }
+
+    for (auto _ : state)
+    {
+        uint32_t sum = 0;
+        for (const uint32_t address : addresses)
+        {
+            if (useErrorCodes)
+            {
+                uint32_t value = 0;
+                if (virtualMemory.TryRead(address, value, Privilege::User) != AccessStatus::Ok)
+                {
+                    state.SkipWithError("Unexpected access error");
+                    return;
+                }
+                sum += value;
+            }
+            else
+            {
+                sum += virtualMemory.Read32(address, Privilege::User);
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * ACCESSES_PER_ITERATION);
+}
+}
+
+static void VirtualHandlerThrowingRead(benchmark::State &state)
+{
+    RunFastPathBenchmark<OSHandler>(state, false);
+}
+BENCHMARK(VirtualHandlerThrowingRead);
+
+static void StaticHandlerThrowingRead(benchmark::State &state)
+{
+    RunFastPathBenchmark<MyOS>(state, false);
+}
+BENCHMARK(StaticHandlerThrowingRead);
+
+static void StaticHandlerTryRead(benchmark::State &state)
+{
+    RunFastPathBenchmark<MyOS>(state, true);
+}
+BENCHMARK(StaticHandlerTryRead);
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+namespace
+{
+void RunForkBenchmark(benchmark::State &state, const ForkMode mode)
+{
+    const auto pageCount = static_cast<uint32_t>(state.range(0));
+
+    // Места хватает на две полные копии, чтобы в замер не попадало вытеснение
+    PhysicalMemoryConfig config;
+    config.numFrames = 2 * pageCount + 128;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    VirtualMemory parent(physicalMemory, osHandler);
+    parent.SetPageTableAddress(0);
+    for (uint32_t page = 0; page < pageCount; ++page)
+    {
+        parent.Write32(page << PTE::FRAME_SHIFT, page, Privilege::User);
+    }
+    const uint32_t parentFrames = osHandler.GetStats().dataFrames;
+
+    uint32_t framesAfterFork = 0;
+    for (auto _ : state)
+    {
+        VirtualMemory child(physicalMemory, osHandler);
+        osHandler.Fork(parent, child, mode);
+
+        state.PauseTiming();
+        framesAfterFork = osHandler.GetStats().dataFrames;
+        osHandler.ReleaseAddressSpace(child);
+        state.ResumeTiming();
+    }
+
+    state.counters["pages"] = pageCount;
+    state.counters["extra_frames"] = framesAfterFork - parentFrames;
+}
+}
+
+static void CopyOnWriteFork(benchmark::State &state)
+{
+    RunForkBenchmark(state, ForkMode::CopyOnWrite);
+}
+BENCHMARK(CopyOnWriteFork)->RangeMultiplier(8)->Range(64, 32768)->Unit(benchmark::kMicrosecond);
+
+static void EagerFork(benchmark::State &state)
+{
+    RunForkBenchmark(state, ForkMode::Eager);
+}
+BENCHMARK(EagerFork)->RangeMultiplier(8)->Range(64, 32768)->Unit(benchmark::kMicrosecond);
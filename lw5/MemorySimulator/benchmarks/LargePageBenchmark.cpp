@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+namespace
+{
+constexpr uint32_t PAGE_SIZE = 1u << PTE::FRAME_SHIFT;
+constexpr uint32_t LARGE_PAGE_SIZE = PTE::LARGE_PAGE_OFFSET_MASK + 1;
+constexpr uint32_t REGION = 0x10000000;
+
+// Последовательный проход по участку с шагом stride. TLB на 64 записи покрывает 256 КиБ обычных страниц
+// и 64 МиБ больших, поэтому на больших участках обычные страницы промахиваются на каждой новой странице
+void RunSequentialScan(benchmark::State &state, const bool useLargePages)
+{
+    const auto regionSize = static_cast<uint32_t>(state.range(0)) << 20;
+    const auto stride = static_cast<uint32_t>(state.range(1));
+    const uint32_t pageCount = regionSize / PAGE_SIZE;
+
+    PhysicalMemoryConfig config;
+    // Вдвое больше рабочего набора: при переносе в большие страницы нужны свободные выровненные блоки
+    config.numFrames = 2 * pageCount + 2 * PTE::ENTRIES_PER_TABLE;
+    config.backing = PhysicalMemoryBacking::AnonymousMapping;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler);
+    virtualMemory.SetPageTableAddress(0);
+
+    for (uint32_t offset = 0; offset < regionSize; offset += PAGE_SIZE)
+    {
+        virtualMemory.Write32(REGION + offset, offset, Privilege::User);
+    }
+    if (useLargePages)
+    {
+        for (uint32_t offset = 0; offset < regionSize; offset += LARGE_PAGE_SIZE)
+        {
+            if (!osHandler.PromoteLargePage(virtualMemory, REGION + offset))
+            {
+                state.SkipWithError("Large page promotion failed");
+                return;
+            }
+        }
+    }
+
+    const TlbStats before = virtualMemory.GetTlbStats();
+    for (auto _ : state)
+    {
+        uint32_t sum = 0;
+        for (uint32_t offset = 0; offset < regionSize; offset += stride)
+        {
+            uint32_t value = 0;
+            (void)virtualMemory.TryRead(REGION + offset, value, Privilege::User);
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    const TlbStats after = virtualMemory.GetTlbStats();
+
+    const uint64_t hits = after.hits - before.hits;
+    const uint64_t misses = after.misses - before.misses;
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * (regionSize / stride));
+    state.counters["tlb_hit_rate"] = static_cast<double>(hits) / static_cast<double>(hits + misses);
+    state.counters["page_table_kib"] = osHandler.GetStats().pageTableFrames * PAGE_SIZE / 1024.0;
+}
+}
+
+static void SmallPageScan(benchmark::State &state)
+{
+    RunSequentialScan(state, false);
+}
+BENCHMARK(SmallPageScan)->ArgNames({ "mib", "stride" })->ArgsProduct({ { 16, 64 }, { 64, 4096 } });
+
+static void LargePageScan(benchmark::State &state)
+{
+    RunSequentialScan(state, true);
+}
+BENCHMARK(LargePageScan)->ArgNames({ "mib", "stride" })->ArgsProduct({ { 16, 64 }, { 64, 4096 } });
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t ACCESSES_PER_CORE = 200000;
+constexpr uint32_t PAGES_PER_CORE = 64;
+constexpr uint32_t SHARED_PAGES = 16;
+
+// Каждое ядро работает со своими страницами и с общим участком. Памяти меньше рабочего набора даже
+// одного ядра, поэтому вытеснения идут постоянно и рассылают сбросы TLB на остальные ядра
+void RunCore(BasicVirtualMemory<MyOS> &core, const uint32_t coreIndex, const uint32_t writePercent)
+{
+    std::mt19937 generator(coreIndex);
+    std::uniform_int_distribution<uint32_t> pageDistribution(0, PAGES_PER_CORE + SHARED_PAGES - 1);
+    std::uniform_int_distribution<uint32_t> percentDistribution(0, 99);
+    const uint32_t privateBase = SHARED_PAGES + coreIndex * PAGES_PER_CORE;
+
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < ACCESSES_PER_CORE; ++i)
+    {
+        const uint32_t index = pageDistribution(generator);
+        const uint32_t page = index < SHARED_PAGES ? index : privateBase + index - SHARED_PAGES;
+        const uint32_t address = page << PTE::FRAME_SHIFT | (i * 4 & 0xFFF);
+        if (percentDistribution(generator) < writePercent)
+        {
+            benchmark::DoNotOptimize(core.TryWrite(address, i, Privilege::User));
+        }
+        else
+        {
+            uint32_t value = 0;
+            benchmark::DoNotOptimize(core.TryRead(address, value, Privilege::User));
+            sum += value;
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+}
+
+void MultiCoreStress(benchmark::State &state)
+{
+    const auto coreCount = static_cast<uint32_t>(state.range(0));
+    const auto writePercent = static_cast<uint32_t>(state.range(1));
+
+    PhysicalMemoryConfig config;
+    config.numFrames = (SHARED_PAGES + PAGES_PER_CORE) * 3 / 4;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+
+    std::vector<std::unique_ptr<BasicVirtualMemory<MyOS>>> cores;
+    for (uint32_t core = 0; core < coreCount; ++core)
+    {
+        cores.push_back(std::make_unique<BasicVirtualMemory<MyOS>>(physicalMemory, osHandler));
+        cores.back()->SetPageTableAddress(0);
+        osHandler.RegisterCore(*cores.back());
+    }
+
+    for (auto _ : state)
+    {
+        std::vector<std::thread> threads;
+        for (uint32_t core = 0; core < coreCount; ++core)
+        {
+            threads.emplace_back(RunCore, std::ref(*cores[core]), core, writePercent);
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    for (const auto &core : cores)
+    {
+        osHandler.UnregisterCore(*core);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * coreCount * ACCESSES_PER_CORE);
+    state.counters["faults"] = static_cast<double>(osHandler.GetStats().pageFaults);
+}
+}
+
+BENCHMARK(MultiCoreStress)
+    ->ArgNames({"cores", "write_pct"})
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 20}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
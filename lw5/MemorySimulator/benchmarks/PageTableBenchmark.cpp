@@ -0,0 +1,100 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+#include <vector>
+
+namespace
+{
+constexpr uint32_t PAGE_SIZE = 1u << PTE::FRAME_SHIFT;
+
+constexpr uint32_t CLUSTER_COUNT = 4;
+
+enum class Layout
+{
+    Dense,
+    // Несколько плотных участков в разных концах адресного пространства: код, куча, mmap, стек
+    Clustered,
+    // Худший случай: по одной странице на каждую таблицу второго уровня
+    Scattered,
+};
+
+std::vector<uint32_t> MakeAddresses(const uint32_t pageCount, const Layout layout)
+{
+    constexpr uint32_t clusterStride = (1u << (32 - PTE::FRAME_SHIFT)) / CLUSTER_COUNT;
+
+    std::vector<uint32_t> addresses;
+    addresses.reserve(pageCount);
+    for (uint32_t i = 0; i < pageCount; ++i)
+    {
+        uint32_t vpn = i;
+        if (layout == Layout::Clustered)
+        {
+            vpn = (i % CLUSTER_COUNT) * clusterStride + i / CLUSTER_COUNT;
+        }
+        else if (layout == Layout::Scattered)
+        {
+            vpn = i * PTE::ENTRIES_PER_TABLE;
+        }
+        addresses.push_back(vpn * PAGE_SIZE);
+    }
+    return addresses;
+}
+
+// TLB отключён, чтобы каждое обращение проходило полный обход двух уровней
+void RunPageTableBenchmark(benchmark::State &state, const Layout layout)
+{
+    const auto pageCount = static_cast<uint32_t>(state.range(0));
+
+    PhysicalMemoryConfig config;
+    config.numFrames = 1 + 2 * pageCount;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = 0;
+    VirtualMemory virtualMemory(physicalMemory, osHandler, tlbConfig);
+    virtualMemory.SetPageTableAddress(0);
+
+    const auto addresses = MakeAddresses(pageCount, layout);
+    for (const uint32_t address : addresses)
+    {
+        virtualMemory.Write32(address, address, Privilege::User);
+    }
+
+    for (auto _ : state)
+    {
+        uint32_t sum = 0;
+        for (const uint32_t address : addresses)
+        {
+            sum += virtualMemory.Read32(address, Privilege::User);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    const MyOSStats stats = osHandler.GetStats();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * pageCount);
+    state.counters["page_table_frames"] = stats.pageTableFrames + 1;
+    state.counters["page_table_kib"] = (stats.pageTableFrames + 1) * PAGE_SIZE / 1024.0;
+    state.counters["data_frames"] = stats.dataFrames;
+}
+}
+
+static void DenseTranslation(benchmark::State &state)
+{
+    RunPageTableBenchmark(state, Layout::Dense);
+}
+BENCHMARK(DenseTranslation)->Arg(64)->Arg(1024);
+
+static void ClusteredTranslation(benchmark::State &state)
+{
+    RunPageTableBenchmark(state, Layout::Clustered);
+}
+BENCHMARK(ClusteredTranslation)->Arg(64)->Arg(1024);
+
+static void ScatteredTranslation(benchmark::State &state)
+{
+    RunPageTableBenchmark(state, Layout::Scattered);
+}
+BENCHMARK(ScatteredTranslation)->Arg(64)->Arg(1024);
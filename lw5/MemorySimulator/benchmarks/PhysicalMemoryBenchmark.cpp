@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+
+#include "PhysicalMemory.h"
+
+#include <fstream>
+#include <unistd.h>
+
+namespace
+{
+// Резидентный размер процесса в байтах по /proc/self/statm
+uint64_t GetResidentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t totalPages = 0;
+    uint64_t residentPages = 0;
+    statm >> totalPages >> residentPages;
+    return residentPages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Разреженная нагрузка: касаемся одного слова в каждом 256-м кадре
+void TouchSparse(PhysicalMemory &physicalMemory, const uint32_t numFrames)
+{
+    for (uint32_t frame = 0; frame < numFrames; frame += 256)
+    {
+        physicalMemory.Write32(frame * 4096, frame);
+    }
+}
+
+void RunConstruction(benchmark::State &state, const PhysicalMemoryBacking backing)
+{
+    PhysicalMemoryConfig config;
+    config.numFrames = static_cast<uint32_t>(state.range(0));
+    config.backing = backing;
+
+    uint64_t residentDelta = 0;
+    for (auto _ : state)
+    {
+        const uint64_t residentBefore = GetResidentBytes();
+        PhysicalMemory physicalMemory(config);
+        TouchSparse(physicalMemory, config.numFrames);
+        residentDelta = GetResidentBytes() - residentBefore;
+        benchmark::DoNotOptimize(physicalMemory.Read32(0));
+    }
+    state.counters["RssMiB"] = static_cast<double>(residentDelta) / (1024.0 * 1024.0);
+}
+}
+
+static void VectorBacking(benchmark::State &state)
+{
+    RunConstruction(state, PhysicalMemoryBacking::Vector);
+}
+
+static void AnonymousMappingBacking(benchmark::State &state)
+{
+    RunConstruction(state, PhysicalMemoryBacking::AnonymousMapping);
+}
+
+// Вектор зануляет всю память сразу, поэтому ограничиваемся 1 ГиБ
+BENCHMARK(VectorBacking)->RangeMultiplier(16)->Range(4, 1 << 18)->Unit(benchmark::kMillisecond);
+BENCHMARK(AnonymousMappingBacking)->RangeMultiplier(16)->Range(4, 1 << 20)->Unit(benchmark::kMillisecond);
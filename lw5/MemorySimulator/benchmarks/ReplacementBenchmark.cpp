@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "Trace.h"
+#include "TraceReplayer.h"
+#include "VirtualMemory.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t FRAMES = 64;
+constexpr uint32_t PAGES = 128;
+constexpr uint32_t TRACE_LENGTH = 20000;
+
+void ReportReplayStats(benchmark::State &state, const ReplayStats &stats)
+{
+    state.counters["fault_rate"] = static_cast<double>(stats.pageFaults) / static_cast<double>(stats.accesses);
+    state.counters["tlb_hit_rate"] = static_cast<double>(stats.tlbHits)
+                                     / static_cast<double>(stats.tlbHits + stats.tlbMisses);
+    state.counters["dirty_write_backs"] = static_cast<double>(stats.dirtyWriteBacks);
+    state.counters["failed"] = static_cast<double>(stats.failedAccesses);
+}
+
+void RunReplacementBenchmark(benchmark::State &state, const ReplacementPolicyKind policy, const TracePattern pattern)
+{
+    TraceGeneratorConfig traceConfig;
+    traceConfig.pattern = pattern;
+    traceConfig.pageCount = PAGES;
+    traceConfig.length = TRACE_LENGTH;
+    const auto trace = GenerateTrace(traceConfig);
+
+    ReplayStats stats;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        PhysicalMemoryConfig config;
+        config.numFrames = FRAMES;
+        PhysicalMemory physicalMemory(config);
+        MyOSConfig osConfig;
+        osConfig.replacementPolicy = policy;
+        MyOS osHandler(physicalMemory, osConfig);
+        BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler);
+        virtualMemory.SetPageTableAddress(0);
+        TraceReplayer replayer(virtualMemory, osHandler);
+        state.ResumeTiming();
+
+        replayer.Replay(trace);
+        stats = replayer.GetStats();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * TRACE_LENGTH);
+    ReportReplayStats(state, stats);
+}
+}
+
+static void Replacement(benchmark::State &state)
+{
+    RunReplacementBenchmark(state,
+                            static_cast<ReplacementPolicyKind>(state.range(0)),
+                            static_cast<TracePattern>(state.range(1)));
+}
+BENCHMARK(Replacement)
+    ->ArgNames({ "policy", "trace" })
+    ->ArgsProduct({ { static_cast<int64_t>(ReplacementPolicyKind::Fifo),
+                      static_cast<int64_t>(ReplacementPolicyKind::Clock),
+                      static_cast<int64_t>(ReplacementPolicyKind::Aging) },
+                    { static_cast<int64_t>(TracePattern::Loop),
+                      static_cast<int64_t>(TracePattern::Uniform),
+                      static_cast<int64_t>(TracePattern::HotCold) } });
+
+// Трасса из файла читается порциями, как в replay_trace; замер включает разбор записей
+static void TraceFileReplay(benchmark::State &state)
+{
+    const auto tracePath = std::filesystem::temp_directory_path() / "memory-simulator-benchmark.trace";
+    TraceGeneratorConfig traceConfig;
+    traceConfig.pattern = TracePattern::HotCold;
+    traceConfig.pageCount = PAGES;
+    traceConfig.length = static_cast<uint32_t>(state.range(0));
+    {
+        TraceRecorder recorder(tracePath);
+        recorder.Record(GenerateTrace(traceConfig));
+    }
+
+    ReplayStats stats;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        PhysicalMemoryConfig config;
+        config.numFrames = FRAMES;
+        PhysicalMemory physicalMemory(config);
+        MyOS osHandler(physicalMemory);
+        BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler);
+        virtualMemory.SetPageTableAddress(0);
+        TraceReplayer replayer(virtualMemory, osHandler);
+        state.ResumeTiming();
+
+        TraceReader reader(tracePath);
+        for (auto chunk = reader.ReadChunk(); !chunk.empty(); chunk = reader.ReadChunk())
+        {
+            replayer.Replay(chunk);
+        }
+        stats = replayer.GetStats();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+    ReportReplayStats(state, stats);
+    std::filesystem::remove(tracePath);
+}
+BENCHMARK(TraceFileReplay)->Arg(1 << 20);
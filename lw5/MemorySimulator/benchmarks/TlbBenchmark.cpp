@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "VirtualMemory.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t PAGE_TABLE_FRAMES = 4;
+constexpr uint32_t ACCESSES_PER_ITERATION = 100000;
+
+// Заранее заполняет таблицу страниц, чтобы в замер не попадали page fault'ы
+void MapPages(PhysicalMemory &physicalMemory, const uint32_t pageCount)
+{
+    for (uint32_t vpn = 0; vpn < pageCount; ++vpn)
+    {
+        const uint32_t tableFrame = 1 + PTE::GetDirectoryIndex(vpn);
+        PTE directoryEntry;
+        directoryEntry.SetPresent(true);
+        directoryEntry.SetWritable(true);
+        directoryEntry.SetUser(true);
+        directoryEntry.SetFrame(tableFrame);
+        physicalMemory.Write32(PTE::GetDirectoryIndex(vpn) * sizeof(PTE), directoryEntry.raw);
+
+        PTE pte;
+        pte.SetPresent(true);
+        pte.SetWritable(true);
+        pte.SetUser(true);
+        pte.SetFrame(PAGE_TABLE_FRAMES + vpn);
+        physicalMemory.Write32((tableFrame << PTE::FRAME_SHIFT) + PTE::GetTableIndex(vpn) * sizeof(PTE), pte.raw);
+    }
+}
+
+std::vector<uint32_t> MakeAddresses(const uint32_t pageCount, const bool random)
+{
+    std::vector<uint32_t> addresses(ACCESSES_PER_ITERATION);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> distribution(0, pageCount * 4096 / sizeof(uint32_t) - 1);
+    for (uint32_t i = 0; i < ACCESSES_PER_ITERATION; ++i)
+    {
+        addresses[i] = random
+                           ? distribution(generator) * static_cast<uint32_t>(sizeof(uint32_t))
+                           : (i * 64) % (pageCount * 4096);
+    }
+    return addresses;
+}
+
+void RunTlbBenchmark(benchmark::State &state, const TlbConfig tlbConfig, const bool random)
+{
+    const auto pageCount = static_cast<uint32_t>(state.range(0));
+
+    PhysicalMemoryConfig config;
+    config.numFrames = PAGE_TABLE_FRAMES + pageCount;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    VirtualMemory virtualMemory(physicalMemory, osHandler, tlbConfig);
+    virtualMemory.SetPageTableAddress(0);
+    MapPages(physicalMemory, pageCount);
+
+    const auto addresses = MakeAddresses(pageCount, random);
+    for (auto _ : state)
+    {
+        uint32_t sum = 0;
+        for (const uint32_t address : addresses)
+        {
+            sum += virtualMemory.Read32(address, Privilege::User);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * ACCESSES_PER_ITERATION);
+    state.counters["tlb_hit_rate"] = virtualMemory.GetTlbStats().GetHitRate();
+}
+
+TlbConfig MakeTlbConfig(const uint32_t numSets, const uint32_t associativity)
+{
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = numSets;
+    tlbConfig.associativity = associativity;
+    return tlbConfig;
+}
+}
+
+static void NoTlbRandom(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(0, 0), true);
+}
+BENCHMARK(NoTlbRandom)->Arg(16)->Arg(64)->Arg(512);
+
+static void DirectMapped64Random(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(64, 1), true);
+}
+BENCHMARK(DirectMapped64Random)->Arg(16)->Arg(64)->Arg(512);
+
+static void FourWay64Random(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(16, 4), true);
+}
+BENCHMARK(FourWay64Random)->Arg(16)->Arg(64)->Arg(512);
+
+static void FullyAssociative64Random(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(1, 64), true);
+}
+BENCHMARK(FullyAssociative64Random)->Arg(16)->Arg(64)->Arg(512);
+
+static void NoTlbSequential(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(0, 0), false);
+}
+BENCHMARK(NoTlbSequential)->Arg(512);
+
+static void FourWay64Sequential(benchmark::State &state)
+{
+    RunTlbBenchmark(state, MakeTlbConfig(16, 4), false);
+}
+BENCHMARK(FourWay64Sequential)->Arg(512);
@@ -0,0 +1,14 @@
+#ifndef MEMORYSIMULATOR_ACCESSSTATUS_H
+#define MEMORYSIMULATOR_ACCESSSTATUS_H
+
+// Результат обращения без исключений; исключения бросают только обёртки Read*/Write*
+enum class AccessStatus
+{
+    Ok,
+    MisalignedAccess,
+    PhysicalAccessOutOfRange,
+    UnhandledPageFault,
+};
+
+
+#endif //MEMORYSIMULATOR_ACCESSSTATUS_H
@@ -0,0 +1,32 @@
+#ifndef MEMORYSIMULATOR_LOGSINK_H
+#define MEMORYSIMULATOR_LOGSINK_H
+#include <ostream>
+#include <string_view>
+
+class LogSink
+{
+public:
+    virtual ~LogSink() = default;
+
+    virtual void Write(std::string_view message) = 0;
+};
+
+class StreamLogSink final : public LogSink
+{
+public:
+    explicit StreamLogSink(std::ostream &stream)
+        : m_stream(stream)
+    {
+    }
+
+    void Write(const std::string_view message) override
+    {
+        m_stream << message << '\n';
+    }
+
+private:
+    std::ostream &m_stream;
+};
+
+
+#endif //MEMORYSIMULATOR_LOGSINK_H
@@ -1,19 +1,173 @@
 #ifndef MEMORYSIMULATOR_MYOS_H
 #define MEMORYSIMULATOR_MYOS_H
+#include "LogSink.h"
 #include "OSHandler.h"
 #include "PhysicalMemory.h"
+#include "ReplacementPolicy.h"
+#include "SwapFile.h"
+#include "TlbShootdown.h"
 
-class MyOS : public OSHandler
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+struct MyOSConfig
+{
+    ReplacementPolicyKind replacementPolicy = ReplacementPolicyKind::Clock;
+    // Пустой путь - временный файл подкачки
+    std::filesystem::path swapFilePath;
+    // Кадры в начале памяти, которые ОС не раздаёт (по умолчанию кадр 0 под каталог страниц)
+    uint32_t reservedFrames = 1;
+    // nullptr - журнал событий не ведётся и сообщения не форматируются
+    LogSink *logSink = nullptr;
+};
+
+enum class ForkMode
+{
+    // Кадры разделяются, копия создаётся при первой записи
+    CopyOnWrite,
+    // Все страницы копируются сразу
+    Eager,
+};
+
+struct MyOSStats
+{
+    uint64_t pageFaults = 0;
+    uint32_t dataFrames = 0;
+    uint32_t pageTableFrames = 0;
+    uint64_t evictions = 0;
+    uint64_t dirtyWriteBacks = 0;
+    uint64_t swapIns = 0;
+    // Кадры, на которые ссылается больше одной PTE
+    uint32_t sharedFrames = 0;
+    uint64_t copyOnWriteCopies = 0;
+    // Страницы 4 МиБ; их кадры не входят в dataFrames и не вытесняются
+    uint32_t largePages = 0;
+};
+
+// final: BasicVirtualMemory<MyOS> вызывает OnPageFault без виртуальной диспетчеризации
+class MyOS final : public OSHandler
 {
 public:
-    explicit MyOS(PhysicalMemory &physicalMemory);
+    explicit MyOS(PhysicalMemory &physicalMemory, MyOSConfig config = {});
+
+    bool OnPageFault(VirtualMemoryBase &virtualMemory, uint32_t virtualPageNumber,
+                     Access access, PageFaultReason reason) override;
+
+    [[nodiscard]] MyOSStats GetStats() const noexcept;
+
+    // Восстанавливает учёт кадров по таблицам страниц, уже лежащим в памяти (например, в образе
+    // PhysicalMemoryBacking::FileMapping). Выгруженные в swap страницы восстановить нельзя
+    void AdoptAddressSpace(VirtualMemoryBase &virtualMemory);
+
+    // Выделяет child собственный каталог страниц и копирует в него адресное пространство parent.
+    // Бросает std::runtime_error, если для таблиц страниц не хватило памяти
+    void Fork(VirtualMemoryBase &parent, VirtualMemoryBase &child, ForkMode mode = ForkMode::CopyOnWrite);
+
+    // Освобождает все кадры, таблицы и слоты swap адресного пространства (завершение процесса)
+    void ReleaseAddressSpace(VirtualMemoryBase &virtualMemory);
+
+    // Собирает выровненный участок 4 МиБ, содержащий virtualAddress, в одну большую страницу: содержимое
+    // переносится в свободный выровненный блок из 1024 кадров, таблица второго уровня освобождается.
+    // Неотображённые страницы участка заполняются нулями, разделяемые копируются. false, если у страниц
+    // участка разные права или подходящий блок кадров не нашёлся. Fork разбивает большие страницы обратно
+    bool PromoteLargePage(VirtualMemoryBase &virtualMemory, uint32_t virtualAddress);
+
+    // Ядро, работающее в отдельном потоке. После изменения PTE ОС сбрасывает страницу в TLB всех
+    // зарегистрированных ядер с тем же каталогом страниц. Все методы MyOS потокобезопасны
+    void RegisterCore(VirtualMemoryBase &core);
+
+    void UnregisterCore(VirtualMemoryBase &core);
 
-    bool OnPageFault(VirtualMemory &virtualMemory, uint32_t virtualPageNumber,
-                             Access access, PageFaultReason reason) override;
 private:
+    enum class FrameUse
+    {
+        Free,
+        Reserved,
+        PageTable,
+        Data,
+        // Часть большой страницы
+        LargePage,
+    };
+
+    struct FrameMapping
+    {
+        // Любое ядро, исполняющее адресное пространство; PTE однозначно задаётся адресом pteAddress
+        VirtualMemoryBase *owner = nullptr;
+        uint32_t virtualPageNumber = 0;
+        uint32_t pteAddress = 0;
+    };
+
+    struct FrameInfo
+    {
+        FrameUse use = FrameUse::Free;
+        // Обратное отображение: все PTE, указывающие на кадр. Его длина - счётчик ссылок
+        std::vector<FrameMapping> mappings;
+        // Слот с копией страницы; пока бит D сброшен, копия актуальна и запись при вытеснении не нужна
+        std::optional<uint32_t> swapSlot;
+    };
+
+    [[nodiscard]] std::optional<uint32_t> AllocateFrame();
+
+    [[nodiscard]] std::optional<uint32_t> EvictFrame();
+
+    // Выгружает страницу из кадра в swap у всех отображающих её PTE
+    void SwapOut(uint32_t frame);
+
+    // Первый кадр выровненного блока под большую страницу: в блоке нет таблиц и зарезервированных кадров,
+    // а вытеснять из него нужно как можно меньше чужих страниц
+    [[nodiscard]] std::optional<uint32_t> FindLargePageBlock(uint32_t tableFrame) const;
+
+    // Разбивает большую страницу обратно на 1024 обычные с новой таблицей второго уровня
+    void DemoteLargePage(VirtualMemoryBase &virtualMemory, uint32_t firstVpn);
+
+    void ReleaseLargePage(uint32_t firstFrame);
+
+    bool HandleNotPresent(VirtualMemoryBase &virtualMemory, uint32_t virtualPageNumber, Access access);
+
+    bool HandleCopyOnWrite(VirtualMemoryBase &virtualMemory, uint32_t virtualPageNumber);
+
+    void ForkPage(VirtualMemoryBase &parent, VirtualMemoryBase &child, uint32_t virtualPageNumber, ForkMode mode);
+
+    void AddMapping(uint32_t frame, const FrameMapping &mapping);
+
+    // Удаляет ссылку PTE по адресу pteAddress на кадр; кадр без ссылок освобождается
+    void RemoveMapping(uint32_t frame, uint32_t pteAddress);
+
+    // Сбрасывает страницу в TLB всех ядер, исполняющих адресное пространство owner
+    void InvalidateMapping(const FrameMapping &mapping);
+
+    void ReleaseFrame(uint32_t frame);
+
+    void RetainSlot(uint32_t slot);
+
+    void ReleaseSlot(uint32_t slot);
+
+    void DropFrameSlot(uint32_t frame);
+
+    [[nodiscard]] bool TestAndClearAccessed(uint32_t frame);
+
+    [[nodiscard]] std::optional<uint32_t> EnsurePageTable(VirtualMemoryBase &virtualMemory, uint32_t virtualPageNumber);
+
+    [[nodiscard]] std::optional<uint32_t> AllocateZeroedTableFrame();
+
+    void ZeroFrame(uint32_t frame);
+
     PhysicalMemory& m_physicalMemory;
-    uint32_t m_nextFreeFrame;
+    std::vector<FrameInfo> m_frames;
+    std::vector<uint32_t> m_freeFrames;
+    std::unique_ptr<ReplacementPolicy> m_policy;
+    AccessedBitProbe m_accessedBitProbe;
+    SwapFile m_swapFile;
+    // Число ссылок на слот: выгруженные PTE и кадры, для которых слот хранит актуальную копию
+    std::vector<uint32_t> m_slotReferences;
+    LogSink *m_logSink;
+    TlbShootdown m_shootdown;
+    mutable std::mutex m_mutex;
+    MyOSStats m_stats;
 };
 
 
-#endif //MEMORYSIMULATOR_MYOS_H
\ No newline at end of file
+#endif //MEMORYSIMULATOR_MYOS_H
@@ -1,7 +1,7 @@
 #ifndef MEMORYSIMULATOR_OSHANDLER_H
 #define MEMORYSIMULATOR_OSHANDLER_H
 #include <cstdint>
-class VirtualMemory;
+class VirtualMemoryBase;
 
 
 enum class Access
@@ -25,7 +25,7 @@ class OSHandler
 public:
     virtual ~OSHandler() = default;
 
-    virtual bool OnPageFault(VirtualMemory &virtualMemory, uint32_t virtualPageNumber,
+    virtual bool OnPageFault(VirtualMemoryBase &virtualMemory, uint32_t virtualPageNumber,
                              Access access, PageFaultReason reason) = 0;
 };
 
@@ -0,0 +1,65 @@
+#ifndef MEMORYSIMULATOR_PAGETABLEENTRY_H
+#define MEMORYSIMULATOR_PAGETABLEENTRY_H
+#include <cstdint>
+
+struct PTE
+{
+    uint32_t raw = 0;
+
+    static constexpr uint32_t P = 1u << 0;
+    static constexpr uint32_t RW = 1u << 1;
+    static constexpr uint32_t US = 1u << 2;
+    static constexpr uint32_t A = 1u << 5;
+    static constexpr uint32_t D = 1u << 6;
+    // Только в записи каталога: запись сама отображает выровненный участок 4 МиБ, таблицы второго уровня нет
+    static constexpr uint32_t PS = 1u << 7;
+    // Бит, отданный ОС: у отсутствующей страницы он означает, что поле кадра хранит номер слота в swap
+    static constexpr uint32_t SWAPPED = 1u << 9;
+    // Страница разделена после Fork и доступна только для чтения; первая запись копирует кадр
+    static constexpr uint32_t COW = 1u << 10;
+    static constexpr uint32_t NX = 1u << 31;
+
+    static constexpr uint32_t FRAME_SHIFT = 12;
+    static constexpr uint32_t FRAME_MASK = 0xFFFFF000u;
+
+    // Двухуровневая схема как в x86: 10 бит индекса каталога, 10 бит индекса таблицы, 12 бит смещения
+    static constexpr uint32_t DIRECTORY_SHIFT = 22;
+    static constexpr uint32_t ENTRIES_PER_TABLE = 1024;
+    static constexpr uint32_t LARGE_PAGE_OFFSET_MASK = (1u << DIRECTORY_SHIFT) - 1;
+
+    [[nodiscard]] static constexpr uint32_t GetDirectoryIndex(const uint32_t vpn) { return vpn / ENTRIES_PER_TABLE; }
+    [[nodiscard]] static constexpr uint32_t GetTableIndex(const uint32_t vpn) { return vpn % ENTRIES_PER_TABLE; }
+
+    [[nodiscard]] uint32_t GetFrame() const { return (raw & FRAME_MASK) >> FRAME_SHIFT; }
+    void SetFrame(const uint32_t fn) { raw = (raw & ~FRAME_MASK) | (fn << FRAME_SHIFT); }
+
+    [[nodiscard]] bool IsPresent() const { return raw & P; }
+    void SetPresent(const bool v) { raw = v ? (raw | P) : (raw & ~P); }
+
+    [[nodiscard]] bool IsWritable() const { return raw & RW; }
+    void SetWritable(const bool v) { raw = v ? (raw | RW) : (raw & ~RW); }
+
+    [[nodiscard]] bool IsUser() const { return raw & US; }
+    void SetUser(const bool v) { raw = v ? (raw | US) : (raw & ~US); }
+
+    [[nodiscard]] bool IsAccessed() const { return raw & A; }
+    void SetAccessed(const bool v) { raw = v ? (raw | A) : (raw & ~A); }
+
+    [[nodiscard]] bool IsDirty() const { return raw & D; }
+    void SetDirty(const bool v) { raw = v ? (raw | D) : (raw & ~D); }
+
+    [[nodiscard]] bool IsLargePage() const { return raw & PS; }
+    void SetLargePage(const bool v) { raw = v ? (raw | PS) : (raw & ~PS); }
+
+    [[nodiscard]] bool IsSwapped() const { return raw & SWAPPED; }
+    void SetSwapped(const bool v) { raw = v ? (raw | SWAPPED) : (raw & ~SWAPPED); }
+
+    [[nodiscard]] bool IsCopyOnWrite() const { return raw & COW; }
+    void SetCopyOnWrite(const bool v) { raw = v ? (raw | COW) : (raw & ~COW); }
+
+    [[nodiscard]] bool IsNX() const { return raw & NX; }
+    void SetNX(const bool v) { raw = v ? (raw | NX) : (raw & ~NX); }
+};
+
+
+#endif //MEMORYSIMULATOR_PAGETABLEENTRY_H
@@ -1,14 +1,31 @@
 #ifndef MEMORYSIMULATOR_PHYSICALMEMORY_H
 #define MEMORYSIMULATOR_PHYSICALMEMORY_H
+#include "AccessStatus.h"
+
+#include <atomic>
 #include <cstdint>
+#include <filesystem>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
 
+enum class PhysicalMemoryBacking
+{
+    // Память выделяется и зануляется сразу
+    Vector,
+    // Анонимное отображение: страницы хоста выделяются при первом обращении
+    AnonymousMapping,
+    // Отображение файла-образа: содержимое переживает перезапуск симуляции
+    FileMapping,
+};
+
 struct PhysicalMemoryConfig
 {
     uint32_t numFrames = 1024;
     uint32_t frameSize = 4096;
+    PhysicalMemoryBacking backing = PhysicalMemoryBacking::Vector;
+    std::filesystem::path imagePath;
 };
 
 class PhysicalMemory
@@ -16,7 +33,19 @@ class PhysicalMemory
 public:
     explicit PhysicalMemory(PhysicalMemoryConfig cfg);
 
-    [[nodiscard]] uint32_t GetSize() const noexcept;
+    ~PhysicalMemory();
+
+    PhysicalMemory(const PhysicalMemory &) = delete;
+
+    PhysicalMemory &operator=(const PhysicalMemory &) = delete;
+
+    [[nodiscard]] uint64_t GetSize() const noexcept;
+
+    // true, если FileMapping открыл существующий образ; образ другого размера конструктор отвергает
+    [[nodiscard]] bool IsResumedImage() const noexcept;
+
+    // Сбрасывает изменения образа на диск; для остальных видов памяти ничего не делает
+    void Sync();
 
     [[nodiscard]] uint8_t Read8(uint32_t address) const;
 
@@ -34,41 +63,86 @@ public:
 
     void Write64(uint32_t address, uint64_t value);
 
-private:
+    // Атомарные операции над 32-битными словами (PTE): ядра выставляют биты A/D, пока ОС меняет записи
+    [[nodiscard]] bool CompareExchange32(uint32_t address, uint32_t &expected, uint32_t desired);
+
+    uint32_t Exchange32(uint32_t address, uint32_t value);
+
+    uint32_t FetchAnd32(uint32_t address, uint32_t mask);
+
+    uint32_t FetchOr32(uint32_t address, uint32_t mask);
+
+    // Блочные операции не атомарны относительно обращений других ядер
+    void ReadBlock(uint32_t address, std::span<uint8_t> buffer) const;
+
+    void WriteBlock(uint32_t address, std::span<const uint8_t> data);
+
+    void ZeroBlock(uint32_t address, uint32_t size);
+
     template<typename T>
-    T Read(const uint32_t address) const
+    [[nodiscard]] AccessStatus TryRead(const uint32_t address, T &value) const noexcept
     {
         if (address % sizeof(T) != 0)
         {
-            throw std::runtime_error("Misaligned memory access");
+            return AccessStatus::MisalignedAccess;
         }
-
-        if (address + sizeof(T) > m_memory.size())
+        if (address + sizeof(T) > m_size)
         {
-            throw std::out_of_range("Physical memory access out of range");
+            return AccessStatus::PhysicalAccessOutOfRange;
         }
 
-        const T *ptr = reinterpret_cast<const T *>(m_memory.data() + address);
-        return *ptr;
+        // acquire/release как у x86: ядро, увидевшее новую PTE, увидит и заполненный ОС кадр
+        value = std::atomic_ref(*reinterpret_cast<T *>(m_data + address)).load(std::memory_order_acquire);
+        return AccessStatus::Ok;
     }
 
     template<typename T>
-    void Write(const uint32_t address, T value)
+    [[nodiscard]] AccessStatus TryWrite(const uint32_t address, const T value) noexcept
     {
         if (address % sizeof(T) != 0)
         {
-            throw std::runtime_error("Misaligned memory access");
+            return AccessStatus::MisalignedAccess;
         }
-        if (address + sizeof(T) > m_memory.size())
+        if (address + sizeof(T) > m_size)
         {
-            throw std::out_of_range("Physical memory access out of range");
+            return AccessStatus::PhysicalAccessOutOfRange;
         }
 
-        T *ptr = reinterpret_cast<T *>(m_memory.data() + address);
-        *ptr = value;
+        std::atomic_ref(*reinterpret_cast<T *>(m_data + address)).store(value, std::memory_order_release);
+        return AccessStatus::Ok;
+    }
+
+private:
+    void CheckBlockRange(uint32_t address, size_t size) const;
+
+    void MapAnonymous();
+
+    void MapFile(const std::filesystem::path &path);
+
+    template<typename T>
+    T Read(const uint32_t address) const
+    {
+        T value{};
+        ThrowOnError(TryRead(address, value));
+        return value;
+    }
+
+    template<typename T>
+    void Write(const uint32_t address, T value)
+    {
+        ThrowOnError(TryWrite(address, value));
     }
 
+    static void ThrowOnError(AccessStatus status);
+
+    [[nodiscard]] std::atomic_ref<uint32_t> GetWord(uint32_t address);
+
     std::vector<uint8_t> m_memory;
+    uint8_t *m_data = nullptr;
+    uint64_t m_size = 0;
+    bool m_isMapped = false;
+    bool m_isResumedImage = false;
+    int m_imageFd = -1;
 };
 
 
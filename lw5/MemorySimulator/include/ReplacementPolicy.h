@@ -0,0 +1,94 @@
+#ifndef MEMORYSIMULATOR_REPLACEMENTPOLICY_H
+#define MEMORYSIMULATOR_REPLACEMENTPOLICY_H
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <vector>
+
+enum class ReplacementPolicyKind
+{
+    Fifo,
+    Clock,
+    Aging,
+};
+
+// Проверяет и сбрасывает бит A у страницы, отображённой в кадр
+using AccessedBitProbe = std::function<bool(uint32_t frame)>;
+
+// Политика видит только кадры, которые можно вытеснить: каталоги и таблицы страниц в неё не попадают
+class ReplacementPolicy
+{
+public:
+    virtual ~ReplacementPolicy() = default;
+
+    virtual void OnFrameMapped(uint32_t frame) = 0;
+
+    virtual void OnFrameUnmapped(uint32_t frame) = 0;
+
+    // Вызывается на каждом page fault, играет роль таймерного прерывания
+    virtual void OnTick(const AccessedBitProbe &testAndClearAccessed);
+
+    [[nodiscard]] virtual std::optional<uint32_t> SelectVictim(const AccessedBitProbe &testAndClearAccessed) = 0;
+};
+
+class FifoPolicy final : public ReplacementPolicy
+{
+public:
+    explicit FifoPolicy(uint32_t numFrames);
+
+    void OnFrameMapped(uint32_t frame) override;
+
+    void OnFrameUnmapped(uint32_t frame) override;
+
+    [[nodiscard]] std::optional<uint32_t> SelectVictim(const AccessedBitProbe &testAndClearAccessed) override;
+
+private:
+    std::list<uint32_t> m_queue;
+    std::vector<std::list<uint32_t>::iterator> m_positions;
+    std::vector<bool> m_tracked;
+};
+
+class ClockPolicy final : public ReplacementPolicy
+{
+public:
+    explicit ClockPolicy(uint32_t numFrames);
+
+    void OnFrameMapped(uint32_t frame) override;
+
+    void OnFrameUnmapped(uint32_t frame) override;
+
+    [[nodiscard]] std::optional<uint32_t> SelectVictim(const AccessedBitProbe &testAndClearAccessed) override;
+
+private:
+    std::vector<bool> m_tracked;
+    uint32_t m_trackedCount = 0;
+    uint32_t m_hand = 0;
+};
+
+// Приближение LRU: 8-битный счётчик возраста, сдвигаемый на каждом тике
+class AgingPolicy final : public ReplacementPolicy
+{
+public:
+    explicit AgingPolicy(uint32_t numFrames);
+
+    void OnFrameMapped(uint32_t frame) override;
+
+    void OnFrameUnmapped(uint32_t frame) override;
+
+    void OnTick(const AccessedBitProbe &testAndClearAccessed) override;
+
+    [[nodiscard]] std::optional<uint32_t> SelectVictim(const AccessedBitProbe &testAndClearAccessed) override;
+
+private:
+    std::vector<uint8_t> m_ages;
+    std::vector<bool> m_tracked;
+    uint32_t m_faultsPerTick;
+    uint32_t m_faultsSinceTick = 0;
+};
+
+std::unique_ptr<ReplacementPolicy> CreateReplacementPolicy(ReplacementPolicyKind kind, uint32_t numFrames);
+
+
+#endif //MEMORYSIMULATOR_REPLACEMENTPOLICY_H
@@ -0,0 +1,41 @@
+#ifndef MEMORYSIMULATOR_SWAPFILE_H
+#define MEMORYSIMULATOR_SWAPFILE_H
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+// Файл подкачки из слотов размером в страницу. Пустой путь - временный файл, удаляемый в деструкторе
+class SwapFile
+{
+public:
+    SwapFile(const std::filesystem::path &path, uint32_t pageSize);
+
+    ~SwapFile();
+
+    SwapFile(const SwapFile &) = delete;
+
+    SwapFile &operator=(const SwapFile &) = delete;
+
+    [[nodiscard]] uint32_t AllocateSlot();
+
+    void FreeSlot(uint32_t slot);
+
+    void Read(uint32_t slot, std::span<uint8_t> page);
+
+    void Write(uint32_t slot, std::span<const uint8_t> page);
+
+    [[nodiscard]] uint32_t GetUsedSlotCount() const noexcept;
+
+private:
+    std::filesystem::path m_path;
+    bool m_isTemporary;
+    uint32_t m_pageSize;
+    std::fstream m_stream;
+    std::vector<uint32_t> m_freeSlots;
+    uint32_t m_slotCount = 0;
+};
+
+
+#endif //MEMORYSIMULATOR_SWAPFILE_H
@@ -0,0 +1,110 @@
+#ifndef MEMORYSIMULATOR_TLB_H
+#define MEMORYSIMULATOR_TLB_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PageTableEntry.h"
+
+// numSets * associativity записей; associativity = 1 даёт кэш прямого отображения,
+// numSets = 1 - полностью ассоциативный. numSets = 0 отключает TLB
+struct TlbConfig
+{
+    uint32_t numSets = 16;
+    uint32_t associativity = 4;
+    // Отдельный полностью ассоциативный TLB для страниц 4 МиБ, как у x86
+    uint32_t largePageEntries = 16;
+};
+
+struct TlbStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Часть hits, пришедшаяся на TLB больших страниц
+    uint64_t largePageHits = 0;
+
+    [[nodiscard]] double GetHitRate() const
+    {
+        const uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+    }
+};
+
+struct TlbEntry
+{
+    // Для большой страницы - номер её первой 4 КиБ страницы
+    uint32_t virtualPageNumber = 0;
+    PTE pte;
+    // Биты виртуального адреса, которые переходят в физический без изменений
+    uint32_t offsetMask = (1u << PTE::FRAME_SHIFT) - 1;
+    uint32_t pteAddress = 0;
+    uint64_t lastUse = 0;
+    bool valid = false;
+};
+
+class Tlb
+{
+public:
+    explicit Tlb(TlbConfig config = {});
+
+    // Определён в заголовке, чтобы попадание в TLB встраивалось в путь обращения к памяти.
+    // Большие страницы ищутся только после промаха среди обычных
+    [[nodiscard]] TlbEntry *Lookup(uint32_t virtualPageNumber)
+    {
+        if (m_entries.empty())
+        {
+            ++m_stats.misses;
+            return nullptr;
+        }
+
+        TlbEntry *set = GetSet(virtualPageNumber);
+        for (uint32_t way = 0; way < m_config.associativity; ++way)
+        {
+            TlbEntry &entry = set[way];
+            if (entry.valid && entry.virtualPageNumber == virtualPageNumber)
+            {
+                ++m_stats.hits;
+                entry.lastUse = ++m_clock;
+                return &entry;
+            }
+        }
+
+        return LookupLargePage(virtualPageNumber);
+    }
+
+    // Запись каталога с битом PS попадает в TLB больших страниц
+    void Insert(uint32_t virtualPageNumber, PTE pte, uint32_t pteAddress);
+
+    // Сбрасывает и большую страницу, в которую попадает virtualPageNumber
+    void Invalidate(uint32_t virtualPageNumber);
+
+    void Flush();
+
+    [[nodiscard]] TlbStats GetStats() const noexcept;
+
+    void ResetStats() noexcept;
+
+private:
+    [[nodiscard]] TlbEntry *LookupLargePage(uint32_t virtualPageNumber);
+
+    [[nodiscard]] static uint32_t GetLargePageBase(const uint32_t virtualPageNumber)
+    {
+        return virtualPageNumber & ~(PTE::ENTRIES_PER_TABLE - 1);
+    }
+
+    [[nodiscard]] TlbEntry *GetSet(const uint32_t virtualPageNumber)
+    {
+        const uint32_t setIndex = virtualPageNumber & (m_config.numSets - 1);
+        return m_entries.data() + static_cast<size_t>(setIndex) * m_config.associativity;
+    }
+
+    TlbConfig m_config;
+    std::vector<TlbEntry> m_entries;
+    std::vector<TlbEntry> m_largeEntries;
+    uint32_t m_lastLargeEntry = 0;
+    uint64_t m_clock = 0;
+    TlbStats m_stats;
+};
+
+
+#endif //MEMORYSIMULATOR_TLB_H
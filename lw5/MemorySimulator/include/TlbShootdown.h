@@ -0,0 +1,55 @@
+#ifndef MEMORYSIMULATOR_TLBSHOOTDOWN_H
+#define MEMORYSIMULATOR_TLBSHOOTDOWN_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class VirtualMemoryBase;
+
+// Очередь страниц, которые ядро должно выбросить из своего TLB перед следующим обращением к памяти
+struct ShootdownMailbox
+{
+    std::mutex mutex;
+    std::vector<uint32_t> pendingPages;
+    uint64_t requested = 0;
+    std::atomic<bool> hasPending{false};
+    // Ядро внутри обращения и может пользоваться записями TLB
+    std::atomic<bool> inAccess{false};
+    std::atomic<uint64_t> acknowledged{0};
+};
+
+// Межпроцессорный сброс TLB. Ядро - это VirtualMemory, работающая в своём потоке со своим TLB;
+// ядра с одинаковым каталогом страниц исполняют один процесс
+class TlbShootdown
+{
+public:
+    TlbShootdown() = default;
+
+    TlbShootdown(const TlbShootdown &) = delete;
+
+    TlbShootdown &operator=(const TlbShootdown &) = delete;
+
+    // Каталог страниц зарегистрированного ядра нельзя менять, пока работают другие потоки
+    void RegisterCore(VirtualMemoryBase &core);
+
+    void UnregisterCore(VirtualMemoryBase &core);
+
+    // Выбрасывает страницу из TLB всех ядер с тем же каталогом, что у owner, и ждёт, пока каждое ядро
+    // применит сброс или окажется вне обращения к памяти. Незарегистрированный owner сбрасывается напрямую
+    void InvalidatePage(VirtualMemoryBase &owner, uint32_t virtualPageNumber);
+
+private:
+    struct Core
+    {
+        VirtualMemoryBase *core = nullptr;
+        std::unique_ptr<ShootdownMailbox> mailbox;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Core> m_cores;
+};
+
+
+#endif //MEMORYSIMULATOR_TLBSHOOTDOWN_H
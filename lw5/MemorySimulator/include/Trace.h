@@ -0,0 +1,93 @@
+#ifndef MEMORYSIMULATOR_TRACE_H
+#define MEMORYSIMULATOR_TRACE_H
+#include "OSHandler.h"
+#include "VirtualMemory.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+// Одно обращение к памяти. В файле занимает 5 байт: адрес (little-endian) и байт флагов
+struct TraceRecord
+{
+    uint32_t address = 0;
+    // 1, 2, 4 или 8 байт
+    uint8_t size = 4;
+    Access access = Access::Read;
+    Privilege privilege = Privilege::User;
+    bool execute = false;
+
+    bool operator==(const TraceRecord &) const = default;
+};
+
+// Формат файла: заголовок "MTRC" + версия (uint32), затем записи до конца файла.
+// Число записей в заголовке не хранится, поэтому трассу можно дописывать по мере работы программы
+class TraceRecorder
+{
+public:
+    explicit TraceRecorder(const std::filesystem::path &path);
+
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder &) = delete;
+
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    void Record(const TraceRecord &record);
+
+    void Record(std::span<const TraceRecord> records);
+
+    // Записывает накопленный буфер в файл
+    void Flush();
+
+    [[nodiscard]] uint64_t GetRecordCount() const noexcept;
+
+private:
+    std::ofstream m_stream;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_recordCount = 0;
+};
+
+// Читает трассу порциями, не загружая файл целиком
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::filesystem::path &path, size_t chunkRecords = 1u << 16);
+
+    // Пустой span - трасса закончилась. Данные действительны до следующего вызова
+    [[nodiscard]] std::span<const TraceRecord> ReadChunk();
+
+private:
+    std::ifstream m_stream;
+    size_t m_chunkRecords;
+    std::vector<uint8_t> m_bytes;
+    std::vector<TraceRecord> m_records;
+};
+
+enum class TracePattern
+{
+    // Циклический проход по всем страницам: худший случай для FIFO и Clock
+    Loop,
+    Uniform,
+    // 80% обращений к 20% страниц
+    HotCold,
+};
+
+struct TraceGeneratorConfig
+{
+    TracePattern pattern = TracePattern::Uniform;
+    uint32_t pageCount = 128;
+    uint32_t length = 20000;
+    uint32_t writePercent = 30;
+    uint32_t seed = 7;
+    // Страница, с которой начинается рабочий набор
+    uint32_t firstPage = 0;
+};
+
+// Синтетическая трасса из 4-байтных пользовательских обращений к началу страниц
+[[nodiscard]] std::vector<TraceRecord> GenerateTrace(const TraceGeneratorConfig &config);
+
+
+#endif //MEMORYSIMULATOR_TRACE_H
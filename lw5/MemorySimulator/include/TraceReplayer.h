@@ -0,0 +1,55 @@
+#ifndef MEMORYSIMULATOR_TRACEREPLAYER_H
+#define MEMORYSIMULATOR_TRACEREPLAYER_H
+#include "MyOS.h"
+#include "Trace.h"
+#include "VirtualMemory.h"
+
+#include <chrono>
+#include <span>
+
+struct ReplayStats
+{
+    uint64_t accesses = 0;
+    // Обращения, завершившиеся ошибкой (невыровненный адрес, необработанный page fault)
+    uint64_t failedAccesses = 0;
+    uint64_t pageFaults = 0;
+    uint64_t tlbHits = 0;
+    uint64_t tlbMisses = 0;
+    uint64_t evictions = 0;
+    uint64_t dirtyWriteBacks = 0;
+    uint64_t swapIns = 0;
+    double seconds = 0;
+
+    [[nodiscard]] double GetAccessesPerSecond() const
+    {
+        return seconds == 0 ? 0.0 : static_cast<double>(accesses) / seconds;
+    }
+};
+
+// Прогоняет трассу через виртуальную память. Статистика считается с момента создания replayer'а,
+// поэтому одно и то же ядро можно прогреть заранее
+class TraceReplayer
+{
+public:
+    TraceReplayer(BasicVirtualMemory<MyOS> &virtualMemory, MyOS &os);
+
+    void Replay(std::span<const TraceRecord> records);
+
+    void Replay(TraceReader &reader);
+
+    [[nodiscard]] ReplayStats GetStats() const;
+
+private:
+    void ReplayRecords(std::span<const TraceRecord> records);
+
+    BasicVirtualMemory<MyOS> &m_virtualMemory;
+    MyOS &m_os;
+    MyOSStats m_initialOsStats;
+    TlbStats m_initialTlbStats;
+    uint64_t m_accesses = 0;
+    uint64_t m_failedAccesses = 0;
+    std::chrono::steady_clock::duration m_elapsed{};
+};
+
+
+#endif //MEMORYSIMULATOR_TRACEREPLAYER_H
@@ -1,195 +1,343 @@
 #ifndef MEMORYSIMULATOR_VIRTUALMEMORY_H
 #define MEMORYSIMULATOR_VIRTUALMEMORY_H
+#include "AccessStatus.h"
 #include "OSHandler.h"
+#include "PageTableEntry.h"
 #include "PhysicalMemory.h"
+#include "Tlb.h"
+#include "TlbShootdown.h"
 
-struct PTE
-{
-    uint32_t raw = 0;
-
-    static constexpr uint32_t P = 1u << 0;
-    static constexpr uint32_t RW = 1u << 1;
-    static constexpr uint32_t US = 1u << 2;
-    static constexpr uint32_t A = 1u << 5;
-    static constexpr uint32_t D = 1u << 6;
-    static constexpr uint32_t NX = 1u << 31;
-
-    static constexpr uint32_t FRAME_SHIFT = 12;
-    static constexpr uint32_t FRAME_MASK = 0xFFFFF000u;
-
-    [[nodiscard]] uint32_t GetFrame() const { return (raw & FRAME_MASK) >> FRAME_SHIFT; }
-    void SetFrame(const uint32_t fn) { raw = (raw & ~FRAME_MASK) | (fn << FRAME_SHIFT); }
-
-    [[nodiscard]] bool IsPresent() const { return raw & P; }
-    void SetPresent(const bool v) { raw = v ? (raw | P) : (raw & ~P); }
-
-    [[nodiscard]] bool IsWritable() const { return raw & RW; }
-    void SetWritable(const bool v) { raw = v ? (raw | RW) : (raw & ~RW); }
-
-    [[nodiscard]] bool IsUser() const { return raw & US; }
-    void SetUser(const bool v) { raw = v ? (raw | US) : (raw & ~US); }
-
-    [[nodiscard]] bool IsAccessed() const { return raw & A; }
-    void SetAccessed(const bool v) { raw = v ? (raw | A) : (raw & ~A); }
-
-    [[nodiscard]] bool IsDirty() const { return raw & D; }
-    void SetDirty(const bool v) { raw = v ? (raw | D) : (raw & ~D); }
-
-    [[nodiscard]] bool IsNX() const { return raw & NX; }
-    void SetNX(const bool v) { raw = v ? (raw | NX) : (raw & ~NX); }
-};
+#include <algorithm>
+#include <optional>
+#include <span>
 
 struct TranslationResult
 {
     bool success = false;
     PTE pte;
+    // Для большой страницы - адрес записи каталога
+    uint32_t pteAddress{};
     uint32_t physicalAddress{};
+    bool fromTlb = false;
     PageFaultReason faultReason = PageFaultReason::NotPresent;
 };
 
 enum class Privilege { User, Supervisor };
 
-class VirtualMemory
+// Часть виртуальной памяти, не зависящая от типа обработчика page fault'ов: её видит ОС
+class VirtualMemoryBase
 {
 public:
-    explicit VirtualMemory(PhysicalMemory &physicalMemory, OSHandler &handler);
-
+    // Сбрасывает TLB: записи старой таблицы страниц больше недействительны
     void SetPageTableAddress(uint32_t physicalAddress);
 
     [[nodiscard]] uint32_t GetPageTableAddress() const noexcept;
 
-    [[nodiscard]] uint8_t Read8(uint32_t address, Privilege privilege, bool execute = false) const;
+    [[nodiscard]] uint32_t GetDirectoryEntryAddress(uint32_t virtualPageNumber) const noexcept;
 
-    [[nodiscard]] uint16_t Read16(uint32_t address, Privilege privilege, bool execute = false) const;
+    // nullopt, если для страницы ещё не выделена таблица второго уровня или участок отображён большой страницей
+    [[nodiscard]] std::optional<uint32_t> GetPageTableEntryAddress(uint32_t virtualPageNumber) const;
 
-    [[nodiscard]] uint32_t Read32(uint32_t address, Privilege privilege, bool execute = false) const;
+    // Должен вызываться обработчиком ОС после изменения PTE, иначе TLB продолжит использовать старую запись.
+    // TLB ядра, зарегистрированного в TlbShootdown, из чужого потока сбрасывается только через TlbShootdown
+    void InvalidatePage(uint32_t virtualPageNumber);
 
-    [[nodiscard]] uint64_t Read64(uint32_t address, Privilege privilege, bool execute = false) const;
+    void FlushTlb();
 
-    void Write8(uint32_t address, uint8_t value, Privilege privilege);
+    [[nodiscard]] TlbStats GetTlbStats() const noexcept;
 
-    void Write16(uint32_t address, uint16_t value, Privilege privilege);
+protected:
+    // Отмечает ядро как находящееся внутри обращения к памяти
+    class AccessScope
+    {
+    public:
+        explicit AccessScope(const VirtualMemoryBase &core)
+            : m_core(core)
+        {
+            m_core.BeginAccess();
+        }
 
-    void Write32(uint32_t address, uint32_t value, Privilege privilege);
+        ~AccessScope()
+        {
+            m_core.EndAccess();
+        }
 
-    void Write64(uint32_t address, uint64_t value, Privilege privilege);
+        AccessScope(const AccessScope &) = delete;
 
-private:
-    [[nodiscard]] TranslationResult TranslateAddress(uint32_t virtualAddress, Access access,
-                                                     Privilege privilege, bool execute) const;
+        AccessScope &operator=(const AccessScope &) = delete;
 
-    static bool CheckAccess(TranslationResult &result, const PTE &pte, Access access, Privilege privilege,
-                            bool execute);
+    private:
+        const VirtualMemoryBase &m_core;
+    };
 
-    PhysicalMemory &m_physicalMemory;
-    OSHandler &m_handler;
-    uint32_t m_pageTableAddress = 0;
+    VirtualMemoryBase(PhysicalMemory &physicalMemory, TlbConfig tlbConfig);
 
-    template<typename T>
-    T Read(const uint32_t address, const Privilege privilege, const bool execute) const
-    {
-        auto result = TranslateAddress(address, Access::Read, privilege, execute);
+    ~VirtualMemoryBase() = default;
 
-        if (!result.success)
+    // Перед использованием TLB ядро применяет сбросы, разосланные другими потоками
+    void BeginAccess() const
+    {
+        if (m_mailbox != nullptr) [[unlikely]]
         {
-            const uint32_t vpn = address >> PTE::FRAME_SHIFT;
-            const bool shouldRetry = m_handler.OnPageFault(
-                *const_cast<VirtualMemory *>(this),
-                vpn,
-                Access::Read,
-                result.faultReason);
-            if (!shouldRetry)
-            {
-                throw std::runtime_error("Unhandled page fault on read");
-            }
-            result = TranslateAddress(address, Access::Read, privilege, execute);
-            if (!result.success)
+            m_mailbox->inAccess.store(true);
+            if (m_mailbox->hasPending.load())
             {
-                throw std::runtime_error("Page fault on read retry");
+                DrainShootdowns();
             }
         }
+    }
 
-        PTE updatedPte = result.pte;
-        updatedPte.SetAccessed(true);
-        if (updatedPte.raw != result.pte.raw)
+    void EndAccess() const
+    {
+        if (m_mailbox != nullptr) [[unlikely]]
         {
-            const uint32_t vpn = address >> PTE::FRAME_SHIFT;
-            const uint32_t pteAddress = m_pageTableAddress + vpn * sizeof(PTE);
-            m_physicalMemory.Write32(pteAddress, updatedPte.raw);
+            m_mailbox->inAccess.store(false, std::memory_order_release);
         }
+    }
+
+    [[nodiscard]] TranslationResult TranslateAddress(uint32_t virtualAddress, Access access,
+                                                     Privilege privilege, bool execute) const;
+
+    // entry - результат уже выполненного поиска в TLB (nullptr при промахе)
+    [[nodiscard]] TranslationResult TranslateAddress(uint32_t virtualAddress, Access access, Privilege privilege,
+                                                     bool execute, const TlbEntry *entry) const;
+
+    // Атомарно записывает биты A/D в PTE и обновляет TLB после успешной трансляции.
+    // false, если PTE успела измениться и трансляцию нужно повторить
+    [[nodiscard]] bool CommitTranslation(const TranslationResult &result, uint32_t virtualPageNumber,
+                                         Access access) const;
 
-        if constexpr (sizeof(T) == 1)
+    // Попадание, не требующее ни проверок с отказом, ни записи битов A/D
+    [[nodiscard]] static bool IsFastHit(const PTE pte, const Access access, const Privilege privilege,
+                                        const bool execute) noexcept
+    {
+        uint32_t required = PTE::P | PTE::A;
+        if (access == Access::Write)
         {
-            return m_physicalMemory.Read8(result.physicalAddress);
+            required |= PTE::RW | PTE::D;
         }
-        if constexpr (sizeof(T) == 2)
+        if (privilege == Privilege::User)
         {
-            return m_physicalMemory.Read16(result.physicalAddress);
+            required |= PTE::US;
         }
-        if constexpr (sizeof(T) == 4)
+        return (pte.raw & required) == required && !(execute && pte.IsNX());
+    }
+
+    [[noreturn]] static void ThrowAccessError(AccessStatus status, Access access);
+
+    static void CheckBlockRange(uint32_t address, size_t size);
+
+    // Сколько page fault'ов подряд обрабатывается за одно обращение: на нескольких ядрах страница может
+    // измениться между обработкой и повтором
+    static constexpr uint32_t MAX_FAULTS_PER_ACCESS = 4;
+
+    PhysicalMemory &m_physicalMemory;
+    uint32_t m_pageTableAddress = 0;
+    mutable Tlb m_tlb;
+
+private:
+    friend class TlbShootdown;
+
+    void DrainShootdowns() const;
+
+    ShootdownMailbox *m_mailbox = nullptr;
+
+    static bool CheckAccess(TranslationResult &result, const PTE &pte, Access access, Privilege privilege,
+                            bool execute);
+};
+
+// Handler - тип обработчика page fault'ов. С OSHandler вызов идёт через виртуальную функцию,
+// с конкретным final-классом (например, MyOS) компилятор вызывает обработчик напрямую
+template<typename Handler>
+class BasicVirtualMemory : public VirtualMemoryBase
+{
+public:
+    explicit BasicVirtualMemory(PhysicalMemory &physicalMemory, Handler &handler, const TlbConfig tlbConfig = {})
+        : VirtualMemoryBase(physicalMemory, tlbConfig),
+          m_handler(handler)
+    {
+    }
+
+    // Обращения без исключений: при попадании в TLB это поиск в TLB и одна загрузка из памяти
+    template<typename T>
+    [[nodiscard]] AccessStatus TryRead(const uint32_t address, T &value, const Privilege privilege,
+                                       const bool execute = false) const
+    {
+        AccessScope scope(*this);
+        uint32_t physicalAddress = 0;
+        const AccessStatus status = TranslateForAccess(address, Access::Read, privilege, execute, physicalAddress);
+        if (status != AccessStatus::Ok) [[unlikely]]
         {
-            return m_physicalMemory.Read32(result.physicalAddress);
+            return status;
         }
-        if constexpr (sizeof(T) == 8)
+        return m_physicalMemory.TryRead(physicalAddress, value);
+    }
+
+    template<typename T>
+    [[nodiscard]] AccessStatus TryWrite(const uint32_t address, const T value, const Privilege privilege)
+    {
+        AccessScope scope(*this);
+        uint32_t physicalAddress = 0;
+        const AccessStatus status = TranslateForAccess(address, Access::Write, privilege, false, physicalAddress);
+        if (status != AccessStatus::Ok) [[unlikely]]
         {
-            return m_physicalMemory.Read64(result.physicalAddress);
+            return status;
         }
-        return 0;
+        return m_physicalMemory.TryWrite(physicalAddress, value);
     }
 
-    template<typename T>
-    void Write(const uint32_t address, T value, const Privilege privilege)
+    [[nodiscard]] uint8_t Read8(const uint32_t address, const Privilege privilege, const bool execute = false) const
+    {
+        return Read<uint8_t>(address, privilege, execute);
+    }
+
+    [[nodiscard]] uint16_t Read16(const uint32_t address, const Privilege privilege, const bool execute = false) const
+    {
+        return Read<uint16_t>(address, privilege, execute);
+    }
+
+    [[nodiscard]] uint32_t Read32(const uint32_t address, const Privilege privilege, const bool execute = false) const
     {
-        auto result = TranslateAddress(address, Access::Write, privilege, false);
+        return Read<uint32_t>(address, privilege, execute);
+    }
+
+    [[nodiscard]] uint64_t Read64(const uint32_t address, const Privilege privilege, const bool execute = false) const
+    {
+        return Read<uint64_t>(address, privilege, execute);
+    }
+
+    void Write8(const uint32_t address, const uint8_t value, const Privilege privilege)
+    {
+        Write<uint8_t>(address, value, privilege);
+    }
+
+    void Write16(const uint32_t address, const uint16_t value, const Privilege privilege)
+    {
+        Write<uint16_t>(address, value, privilege);
+    }
+
+    void Write32(const uint32_t address, const uint32_t value, const Privilege privilege)
+    {
+        Write<uint32_t>(address, value, privilege);
+    }
+
+    void Write64(const uint32_t address, const uint64_t value, const Privilege privilege)
+    {
+        Write<uint64_t>(address, value, privilege);
+    }
+
+    // Транслирует адрес один раз на страницу и копирует целые участки; выравнивание не требуется,
+    // page fault обрабатывается отдельно для каждой затронутой страницы
+    void ReadBlock(const uint32_t address, const std::span<uint8_t> buffer, const Privilege privilege) const
+    {
+        ForEachPage(address, buffer, Access::Read, privilege,
+                    [this](const uint32_t physicalAddress, const std::span<uint8_t> chunk) {
+                        m_physicalMemory.ReadBlock(physicalAddress, chunk);
+                    });
+    }
 
-        if (!result.success)
+    void WriteBlock(const uint32_t address, const std::span<const uint8_t> data, const Privilege privilege)
+    {
+        ForEachPage(address, data, Access::Write, privilege,
+                    [this](const uint32_t physicalAddress, const std::span<const uint8_t> chunk) {
+                        m_physicalMemory.WriteBlock(physicalAddress, chunk);
+                    });
+    }
+
+private:
+    [[nodiscard]] AccessStatus TranslateForAccess(const uint32_t virtualAddress, const Access access,
+                                                  const Privilege privilege, const bool execute,
+                                                  uint32_t &physicalAddress) const
+    {
+        const uint32_t virtualPageNumber = virtualAddress >> PTE::FRAME_SHIFT;
+        const TlbEntry *entry = m_tlb.Lookup(virtualPageNumber);
+        if (entry != nullptr && IsFastHit(entry->pte, access, privilege, execute)) [[likely]]
+        {
+            physicalAddress = (entry->pte.GetFrame() << PTE::FRAME_SHIFT & ~entry->offsetMask)
+                              | (virtualAddress & entry->offsetMask);
+            return AccessStatus::Ok;
+        }
+
+        auto result = TranslateAddress(virtualAddress, access, privilege, execute, entry);
+        uint32_t faults = 0;
+        while (true)
         {
-            const uint32_t vpn = address >> PTE::FRAME_SHIFT;
-            bool shouldRetry = m_handler.OnPageFault(
-                *this,
-                vpn,
-                Access::Write,
-                result.faultReason);
-            if (!shouldRetry)
+            if (!result.success)
             {
-                throw std::runtime_error("Unhandled page fault on write");
+                if (++faults > MAX_FAULTS_PER_ACCESS)
+                {
+                    return AccessStatus::UnhandledPageFault;
+                }
+                // Пока работает обработчик, ядро не держит трансляций и не задерживает рассылку сбросов TLB
+                EndAccess();
+                const bool isHandled = m_handler.OnPageFault(*const_cast<BasicVirtualMemory *>(this),
+                                                             virtualPageNumber, access, result.faultReason);
+                BeginAccess();
+                if (!isHandled)
+                {
+                    return AccessStatus::UnhandledPageFault;
+                }
             }
-            result = TranslateAddress(address, Access::Write, privilege, false);
-            if (!result.success)
+            else if (CommitTranslation(result, virtualPageNumber, access))
             {
-                throw std::runtime_error("Page fault on write retry");
+                physicalAddress = result.physicalAddress;
+                return AccessStatus::Ok;
             }
+            result = TranslateAddress(virtualAddress, access, privilege, execute);
         }
+    }
 
-        PTE updatedPte = result.pte;
-        updatedPte.SetAccessed(true);
-        updatedPte.SetDirty(true);
-
-        if (updatedPte.raw != result.pte.raw)
+    template<typename T>
+    T Read(const uint32_t address, const Privilege privilege, const bool execute) const
+    {
+        T value{};
+        const AccessStatus status = TryRead(address, value, privilege, execute);
+        if (status != AccessStatus::Ok)
         {
-            const uint32_t vpn = address >> PTE::FRAME_SHIFT;
-            const uint32_t pteAddress = m_pageTableAddress + vpn * sizeof(PTE);
-            m_physicalMemory.Write32(pteAddress, updatedPte.raw);
+            ThrowAccessError(status, Access::Read);
         }
+        return value;
+    }
 
-        if constexpr (sizeof(T) == 1)
-        {
-            m_physicalMemory.Write8(result.physicalAddress, value);
-        }
-        if constexpr (sizeof(T) == 2)
-        {
-            m_physicalMemory.Write16(result.physicalAddress, value);
-        }
-        if constexpr (sizeof(T) == 4)
+    template<typename T>
+    void Write(const uint32_t address, const T value, const Privilege privilege)
+    {
+        const AccessStatus status = TryWrite(address, value, privilege);
+        if (status != AccessStatus::Ok)
         {
-            m_physicalMemory.Write32(result.physicalAddress, value);
+            ThrowAccessError(status, Access::Write);
         }
-        if constexpr (sizeof(T) == 8)
+    }
+
+    template<typename Span, typename CopyPage>
+    void ForEachPage(const uint32_t address, const Span span, const Access access, const Privilege privilege,
+                     CopyPage copyPage) const
+    {
+        CheckBlockRange(address, span.size());
+
+        size_t done = 0;
+        while (done < span.size())
         {
-            m_physicalMemory.Write64(result.physicalAddress, value);
+            const uint32_t virtualAddress = address + static_cast<uint32_t>(done);
+            const uint32_t pageRemainder = (1u << PTE::FRAME_SHIFT) - (virtualAddress & 0xFFF);
+            const size_t chunk = std::min<size_t>(pageRemainder, span.size() - done);
+
+            AccessScope scope(*this);
+            uint32_t physicalAddress = 0;
+            const AccessStatus status = TranslateForAccess(virtualAddress, access, privilege, false, physicalAddress);
+            if (status != AccessStatus::Ok)
+            {
+                ThrowAccessError(status, access);
+            }
+            copyPage(physicalAddress, span.subspan(done, chunk));
+            done += chunk;
         }
     }
+
+    Handler &m_handler;
 };
 
+using VirtualMemory = BasicVirtualMemory<OSHandler>;
+
 
 #endif //MEMORYSIMULATOR_VIRTUALMEMORY_H
@@ -1,52 +1,865 @@
 #include "MyOS.h"
 #include "VirtualMemory.h"
-#include <iostream>
+#include <algorithm>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 
-MyOS::MyOS(PhysicalMemory &physicalMemory)
+namespace
+{
+constexpr uint32_t PAGE_SIZE = 1u << PTE::FRAME_SHIFT;
+// Права, которые страница сохраняет, пока лежит в swap
+constexpr uint32_t PRESERVED_FLAGS = PTE::RW | PTE::US | PTE::NX | PTE::COW;
+
+PTE MakeTableDirectoryEntry(const uint32_t tableFrame)
+{
+    PTE directoryEntry;
+    directoryEntry.SetPresent(true);
+    directoryEntry.SetWritable(true);
+    directoryEntry.SetUser(true);
+    directoryEntry.SetFrame(tableFrame);
+    return directoryEntry;
+}
+
+template<typename... Args>
+void Log(LogSink *sink, const Args &... args)
+{
+    if (sink == nullptr)
+    {
+        return;
+    }
+    std::ostringstream message;
+    message << "[OS HANDLER]: ";
+    (message << ... << args);
+    sink->Write(message.str());
+}
+}
+
+MyOS::MyOS(PhysicalMemory &physicalMemory, const MyOSConfig config)
     : OSHandler(),
       m_physicalMemory(physicalMemory),
-      m_nextFreeFrame(1)
+      m_frames(physicalMemory.GetSize() / PAGE_SIZE),
+      m_policy(CreateReplacementPolicy(config.replacementPolicy, static_cast<uint32_t>(m_frames.size()))),
+      m_accessedBitProbe([this](const uint32_t frame) { return TestAndClearAccessed(frame); }),
+      m_swapFile(config.swapFilePath, PAGE_SIZE),
+      m_logSink(config.logSink)
 {
+    const auto numFrames = static_cast<uint32_t>(m_frames.size());
+    for (uint32_t frame = 0; frame < std::min(config.reservedFrames, numFrames); ++frame)
+    {
+        m_frames[frame].use = FrameUse::Reserved;
+    }
+    // Раздаём кадры по возрастанию номеров, поэтому кладём их в стек в обратном порядке
+    for (uint32_t frame = numFrames; frame > config.reservedFrames; --frame)
+    {
+        m_freeFrames.push_back(frame - 1);
+    }
 }
 
 bool MyOS::OnPageFault(
-    VirtualMemory &virtualMemory,
+    VirtualMemoryBase &virtualMemory,
     const uint32_t virtualPageNumber,
     Access access,
     PageFaultReason reason)
 {
-    std::cout << "[OS HANDLER]: Page Fault! Reason: " << static_cast<int>(reason)
-            << " on virtual page " << virtualPageNumber << std::endl;
+    std::lock_guard lock(m_mutex);
+    ++m_stats.pageFaults;
+    Log(m_logSink, "Page Fault! Reason: ", static_cast<int>(reason), " on virtual page ", virtualPageNumber);
 
+    // Участок мог стать большой страницей, пока ядро ждало ОС. Нарушения прав в большой странице не исправляются
+    PTE directoryEntry;
+    directoryEntry.raw = m_physicalMemory.Read32(virtualMemory.GetDirectoryEntryAddress(virtualPageNumber));
+    if (directoryEntry.IsPresent() && directoryEntry.IsLargePage())
+    {
+        return reason == PageFaultReason::NotPresent;
+    }
+
+    if (reason == PageFaultReason::WriteToReadOnly)
+    {
+        return HandleCopyOnWrite(virtualMemory, virtualPageNumber);
+    }
     if (reason != PageFaultReason::NotPresent)
     {
-        std::cout << "[OS HANDLER]: Cannot fix this fault. Aborting." << std::endl;
+        Log(m_logSink, "Cannot fix this fault. Aborting.");
         return false;
     }
+    return HandleNotPresent(virtualMemory, virtualPageNumber, access);
+}
 
-    const uint32_t newFrame = m_nextFreeFrame++;
+bool MyOS::HandleNotPresent(VirtualMemoryBase &virtualMemory, const uint32_t virtualPageNumber, const Access access)
+{
+    m_policy->OnTick(m_accessedBitProbe);
 
-    const uint32_t newFrameAddress = newFrame * (1u << PTE::FRAME_SHIFT);
-    if (newFrameAddress >= m_physicalMemory.GetSize())
+    const auto pteAddress = EnsurePageTable(virtualMemory, virtualPageNumber);
+    if (!pteAddress)
     {
-        std::cout << "[OS HANDLER]: Out of physical memory! Aborting." << std::endl;
-        m_nextFreeFrame--;
+        Log(m_logSink, "Out of physical memory for page table! Aborting.");
         return false;
     }
 
-    std::cout << "[OS HANDLER]: Allocating physical frame " << newFrame
-            << " for virtual page " << virtualPageNumber << std::endl;
+    // Пока ядро ждало ОС, ту же страницу мог подгрузить page fault на другом ядре
+    PTE oldPte;
+    oldPte.raw = m_physicalMemory.Read32(*pteAddress);
+    if (oldPte.IsPresent())
+    {
+        return true;
+    }
+
+    const auto newFrame = AllocateFrame();
+    if (!newFrame)
+    {
+        Log(m_logSink, "Out of physical memory! Aborting.");
+        return false;
+    }
 
     PTE newPte;
+    FrameInfo &frameInfo = m_frames[*newFrame];
+    if (oldPte.IsSwapped())
+    {
+        const uint32_t slot = oldPte.GetFrame();
+        Log(m_logSink, "Swapping in virtual page ", virtualPageNumber, " from slot ", slot, " to frame ", *newFrame);
+
+        std::vector<uint8_t> page(PAGE_SIZE);
+        m_swapFile.Read(slot, page);
+        m_physicalMemory.WriteBlock(*newFrame << PTE::FRAME_SHIFT, page);
+        // Ссылка на слот переходит от PTE к кадру
+        frameInfo.swapSlot = slot;
+        newPte.raw = oldPte.raw & PRESERVED_FLAGS;
+        ++m_stats.swapIns;
+    }
+    else
+    {
+        Log(m_logSink, "Allocating physical frame ", *newFrame, " for virtual page ", virtualPageNumber);
+
+        ZeroFrame(*newFrame);
+        frameInfo.swapSlot.reset();
+        newPte.SetWritable(true);
+        newPte.SetUser(true);
+    }
     newPte.SetPresent(true);
-    newPte.SetWritable(true);
-    newPte.SetUser(true);
-    newPte.SetFrame(newFrame);
+    newPte.SetFrame(*newFrame);
+
+    frameInfo.use = FrameUse::Data;
+    AddMapping(*newFrame, {&virtualMemory, virtualPageNumber, *pteAddress});
+    ++m_stats.dataFrames;
+
+    // Запись PTE публикует уже заполненный кадр для остальных ядер
+    m_physicalMemory.Write32(*pteAddress, newPte.raw);
+    virtualMemory.InvalidatePage(virtualPageNumber);
+    m_policy->OnFrameMapped(*newFrame);
+
+    // Повтор обращения проходит только одну трансляцию, поэтому запись в подгруженную
+    // разделяемую страницу нужно разрешить сразу
+    if (access == Access::Write && newPte.IsCopyOnWrite())
+    {
+        return HandleCopyOnWrite(virtualMemory, virtualPageNumber);
+    }
+
+    Log(m_logSink, "PTE updated. Retrying the operation...");
+    return true;
+}
+
+void MyOS::RegisterCore(VirtualMemoryBase &core)
+{
+    m_shootdown.RegisterCore(core);
+}
+
+void MyOS::UnregisterCore(VirtualMemoryBase &core)
+{
+    m_shootdown.UnregisterCore(core);
+}
+
+MyOSStats MyOS::GetStats() const noexcept
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
+
+void MyOS::AdoptAddressSpace(VirtualMemoryBase &virtualMemory)
+{
+    std::lock_guard lock(m_mutex);
+    const auto claimFrame = [this](const uint32_t frame, const FrameUse use) -> FrameInfo & {
+        if (frame >= m_frames.size() || m_frames[frame].use != FrameUse::Free)
+        {
+            throw std::runtime_error("Page tables reference an unavailable frame");
+        }
+        m_frames[frame].use = use;
+        return m_frames[frame];
+    };
+
+    const uint32_t directoryFrame = virtualMemory.GetPageTableAddress() >> PTE::FRAME_SHIFT;
+    if (m_frames[directoryFrame].use == FrameUse::Free)
+    {
+        m_frames[directoryFrame].use = FrameUse::Reserved;
+    }
+
+    for (uint32_t directoryIndex = 0; directoryIndex < PTE::ENTRIES_PER_TABLE; ++directoryIndex)
+    {
+        const uint32_t firstVpn = directoryIndex * PTE::ENTRIES_PER_TABLE;
+        PTE directoryEntry;
+        directoryEntry.raw = m_physicalMemory.Read32(virtualMemory.GetDirectoryEntryAddress(firstVpn));
+        if (!directoryEntry.IsPresent())
+        {
+            continue;
+        }
+        if (directoryEntry.IsLargePage())
+        {
+            for (uint32_t index = 0; index < PTE::ENTRIES_PER_TABLE; ++index)
+            {
+                claimFrame(directoryEntry.GetFrame() + index, FrameUse::LargePage);
+            }
+            ++m_stats.largePages;
+            continue;
+        }
+        claimFrame(directoryEntry.GetFrame(), FrameUse::PageTable);
+        ++m_stats.pageTableFrames;
+
+        for (uint32_t tableIndex = 0; tableIndex < PTE::ENTRIES_PER_TABLE; ++tableIndex)
+        {
+            const uint32_t vpn = firstVpn + tableIndex;
+            const uint32_t pteAddress = *virtualMemory.GetPageTableEntryAddress(vpn);
+            PTE pte;
+            pte.raw = m_physicalMemory.Read32(pteAddress);
+            if (pte.IsSwapped())
+            {
+                throw std::runtime_error("Swapped out pages cannot be restored");
+            }
+            if (!pte.IsPresent())
+            {
+                continue;
+            }
+
+            claimFrame(pte.GetFrame(), FrameUse::Data);
+            AddMapping(pte.GetFrame(), {&virtualMemory, vpn, pteAddress});
+            m_policy->OnFrameMapped(pte.GetFrame());
+            ++m_stats.dataFrames;
+        }
+    }
+
+    m_freeFrames.clear();
+    for (auto frame = static_cast<uint32_t>(m_frames.size()); frame > 0; --frame)
+    {
+        if (m_frames[frame - 1].use == FrameUse::Free)
+        {
+            m_freeFrames.push_back(frame - 1);
+        }
+    }
+    virtualMemory.FlushTlb();
+}
+
+void MyOS::Fork(VirtualMemoryBase &parent, VirtualMemoryBase &child, const ForkMode mode)
+{
+    std::lock_guard lock(m_mutex);
+    const auto directoryFrame = AllocateZeroedTableFrame();
+    if (!directoryFrame)
+    {
+        throw std::runtime_error("Out of physical memory for page directory");
+    }
+    child.SetPageTableAddress(*directoryFrame << PTE::FRAME_SHIFT);
+
+    for (uint32_t directoryIndex = 0; directoryIndex < PTE::ENTRIES_PER_TABLE; ++directoryIndex)
+    {
+        const uint32_t firstVpn = directoryIndex * PTE::ENTRIES_PER_TABLE;
+        PTE directoryEntry;
+        directoryEntry.raw = m_physicalMemory.Read32(parent.GetDirectoryEntryAddress(firstVpn));
+        if (!directoryEntry.IsPresent())
+        {
+            continue;
+        }
+        if (directoryEntry.IsLargePage())
+        {
+            // Копирование при записи работает с обычными страницами, поэтому большая страница разбивается
+            DemoteLargePage(parent, firstVpn);
+        }
+
+        for (uint32_t tableIndex = 0; tableIndex < PTE::ENTRIES_PER_TABLE; ++tableIndex)
+        {
+            ForkPage(parent, child, firstVpn + tableIndex, mode);
+        }
+    }
+
+    Log(m_logSink, "Forked address space, ", m_stats.sharedFrames, " frames shared");
+}
+
+void MyOS::ReleaseAddressSpace(VirtualMemoryBase &virtualMemory)
+{
+    std::lock_guard lock(m_mutex);
+    for (uint32_t directoryIndex = 0; directoryIndex < PTE::ENTRIES_PER_TABLE; ++directoryIndex)
+    {
+        const uint32_t firstVpn = directoryIndex * PTE::ENTRIES_PER_TABLE;
+        const uint32_t directoryEntryAddress = virtualMemory.GetDirectoryEntryAddress(firstVpn);
+        PTE directoryEntry;
+        directoryEntry.raw = m_physicalMemory.Read32(directoryEntryAddress);
+        if (!directoryEntry.IsPresent())
+        {
+            continue;
+        }
+        if (directoryEntry.IsLargePage())
+        {
+            ReleaseLargePage(directoryEntry.GetFrame());
+            m_physicalMemory.Write32(directoryEntryAddress, 0);
+            continue;
+        }
+
+        for (uint32_t tableIndex = 0; tableIndex < PTE::ENTRIES_PER_TABLE; ++tableIndex)
+        {
+            const uint32_t vpn = firstVpn + tableIndex;
+            PTE pte;
+            pte.raw = m_physicalMemory.Read32(*virtualMemory.GetPageTableEntryAddress(vpn));
+            if (pte.IsPresent())
+            {
+                RemoveMapping(pte.GetFrame(), *virtualMemory.GetPageTableEntryAddress(vpn));
+            }
+            else if (pte.IsSwapped())
+            {
+                ReleaseSlot(pte.GetFrame());
+            }
+        }
+
+        m_frames[directoryEntry.GetFrame()] = FrameInfo{};
+        m_freeFrames.push_back(directoryEntry.GetFrame());
+        --m_stats.pageTableFrames;
+        m_physicalMemory.Write32(directoryEntryAddress, 0);
+    }
+
+    // Каталог, выделенный в Fork, возвращается ОС; зарезервированный остаётся пустым
+    const uint32_t directoryFrame = virtualMemory.GetPageTableAddress() >> PTE::FRAME_SHIFT;
+    if (m_frames[directoryFrame].use == FrameUse::PageTable)
+    {
+        m_frames[directoryFrame] = FrameInfo{};
+        m_freeFrames.push_back(directoryFrame);
+        --m_stats.pageTableFrames;
+    }
+    virtualMemory.FlushTlb();
+}
+
+std::optional<uint32_t> MyOS::AllocateFrame()
+{
+    if (m_freeFrames.empty())
+    {
+        return EvictFrame();
+    }
+
+    const uint32_t frame = m_freeFrames.back();
+    m_freeFrames.pop_back();
+    return frame;
+}
+
+std::optional<uint32_t> MyOS::EvictFrame()
+{
+    const auto victim = m_policy->SelectVictim(m_accessedBitProbe);
+    if (!victim)
+    {
+        return std::nullopt;
+    }
+    SwapOut(*victim);
+    return victim;
+}
+
+void MyOS::SwapOut(const uint32_t frame)
+{
+    FrameInfo &frameInfo = m_frames[frame];
+
+    // Сначала страница отбирается у всех ядер, и только потом копируется: иначе запись через старую
+    // запись TLB могла бы попасть в кадр уже после копирования. Бит D читается атомарно вместе со снятием P
+    bool isDirty = false;
+    std::vector<PTE> oldPtes;
+    for (const FrameMapping &mapping : frameInfo.mappings)
+    {
+        PTE oldPte;
+        oldPte.raw = m_physicalMemory.Exchange32(mapping.pteAddress, 0);
+        InvalidateMapping(mapping);
+        isDirty = isDirty || oldPte.IsDirty();
+        oldPtes.push_back(oldPte);
+    }
+
+    // Чистая страница, у которой уже есть копия в swap, просто отбрасывается
+    if (isDirty || !frameInfo.swapSlot)
+    {
+        // Слот, который ещё читают выгруженные PTE других процессов, перезаписывать нельзя
+        if (frameInfo.swapSlot && m_slotReferences[*frameInfo.swapSlot] > 1)
+        {
+            DropFrameSlot(frame);
+        }
+        if (!frameInfo.swapSlot)
+        {
+            frameInfo.swapSlot = m_swapFile.AllocateSlot();
+            RetainSlot(*frameInfo.swapSlot);
+        }
+        std::vector<uint8_t> page(PAGE_SIZE);
+        m_physicalMemory.ReadBlock(frame << PTE::FRAME_SHIFT, page);
+        m_swapFile.Write(*frameInfo.swapSlot, page);
+        ++m_stats.dirtyWriteBacks;
+    }
+
+    for (size_t i = 0; i < frameInfo.mappings.size(); ++i)
+    {
+        const FrameMapping &mapping = frameInfo.mappings[i];
+        Log(m_logSink, "Evicting virtual page ", mapping.virtualPageNumber, " from frame ", frame,
+            " to slot ", *frameInfo.swapSlot);
+
+        PTE swappedPte;
+        swappedPte.raw = oldPtes[i].raw & PRESERVED_FLAGS;
+        swappedPte.SetSwapped(true);
+        swappedPte.SetFrame(*frameInfo.swapSlot);
+        m_physicalMemory.Write32(mapping.pteAddress, swappedPte.raw);
+        RetainSlot(*frameInfo.swapSlot);
+    }
+
+    if (frameInfo.mappings.size() > 1)
+    {
+        --m_stats.sharedFrames;
+    }
+    frameInfo.mappings.clear();
+    ReleaseFrame(frame);
+    ++m_stats.evictions;
+}
+
+bool MyOS::PromoteLargePage(VirtualMemoryBase &virtualMemory, const uint32_t virtualAddress)
+{
+    std::lock_guard lock(m_mutex);
+    const uint32_t firstVpn = (virtualAddress >> PTE::FRAME_SHIFT) & ~(PTE::ENTRIES_PER_TABLE - 1);
+    const uint32_t directoryEntryAddress = virtualMemory.GetDirectoryEntryAddress(firstVpn);
+    const auto tableAddress = virtualMemory.GetPageTableEntryAddress(firstVpn);
+    if (!tableAddress)
+    {
+        return false;
+    }
+    const uint32_t tableFrame = *tableAddress >> PTE::FRAME_SHIFT;
+
+    // Разделяемая страница после переноса станет собственной копией процесса, поэтому COW считается записью
+    std::optional<uint32_t> permissions;
+    for (uint32_t index = 0; index < PTE::ENTRIES_PER_TABLE; ++index)
+    {
+        PTE pte;
+        pte.raw = m_physicalMemory.Read32(*tableAddress + index * sizeof(PTE));
+        if (!pte.IsPresent() && !pte.IsSwapped())
+        {
+            continue;
+        }
+        uint32_t pagePermissions = pte.raw & (PTE::RW | PTE::US | PTE::NX);
+        if (pte.IsCopyOnWrite())
+        {
+            pagePermissions |= PTE::RW;
+        }
+        if (permissions && *permissions != pagePermissions)
+        {
+            Log(m_logSink, "Pages around virtual page ", firstVpn, " have different permissions, not promoting");
+            return false;
+        }
+        permissions = pagePermissions;
+    }
+    if (!permissions)
+    {
+        return false;
+    }
+
+    const auto firstFrame = FindLargePageBlock(tableFrame);
+    if (!firstFrame)
+    {
+        Log(m_logSink, "No aligned block of frames for a large page");
+        return false;
+    }
+
+    // Страница отбирается у ядер до копирования, чтобы запись через старую трансляцию не потерялась
+    std::vector<uint8_t> content(size_t{PTE::ENTRIES_PER_TABLE} * PAGE_SIZE);
+    for (uint32_t index = 0; index < PTE::ENTRIES_PER_TABLE; ++index)
+    {
+        const uint32_t pteAddress = *tableAddress + index * sizeof(PTE);
+        const auto page = std::span(content).subspan(size_t{index} * PAGE_SIZE, PAGE_SIZE);
+        PTE pte;
+        pte.raw = m_physicalMemory.Exchange32(pteAddress, 0);
+        if (pte.IsPresent())
+        {
+            InvalidateMapping({&virtualMemory, firstVpn + index, pteAddress});
+            m_physicalMemory.ReadBlock(pte.GetFrame() << PTE::FRAME_SHIFT, page);
+            RemoveMapping(pte.GetFrame(), pteAddress);
+        }
+        else if (pte.IsSwapped())
+        {
+            m_swapFile.Read(pte.GetFrame(), page);
+            ReleaseSlot(pte.GetFrame());
+        }
+    }
+
+    const uint32_t endFrame = *firstFrame + PTE::ENTRIES_PER_TABLE;
+    for (uint32_t frame = *firstFrame; frame < endFrame; ++frame)
+    {
+        if (m_frames[frame].use == FrameUse::Data)
+        {
+            SwapOut(frame);
+        }
+        m_frames[frame].use = FrameUse::LargePage;
+    }
+    std::erase_if(m_freeFrames, [&](const uint32_t frame) { return frame >= *firstFrame && frame < endFrame; });
+    m_physicalMemory.WriteBlock(*firstFrame << PTE::FRAME_SHIFT, content);
+
+    PTE directoryEntry;
+    directoryEntry.raw = *permissions | PTE::P | PTE::PS | PTE::A | PTE::D;
+    directoryEntry.SetFrame(*firstFrame);
+    m_physicalMemory.Write32(directoryEntryAddress, directoryEntry.raw);
+    // Таблицу можно отдать только после того, как ни одно ядро её больше не обходит
+    InvalidateMapping({&virtualMemory, firstVpn, directoryEntryAddress});
+
+    m_frames[tableFrame] = FrameInfo{};
+    m_freeFrames.push_back(tableFrame);
+    --m_stats.pageTableFrames;
+    ++m_stats.largePages;
+    Log(m_logSink, "Promoted virtual pages ", firstVpn, "..", firstVpn + PTE::ENTRIES_PER_TABLE - 1,
+        " to a large page at frame ", *firstFrame);
+    return true;
+}
+
+std::optional<uint32_t> MyOS::FindLargePageBlock(const uint32_t tableFrame) const
+{
+    std::optional<uint32_t> best;
+    uint32_t bestCost = 0;
+    for (uint32_t firstFrame = 0; firstFrame + PTE::ENTRIES_PER_TABLE <= m_frames.size();
+         firstFrame += PTE::ENTRIES_PER_TABLE)
+    {
+        uint32_t cost = 0;
+        bool isUsable = true;
+        for (uint32_t frame = firstFrame; frame < firstFrame + PTE::ENTRIES_PER_TABLE && isUsable; ++frame)
+        {
+            const FrameInfo &frameInfo = m_frames[frame];
+            isUsable = frameInfo.use == FrameUse::Free || frameInfo.use == FrameUse::Data;
+            // Страницы самого участка освободятся при переносе, вытеснять их не придётся
+            const bool isOwnPage = std::ranges::all_of(frameInfo.mappings, [tableFrame](const FrameMapping &mapping) {
+                return mapping.pteAddress >> PTE::FRAME_SHIFT == tableFrame;
+            });
+            if (frameInfo.use == FrameUse::Data && !isOwnPage)
+            {
+                ++cost;
+            }
+        }
+        if (isUsable && (!best || cost < bestCost))
+        {
+            best = firstFrame;
+            bestCost = cost;
+        }
+    }
+    return best;
+}
+
+void MyOS::DemoteLargePage(VirtualMemoryBase &virtualMemory, const uint32_t firstVpn)
+{
+    const auto tableFrame = AllocateZeroedTableFrame();
+    if (!tableFrame)
+    {
+        throw std::runtime_error("Out of physical memory for page table");
+    }
+
+    const uint32_t directoryEntryAddress = virtualMemory.GetDirectoryEntryAddress(firstVpn);
+    PTE directoryEntry;
+    directoryEntry.raw = m_physicalMemory.Read32(directoryEntryAddress);
+    for (uint32_t index = 0; index < PTE::ENTRIES_PER_TABLE; ++index)
+    {
+        const uint32_t frame = directoryEntry.GetFrame() + index;
+        const uint32_t pteAddress = (*tableFrame << PTE::FRAME_SHIFT) + index * sizeof(PTE);
+        PTE pte;
+        pte.raw = directoryEntry.raw & (PRESERVED_FLAGS | PTE::A | PTE::D);
+        pte.SetPresent(true);
+        pte.SetFrame(frame);
+        m_physicalMemory.Write32(pteAddress, pte.raw);
+
+        m_frames[frame].use = FrameUse::Data;
+        AddMapping(frame, {&virtualMemory, firstVpn + index, pteAddress});
+        ++m_stats.dataFrames;
+        m_policy->OnFrameMapped(frame);
+    }
+
+    m_physicalMemory.Write32(directoryEntryAddress, MakeTableDirectoryEntry(*tableFrame).raw);
+    InvalidateMapping({&virtualMemory, firstVpn, directoryEntryAddress});
+    --m_stats.largePages;
+}
+
+void MyOS::ReleaseLargePage(const uint32_t firstFrame)
+{
+    for (uint32_t frame = firstFrame; frame < firstFrame + PTE::ENTRIES_PER_TABLE; ++frame)
+    {
+        m_frames[frame] = FrameInfo{};
+        m_freeFrames.push_back(frame);
+    }
+    --m_stats.largePages;
+}
+
+bool MyOS::HandleCopyOnWrite(VirtualMemoryBase &virtualMemory, const uint32_t virtualPageNumber)
+{
+    const auto pteAddress = virtualMemory.GetPageTableEntryAddress(virtualPageNumber);
+    if (!pteAddress)
+    {
+        Log(m_logSink, "Cannot fix this fault. Aborting.");
+        return false;
+    }
+
+    // Пока ядро ждало ОС, страницу могли скопировать или вытеснить по запросу другого ядра
+    PTE pte;
+    pte.raw = m_physicalMemory.Read32(*pteAddress);
+    if (!pte.IsPresent() && pte.IsSwapped())
+    {
+        return HandleNotPresent(virtualMemory, virtualPageNumber, Access::Write);
+    }
+    if (pte.IsPresent() && pte.IsWritable())
+    {
+        return true;
+    }
+    if (!pte.IsPresent() || !pte.IsCopyOnWrite())
+    {
+        Log(m_logSink, "Cannot fix this fault. Aborting.");
+        return false;
+    }
+
+    const uint32_t sharedFrame = pte.GetFrame();
+    if (m_frames[sharedFrame].mappings.size() == 1)
+    {
+        // Остальные владельцы уже получили свои копии, кадр можно отдать на запись без копирования.
+        // Слот swap может ещё читаться чужими выгруженными PTE, поэтому кадр от него отвязывается
+        Log(m_logSink, "Virtual page ", virtualPageNumber, " is no longer shared, making it writable");
+        DropFrameSlot(sharedFrame);
+        // Другие ядра могут одновременно выставлять бит A, поэтому только атомарные операции над битами
+        m_physicalMemory.FetchOr32(*pteAddress, PTE::RW);
+        m_physicalMemory.FetchAnd32(*pteAddress, ~PTE::COW);
+        InvalidateMapping({&virtualMemory, virtualPageNumber, *pteAddress});
+        return true;
+    }
+
+    const auto newFrame = AllocateFrame();
+    if (!newFrame)
+    {
+        Log(m_logSink, "Out of physical memory! Aborting.");
+        return false;
+    }
+
+    // Разделяемый кадр мог быть вытеснен ради нового. Тогда страница подгружается заново уже
+    // в собственный кадр процесса, и копировать больше нечего
+    pte.raw = m_physicalMemory.Read32(*pteAddress);
+    if (!pte.IsPresent())
+    {
+        m_freeFrames.push_back(*newFrame);
+        return HandleNotPresent(virtualMemory, virtualPageNumber, Access::Write);
+    }
+
+    Log(m_logSink, "Copying shared frame ", sharedFrame, " to frame ", *newFrame,
+        " for virtual page ", virtualPageNumber);
 
-    const uint32_t pageTableAddress = virtualMemory.GetPageTableAddress();
-    const uint32_t pteAddress = pageTableAddress + virtualPageNumber * sizeof(PTE);
-    m_physicalMemory.Write32(pteAddress, newPte.raw);
+    std::vector<uint8_t> page(PAGE_SIZE);
+    m_physicalMemory.ReadBlock(sharedFrame << PTE::FRAME_SHIFT, page);
+    m_physicalMemory.WriteBlock(*newFrame << PTE::FRAME_SHIFT, page);
 
-    std::cout << "[OS HANDLER]: PTE updated. Retrying the operation..." << std::endl;
+    PTE newPte;
+    newPte.raw = pte.raw & PRESERVED_FLAGS;
+    newPte.SetCopyOnWrite(false);
+    newPte.SetWritable(true);
+    newPte.SetPresent(true);
+    newPte.SetFrame(*newFrame);
+    m_physicalMemory.Exchange32(*pteAddress, newPte.raw);
+    InvalidateMapping({&virtualMemory, virtualPageNumber, *pteAddress});
+
+    RemoveMapping(sharedFrame, *pteAddress);
+    m_frames[*newFrame].use = FrameUse::Data;
+    AddMapping(*newFrame, {&virtualMemory, virtualPageNumber, *pteAddress});
+    ++m_stats.dataFrames;
+    m_policy->OnFrameMapped(*newFrame);
+    ++m_stats.copyOnWriteCopies;
     return true;
 }
+
+void MyOS::ForkPage(VirtualMemoryBase &parent, VirtualMemoryBase &child, const uint32_t virtualPageNumber,
+                    const ForkMode mode)
+{
+    const auto isMapped = [this, &parent, virtualPageNumber] {
+        PTE pte;
+        pte.raw = m_physicalMemory.Read32(*parent.GetPageTableEntryAddress(virtualPageNumber));
+        return pte.IsPresent() || pte.IsSwapped();
+    };
+    if (!isMapped())
+    {
+        return;
+    }
+
+    const auto childPteAddress = EnsurePageTable(child, virtualPageNumber);
+    if (!childPteAddress)
+    {
+        throw std::runtime_error("Out of physical memory for page table");
+    }
+
+    // Выделение таблицы могло вытеснить страницу родителя, поэтому PTE читается только теперь
+    const uint32_t parentPteAddress = *parent.GetPageTableEntryAddress(virtualPageNumber);
+    PTE parentPte;
+    parentPte.raw = m_physicalMemory.Read32(parentPteAddress);
+    PTE childPte = parentPte;
+
+    if (mode == ForkMode::Eager)
+    {
+        std::vector<uint8_t> page(PAGE_SIZE);
+        if (parentPte.IsSwapped())
+        {
+            const uint32_t slot = m_swapFile.AllocateSlot();
+            RetainSlot(slot);
+            m_swapFile.Read(parentPte.GetFrame(), page);
+            m_swapFile.Write(slot, page);
+            childPte.SetFrame(slot);
+        }
+        else
+        {
+            // Копия снимается до выделения кадра: выделение может вытеснить исходную страницу
+            m_physicalMemory.ReadBlock(parentPte.GetFrame() << PTE::FRAME_SHIFT, page);
+            const auto frame = AllocateFrame();
+            if (!frame)
+            {
+                throw std::runtime_error("Out of physical memory for forked page");
+            }
+            m_physicalMemory.WriteBlock(*frame << PTE::FRAME_SHIFT, page);
+            childPte.SetFrame(*frame);
+            m_frames[*frame].use = FrameUse::Data;
+            AddMapping(*frame, {&child, virtualPageNumber, *childPteAddress});
+            ++m_stats.dataFrames;
+            m_policy->OnFrameMapped(*frame);
+        }
+        m_physicalMemory.Write32(*childPteAddress, childPte.raw);
+        return;
+    }
+
+    if (parentPte.IsWritable())
+    {
+        // Ядра родителя продолжают работать и могут выставить бит D, поэтому биты меняются атомарно
+        m_physicalMemory.FetchOr32(parentPteAddress, PTE::COW);
+        m_physicalMemory.FetchAnd32(parentPteAddress, ~PTE::RW);
+        InvalidateMapping({&parent, virtualPageNumber, parentPteAddress});
+        parentPte.raw = m_physicalMemory.Read32(parentPteAddress);
+        childPte = parentPte;
+    }
+
+    if (parentPte.IsSwapped())
+    {
+        RetainSlot(parentPte.GetFrame());
+    }
+    else
+    {
+        AddMapping(parentPte.GetFrame(), {&child, virtualPageNumber, *childPteAddress});
+    }
+    m_physicalMemory.Write32(*childPteAddress, childPte.raw);
+}
+
+void MyOS::AddMapping(const uint32_t frame, const FrameMapping &mapping)
+{
+    auto &mappings = m_frames[frame].mappings;
+    mappings.push_back(mapping);
+    if (mappings.size() == 2)
+    {
+        ++m_stats.sharedFrames;
+    }
+}
+
+void MyOS::RemoveMapping(const uint32_t frame, const uint32_t pteAddress)
+{
+    auto &mappings = m_frames[frame].mappings;
+    std::erase_if(mappings, [pteAddress](const FrameMapping &mapping) { return mapping.pteAddress == pteAddress; });
+
+    if (mappings.size() == 1)
+    {
+        --m_stats.sharedFrames;
+    }
+    else if (mappings.empty())
+    {
+        ReleaseFrame(frame);
+        m_freeFrames.push_back(frame);
+    }
+}
+
+void MyOS::InvalidateMapping(const FrameMapping &mapping)
+{
+    m_shootdown.InvalidatePage(*mapping.owner, mapping.virtualPageNumber);
+}
+
+void MyOS::ReleaseFrame(const uint32_t frame)
+{
+    m_policy->OnFrameUnmapped(frame);
+    DropFrameSlot(frame);
+    m_frames[frame] = FrameInfo{};
+    --m_stats.dataFrames;
+}
+
+void MyOS::RetainSlot(const uint32_t slot)
+{
+    if (slot >= m_slotReferences.size())
+    {
+        m_slotReferences.resize(slot + 1, 0);
+    }
+    ++m_slotReferences[slot];
+}
+
+void MyOS::ReleaseSlot(const uint32_t slot)
+{
+    if (--m_slotReferences[slot] == 0)
+    {
+        m_swapFile.FreeSlot(slot);
+    }
+}
+
+void MyOS::DropFrameSlot(const uint32_t frame)
+{
+    auto &swapSlot = m_frames[frame].swapSlot;
+    if (swapSlot)
+    {
+        ReleaseSlot(*swapSlot);
+        swapSlot.reset();
+    }
+}
+
+bool MyOS::TestAndClearAccessed(const uint32_t frame)
+{
+    bool isAccessed = false;
+    for (const FrameMapping &mapping : m_frames[frame].mappings)
+    {
+        PTE oldPte;
+        oldPte.raw = m_physicalMemory.FetchAnd32(mapping.pteAddress, ~PTE::A);
+        if (!oldPte.IsAccessed())
+        {
+            continue;
+        }
+
+        // Иначе TLB продолжит считать бит A установленным и больше не запишет его в PTE
+        InvalidateMapping(mapping);
+        isAccessed = true;
+    }
+    return isAccessed;
+}
+
+std::optional<uint32_t> MyOS::EnsurePageTable(VirtualMemoryBase &virtualMemory, const uint32_t virtualPageNumber)
+{
+    if (const auto pteAddress = virtualMemory.GetPageTableEntryAddress(virtualPageNumber))
+    {
+        return pteAddress;
+    }
+
+    // Таблицы второго уровня создаются только для реально используемых 4 МиБ участков
+    const auto tableFrame = AllocateZeroedTableFrame();
+    if (!tableFrame)
+    {
+        return std::nullopt;
+    }
+
+    m_physicalMemory.Write32(virtualMemory.GetDirectoryEntryAddress(virtualPageNumber),
+                             MakeTableDirectoryEntry(*tableFrame).raw);
+
+    return virtualMemory.GetPageTableEntryAddress(virtualPageNumber);
+}
+
+std::optional<uint32_t> MyOS::AllocateZeroedTableFrame()
+{
+    const auto tableFrame = AllocateFrame();
+    if (!tableFrame)
+    {
+        return std::nullopt;
+    }
+    ZeroFrame(*tableFrame);
+    m_frames[*tableFrame].use = FrameUse::PageTable;
+    ++m_stats.pageTableFrames;
+    return tableFrame;
+}
+
+void MyOS::ZeroFrame(const uint32_t frame)
+{
+    m_physicalMemory.ZeroBlock(frame << PTE::FRAME_SHIFT, PAGE_SIZE);
+}
@@ -1,13 +1,63 @@
 #include "PhysicalMemory.h"
 
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 PhysicalMemory::PhysicalMemory(const PhysicalMemoryConfig cfg)
+    : m_size(static_cast<uint64_t>(cfg.numFrames) * cfg.frameSize)
 {
-    m_memory.resize(static_cast<size_t>(cfg.numFrames) * cfg.frameSize, 0);
+    if (m_size > (uint64_t{1} << 32))
+    {
+        throw std::invalid_argument("Physical memory cannot exceed the 32-bit address space");
+    }
+
+    switch (cfg.backing)
+    {
+    case PhysicalMemoryBacking::Vector:
+        m_memory.resize(m_size, 0);
+        m_data = m_memory.data();
+        break;
+    case PhysicalMemoryBacking::AnonymousMapping:
+        MapAnonymous();
+        break;
+    case PhysicalMemoryBacking::FileMapping:
+        MapFile(cfg.imagePath);
+        break;
+    }
 }
 
-uint32_t PhysicalMemory::GetSize() const noexcept
+PhysicalMemory::~PhysicalMemory()
 {
-    return m_memory.size();
+    if (m_isMapped)
+    {
+        munmap(m_data, m_size);
+    }
+    if (m_imageFd != -1)
+    {
+        close(m_imageFd);
+    }
+}
+
+uint64_t PhysicalMemory::GetSize() const noexcept
+{
+    return m_size;
+}
+
+bool PhysicalMemory::IsResumedImage() const noexcept
+{
+    return m_isResumedImage;
+}
+
+void PhysicalMemory::Sync()
+{
+    if (m_imageFd != -1 && msync(m_data, m_size, MS_SYNC) != 0)
+    {
+        throw std::runtime_error("Failed to sync physical memory image");
+    }
 }
 
 uint8_t PhysicalMemory::Read8(const uint32_t address) const
@@ -49,3 +99,135 @@ void PhysicalMemory::Write64(const uint32_t address, const uint64_t value)
 {
     Write<uint64_t>(address, value);
 }
+
+bool PhysicalMemory::CompareExchange32(const uint32_t address, uint32_t &expected, const uint32_t desired)
+{
+    return GetWord(address).compare_exchange_strong(expected, desired);
+}
+
+uint32_t PhysicalMemory::Exchange32(const uint32_t address, const uint32_t value)
+{
+    return GetWord(address).exchange(value);
+}
+
+uint32_t PhysicalMemory::FetchAnd32(const uint32_t address, const uint32_t mask)
+{
+    return GetWord(address).fetch_and(mask);
+}
+
+uint32_t PhysicalMemory::FetchOr32(const uint32_t address, const uint32_t mask)
+{
+    return GetWord(address).fetch_or(mask);
+}
+
+void PhysicalMemory::ReadBlock(const uint32_t address, const std::span<uint8_t> buffer) const
+{
+    CheckBlockRange(address, buffer.size());
+    std::memcpy(buffer.data(), m_data + address, buffer.size());
+}
+
+void PhysicalMemory::WriteBlock(const uint32_t address, const std::span<const uint8_t> data)
+{
+    CheckBlockRange(address, data.size());
+    std::memcpy(m_data + address, data.data(), data.size());
+}
+
+void PhysicalMemory::ZeroBlock(const uint32_t address, const uint32_t size)
+{
+    CheckBlockRange(address, size);
+    std::memset(m_data + address, 0, size);
+}
+
+void PhysicalMemory::CheckBlockRange(const uint32_t address, const size_t size) const
+{
+    if (static_cast<uint64_t>(address) + size > m_size)
+    {
+        throw std::out_of_range("Physical memory access out of range");
+    }
+}
+
+std::atomic_ref<uint32_t> PhysicalMemory::GetWord(const uint32_t address)
+{
+    if (address % sizeof(uint32_t) != 0)
+    {
+        ThrowOnError(AccessStatus::MisalignedAccess);
+    }
+    if (address + sizeof(uint32_t) > m_size)
+    {
+        ThrowOnError(AccessStatus::PhysicalAccessOutOfRange);
+    }
+    return std::atomic_ref(*reinterpret_cast<uint32_t *>(m_data + address));
+}
+
+void PhysicalMemory::ThrowOnError(const AccessStatus status)
+{
+    if (status == AccessStatus::MisalignedAccess)
+    {
+        throw std::runtime_error("Misaligned memory access");
+    }
+    if (status == AccessStatus::PhysicalAccessOutOfRange)
+    {
+        throw std::out_of_range("Physical memory access out of range");
+    }
+}
+
+void PhysicalMemory::MapAnonymous()
+{
+    // MAP_NORESERVE: хост выделяет страницу только при первом обращении к ней
+    void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map physical memory");
+    }
+    m_data = static_cast<uint8_t *>(data);
+    m_isMapped = true;
+}
+
+void PhysicalMemory::MapFile(const std::filesystem::path &path)
+{
+    if (path.empty())
+    {
+        throw std::invalid_argument("File-backed physical memory requires an image path");
+    }
+
+    m_imageFd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_imageFd == -1)
+    {
+        throw std::runtime_error("Cannot open physical memory image " + path.string());
+    }
+
+    // Деструктор не вызывается, если конструктор бросил исключение
+    const auto fail = [this](const std::string &message) {
+        close(m_imageFd);
+        m_imageFd = -1;
+        throw std::runtime_error(message);
+    };
+
+    struct stat imageStat{};
+    if (fstat(m_imageFd, &imageStat) != 0)
+    {
+        fail("Cannot stat physical memory image " + path.string());
+    }
+    const auto imageSize = static_cast<uint64_t>(imageStat.st_size);
+    // Образ другого размера - снимок с другим числом кадров, подгонять его под конфигурацию нельзя
+    if (imageSize != 0 && imageSize != m_size)
+    {
+        fail("Physical memory image " + path.string() + " has size " + std::to_string(imageSize)
+             + ", expected " + std::to_string(m_size));
+    }
+    m_isResumedImage = imageSize != 0;
+
+    // ftruncate создаёт разреженный файл, поэтому на диске занято только то, во что писали
+    if (!m_isResumedImage && ftruncate(m_imageFd, static_cast<off_t>(m_size)) != 0)
+    {
+        fail("Cannot resize physical memory image " + path.string());
+    }
+
+    void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_imageFd, 0);
+    if (data == MAP_FAILED)
+    {
+        fail("Failed to map physical memory image " + path.string());
+    }
+    m_data = static_cast<uint8_t *>(data);
+    m_isMapped = true;
+}
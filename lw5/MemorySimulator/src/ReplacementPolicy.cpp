@@ -0,0 +1,152 @@
+#include "ReplacementPolicy.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void ReplacementPolicy::OnTick(const AccessedBitProbe &)
+{
+}
+
+FifoPolicy::FifoPolicy(const uint32_t numFrames)
+    : m_positions(numFrames),
+      m_tracked(numFrames, false)
+{
+}
+
+void FifoPolicy::OnFrameMapped(const uint32_t frame)
+{
+    if (m_tracked[frame])
+    {
+        return;
+    }
+    m_positions[frame] = m_queue.insert(m_queue.end(), frame);
+    m_tracked[frame] = true;
+}
+
+void FifoPolicy::OnFrameUnmapped(const uint32_t frame)
+{
+    if (!m_tracked[frame])
+    {
+        return;
+    }
+    m_queue.erase(m_positions[frame]);
+    m_tracked[frame] = false;
+}
+
+std::optional<uint32_t> FifoPolicy::SelectVictim(const AccessedBitProbe &)
+{
+    if (m_queue.empty())
+    {
+        return std::nullopt;
+    }
+    return m_queue.front();
+}
+
+ClockPolicy::ClockPolicy(const uint32_t numFrames)
+    : m_tracked(numFrames, false)
+{
+}
+
+void ClockPolicy::OnFrameMapped(const uint32_t frame)
+{
+    if (!m_tracked[frame])
+    {
+        m_tracked[frame] = true;
+        ++m_trackedCount;
+    }
+}
+
+void ClockPolicy::OnFrameUnmapped(const uint32_t frame)
+{
+    if (m_tracked[frame])
+    {
+        m_tracked[frame] = false;
+        --m_trackedCount;
+    }
+}
+
+std::optional<uint32_t> ClockPolicy::SelectVictim(const AccessedBitProbe &testAndClearAccessed)
+{
+    if (m_trackedCount == 0)
+    {
+        return std::nullopt;
+    }
+
+    // За два полных оборота стрелки хотя бы у одного кадра бит A окажется сброшен
+    const auto numFrames = static_cast<uint32_t>(m_tracked.size());
+    for (uint32_t step = 0; step < 2 * numFrames; ++step)
+    {
+        const uint32_t frame = m_hand;
+        m_hand = (m_hand + 1) % numFrames;
+        if (m_tracked[frame] && !testAndClearAccessed(frame))
+        {
+            return frame;
+        }
+    }
+    return std::nullopt;
+}
+
+AgingPolicy::AgingPolicy(const uint32_t numFrames)
+    : m_ages(numFrames, 0),
+      m_tracked(numFrames, false),
+      m_faultsPerTick(std::max(1u, numFrames / 64))
+{
+}
+
+void AgingPolicy::OnFrameMapped(const uint32_t frame)
+{
+    m_tracked[frame] = true;
+    m_ages[frame] = 0x80;
+}
+
+void AgingPolicy::OnFrameUnmapped(const uint32_t frame)
+{
+    m_tracked[frame] = false;
+    m_ages[frame] = 0;
+}
+
+void AgingPolicy::OnTick(const AccessedBitProbe &testAndClearAccessed)
+{
+    // Обход всех кадров дорог, поэтому на больших памятях тик срабатывает раз в несколько page fault'ов
+    if (++m_faultsSinceTick < m_faultsPerTick)
+    {
+        return;
+    }
+    m_faultsSinceTick = 0;
+
+    for (uint32_t frame = 0; frame < m_tracked.size(); ++frame)
+    {
+        if (m_tracked[frame])
+        {
+            const bool accessed = testAndClearAccessed(frame);
+            m_ages[frame] = static_cast<uint8_t>((m_ages[frame] >> 1) | (accessed ? 0x80 : 0));
+        }
+    }
+}
+
+std::optional<uint32_t> AgingPolicy::SelectVictim(const AccessedBitProbe &)
+{
+    std::optional<uint32_t> victim;
+    for (uint32_t frame = 0; frame < m_tracked.size(); ++frame)
+    {
+        if (m_tracked[frame] && (!victim || m_ages[frame] < m_ages[*victim]))
+        {
+            victim = frame;
+        }
+    }
+    return victim;
+}
+
+std::unique_ptr<ReplacementPolicy> CreateReplacementPolicy(const ReplacementPolicyKind kind, const uint32_t numFrames)
+{
+    switch (kind)
+    {
+    case ReplacementPolicyKind::Fifo:
+        return std::make_unique<FifoPolicy>(numFrames);
+    case ReplacementPolicyKind::Clock:
+        return std::make_unique<ClockPolicy>(numFrames);
+    case ReplacementPolicyKind::Aging:
+        return std::make_unique<AgingPolicy>(numFrames);
+    }
+    throw std::invalid_argument("Unknown replacement policy");
+}
@@ -0,0 +1,176 @@
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MyOS.h"
+#include "PhysicalMemory.h"
+#include "Trace.h"
+#include "TraceReplayer.h"
+#include "VirtualMemory.h"
+
+namespace
+{
+void PrintUsage()
+{
+    std::cerr << "Usage:\n"
+              << "  replay_trace generate <trace> <loop|uniform|hotcold> [--pages N] [--length N]"
+                 " [--write-percent N] [--seed N]\n"
+              << "  replay_trace replay <trace> [--frames N] [--policy fifo|clock|aging|all]"
+                 " [--tlb-sets N] [--tlb-ways N]\n";
+}
+
+class Options
+{
+public:
+    Options(const int argc, char *argv[], const int first)
+    {
+        if ((argc - first) % 2 != 0)
+        {
+            throw std::invalid_argument(std::string("Missing value for ") + argv[argc - 1]);
+        }
+        for (int i = first; i < argc; i += 2)
+        {
+            m_values.emplace_back(argv[i], argv[i + 1]);
+        }
+    }
+
+    [[nodiscard]] std::optional<std::string_view> Get(const std::string_view name) const
+    {
+        for (const auto &[key, value] : m_values)
+        {
+            if (key == name)
+            {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] uint32_t GetNumber(const std::string_view name, const uint32_t defaultValue) const
+    {
+        const auto value = Get(name);
+        return value ? static_cast<uint32_t>(std::stoul(std::string(*value))) : defaultValue;
+    }
+
+private:
+    std::vector<std::pair<std::string_view, std::string_view>> m_values;
+};
+
+TracePattern ParsePattern(const std::string_view name)
+{
+    if (name == "loop")
+    {
+        return TracePattern::Loop;
+    }
+    if (name == "uniform")
+    {
+        return TracePattern::Uniform;
+    }
+    if (name == "hotcold")
+    {
+        return TracePattern::HotCold;
+    }
+    throw std::invalid_argument("Unknown trace pattern " + std::string(name));
+}
+
+std::vector<std::pair<std::string_view, ReplacementPolicyKind>> ParsePolicies(const std::string_view name)
+{
+    const std::vector<std::pair<std::string_view, ReplacementPolicyKind>> all{
+        { "fifo", ReplacementPolicyKind::Fifo },
+        { "clock", ReplacementPolicyKind::Clock },
+        { "aging", ReplacementPolicyKind::Aging },
+    };
+    if (name == "all")
+    {
+        return all;
+    }
+    for (const auto &policy : all)
+    {
+        if (policy.first == name)
+        {
+            return { policy };
+        }
+    }
+    throw std::invalid_argument("Unknown replacement policy " + std::string(name));
+}
+
+int Generate(const std::string &path, const std::string_view pattern, const Options &options)
+{
+    TraceGeneratorConfig config;
+    config.pattern = ParsePattern(pattern);
+    config.pageCount = options.GetNumber("--pages", config.pageCount);
+    config.length = options.GetNumber("--length", config.length);
+    config.writePercent = options.GetNumber("--write-percent", config.writePercent);
+    config.seed = options.GetNumber("--seed", config.seed);
+
+    TraceRecorder recorder(path);
+    recorder.Record(GenerateTrace(config));
+    recorder.Flush();
+    std::cout << "Recorded " << recorder.GetRecordCount() << " accesses to " << path << std::endl;
+    return 0;
+}
+
+int Replay(const std::string &path, const Options &options)
+{
+    PhysicalMemoryConfig config;
+    config.numFrames = options.GetNumber("--frames", 64);
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = options.GetNumber("--tlb-sets", tlbConfig.numSets);
+    tlbConfig.associativity = options.GetNumber("--tlb-ways", tlbConfig.associativity);
+    const auto policies = ParsePolicies(options.Get("--policy").value_or("all"));
+
+    std::cout << std::left << std::setw(8) << "policy" << std::right
+              << std::setw(12) << "accesses" << std::setw(10) << "failed" << std::setw(10) << "faults"
+              << std::setw(12) << "tlb_hits" << std::setw(10) << "evictions" << std::setw(12) << "write_backs"
+              << std::setw(16) << "accesses/s" << '\n';
+
+    for (const auto &[name, policy] : policies)
+    {
+        PhysicalMemory physicalMemory(config);
+        MyOSConfig osConfig;
+        osConfig.replacementPolicy = policy;
+        MyOS osHandler(physicalMemory, osConfig);
+        BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler, tlbConfig);
+        virtualMemory.SetPageTableAddress(0);
+
+        TraceReader reader(path);
+        TraceReplayer replayer(virtualMemory, osHandler);
+        replayer.Replay(reader);
+
+        const ReplayStats stats = replayer.GetStats();
+        std::cout << std::left << std::setw(8) << name << std::right
+                  << std::setw(12) << stats.accesses << std::setw(10) << stats.failedAccesses
+                  << std::setw(10) << stats.pageFaults << std::setw(12) << stats.tlbHits
+                  << std::setw(10) << stats.evictions << std::setw(12) << stats.dirtyWriteBacks
+                  << std::setw(16) << std::fixed << std::setprecision(0) << stats.GetAccessesPerSecond() << '\n';
+    }
+    return 0;
+}
+}
+
+int main(const int argc, char *argv[])
+{
+    try
+    {
+        const std::string_view command = argc > 1 ? argv[1] : "";
+        if (command == "generate" && argc >= 4)
+        {
+            return Generate(argv[2], argv[3], Options(argc, argv, 4));
+        }
+        if (command == "replay" && argc >= 3)
+        {
+            return Replay(argv[2], Options(argc, argv, 3));
+        }
+        PrintUsage();
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
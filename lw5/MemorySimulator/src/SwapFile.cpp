@@ -0,0 +1,86 @@
+#include "SwapFile.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+// Номер слота хранится в поле кадра PTE, поэтому слотов не больше, чем кадров
+constexpr uint32_t MAX_SLOTS = 1u << 20;
+
+std::filesystem::path MakeTemporaryPath()
+{
+    static std::atomic<uint32_t> counter{0};
+    return std::filesystem::temp_directory_path()
+           / ("memory-simulator-swap-" + std::to_string(getpid()) + "-" + std::to_string(counter++) + ".bin");
+}
+}
+
+SwapFile::SwapFile(const std::filesystem::path &path, const uint32_t pageSize)
+    : m_path(path.empty() ? MakeTemporaryPath() : path),
+      m_isTemporary(path.empty()),
+      m_pageSize(pageSize)
+{
+    m_stream.open(m_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_stream.is_open())
+    {
+        throw std::runtime_error("Cannot open swap file " + m_path.string());
+    }
+}
+
+SwapFile::~SwapFile()
+{
+    m_stream.close();
+    if (m_isTemporary)
+    {
+        std::error_code error;
+        std::filesystem::remove(m_path, error);
+    }
+}
+
+uint32_t SwapFile::AllocateSlot()
+{
+    if (!m_freeSlots.empty())
+    {
+        const uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+    if (m_slotCount == MAX_SLOTS)
+    {
+        throw std::runtime_error("Swap file is full");
+    }
+    return m_slotCount++;
+}
+
+void SwapFile::FreeSlot(const uint32_t slot)
+{
+    m_freeSlots.push_back(slot);
+}
+
+void SwapFile::Read(const uint32_t slot, const std::span<uint8_t> page)
+{
+    m_stream.seekg(static_cast<std::streamoff>(slot) * m_pageSize, std::ios::beg);
+    m_stream.read(reinterpret_cast<char *>(page.data()), static_cast<std::streamsize>(page.size()));
+    if (!m_stream)
+    {
+        throw std::runtime_error("Swap file read failed");
+    }
+}
+
+void SwapFile::Write(const uint32_t slot, const std::span<const uint8_t> page)
+{
+    m_stream.seekp(static_cast<std::streamoff>(slot) * m_pageSize, std::ios::beg);
+    m_stream.write(reinterpret_cast<const char *>(page.data()), static_cast<std::streamsize>(page.size()));
+    if (!m_stream)
+    {
+        throw std::runtime_error("Swap file write failed");
+    }
+}
+
+uint32_t SwapFile::GetUsedSlotCount() const noexcept
+{
+    return m_slotCount - static_cast<uint32_t>(m_freeSlots.size());
+}
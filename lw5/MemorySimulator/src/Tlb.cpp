@@ -0,0 +1,148 @@
+#include "Tlb.h"
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+
+Tlb::Tlb(const TlbConfig config)
+    : m_config(config)
+{
+    if (config.numSets != 0 && (config.numSets & (config.numSets - 1)) != 0)
+    {
+        throw std::invalid_argument("TLB set count must be a power of two.");
+    }
+    if (config.numSets != 0 && config.associativity == 0)
+    {
+        throw std::invalid_argument("TLB associativity must be positive.");
+    }
+    m_entries.resize(static_cast<size_t>(config.numSets) * config.associativity);
+    if (config.numSets != 0)
+    {
+        m_largeEntries.resize(config.largePageEntries);
+    }
+}
+
+void Tlb::Insert(uint32_t virtualPageNumber, const PTE pte, const uint32_t pteAddress)
+{
+    if (m_entries.empty())
+    {
+        return;
+    }
+
+    std::span<TlbEntry> candidates(GetSet(virtualPageNumber), m_config.associativity);
+    uint32_t offsetMask = (1u << PTE::FRAME_SHIFT) - 1;
+    if (pte.IsLargePage())
+    {
+        if (m_largeEntries.empty())
+        {
+            return;
+        }
+        candidates = m_largeEntries;
+        virtualPageNumber = GetLargePageBase(virtualPageNumber);
+        offsetMask = PTE::LARGE_PAGE_OFFSET_MASK;
+    }
+
+    TlbEntry *victim = &candidates[0];
+    for (TlbEntry &entry : candidates)
+    {
+        if (entry.valid && entry.virtualPageNumber == virtualPageNumber)
+        {
+            victim = &entry;
+            break;
+        }
+        if (!entry.valid)
+        {
+            victim = &entry;
+        }
+        else if (victim->valid && entry.lastUse < victim->lastUse)
+        {
+            victim = &entry;
+        }
+    }
+
+    victim->virtualPageNumber = virtualPageNumber;
+    victim->pte = pte;
+    victim->pteAddress = pteAddress;
+    victim->offsetMask = offsetMask;
+    victim->lastUse = ++m_clock;
+    victim->valid = true;
+}
+
+void Tlb::Invalidate(const uint32_t virtualPageNumber)
+{
+    if (m_entries.empty())
+    {
+        return;
+    }
+
+    TlbEntry *set = GetSet(virtualPageNumber);
+    for (uint32_t way = 0; way < m_config.associativity; ++way)
+    {
+        if (set[way].virtualPageNumber == virtualPageNumber)
+        {
+            set[way].valid = false;
+        }
+    }
+
+    const uint32_t largePageBase = GetLargePageBase(virtualPageNumber);
+    for (TlbEntry &entry : m_largeEntries)
+    {
+        if (entry.virtualPageNumber == largePageBase)
+        {
+            entry.valid = false;
+        }
+    }
+}
+
+void Tlb::Flush()
+{
+    for (auto &entry : m_entries)
+    {
+        entry.valid = false;
+    }
+    for (auto &entry : m_largeEntries)
+    {
+        entry.valid = false;
+    }
+}
+
+TlbEntry *Tlb::LookupLargePage(const uint32_t virtualPageNumber)
+{
+    if (m_largeEntries.empty())
+    {
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    const uint32_t largePageBase = GetLargePageBase(virtualPageNumber);
+    // Последовательный проход долго остаётся в одной большой странице, поэтому она проверяется первой
+    TlbEntry *entry = &m_largeEntries[m_lastLargeEntry];
+    if (!entry->valid || entry->virtualPageNumber != largePageBase)
+    {
+        const auto found = std::ranges::find_if(m_largeEntries, [largePageBase](const TlbEntry &candidate) {
+            return candidate.valid && candidate.virtualPageNumber == largePageBase;
+        });
+        entry = found == m_largeEntries.end() ? nullptr : &*found;
+    }
+    if (entry != nullptr)
+    {
+        ++m_stats.hits;
+        ++m_stats.largePageHits;
+        entry->lastUse = ++m_clock;
+        m_lastLargeEntry = static_cast<uint32_t>(entry - m_largeEntries.data());
+        return entry;
+    }
+
+    ++m_stats.misses;
+    return nullptr;
+}
+
+TlbStats Tlb::GetStats() const noexcept
+{
+    return m_stats;
+}
+
+void Tlb::ResetStats() noexcept
+{
+    m_stats = {};
+}
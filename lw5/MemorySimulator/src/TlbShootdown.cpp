@@ -0,0 +1,56 @@
+#include "TlbShootdown.h"
+#include "VirtualMemory.h"
+
+#include <stdexcept>
+#include <thread>
+
+void TlbShootdown::RegisterCore(VirtualMemoryBase &core)
+{
+    std::lock_guard lock(m_mutex);
+    if (core.m_mailbox != nullptr)
+    {
+        throw std::invalid_argument("Core is already registered for TLB shootdown");
+    }
+    auto mailbox = std::make_unique<ShootdownMailbox>();
+    core.m_mailbox = mailbox.get();
+    m_cores.push_back({&core, std::move(mailbox)});
+}
+
+void TlbShootdown::UnregisterCore(VirtualMemoryBase &core)
+{
+    std::lock_guard lock(m_mutex);
+    core.m_mailbox = nullptr;
+    std::erase_if(m_cores, [&core](const Core &registered) { return registered.core == &core; });
+}
+
+void TlbShootdown::InvalidatePage(VirtualMemoryBase &owner, const uint32_t virtualPageNumber)
+{
+    std::lock_guard lock(m_mutex);
+    if (owner.m_mailbox == nullptr)
+    {
+        owner.InvalidatePage(virtualPageNumber);
+    }
+
+    std::vector<std::pair<ShootdownMailbox *, uint64_t>> targets;
+    for (const Core &core : m_cores)
+    {
+        if (core.core->GetPageTableAddress() != owner.GetPageTableAddress())
+        {
+            continue;
+        }
+        std::lock_guard mailboxLock(core.mailbox->mutex);
+        core.mailbox->pendingPages.push_back(virtualPageNumber);
+        targets.emplace_back(core.mailbox.get(), ++core.mailbox->requested);
+        core.mailbox->hasPending.store(true);
+    }
+
+    // Пара seq_cst-операций hasPending/inAccess гарантирует: ядро, начавшее обращение после проверки,
+    // увидит запрос. Ядро в обработчике page fault'а вне обращения, поэтому ожидание не блокирует ОС
+    for (const auto &[mailbox, generation] : targets)
+    {
+        while (mailbox->inAccess.load() && mailbox->acknowledged.load(std::memory_order_acquire) < generation)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,231 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::array<char, 4> MAGIC{ 'M', 'T', 'R', 'C' };
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = MAGIC.size() + sizeof(VERSION);
+constexpr size_t RECORD_SIZE = 5;
+
+// Биты 0-1 - log2 размера обращения
+constexpr uint8_t SIZE_MASK = 0b11;
+constexpr uint8_t WRITE_FLAG = 1u << 2;
+constexpr uint8_t SUPERVISOR_FLAG = 1u << 3;
+constexpr uint8_t EXECUTE_FLAG = 1u << 4;
+constexpr uint8_t KNOWN_FLAGS = SIZE_MASK | WRITE_FLAG | SUPERVISOR_FLAG | EXECUTE_FLAG;
+
+constexpr size_t RECORDER_BUFFER_SIZE = RECORD_SIZE << 14;
+
+void PutUint32(uint8_t *out, const uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t GetUint32(const uint8_t *in)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+uint8_t EncodeFlags(const TraceRecord &record)
+{
+    if (!std::has_single_bit(record.size) || record.size > 8)
+    {
+        throw std::invalid_argument("Trace record size must be 1, 2, 4 or 8");
+    }
+    uint8_t flags = static_cast<uint8_t>(std::countr_zero(record.size));
+    if (record.access == Access::Write)
+    {
+        flags |= WRITE_FLAG;
+    }
+    if (record.privilege == Privilege::Supervisor)
+    {
+        flags |= SUPERVISOR_FLAG;
+    }
+    if (record.execute)
+    {
+        flags |= EXECUTE_FLAG;
+    }
+    return flags;
+}
+
+TraceRecord DecodeRecord(const uint8_t *in)
+{
+    const uint8_t flags = in[4];
+    if ((flags & ~KNOWN_FLAGS) != 0)
+    {
+        throw std::runtime_error("Trace record has unknown flags");
+    }
+
+    TraceRecord record;
+    record.address = GetUint32(in);
+    record.size = static_cast<uint8_t>(1u << (flags & SIZE_MASK));
+    record.access = (flags & WRITE_FLAG) != 0 ? Access::Write : Access::Read;
+    record.privilege = (flags & SUPERVISOR_FLAG) != 0 ? Privilege::Supervisor : Privilege::User;
+    record.execute = (flags & EXECUTE_FLAG) != 0;
+    return record;
+}
+}
+
+TraceRecorder::TraceRecorder(const std::filesystem::path &path)
+    : m_stream(path, std::ios::binary | std::ios::trunc)
+{
+    if (!m_stream.is_open())
+    {
+        throw std::runtime_error("Cannot create trace file " + path.string());
+    }
+    m_buffer.reserve(RECORDER_BUFFER_SIZE);
+    m_buffer.insert(m_buffer.end(), MAGIC.begin(), MAGIC.end());
+    m_buffer.resize(HEADER_SIZE);
+    PutUint32(m_buffer.data() + MAGIC.size(), VERSION);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+void TraceRecorder::Record(const TraceRecord &record)
+{
+    const uint8_t flags = EncodeFlags(record);
+    const size_t offset = m_buffer.size();
+    m_buffer.resize(offset + RECORD_SIZE);
+    PutUint32(m_buffer.data() + offset, record.address);
+    m_buffer[offset + 4] = flags;
+    ++m_recordCount;
+
+    if (m_buffer.size() + RECORD_SIZE > RECORDER_BUFFER_SIZE)
+    {
+        Flush();
+    }
+}
+
+void TraceRecorder::Record(const std::span<const TraceRecord> records)
+{
+    for (const TraceRecord &record : records)
+    {
+        Record(record);
+    }
+}
+
+void TraceRecorder::Flush()
+{
+    if (m_buffer.empty())
+    {
+        return;
+    }
+    m_stream.write(reinterpret_cast<const char *>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+    m_stream.flush();
+    m_buffer.clear();
+    if (!m_stream)
+    {
+        throw std::runtime_error("Trace file write failed");
+    }
+}
+
+uint64_t TraceRecorder::GetRecordCount() const noexcept
+{
+    return m_recordCount;
+}
+
+TraceReader::TraceReader(const std::filesystem::path &path, const size_t chunkRecords)
+    : m_stream(path, std::ios::binary),
+      m_chunkRecords(chunkRecords)
+{
+    if (!m_stream.is_open())
+    {
+        throw std::runtime_error("Cannot open trace file " + path.string());
+    }
+    if (chunkRecords == 0)
+    {
+        throw std::invalid_argument("Trace chunk must hold at least one record");
+    }
+
+    std::array<uint8_t, HEADER_SIZE> header{};
+    m_stream.read(reinterpret_cast<char *>(header.data()), header.size());
+    if (!m_stream || !std::equal(MAGIC.begin(), MAGIC.end(), header.begin()))
+    {
+        throw std::runtime_error(path.string() + " is not a memory trace");
+    }
+    if (GetUint32(header.data() + MAGIC.size()) != VERSION)
+    {
+        throw std::runtime_error("Unsupported trace version in " + path.string());
+    }
+
+    m_bytes.resize(m_chunkRecords * RECORD_SIZE);
+    m_records.reserve(m_chunkRecords);
+}
+
+std::span<const TraceRecord> TraceReader::ReadChunk()
+{
+    m_records.clear();
+    m_stream.read(reinterpret_cast<char *>(m_bytes.data()), static_cast<std::streamsize>(m_bytes.size()));
+    const auto bytesRead = static_cast<size_t>(m_stream.gcount());
+    if (bytesRead % RECORD_SIZE != 0)
+    {
+        throw std::runtime_error("Trace file is truncated");
+    }
+
+    for (size_t offset = 0; offset < bytesRead; offset += RECORD_SIZE)
+    {
+        m_records.push_back(DecodeRecord(m_bytes.data() + offset));
+    }
+    return m_records;
+}
+
+std::vector<TraceRecord> GenerateTrace(const TraceGeneratorConfig &config)
+{
+    if (config.pageCount == 0)
+    {
+        throw std::invalid_argument("Trace needs at least one page");
+    }
+
+    std::mt19937 generator(config.seed);
+    std::uniform_int_distribution<uint32_t> page(0, config.pageCount - 1);
+    std::uniform_int_distribution<uint32_t> hotPage(0, std::max(config.pageCount / 5, 1u) - 1);
+    std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+    std::vector<TraceRecord> trace;
+    trace.reserve(config.length);
+    for (uint32_t i = 0; i < config.length; ++i)
+    {
+        uint32_t vpn = 0;
+        switch (config.pattern)
+        {
+        case TracePattern::Loop:
+            vpn = i % config.pageCount;
+            break;
+        case TracePattern::Uniform:
+            vpn = page(generator);
+            break;
+        case TracePattern::HotCold:
+            vpn = percent(generator) < 80 ? hotPage(generator) : page(generator);
+            break;
+        }
+
+        TraceRecord record;
+        record.address = (config.firstPage + vpn) << PTE::FRAME_SHIFT;
+        record.access = percent(generator) < config.writePercent ? Access::Write : Access::Read;
+        trace.push_back(record);
+    }
+    return trace;
+}
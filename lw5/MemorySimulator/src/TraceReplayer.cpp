@@ -0,0 +1,85 @@
+#include "TraceReplayer.h"
+
+namespace
+{
+template<typename T>
+AccessStatus ReplayAccess(BasicVirtualMemory<MyOS> &virtualMemory, const TraceRecord &record)
+{
+    if (record.access == Access::Write)
+    {
+        return virtualMemory.TryWrite(record.address, static_cast<T>(record.address), record.privilege);
+    }
+    T value{};
+    return virtualMemory.TryRead(record.address, value, record.privilege, record.execute);
+}
+}
+
+TraceReplayer::TraceReplayer(BasicVirtualMemory<MyOS> &virtualMemory, MyOS &os)
+    : m_virtualMemory(virtualMemory),
+      m_os(os),
+      m_initialOsStats(os.GetStats()),
+      m_initialTlbStats(virtualMemory.GetTlbStats())
+{
+}
+
+void TraceReplayer::Replay(const std::span<const TraceRecord> records)
+{
+    const auto start = std::chrono::steady_clock::now();
+    ReplayRecords(records);
+    m_elapsed += std::chrono::steady_clock::now() - start;
+}
+
+void TraceReplayer::Replay(TraceReader &reader)
+{
+    // Время чтения и разбора файла в статистику не входит
+    for (auto chunk = reader.ReadChunk(); !chunk.empty(); chunk = reader.ReadChunk())
+    {
+        Replay(chunk);
+    }
+}
+
+ReplayStats TraceReplayer::GetStats() const
+{
+    const MyOSStats osStats = m_os.GetStats();
+    const TlbStats tlbStats = m_virtualMemory.GetTlbStats();
+
+    ReplayStats stats;
+    stats.accesses = m_accesses;
+    stats.failedAccesses = m_failedAccesses;
+    stats.pageFaults = osStats.pageFaults - m_initialOsStats.pageFaults;
+    stats.tlbHits = tlbStats.hits - m_initialTlbStats.hits;
+    stats.tlbMisses = tlbStats.misses - m_initialTlbStats.misses;
+    stats.evictions = osStats.evictions - m_initialOsStats.evictions;
+    stats.dirtyWriteBacks = osStats.dirtyWriteBacks - m_initialOsStats.dirtyWriteBacks;
+    stats.swapIns = osStats.swapIns - m_initialOsStats.swapIns;
+    stats.seconds = std::chrono::duration<double>(m_elapsed).count();
+    return stats;
+}
+
+void TraceReplayer::ReplayRecords(const std::span<const TraceRecord> records)
+{
+    for (const TraceRecord &record : records)
+    {
+        AccessStatus status = AccessStatus::Ok;
+        switch (record.size)
+        {
+        case 1:
+            status = ReplayAccess<uint8_t>(m_virtualMemory, record);
+            break;
+        case 2:
+            status = ReplayAccess<uint16_t>(m_virtualMemory, record);
+            break;
+        case 8:
+            status = ReplayAccess<uint64_t>(m_virtualMemory, record);
+            break;
+        default:
+            status = ReplayAccess<uint32_t>(m_virtualMemory, record);
+            break;
+        }
+        if (status != AccessStatus::Ok)
+        {
+            ++m_failedAccesses;
+        }
+    }
+    m_accesses += records.size();
+}
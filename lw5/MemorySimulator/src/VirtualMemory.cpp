@@ -1,86 +1,119 @@
 #include "VirtualMemory.h"
 
-VirtualMemory::VirtualMemory(PhysicalMemory &physicalMemory, OSHandler &handler)
+VirtualMemoryBase::VirtualMemoryBase(PhysicalMemory &physicalMemory, const TlbConfig tlbConfig)
     : m_physicalMemory(physicalMemory),
-      m_handler(handler)
+      m_tlb(tlbConfig)
 {
 }
 
-void VirtualMemory::SetPageTableAddress(const uint32_t physicalAddress)
+void VirtualMemoryBase::SetPageTableAddress(const uint32_t physicalAddress)
 {
     if ((physicalAddress & 0xFFF) != 0)
     {
         throw std::invalid_argument("Page table address must be aligned to 4096 bytes.");
     }
     m_pageTableAddress = physicalAddress;
+    m_tlb.Flush();
 }
 
-uint32_t VirtualMemory::GetPageTableAddress() const noexcept
+uint32_t VirtualMemoryBase::GetPageTableAddress() const noexcept
 {
     return m_pageTableAddress;
 }
 
-uint8_t VirtualMemory::Read8(const uint32_t address, const Privilege privilege, const bool execute) const
+uint32_t VirtualMemoryBase::GetDirectoryEntryAddress(const uint32_t virtualPageNumber) const noexcept
 {
-    return Read<uint8_t>(address, privilege, execute);
+    return m_pageTableAddress + PTE::GetDirectoryIndex(virtualPageNumber) * sizeof(PTE);
 }
 
-uint16_t VirtualMemory::Read16(const uint32_t address, const Privilege privilege, const bool execute) const
+std::optional<uint32_t> VirtualMemoryBase::GetPageTableEntryAddress(const uint32_t virtualPageNumber) const
 {
-    return Read<uint16_t>(address, privilege, execute);
-}
-
-uint32_t VirtualMemory::Read32(const uint32_t address, const Privilege privilege, const bool execute) const
-{
-    return Read<uint32_t>(address, privilege, execute);
-}
-
-uint64_t VirtualMemory::Read64(const uint32_t address, const Privilege privilege, const bool execute) const
-{
-    return Read<uint64_t>(address, privilege, execute);
+    PTE directoryEntry;
+    directoryEntry.raw = m_physicalMemory.Read32(GetDirectoryEntryAddress(virtualPageNumber));
+    if (!directoryEntry.IsPresent() || directoryEntry.IsLargePage())
+    {
+        return std::nullopt;
+    }
+    return (directoryEntry.GetFrame() << PTE::FRAME_SHIFT) + PTE::GetTableIndex(virtualPageNumber) * sizeof(PTE);
 }
 
-void VirtualMemory::Write8(const uint32_t address, const uint8_t value, const Privilege privilege)
+void VirtualMemoryBase::InvalidatePage(const uint32_t virtualPageNumber)
 {
-    Write<uint8_t>(address, value, privilege);
+    m_tlb.Invalidate(virtualPageNumber);
 }
 
-void VirtualMemory::Write16(const uint32_t address, const uint16_t value, const Privilege privilege)
+void VirtualMemoryBase::FlushTlb()
 {
-    Write<uint16_t>(address, value, privilege);
+    m_tlb.Flush();
 }
 
-void VirtualMemory::Write32(const uint32_t address, const uint32_t value, const Privilege privilege)
+TlbStats VirtualMemoryBase::GetTlbStats() const noexcept
 {
-    Write<uint32_t>(address, value, privilege);
+    return m_tlb.GetStats();
 }
 
-void VirtualMemory::Write64(const uint32_t address, const uint64_t value, const Privilege privilege)
+TranslationResult VirtualMemoryBase::TranslateAddress(
+    const uint32_t virtualAddress,
+    const Access access,
+    const Privilege privilege,
+    const bool execute) const
 {
-    Write<uint64_t>(address, value, privilege);
+    return TranslateAddress(virtualAddress, access, privilege, execute,
+                            m_tlb.Lookup(virtualAddress >> PTE::FRAME_SHIFT));
 }
 
-TranslationResult VirtualMemory::TranslateAddress(
+TranslationResult VirtualMemoryBase::TranslateAddress(
     const uint32_t virtualAddress,
     const Access access,
     const Privilege privilege,
-    const bool execute) const
+    const bool execute,
+    const TlbEntry *entry) const
 {
     const uint32_t virtualPageNumber = virtualAddress >> PTE::FRAME_SHIFT;
     const uint32_t offset = virtualAddress & 0xFFF;
 
-    const uint32_t pteAddress = m_pageTableAddress + virtualPageNumber * sizeof(PTE);
-
-    PTE pageTableEntry;
-    pageTableEntry.raw = m_physicalMemory.Read32(pteAddress);
-
     TranslationResult result;
-    result.pte = pageTableEntry;
-    if (!CheckAccess(result, pageTableEntry, access, privilege, execute)) {
+    if (entry != nullptr)
+    {
+        result.pte = entry->pte;
+        result.pteAddress = entry->pteAddress;
+        result.fromTlb = true;
+    }
+    else
+    {
+        const uint32_t directoryEntryAddress = GetDirectoryEntryAddress(virtualPageNumber);
+        PTE directoryEntry;
+        directoryEntry.raw = m_physicalMemory.Read32(directoryEntryAddress);
+        if (directoryEntry.IsPresent() && directoryEntry.IsLargePage())
+        {
+            // Запись каталога и есть последний уровень: биты A/D выставляются в ней
+            result.pteAddress = directoryEntryAddress;
+            result.pte = directoryEntry;
+        }
+        else
+        {
+            if (!CheckAccess(result, directoryEntry, access, privilege, false))
+            {
+                return result;
+            }
+
+            result.pteAddress = (directoryEntry.GetFrame() << PTE::FRAME_SHIFT)
+                                + PTE::GetTableIndex(virtualPageNumber) * sizeof(PTE);
+            result.pte.raw = m_physicalMemory.Read32(result.pteAddress);
+        }
+    }
+
+    if (!CheckAccess(result, result.pte, access, privilege, execute)) {
+        // Как и x86, при отказе выбрасываем запись, чтобы повтор перечитал PTE из памяти
+        m_tlb.Invalidate(virtualPageNumber);
         return result;
     }
 
-    const uint32_t pageFrameNumber = pageTableEntry.GetFrame();
+    uint32_t pageFrameNumber = result.pte.GetFrame();
+    if (result.pte.IsLargePage())
+    {
+        pageFrameNumber += PTE::GetTableIndex(virtualPageNumber);
+    }
     const uint32_t physicalAddress = pageFrameNumber << PTE::FRAME_SHIFT | offset;
 
     result.success = true;
@@ -89,7 +122,75 @@ TranslationResult VirtualMemory::TranslateAddress(
     return result;
 }
 
-bool VirtualMemory::CheckAccess(
+bool VirtualMemoryBase::CommitTranslation(
+    const TranslationResult &result,
+    const uint32_t virtualPageNumber,
+    const Access access) const
+{
+    PTE updatedPte = result.pte;
+    updatedPte.SetAccessed(true);
+    if (access == Access::Write)
+    {
+        updatedPte.SetDirty(true);
+    }
+
+    // Как и процессор, выставляем биты атомарно: ОС могла изменить PTE после нашего чтения
+    uint32_t expected = result.pte.raw;
+    if (updatedPte.raw != result.pte.raw
+        && !m_physicalMemory.CompareExchange32(result.pteAddress, expected, updatedPte.raw))
+    {
+        m_tlb.Invalidate(virtualPageNumber);
+        return false;
+    }
+    if (updatedPte.raw != result.pte.raw || !result.fromTlb)
+    {
+        m_tlb.Insert(virtualPageNumber, updatedPte, result.pteAddress);
+    }
+    return true;
+}
+
+void VirtualMemoryBase::DrainShootdowns() const
+{
+    std::vector<uint32_t> pages;
+    uint64_t generation = 0;
+    {
+        std::lock_guard lock(m_mailbox->mutex);
+        pages.swap(m_mailbox->pendingPages);
+        generation = m_mailbox->requested;
+        m_mailbox->hasPending.store(false);
+    }
+
+    for (const uint32_t virtualPageNumber : pages)
+    {
+        m_tlb.Invalidate(virtualPageNumber);
+    }
+    m_mailbox->acknowledged.store(generation, std::memory_order_release);
+}
+
+void VirtualMemoryBase::ThrowAccessError(const AccessStatus status, const Access access)
+{
+    switch (status)
+    {
+    case AccessStatus::MisalignedAccess:
+        throw std::runtime_error("Misaligned memory access");
+    case AccessStatus::PhysicalAccessOutOfRange:
+        throw std::out_of_range("Physical memory access out of range");
+    default:
+        throw std::runtime_error(access == Access::Read
+                                     ? "Unhandled page fault on read"
+                                     : "Unhandled page fault on write");
+    }
+}
+
+void VirtualMemoryBase::CheckBlockRange(const uint32_t address, const size_t size)
+{
+    if (static_cast<uint64_t>(address) + size > (uint64_t{1} << 32))
+    {
+        throw std::out_of_range("Virtual memory block crosses the end of the address space");
+    }
+}
+
+bool VirtualMemoryBase::CheckAccess(
     TranslationResult &result,
     const PTE &pte,
     const Access access,
@@ -13,7 +13,10 @@ void RunSimulation()
     config.numFrames = 256;
     PhysicalMemory physicalMemory(config);
 
-    MyOS osHandler(physicalMemory);
+    StreamLogSink logSink(std::cout);
+    MyOSConfig osConfig;
+    osConfig.logSink = &logSink;
+    MyOS osHandler(physicalMemory, osConfig);
     VirtualMemory virtualMemory(physicalMemory, osHandler);
 
     constexpr uint32_t pageTableAddress = 0;
@@ -41,9 +44,10 @@ void RunSimulation()
     std::cout << "\n--- Ending Simulation ---" << std::endl;
 
     constexpr uint32_t vpn = virtualAddressToTest >> PTE::FRAME_SHIFT;
-    constexpr uint32_t pteAddress = pageTableAddress + vpn * sizeof(PTE);
+    const auto pteAddress = virtualMemory.GetPageTableEntryAddress(vpn);
+    assert(pteAddress.has_value());
     PTE finalPte;
-    finalPte.raw = physicalMemory.Read32(pteAddress);
+    finalPte.raw = physicalMemory.Read32(*pteAddress);
 
     std::cout << "\nFinal PTE raw value: " << std::hex << finalPte.raw << std::endl;
     assert(finalPte.IsPresent());
@@ -3,6 +3,11 @@
 #include "../include/PhysicalMemory.h"
 #include "../include/MyOS.h"
 #include "../include/VirtualMemory.h"
+#include "../include/Trace.h"
+#include "../include/TraceReplayer.h"
+
+#include <fstream>
+#include <thread>
 
 class VirtualMemoryTest : public ::testing::Test {
 protected:
@@ -27,10 +32,26 @@ protected:
         pte.SetUser(isUser);
         pte.SetFrame(pfn);
 
-        const uint32_t pte_address = virtualMemory->GetPageTableAddress() + vpn * sizeof(PTE);
-        physicalMemory->Write32(pte_address, pte.raw);
+        physicalMemory->Write32(EnsurePageTable(vpn), pte.raw);
         return pte;
     }
+
+    uint32_t EnsurePageTable(const uint32_t vpn) const
+    {
+        PTE directoryEntry;
+        directoryEntry.raw = physicalMemory->Read32(virtualMemory->GetDirectoryEntryAddress(vpn));
+        if (!directoryEntry.IsPresent())
+        {
+            directoryEntry.SetPresent(true);
+            directoryEntry.SetWritable(true);
+            directoryEntry.SetUser(true);
+            directoryEntry.SetFrame(PAGE_TABLE_FRAME);
+            physicalMemory->Write32(virtualMemory->GetDirectoryEntryAddress(vpn), directoryEntry.raw);
+        }
+        return *virtualMemory->GetPageTableEntryAddress(vpn);
+    }
+
+    static constexpr uint32_t PAGE_TABLE_FRAME = 200;
 };
 
 TEST_F(VirtualMemoryTest, HandlesPageFaultOnFirstWrite) {
@@ -89,7 +110,7 @@ TEST_F(VirtualMemoryTest, ThrowsOnExecuteFromNXPage) {
 
     PTE pte = CreatePage(vpn, pfn, true, true);
     pte.SetNX(true);
-    physicalMemory->Write32(virtualMemory->GetPageTableAddress() + vpn * sizeof(PTE), pte.raw);
+    physicalMemory->Write32(EnsurePageTable(vpn), pte.raw);
 
     ASSERT_THROW(virtualMemory->Read32(addr, Privilege::User, true), std::runtime_error);
 }
@@ -98,7 +119,7 @@ TEST_F(VirtualMemoryTest, SetsAccessedBitOnRead) {
     constexpr uint32_t vpn = 50;
     constexpr uint32_t pfn = 7;
     constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
-    const uint32_t pteAddr = virtualMemory->GetPageTableAddress() + vpn * sizeof(PTE);
+    const uint32_t pteAddr = EnsurePageTable(vpn);
 
     CreatePage(vpn, pfn, true, true);
 
@@ -115,7 +136,7 @@ TEST_F(VirtualMemoryTest, SetsAccessedAndDirtyBitsOnWrite) {
     constexpr uint32_t vpn = 60;
     constexpr uint32_t pfn = 8;
     constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
-    const uint32_t pteAddr = virtualMemory->GetPageTableAddress() + vpn * sizeof(PTE);
+    const uint32_t pteAddr = EnsurePageTable(vpn);
 
     CreatePage(vpn, pfn, true, true);
 
@@ -135,4 +156,737 @@ TEST_F(VirtualMemoryTest, ThrowsOnMisalignedPageTableAddress) {
     ASSERT_NO_THROW(virtualMemory->SetPageTableAddress(0));
     ASSERT_NO_THROW(virtualMemory->SetPageTableAddress(4096));
     ASSERT_NO_THROW(virtualMemory->SetPageTableAddress(8192));
-}
\ No newline at end of file
+}
+
+TEST_F(VirtualMemoryTest, RepeatedAccessHitsTlb) {
+    constexpr uint32_t vpn = 70;
+    constexpr uint32_t pfn = 9;
+    constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
+
+    CreatePage(vpn, pfn, true, true);
+
+    virtualMemory->Write32(addr, 1, Privilege::User);
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(virtualMemory->Read32(addr + i * 4, Privilege::User), i == 0 ? 1u : 0u);
+    }
+
+    const TlbStats stats = virtualMemory->GetTlbStats();
+    ASSERT_EQ(stats.misses, 1u);
+    ASSERT_EQ(stats.hits, 10u);
+}
+
+TEST_F(VirtualMemoryTest, InvalidatePageDropsStaleTranslation) {
+    constexpr uint32_t vpn = 80;
+    constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
+
+    CreatePage(vpn, 10, true, true);
+    physicalMemory->Write32(10u << PTE::FRAME_SHIFT, 111);
+    physicalMemory->Write32(11u << PTE::FRAME_SHIFT, 222);
+    ASSERT_EQ(virtualMemory->Read32(addr, Privilege::User), 111u);
+
+    CreatePage(vpn, 11, true, true);
+    ASSERT_EQ(virtualMemory->Read32(addr, Privilege::User), 111u);
+
+    virtualMemory->InvalidatePage(vpn);
+    ASSERT_EQ(virtualMemory->Read32(addr, Privilege::User), 222u);
+}
+
+TEST_F(VirtualMemoryTest, SetPageTableAddressFlushesTlb) {
+    constexpr uint32_t vpn = 90;
+    constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
+
+    CreatePage(vpn, 12, true, true);
+    virtualMemory->Write32(addr, 5, Privilege::User);
+
+    virtualMemory->SetPageTableAddress(100u << PTE::FRAME_SHIFT);
+    CreatePage(vpn, 13, true, true);
+    ASSERT_EQ(virtualMemory->Read32(addr, Privilege::User), 0u);
+}
+
+TEST_F(VirtualMemoryTest, DirectMappedTlbEvictsConflictingPages) {
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = 4;
+    tlbConfig.associativity = 1;
+    VirtualMemory directMapped(*physicalMemory, *osHandler, tlbConfig);
+
+    CreatePage(100, 14, true, true);
+    CreatePage(104, 15, true, true);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        (void)directMapped.Read32(100u << PTE::FRAME_SHIFT, Privilege::User);
+        (void)directMapped.Read32(104u << PTE::FRAME_SHIFT, Privilege::User);
+    }
+
+    ASSERT_EQ(directMapped.GetTlbStats().hits, 0u);
+    ASSERT_EQ(directMapped.GetTlbStats().misses, 6u);
+}
+
+TEST_F(VirtualMemoryTest, SetAssociativeTlbKeepsConflictingPages) {
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = 4;
+    tlbConfig.associativity = 2;
+    VirtualMemory setAssociative(*physicalMemory, *osHandler, tlbConfig);
+
+    CreatePage(100, 14, true, true);
+    CreatePage(104, 15, true, true);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        (void)setAssociative.Read32(100u << PTE::FRAME_SHIFT, Privilege::User);
+        (void)setAssociative.Read32(104u << PTE::FRAME_SHIFT, Privilege::User);
+    }
+
+    ASSERT_EQ(setAssociative.GetTlbStats().hits, 4u);
+    ASSERT_EQ(setAssociative.GetTlbStats().misses, 2u);
+}
+
+TEST(TlbTest, RejectsNonPowerOfTwoSetCount) {
+    TlbConfig tlbConfig;
+    tlbConfig.numSets = 3;
+    ASSERT_THROW(Tlb{tlbConfig}, std::invalid_argument);
+}
+
+
+TEST_F(VirtualMemoryTest, SparseAddressSpaceAllocatesTablesOnDemand) {
+    constexpr uint32_t lowAddr = 0x00001000;
+    constexpr uint32_t highAddr = 0xFFC00000;
+
+    virtualMemory->Write32(lowAddr, 1, Privilege::User);
+    virtualMemory->Write32(lowAddr + 0x1000, 2, Privilege::User);
+    virtualMemory->Write32(highAddr, 3, Privilege::User);
+
+    ASSERT_EQ(virtualMemory->Read32(lowAddr, Privilege::User), 1u);
+    ASSERT_EQ(virtualMemory->Read32(lowAddr + 0x1000, Privilege::User), 2u);
+    ASSERT_EQ(virtualMemory->Read32(highAddr, Privilege::User), 3u);
+
+    const MyOSStats stats = osHandler->GetStats();
+    ASSERT_EQ(stats.pageTableFrames, 2u);
+    ASSERT_EQ(stats.dataFrames, 3u);
+}
+
+TEST_F(VirtualMemoryTest, ThrowsOnUserAccessThroughSupervisorDirectoryEntry) {
+    constexpr uint32_t vpn = 110;
+    constexpr uint32_t addr = vpn << PTE::FRAME_SHIFT;
+
+    CreatePage(vpn, 16, true, true);
+    PTE directoryEntry;
+    directoryEntry.raw = physicalMemory->Read32(virtualMemory->GetDirectoryEntryAddress(vpn));
+    directoryEntry.SetUser(false);
+    physicalMemory->Write32(virtualMemory->GetDirectoryEntryAddress(vpn), directoryEntry.raw);
+
+    ASSERT_THROW((void)virtualMemory->Read32(addr, Privilege::User), std::runtime_error);
+    ASSERT_NO_THROW((void)virtualMemory->Read32(addr, Privilege::Supervisor));
+}
+
+
+TEST_F(VirtualMemoryTest, BlockAccessSplitsAcrossPages) {
+    constexpr uint32_t addr = 0x5000 - 3;
+    std::vector<uint8_t> data(2 * 4096 + 10);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    virtualMemory->WriteBlock(addr, data, Privilege::User);
+    ASSERT_EQ(osHandler->GetStats().dataFrames, 4u);
+
+    std::vector<uint8_t> readBack(data.size());
+    virtualMemory->ReadBlock(addr, readBack, Privilege::User);
+    ASSERT_EQ(readBack, data);
+
+    ASSERT_EQ(virtualMemory->Read8(addr + 3, Privilege::User), data[3]);
+    ASSERT_EQ(virtualMemory->Read8(addr + 4096 + 3, Privilege::User), data[4096 + 3]);
+}
+
+TEST_F(VirtualMemoryTest, BlockWriteSetsDirtyBitOnEveryPage) {
+    std::vector<uint8_t> data(3 * 4096, 0xAB);
+    virtualMemory->WriteBlock(0x10000, data, Privilege::User);
+
+    for (uint32_t vpn = 0x10; vpn < 0x13; ++vpn)
+    {
+        PTE pte;
+        pte.raw = physicalMemory->Read32(*virtualMemory->GetPageTableEntryAddress(vpn));
+        ASSERT_TRUE(pte.IsDirty());
+    }
+}
+
+TEST_F(VirtualMemoryTest, BlockWriteFaultsOnReadOnlyPageInTheMiddle) {
+    CreatePage(120, 17, true, true);
+    CreatePage(121, 18, false, true);
+
+    std::vector<uint8_t> data(2 * 4096, 1);
+    ASSERT_THROW(virtualMemory->WriteBlock(120u << PTE::FRAME_SHIFT, data, Privilege::User), std::runtime_error);
+    ASSERT_EQ(physicalMemory->Read8(17u << PTE::FRAME_SHIFT), 1u);
+    ASSERT_EQ(physicalMemory->Read8(18u << PTE::FRAME_SHIFT), 0u);
+}
+
+TEST_F(VirtualMemoryTest, BlockAccessRejectsAddressSpaceOverflow) {
+    std::vector<uint8_t> buffer(16);
+    ASSERT_THROW(virtualMemory->ReadBlock(0xFFFFFFF8, buffer, Privilege::User), std::out_of_range);
+}
+
+TEST_F(VirtualMemoryTest, TryAccessReportsErrorsWithoutThrowing) {
+    constexpr uint32_t vpn = 10;
+    CreatePage(vpn, 2, false, true);
+
+    uint32_t value = 0;
+    ASSERT_EQ(virtualMemory->TryWrite<uint32_t>(vpn << PTE::FRAME_SHIFT, 1, Privilege::User),
+              AccessStatus::UnhandledPageFault);
+    ASSERT_EQ(virtualMemory->TryRead((vpn << PTE::FRAME_SHIFT) + 2, value, Privilege::User),
+              AccessStatus::MisalignedAccess);
+    ASSERT_EQ(virtualMemory->TryRead(vpn << PTE::FRAME_SHIFT, value, Privilege::User), AccessStatus::Ok);
+}
+
+TEST(StaticHandlerTest, HandlesFaultsThroughConcreteHandler) {
+    PhysicalMemoryConfig config;
+    config.numFrames = 16;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler);
+    virtualMemory.SetPageTableAddress(0);
+
+    ASSERT_EQ(virtualMemory.TryWrite<uint64_t>(0x5000, 0x1122334455667788, Privilege::User), AccessStatus::Ok);
+    uint64_t value = 0;
+    ASSERT_EQ(virtualMemory.TryRead(0x5000, value, Privilege::User), AccessStatus::Ok);
+    ASSERT_EQ(value, 0x1122334455667788u);
+    ASSERT_EQ(osHandler.GetStats().pageFaults, 1u);
+}
+
+class PageReplacementTest : public ::testing::TestWithParam<ReplacementPolicyKind> {
+protected:
+    void SetUp() override {
+        PhysicalMemoryConfig config;
+        config.numFrames = FRAMES;
+        physicalMemory = std::make_unique<PhysicalMemory>(config);
+        MyOSConfig osConfig;
+        osConfig.replacementPolicy = GetParam();
+        osHandler = std::make_unique<MyOS>(*physicalMemory, osConfig);
+        virtualMemory = std::make_unique<VirtualMemory>(*physicalMemory, *osHandler);
+        virtualMemory->SetPageTableAddress(0);
+    }
+
+    // Каталог и одна таблица страниц занимают два кадра, под данные остаётся шесть
+    static constexpr uint32_t FRAMES = 8;
+    static constexpr uint32_t PAGES = 20;
+
+    std::unique_ptr<PhysicalMemory> physicalMemory;
+    std::unique_ptr<MyOS> osHandler;
+    std::unique_ptr<VirtualMemory> virtualMemory;
+};
+
+TEST_P(PageReplacementTest, EvictsAndRestoresPagesThroughSwap) {
+    for (uint32_t page = 0; page < PAGES; ++page)
+    {
+        virtualMemory->Write32(page << PTE::FRAME_SHIFT, page * 7 + 1, Privilege::User);
+    }
+    for (uint32_t page = 0; page < PAGES; ++page)
+    {
+        ASSERT_EQ(virtualMemory->Read32(page << PTE::FRAME_SHIFT, Privilege::User), page * 7 + 1);
+    }
+
+    const MyOSStats stats = osHandler->GetStats();
+    ASSERT_GT(stats.evictions, 0u);
+    ASSERT_GT(stats.swapIns, 0u);
+    ASSERT_LE(stats.dataFrames, FRAMES - 2);
+}
+
+TEST_P(PageReplacementTest, SkipsWriteBackOfCleanPages) {
+    for (uint32_t page = 0; page < PAGES; ++page)
+    {
+        virtualMemory->Write32(page << PTE::FRAME_SHIFT, page, Privilege::User);
+    }
+    const uint64_t writeBacksAfterFill = osHandler->GetStats().dirtyWriteBacks;
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (uint32_t page = 0; page < PAGES; ++page)
+        {
+            ASSERT_EQ(virtualMemory->Read32(page << PTE::FRAME_SHIFT, Privilege::User), page);
+        }
+    }
+
+    // Повторно вытесняемые страницы только читались, их копии в swap остаются актуальными
+    ASSERT_LE(osHandler->GetStats().dirtyWriteBacks, writeBacksAfterFill + FRAMES);
+    ASSERT_GT(osHandler->GetStats().evictions, 2u * PAGES);
+}
+
+TEST_P(PageReplacementTest, PreservesPagePermissionsAcrossSwap) {
+    constexpr uint32_t readOnlyPage = 0;
+    virtualMemory->Write32(readOnlyPage, 42, Privilege::User);
+
+    const uint32_t pteAddress = *virtualMemory->GetPageTableEntryAddress(readOnlyPage);
+    PTE pte;
+    pte.raw = physicalMemory->Read32(pteAddress);
+    pte.SetWritable(false);
+    physicalMemory->Write32(pteAddress, pte.raw);
+    virtualMemory->InvalidatePage(readOnlyPage);
+
+    for (uint32_t page = 1; page < PAGES; ++page)
+    {
+        virtualMemory->Write32(page << PTE::FRAME_SHIFT, page, Privilege::User);
+    }
+
+    pte.raw = physicalMemory->Read32(pteAddress);
+    ASSERT_FALSE(pte.IsPresent());
+    ASSERT_TRUE(pte.IsSwapped());
+    ASSERT_EQ(virtualMemory->Read32(readOnlyPage, Privilege::User), 42u);
+    ASSERT_THROW(virtualMemory->Write32(readOnlyPage, 1, Privilege::User), std::runtime_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(Policies, PageReplacementTest,
+                         ::testing::Values(ReplacementPolicyKind::Fifo,
+                                           ReplacementPolicyKind::Clock,
+                                           ReplacementPolicyKind::Aging));
+
+TEST(PhysicalMemoryBackingTest, AnonymousMappingStartsZeroed) {
+    PhysicalMemoryConfig config;
+    config.numFrames = 1u << 16;
+    config.backing = PhysicalMemoryBacking::AnonymousMapping;
+    PhysicalMemory physicalMemory(config);
+
+    ASSERT_EQ(physicalMemory.GetSize(), uint64_t{1} << 28);
+    ASSERT_EQ(physicalMemory.Read32(static_cast<uint32_t>(physicalMemory.GetSize() - 4)), 0u);
+    physicalMemory.Write32(0x0FFFFFF0, 0xCAFEBABE);
+    ASSERT_EQ(physicalMemory.Read32(0x0FFFFFF0), 0xCAFEBABEu);
+    ASSERT_FALSE(physicalMemory.IsResumedImage());
+}
+
+TEST(PhysicalMemoryBackingTest, RejectsMoreThanFourGigabytes) {
+    PhysicalMemoryConfig config;
+    config.numFrames = (1u << 20) + 1;
+    config.backing = PhysicalMemoryBacking::AnonymousMapping;
+    ASSERT_THROW(PhysicalMemory{config}, std::invalid_argument);
+}
+
+TEST(PhysicalMemoryBackingTest, FileImageResumesAddressSpace) {
+    const auto imagePath = std::filesystem::temp_directory_path() / "memory-simulator-resume-test.img";
+    std::filesystem::remove(imagePath);
+
+    PhysicalMemoryConfig config;
+    config.numFrames = 64;
+    config.backing = PhysicalMemoryBacking::FileMapping;
+    config.imagePath = imagePath;
+
+    {
+        PhysicalMemory physicalMemory(config);
+        ASSERT_FALSE(physicalMemory.IsResumedImage());
+        MyOS osHandler(physicalMemory);
+        VirtualMemory virtualMemory(physicalMemory, osHandler);
+        virtualMemory.SetPageTableAddress(0);
+        for (uint32_t page = 0; page < 8; ++page)
+        {
+            virtualMemory.Write32(0x400000 + (page << PTE::FRAME_SHIFT), page * 7, Privilege::User);
+        }
+        physicalMemory.Sync();
+    }
+
+    {
+        PhysicalMemory physicalMemory(config);
+        ASSERT_TRUE(physicalMemory.IsResumedImage());
+        MyOS osHandler(physicalMemory);
+        VirtualMemory virtualMemory(physicalMemory, osHandler);
+        virtualMemory.SetPageTableAddress(0);
+        osHandler.AdoptAddressSpace(virtualMemory);
+
+        ASSERT_EQ(osHandler.GetStats().dataFrames, 8u);
+        ASSERT_EQ(osHandler.GetStats().pageTableFrames, 1u);
+        for (uint32_t page = 0; page < 8; ++page)
+        {
+            ASSERT_EQ(virtualMemory.Read32(0x400000 + (page << PTE::FRAME_SHIFT), Privilege::User), page * 7);
+        }
+        // Новые страницы не должны попасть в кадры, занятые восстановленными
+        virtualMemory.Write32(0x800000, 99, Privilege::User);
+        ASSERT_EQ(virtualMemory.Read32(0x400000, Privilege::User), 0u);
+        ASSERT_EQ(virtualMemory.Read32(0x800000, Privilege::User), 99u);
+    }
+
+    std::filesystem::remove(imagePath);
+}
+
+TEST(PhysicalMemoryBackingTest, FileImageOfOtherSizeIsRejected) {
+    const auto imagePath = std::filesystem::temp_directory_path() / "memory-simulator-size-test.img";
+    std::filesystem::remove(imagePath);
+
+    PhysicalMemoryConfig config;
+    config.numFrames = 64;
+    config.backing = PhysicalMemoryBacking::FileMapping;
+    config.imagePath = imagePath;
+    {
+        PhysicalMemory physicalMemory(config);
+        physicalMemory.Write32(0x100, 0xDEADBEEF);
+        physicalMemory.Sync();
+    }
+
+    config.numFrames = 128;
+    ASSERT_THROW(PhysicalMemory{config}, std::runtime_error);
+    // Снимок остаётся нетронутым и открывается с исходным числом кадров
+    ASSERT_EQ(std::filesystem::file_size(imagePath), uint64_t{64} * config.frameSize);
+    config.numFrames = 64;
+    PhysicalMemory physicalMemory(config);
+    ASSERT_TRUE(physicalMemory.IsResumedImage());
+    ASSERT_EQ(physicalMemory.Read32(0x100), 0xDEADBEEFu);
+
+    std::filesystem::remove(imagePath);
+}
+
+class ForkTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        PhysicalMemoryConfig config;
+        config.numFrames = 64;
+        physicalMemory = std::make_unique<PhysicalMemory>(config);
+        osHandler = std::make_unique<MyOS>(*physicalMemory);
+        parent = std::make_unique<VirtualMemory>(*physicalMemory, *osHandler);
+        child = std::make_unique<VirtualMemory>(*physicalMemory, *osHandler);
+        parent->SetPageTableAddress(0);
+
+        for (uint32_t page = 0; page < PAGES; ++page)
+        {
+            parent->Write32(page << PTE::FRAME_SHIFT, page + 100, Privilege::User);
+        }
+    }
+
+    std::unique_ptr<PhysicalMemory> physicalMemory;
+    std::unique_ptr<MyOS> osHandler;
+    std::unique_ptr<VirtualMemory> parent;
+    std::unique_ptr<VirtualMemory> child;
+
+    static constexpr uint32_t PAGES = 8;
+};
+
+TEST_F(ForkTest, CopyOnWriteSharesFramesUntilFirstWrite) {
+    osHandler->Fork(*parent, *child);
+
+    ASSERT_EQ(osHandler->GetStats().dataFrames, PAGES);
+    ASSERT_EQ(osHandler->GetStats().sharedFrames, PAGES);
+    for (uint32_t page = 0; page < PAGES; ++page)
+    {
+        ASSERT_EQ(child->Read32(page << PTE::FRAME_SHIFT, Privilege::User), page + 100);
+    }
+
+    child->Write32(0, 1, Privilege::User);
+    ASSERT_EQ(child->Read32(0, Privilege::User), 1u);
+    ASSERT_EQ(parent->Read32(0, Privilege::User), 100u);
+    ASSERT_EQ(osHandler->GetStats().copyOnWriteCopies, 1u);
+    ASSERT_EQ(osHandler->GetStats().dataFrames, PAGES + 1);
+
+    // Последний владелец кадра получает его на запись без копирования
+    parent->Write32(0, 2, Privilege::User);
+    ASSERT_EQ(osHandler->GetStats().copyOnWriteCopies, 1u);
+    ASSERT_EQ(parent->Read32(0, Privilege::User), 2u);
+    ASSERT_EQ(child->Read32(0, Privilege::User), 1u);
+}
+
+TEST_F(ForkTest, EagerForkCopiesEveryFrame) {
+    osHandler->Fork(*parent, *child, ForkMode::Eager);
+
+    ASSERT_EQ(osHandler->GetStats().dataFrames, 2 * PAGES);
+    ASSERT_EQ(osHandler->GetStats().sharedFrames, 0u);
+    child->Write32(0, 1, Privilege::User);
+    ASSERT_EQ(parent->Read32(0, Privilege::User), 100u);
+    ASSERT_EQ(osHandler->GetStats().copyOnWriteCopies, 0u);
+}
+
+TEST_F(ForkTest, ReadOnlyPagesStayReadOnlyAfterFork) {
+    const uint32_t pteAddress = *parent->GetPageTableEntryAddress(1);
+    PTE pte;
+    pte.raw = physicalMemory->Read32(pteAddress);
+    pte.SetWritable(false);
+    physicalMemory->Write32(pteAddress, pte.raw);
+    parent->InvalidatePage(1);
+
+    osHandler->Fork(*parent, *child);
+
+    ASSERT_THROW(child->Write32(1 << PTE::FRAME_SHIFT, 1, Privilege::User), std::runtime_error);
+    ASSERT_THROW(parent->Write32(1 << PTE::FRAME_SHIFT, 1, Privilege::User), std::runtime_error);
+}
+
+TEST_F(ForkTest, ReleasingChildReturnsItsFrames) {
+    const MyOSStats before = osHandler->GetStats();
+    osHandler->Fork(*parent, *child);
+    child->Write32(0, 1, Privilege::User);
+
+    osHandler->ReleaseAddressSpace(*child);
+
+    const MyOSStats after = osHandler->GetStats();
+    ASSERT_EQ(after.dataFrames, before.dataFrames);
+    ASSERT_EQ(after.pageTableFrames, before.pageTableFrames);
+    ASSERT_EQ(after.sharedFrames, 0u);
+    parent->Write32(0, 3, Privilege::User);
+    ASSERT_EQ(osHandler->GetStats().copyOnWriteCopies, 1u);
+}
+
+TEST(ForkUnderPressureTest, SharedPagesSurviveEviction) {
+    constexpr uint32_t frames = 16;
+    constexpr uint32_t pages = 24;
+    PhysicalMemoryConfig config;
+    config.numFrames = frames;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    VirtualMemory parent(physicalMemory, osHandler);
+    VirtualMemory child(physicalMemory, osHandler);
+    parent.SetPageTableAddress(0);
+
+    for (uint32_t page = 0; page < pages; ++page)
+    {
+        parent.Write32(page << PTE::FRAME_SHIFT, page, Privilege::User);
+    }
+    osHandler.Fork(parent, child);
+
+    for (uint32_t page = 0; page < pages; ++page)
+    {
+        child.Write32(page << PTE::FRAME_SHIFT, page + 1000, Privilege::User);
+    }
+    for (uint32_t page = 0; page < pages; ++page)
+    {
+        ASSERT_EQ(parent.Read32(page << PTE::FRAME_SHIFT, Privilege::User), page);
+        ASSERT_EQ(child.Read32(page << PTE::FRAME_SHIFT, Privilege::User), page + 1000);
+    }
+
+    osHandler.ReleaseAddressSpace(child);
+    for (uint32_t page = 0; page < pages; ++page)
+    {
+        parent.Write32(page << PTE::FRAME_SHIFT, page + 2000, Privilege::User);
+        ASSERT_EQ(parent.Read32(page << PTE::FRAME_SHIFT, Privilege::User), page + 2000);
+    }
+}
+
+TEST(MultiCoreTest, ForkShootsDownWritableTranslationsOnOtherCores) {
+    PhysicalMemoryConfig config;
+    config.numFrames = 32;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    VirtualMemory firstCore(physicalMemory, osHandler);
+    VirtualMemory secondCore(physicalMemory, osHandler);
+    VirtualMemory child(physicalMemory, osHandler);
+    firstCore.SetPageTableAddress(0);
+    secondCore.SetPageTableAddress(0);
+    osHandler.RegisterCore(firstCore);
+    osHandler.RegisterCore(secondCore);
+
+    // Второе ядро кэширует трансляцию страницы с правом записи
+    secondCore.Write32(0x3000, 1, Privilege::User);
+    osHandler.Fork(firstCore, child);
+
+    secondCore.Write32(0x3000, 2, Privilege::User);
+    ASSERT_EQ(child.Read32(0x3000, Privilege::User), 1u);
+    ASSERT_EQ(firstCore.Read32(0x3000, Privilege::User), 2u);
+    ASSERT_EQ(osHandler.GetStats().copyOnWriteCopies, 1u);
+
+    osHandler.UnregisterCore(firstCore);
+    osHandler.UnregisterCore(secondCore);
+}
+
+TEST(MultiCoreTest, ConcurrentCoresKeepTheirDataUnderEviction) {
+    constexpr uint32_t cores = 4;
+    constexpr uint32_t pagesPerCore = 12;
+    PhysicalMemoryConfig config;
+    config.numFrames = 24;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+
+    std::vector<std::unique_ptr<VirtualMemory>> coreMemories;
+    for (uint32_t core = 0; core < cores; ++core)
+    {
+        coreMemories.push_back(std::make_unique<VirtualMemory>(physicalMemory, osHandler));
+        coreMemories.back()->SetPageTableAddress(0);
+        osHandler.RegisterCore(*coreMemories.back());
+    }
+
+    std::vector<uint32_t> mismatches(cores, 0);
+    std::vector<std::thread> threads;
+    for (uint32_t core = 0; core < cores; ++core)
+    {
+        threads.emplace_back([&, core] {
+            VirtualMemory &memory = *coreMemories[core];
+            const uint32_t firstPage = core * pagesPerCore;
+            for (uint32_t round = 0; round < 20; ++round)
+            {
+                for (uint32_t page = firstPage; page < firstPage + pagesPerCore; ++page)
+                {
+                    memory.Write32(page << PTE::FRAME_SHIFT, page * 1000 + round, Privilege::User);
+                }
+                for (uint32_t page = firstPage; page < firstPage + pagesPerCore; ++page)
+                {
+                    if (memory.Read32(page << PTE::FRAME_SHIFT, Privilege::User) != page * 1000 + round)
+                    {
+                        ++mismatches[core];
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (uint32_t core = 0; core < cores; ++core)
+    {
+        ASSERT_EQ(mismatches[core], 0u);
+        osHandler.UnregisterCore(*coreMemories[core]);
+    }
+    ASSERT_GT(osHandler.GetStats().evictions, 0u);
+}
+
+class LargePageTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        PhysicalMemoryConfig config;
+        config.numFrames = 4 * PTE::ENTRIES_PER_TABLE;
+        physicalMemory = std::make_unique<PhysicalMemory>(config);
+        osHandler = std::make_unique<MyOS>(*physicalMemory);
+        virtualMemory = std::make_unique<BasicVirtualMemory<MyOS>>(*physicalMemory, *osHandler);
+        virtualMemory->SetPageTableAddress(0);
+    }
+
+    void FillRegion() {
+        for (uint32_t page = 0; page < PTE::ENTRIES_PER_TABLE; page += 3)
+        {
+            virtualMemory->Write32(REGION + (page << PTE::FRAME_SHIFT) + 8, page + 1, Privilege::User);
+        }
+    }
+
+    std::unique_ptr<PhysicalMemory> physicalMemory;
+    std::unique_ptr<MyOS> osHandler;
+    std::unique_ptr<BasicVirtualMemory<MyOS>> virtualMemory;
+
+    static constexpr uint32_t REGION = 0x00C00000;
+};
+
+TEST_F(LargePageTest, PromotionKeepsDataAndNeedsOneTlbEntry) {
+    FillRegion();
+    const uint32_t pageTableFrames = osHandler->GetStats().pageTableFrames;
+
+    ASSERT_TRUE(osHandler->PromoteLargePage(*virtualMemory, REGION + 0x1234));
+    const MyOSStats stats = osHandler->GetStats();
+    ASSERT_EQ(stats.largePages, 1u);
+    ASSERT_EQ(stats.dataFrames, 0u);
+    ASSERT_EQ(stats.pageTableFrames, pageTableFrames - 1);
+
+    PTE directoryEntry;
+    directoryEntry.raw = physicalMemory->Read32(virtualMemory->GetDirectoryEntryAddress(REGION >> PTE::FRAME_SHIFT));
+    ASSERT_TRUE(directoryEntry.IsLargePage());
+    ASSERT_EQ(directoryEntry.GetFrame() % PTE::ENTRIES_PER_TABLE, 0u);
+    ASSERT_FALSE(virtualMemory->GetPageTableEntryAddress(REGION >> PTE::FRAME_SHIFT).has_value());
+
+    const TlbStats before = virtualMemory->GetTlbStats();
+    for (uint32_t page = 0; page < PTE::ENTRIES_PER_TABLE; ++page)
+    {
+        const uint32_t expected = page % 3 == 0 ? page + 1 : 0;
+        ASSERT_EQ(virtualMemory->Read32(REGION + (page << PTE::FRAME_SHIFT) + 8, Privilege::User), expected);
+    }
+    const TlbStats after = virtualMemory->GetTlbStats();
+    ASSERT_EQ(after.misses - before.misses, 1u);
+    ASSERT_EQ(after.largePageHits - before.largePageHits, PTE::ENTRIES_PER_TABLE - 1);
+
+    virtualMemory->Write32(REGION + 0x3FFFFC, 77, Privilege::User);
+    ASSERT_EQ(virtualMemory->Read32(REGION + 0x3FFFFC, Privilege::User), 77u);
+    ASSERT_EQ(osHandler->GetStats().pageFaults, stats.pageFaults);
+}
+
+TEST_F(LargePageTest, PromotionRejectsMixedPermissions) {
+    FillRegion();
+    const auto pteAddress = *virtualMemory->GetPageTableEntryAddress((REGION >> PTE::FRAME_SHIFT) + 3);
+    PTE pte;
+    pte.raw = physicalMemory->Read32(pteAddress);
+    pte.SetWritable(false);
+    physicalMemory->Write32(pteAddress, pte.raw);
+
+    ASSERT_FALSE(osHandler->PromoteLargePage(*virtualMemory, REGION));
+    ASSERT_EQ(osHandler->GetStats().largePages, 0u);
+    ASSERT_EQ(virtualMemory->Read32(REGION + 8, Privilege::User), 1u);
+}
+
+TEST_F(LargePageTest, ForkSplitsLargePageAndReleaseFreesIt) {
+    FillRegion();
+    ASSERT_TRUE(osHandler->PromoteLargePage(*virtualMemory, REGION));
+
+    BasicVirtualMemory<MyOS> child(*physicalMemory, *osHandler);
+    osHandler->Fork(*virtualMemory, child);
+    ASSERT_EQ(osHandler->GetStats().largePages, 0u);
+    ASSERT_EQ(osHandler->GetStats().dataFrames, PTE::ENTRIES_PER_TABLE);
+
+    virtualMemory->Write32(REGION + 8, 500, Privilege::User);
+    ASSERT_EQ(child.Read32(REGION + 8, Privilege::User), 1u);
+    ASSERT_EQ(virtualMemory->Read32(REGION + 8, Privilege::User), 500u);
+
+    osHandler->ReleaseAddressSpace(child);
+    ASSERT_TRUE(osHandler->PromoteLargePage(*virtualMemory, REGION));
+    osHandler->ReleaseAddressSpace(*virtualMemory);
+    const MyOSStats stats = osHandler->GetStats();
+    ASSERT_EQ(stats.largePages, 0u);
+    ASSERT_EQ(stats.dataFrames, 0u);
+    ASSERT_EQ(stats.pageTableFrames, 0u);
+}
+
+TEST(TraceTest, RecorderAndReaderRoundTripRecords) {
+    const auto tracePath = std::filesystem::temp_directory_path() / "memory-simulator-trace-test.trace";
+    std::vector<TraceRecord> records = GenerateTrace({});
+    records.push_back({ 0x1001, 1, Access::Write, Privilege::Supervisor, false });
+    records.push_back({ 0x2000, 8, Access::Read, Privilege::User, true });
+    {
+        TraceRecorder recorder(tracePath);
+        recorder.Record(records);
+        ASSERT_EQ(recorder.GetRecordCount(), records.size());
+    }
+
+    // Маленькие порции проверяют стык между ними
+    TraceReader reader(tracePath, 7);
+    std::vector<TraceRecord> readBack;
+    for (auto chunk = reader.ReadChunk(); !chunk.empty(); chunk = reader.ReadChunk())
+    {
+        readBack.insert(readBack.end(), chunk.begin(), chunk.end());
+    }
+    ASSERT_EQ(readBack, records);
+    std::filesystem::remove(tracePath);
+}
+
+TEST(TraceTest, ReaderRejectsForeignAndTruncatedFiles) {
+    const auto tracePath = std::filesystem::temp_directory_path() / "memory-simulator-bad-trace-test.trace";
+    {
+        std::ofstream stream(tracePath, std::ios::binary);
+        stream << "not a trace";
+    }
+    ASSERT_THROW(TraceReader{tracePath}, std::runtime_error);
+
+    {
+        TraceRecorder recorder(tracePath);
+        recorder.Record(TraceRecord{});
+    }
+    std::filesystem::resize_file(tracePath, std::filesystem::file_size(tracePath) - 1);
+    TraceReader reader(tracePath);
+    ASSERT_THROW((void)reader.ReadChunk(), std::runtime_error);
+    std::filesystem::remove(tracePath);
+}
+
+TEST(TraceTest, ReplayReportsFaultsAndWriteBacks) {
+    PhysicalMemoryConfig config;
+    config.numFrames = 16;
+    PhysicalMemory physicalMemory(config);
+    MyOS osHandler(physicalMemory);
+    BasicVirtualMemory<MyOS> virtualMemory(physicalMemory, osHandler);
+    virtualMemory.SetPageTableAddress(0);
+
+    TraceGeneratorConfig traceConfig;
+    traceConfig.pattern = TracePattern::Loop;
+    traceConfig.pageCount = 32;
+    traceConfig.length = 320;
+    traceConfig.writePercent = 100;
+    std::vector<TraceRecord> trace = GenerateTrace(traceConfig);
+    trace.push_back({ 0x1002, 4, Access::Read, Privilege::User, false });
+
+    TraceReplayer replayer(virtualMemory, osHandler);
+    replayer.Replay(trace);
+    const ReplayStats stats = replayer.GetStats();
+
+    ASSERT_EQ(stats.accesses, trace.size());
+    ASSERT_EQ(stats.failedAccesses, 1u);
+    // Циклический проход по вдвое большему набору страниц промахивается при каждом обращении
+    ASSERT_GE(stats.pageFaults, 320u);
+    ASSERT_GT(stats.evictions, 0u);
+    ASSERT_GT(stats.dirtyWriteBacks, 0u);
+    ASSERT_GE(stats.tlbMisses, stats.pageFaults);
+}
@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t FILES_COUNT = 100000;
+constexpr uint32_t SPARE_ENTRIES = 20000;
+constexpr uint64_t IMAGE_SIZE = 1ULL << 30;
+
+// Образ со 100 тысячами файлов по одному блоку строится один раз на все замеры:
+// файлы идут в образе подряд, поэтому каждому росту нужен новый экстент
+FileSystemManager& GetPopulatedImage()
+{
+	static const auto imagePath = std::filesystem::temp_directory_path() / "myfs-allocation-benchmark.img";
+	static std::unique_ptr<FileSystemManager> fs;
+	if (fs)
+	{
+		return *fs;
+	}
+
+	fs = std::make_unique<FileSystemManager>();
+	fs->CreateImage(imagePath.string(), IMAGE_SIZE, FILES_COUNT + SPARE_ENTRIES);
+	const std::vector<char> block(BLOCK_SIZE, 'x');
+	for (uint32_t file = 0; file < FILES_COUNT; ++file)
+	{
+		const std::string name = "file" + std::to_string(file);
+		fs->CreateFile(name);
+		fs->WriteData(name, block.data(), BLOCK_SIZE, 0);
+	}
+	std::filesystem::remove(imagePath);
+	return *fs;
+}
+}
+
+// Новый файл с первым блоком данных
+static void CreateAndGrow(benchmark::State& state)
+{
+	FileSystemManager& fs = GetPopulatedImage();
+	const std::vector<char> block(BLOCK_SIZE, 'x');
+
+	uint32_t created = 0;
+	for (auto _ : state)
+	{
+		const std::string name = "new" + std::to_string(created++);
+		if (!fs.CreateFile(name) || fs.WriteData(name, block.data(), BLOCK_SIZE, 0) != BLOCK_SIZE)
+		{
+			state.SkipWithError("Create failed");
+			return;
+		}
+	}
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(CreateAndGrow)->Iterations(2000);
+
+// Дозапись блока в случайный из существующих файлов
+static void GrowExisting(benchmark::State& state)
+{
+	FileSystemManager& fs = GetPopulatedImage();
+	const std::vector<char> block(BLOCK_SIZE, 'x');
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<uint32_t> fileDistribution(0, FILES_COUNT - 1);
+
+	for (auto _ : state)
+	{
+		const std::string name = "file" + std::to_string(fileDistribution(generator));
+		FileEntry entry{};
+		fs.GetFileStat(name, entry);
+		if (fs.WriteData(name, block.data(), BLOCK_SIZE, entry.size) != BLOCK_SIZE)
+		{
+			state.SkipWithError("Append failed");
+			return;
+		}
+	}
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(GrowExisting)->Iterations(5000);
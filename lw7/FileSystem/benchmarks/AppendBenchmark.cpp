@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t IMAGE_SLACK = 64ULL * 1024 * 1024;
+
+// Файлы дописываются по очереди блоками по 4 КиБ, как при копировании нескольких файлов сразу.
+// Несколько файлов чередуют свои участки в образе, и без экстентов каждое удвоение переносило бы файл целиком
+void RunAppendBenchmark(benchmark::State& state)
+{
+	const auto fileSize = static_cast<uint64_t>(state.range(0));
+	const auto filesCount = static_cast<uint32_t>(state.range(1));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-append-benchmark.img";
+	const std::vector<char> block(BLOCK_SIZE, 'x');
+
+	uint32_t extentsCount = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		FileSystemManager fs;
+		if (!fs.CreateImage(imagePath.string(), fileSize * filesCount + IMAGE_SLACK, 16))
+		{
+			state.SkipWithError("Cannot create image");
+			return;
+		}
+		for (uint32_t file = 0; file < filesCount; ++file)
+		{
+			fs.CreateFile("file" + std::to_string(file));
+		}
+		state.ResumeTiming();
+
+		for (uint64_t offset = 0; offset < fileSize; offset += BLOCK_SIZE)
+		{
+			for (uint32_t file = 0; file < filesCount; ++file)
+			{
+				if (fs.WriteData("file" + std::to_string(file), block.data(), BLOCK_SIZE, offset) != BLOCK_SIZE)
+				{
+					state.SkipWithError("Append failed");
+					return;
+				}
+			}
+		}
+
+		state.PauseTiming();
+		FileEntry entry{};
+		fs.GetFileStat("file0", entry);
+		extentsCount = entry.extentsCount;
+		fs.CloseImage();
+		std::filesystem::remove(imagePath);
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * fileSize * filesCount));
+	state.counters["extents"] = extentsCount;
+}
+}
+
+static void AppendGrowth(benchmark::State& state)
+{
+	RunAppendBenchmark(state);
+}
+BENCHMARK(AppendGrowth)
+	->ArgNames({ "bytes", "files" })
+	->Args({ 64LL << 20, 1 })
+	->Args({ 64LL << 20, 4 })
+	->Args({ 1LL << 30, 1 })
+	->Unit(benchmark::kMillisecond)
+	->Iterations(1);
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <fcntl.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t FILE_SIZE = 64ULL * 1024 * 1024;
+constexpr size_t READ_SIZE = 4096;
+
+// Выбрасывает образ из страничного кэша ОС, чтобы следующие чтения шли с диска
+void DropPageCache(const std::filesystem::path& imagePath)
+{
+	const int fd = ::open(imagePath.c_str(), O_RDONLY);
+	if (fd != -1)
+	{
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+}
+
+// Чтения по 4 КиБ, как их присылает FUSE. В тёплом режиме образ лежит в страничном кэше ОС
+// и замер показывает цену системных вызовов и копирований; в холодном страничный кэш
+// сбрасывается на каждом проходе по файлу, и решает число обращений к диску
+void RunReadBenchmark(benchmark::State& state, const bool isSequential)
+{
+	const auto cacheBlocks = static_cast<size_t>(state.range(0));
+	const bool isCold = state.range(1) != 0;
+	constexpr uint64_t READS_PER_PASS = FILE_SIZE / READ_SIZE;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-block-cache-benchmark.img";
+
+	FileSystemManager fs;
+	fs.SetBlockCacheSize(cacheBlocks);
+	if (!fs.CreateImage(imagePath.string(), FILE_SIZE * 2, 16))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	fs.CreateFile("file");
+	const std::vector<char> data(FILE_SIZE, 'x');
+	fs.WriteData("file", data.data(), data.size(), 0);
+	fs.Sync();
+
+	std::vector<char> buffer(READ_SIZE);
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<uint64_t> blockDistribution(0, FILE_SIZE / READ_SIZE - 1);
+	uint64_t offset = 0;
+	uint64_t reads = 0;
+	const BlockCacheStats before = fs.GetBlockCacheStats();
+	for (auto _ : state)
+	{
+		if (isCold && reads++ % READS_PER_PASS == 0)
+		{
+			state.PauseTiming();
+			DropPageCache(imagePath);
+			state.ResumeTiming();
+		}
+		if (isSequential)
+		{
+			offset = (offset + READ_SIZE) % FILE_SIZE;
+		}
+		else
+		{
+			offset = blockDistribution(generator) * READ_SIZE;
+		}
+		if (fs.ReadData("file", buffer.data(), READ_SIZE, offset) != static_cast<int>(READ_SIZE))
+		{
+			state.SkipWithError("Read failed");
+			break;
+		}
+	}
+	const BlockCacheStats after = fs.GetBlockCacheStats();
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * READ_SIZE));
+	const uint64_t hits = after.hits - before.hits;
+	const uint64_t misses = after.misses - before.misses;
+	state.counters["hit_rate"] = hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+}
+
+static void SequentialReads(benchmark::State& state)
+{
+	RunReadBenchmark(state, true);
+}
+BENCHMARK(SequentialReads)
+	->ArgNames({ "cache_blocks", "cold" })
+	->ArgsProduct({ { 0, FileSystemManager::DEFAULT_BLOCK_CACHE_BLOCKS }, { 0, 1 } });
+
+static void RandomReads(benchmark::State& state)
+{
+	RunReadBenchmark(state, false);
+}
+// Кэш на 16384 блока вмещает весь файл
+BENCHMARK(RandomReads)
+	->ArgNames({ "cache_blocks", "cold" })
+	->ArgsProduct({ { 0, FileSystemManager::DEFAULT_BLOCK_CACHE_BLOCKS, 16384 }, { 0, 1 } });
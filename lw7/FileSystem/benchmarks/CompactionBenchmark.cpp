@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t IMAGE_SIZE = 1024ULL * 1024 * 1024;
+constexpr uint32_t FILES_COUNT = 256;
+// Дозапись кусками меньше блока, как у журналов и логов: файлы получают запас за концом
+constexpr size_t APPEND_SIZE = 1000;
+
+// Заполняет образ файлами, растущими дозаписью вперемешку, и удаляет каждый второй.
+// Остаются разбросанные файлы, запас за их концом и дыры между ними
+bool FragmentImage(FileSystemManager& fs, const std::filesystem::path& imagePath, const size_t fileSize)
+{
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, FILES_COUNT))
+	{
+		return false;
+	}
+	const std::vector<char> piece(APPEND_SIZE, 'c');
+	for (uint32_t file = 0; file < FILES_COUNT; ++file)
+	{
+		if (!fs.CreateFile("f" + std::to_string(file)))
+		{
+			return false;
+		}
+	}
+	for (size_t offset = 0; offset < fileSize; offset += APPEND_SIZE)
+	{
+		for (uint32_t file = 0; file < FILES_COUNT; ++file)
+		{
+			if (fs.WriteData("f" + std::to_string(file), piece.data(), piece.size(), offset) != static_cast<int>(piece.size()))
+			{
+				return false;
+			}
+		}
+	}
+	for (uint32_t file = 0; file < FILES_COUNT; file += 2)
+	{
+		if (!fs.RemoveFile("f" + std::to_string(file)))
+		{
+			return false;
+		}
+	}
+	fs.Sync();
+	return true;
+}
+
+void SetStatsCounters(benchmark::State& state, const std::string& prefix, const FragmentationStats& stats)
+{
+	state.counters[prefix + "_largest_free_run"] = stats.largestFreeRun;
+	state.counters[prefix + "_free_runs"] = stats.freeRuns;
+	state.counters[prefix + "_fragmented_files"] = stats.fragmentedFiles;
+	state.counters[prefix + "_tail_blocks"] = static_cast<double>(stats.tailBlocks);
+}
+}
+
+// Уплотнение образа, в котором дозапись вперемешку разбросала файлы по 64 КиБ и 1 МиБ.
+// Время - полный Compact; счётчики показывают свободные участки до и после и скорость переноса данных
+static void CompactFragmentedImage(benchmark::State& state)
+{
+	const auto fileSize = static_cast<size_t>(state.range(0));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-compaction-benchmark.img";
+	FragmentationStats before;
+	FragmentationStats after;
+	int64_t movedBlocks = 0;
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		FileSystemManager fs;
+		const bool isPrepared = FragmentImage(fs, imagePath, fileSize);
+		before = fs.GetFragmentationStats();
+		state.ResumeTiming();
+		if (!isPrepared)
+		{
+			state.SkipWithError("Cannot fragment image");
+			break;
+		}
+		const int64_t moved = fs.Compact();
+		state.PauseTiming();
+		after = fs.GetFragmentationStats();
+		fs.CloseImage();
+		std::filesystem::remove(imagePath);
+		state.ResumeTiming();
+		if (moved == -1)
+		{
+			state.SkipWithError("Compaction failed");
+			break;
+		}
+		movedBlocks += moved;
+	}
+
+	SetStatsCounters(state, "before", before);
+	SetStatsCounters(state, "after", after);
+	state.SetBytesProcessed(movedBlocks * static_cast<int64_t>(BLOCK_SIZE));
+}
+BENCHMARK(CompactFragmentedImage)->ArgName("file_size")->Arg(64 * 1024)->Arg(1024 * 1024)->Unit(benchmark::kMillisecond)->Iterations(3);
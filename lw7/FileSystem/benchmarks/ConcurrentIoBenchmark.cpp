@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t MAX_THREADS = 8;
+constexpr uint64_t FILE_SIZE = 16ULL * 1024 * 1024;
+constexpr size_t READ_SIZE = 64 * 1024;
+constexpr size_t WRITE_SIZE = 4096;
+
+const auto IMAGE_PATH = std::filesystem::temp_directory_path() / "myfs-concurrent-benchmark.img";
+std::unique_ptr<FileSystemManager> fs;
+
+// Каждому потоку - свой файл, как нескольким процессам, читающим разные файлы через FUSE
+void SetUp()
+{
+	fs = std::make_unique<FileSystemManager>();
+	fs->CreateImage(IMAGE_PATH.string(), FILE_SIZE * MAX_THREADS * 2, 64);
+	const std::vector<char> data(FILE_SIZE, 'x');
+	for (uint32_t thread = 0; thread < MAX_THREADS; ++thread)
+	{
+		const std::string name = "file" + std::to_string(thread);
+		fs->CreateFile(name);
+		fs->WriteData(name, data.data(), data.size(), 0);
+	}
+}
+
+void TearDown()
+{
+	fs.reset();
+	std::filesystem::remove(IMAGE_PATH);
+}
+
+void RunConcurrentIo(benchmark::State& state, const bool withWriters)
+{
+	if (state.thread_index() == 0)
+	{
+		SetUp();
+	}
+
+	const std::string name = "file" + std::to_string(state.thread_index());
+	// В смешанной нагрузке нечётные потоки пишут в свои файлы, пока чётные читают
+	const bool isWriter = withWriters && state.thread_index() % 2 == 1;
+	const size_t ioSize = isWriter ? WRITE_SIZE : READ_SIZE;
+	std::vector<char> buffer(ioSize, 'y');
+	std::mt19937 generator(state.thread_index());
+	std::uniform_int_distribution<uint64_t> offsetDistribution(0, (FILE_SIZE - ioSize) / WRITE_SIZE);
+
+	for (auto _ : state)
+	{
+		const uint64_t offset = offsetDistribution(generator) * WRITE_SIZE;
+		const int result = isWriter
+			? fs->WriteData(name, buffer.data(), ioSize, offset)
+			: fs->ReadData(name, buffer.data(), ioSize, offset);
+		if (result != static_cast<int>(ioSize))
+		{
+			state.SkipWithError("I/O failed");
+			break;
+		}
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * ioSize));
+	if (state.thread_index() == 0)
+	{
+		TearDown();
+	}
+}
+}
+
+static void ParallelReads(benchmark::State& state)
+{
+	RunConcurrentIo(state, false);
+}
+BENCHMARK(ParallelReads)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+
+static void ReadWriteMix(benchmark::State& state)
+{
+	RunConcurrentIo(state, true);
+}
+BENCHMARK(ReadWriteMix)->DenseThreadRange(2, MAX_THREADS, 2)->UseRealTime();
@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t DATA_SIZE = 16ULL * 1024 * 1024;
+
+// Каталог с entries файлами на глубине depth: "d0/d1/.../big"
+std::string CreateLargeDirectory(FileSystemManager& fs, const uint32_t entries, const uint32_t depth)
+{
+	std::string path;
+	for (uint32_t level = 0; level + 1 < depth; ++level)
+	{
+		path += "d" + std::to_string(level);
+		fs.CreateDirectory(path);
+		path += '/';
+	}
+	path += "big";
+	fs.CreateDirectory(path);
+	for (uint32_t file = 0; file < entries; ++file)
+	{
+		fs.CreateFile(path + "/file" + std::to_string(file));
+	}
+	return path;
+}
+
+bool CreateImage(FileSystemManager& fs, const std::filesystem::path& imagePath, const uint32_t entries, const uint32_t depth)
+{
+	const uint32_t maxFiles = entries + depth;
+	return fs.CreateImage(imagePath.string(), maxFiles * sizeof(FileEntry) + DATA_SIZE, maxFiles);
+}
+}
+
+// readdir большого каталога: имена всех записей за один вызов
+static void ReadLargeDirectory(benchmark::State& state)
+{
+	const auto entries = static_cast<uint32_t>(state.range(0));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-directory-benchmark.img";
+	FileSystemManager fs;
+	if (!CreateImage(fs, imagePath, entries, 1))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	const std::string directory = CreateLargeDirectory(fs, entries, 1);
+
+	std::vector<std::string> names;
+	for (auto _ : state)
+	{
+		fs.ReadDirectory(directory, names);
+		benchmark::DoNotOptimize(names.data());
+	}
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * entries);
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(ReadLargeDirectory)->ArgName("entries")->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// getattr случайного файла большого каталога, лежащего на глубине depth
+static void LookupInLargeDirectory(benchmark::State& state)
+{
+	const auto entries = static_cast<uint32_t>(state.range(0));
+	const auto depth = static_cast<uint32_t>(state.range(1));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-directory-benchmark.img";
+	FileSystemManager fs;
+	if (!CreateImage(fs, imagePath, entries, depth))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	const std::string directory = CreateLargeDirectory(fs, entries, depth);
+	std::vector<std::string> paths;
+	paths.reserve(entries);
+	for (uint32_t file = 0; file < entries; ++file)
+	{
+		paths.push_back(directory + "/file" + std::to_string(file));
+	}
+
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<uint32_t> fileDistribution(0, entries - 1);
+	FileEntry entry{};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(fs.GetFileStat(paths[fileDistribution(generator)], entry));
+	}
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(LookupInLargeDirectory)->ArgNames({ "entries", "depth" })->ArgsProduct({ { 100000 }, { 1, 8 } });
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+
+namespace
+{
+constexpr uint32_t MAX_FILES = 100000;
+}
+
+// mkfs: создание образа вместе с метаданными и сбросом их на носитель при закрытии
+static void CreateImage(benchmark::State& state)
+{
+	const uint64_t imageSize = static_cast<uint64_t>(state.range(0)) * 1024 * 1024 * 1024;
+	const bool preallocate = state.range(1) != 0;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-creation-benchmark.img";
+
+	for (auto _ : state)
+	{
+		FileSystemManager fs;
+		if (!fs.CreateImage(imagePath.string(), imageSize, MAX_FILES, preallocate))
+		{
+			state.SkipWithError("Cannot create image");
+			break;
+		}
+		fs.CloseImage();
+
+		state.PauseTiming();
+		std::filesystem::remove(imagePath);
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(CreateImage)
+	->ArgNames({ "size_gib", "preallocate" })
+	->ArgsProduct({ { 1, 10, 100 }, { 0, 1 } })
+	->Unit(benchmark::kMillisecond);
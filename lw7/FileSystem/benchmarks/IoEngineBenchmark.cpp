@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t IMAGE_SIZE = 1ULL << 30;
+constexpr uint64_t FILE_SIZE = 256ULL * 1024 * 1024;
+constexpr size_t REQUEST_SIZE = 4 * 1024 * 1024;
+
+void DropPageCache(const std::filesystem::path& imagePath)
+{
+	const int fd = ::open(imagePath.c_str(), O_RDONLY);
+	if (fd != -1)
+	{
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+}
+
+// Последовательный проход по большому файлу запросами по 4 МиБ: каждый делится на куски по 128 КиБ,
+// и глубина очереди задаёт, сколько из них одновременно в работе. В холодном режиме
+// образ выбрасывается из страничного кэша ОС на каждом проходе
+void RunLargeIo(benchmark::State& state, const bool isWrite)
+{
+	const auto kind = state.range(0) == 0 ? IoEngineKind::Sync : IoEngineKind::Uring;
+	const auto queueDepth = static_cast<uint32_t>(state.range(1));
+	const bool isCold = state.range(2) != 0;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-io-engine-benchmark.img";
+
+	FileSystemManager fs;
+	fs.SetIoEngine(kind, queueDepth);
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, 16))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	fs.CreateFile("file");
+	std::vector<char> buffer(REQUEST_SIZE, 'x');
+	for (uint64_t offset = 0; offset < FILE_SIZE; offset += REQUEST_SIZE)
+	{
+		fs.WriteData("file", buffer.data(), buffer.size(), offset);
+	}
+	fs.Sync();
+
+	uint64_t offset = 0;
+	for (auto _ : state)
+	{
+		if (isCold && offset == 0)
+		{
+			state.PauseTiming();
+			fs.Sync();
+			DropPageCache(imagePath);
+			state.ResumeTiming();
+		}
+		const int result = isWrite
+			? fs.WriteData("file", buffer.data(), REQUEST_SIZE, offset)
+			: fs.ReadData("file", buffer.data(), REQUEST_SIZE, offset);
+		if (result != static_cast<int>(REQUEST_SIZE))
+		{
+			state.SkipWithError("I/O failed");
+			break;
+		}
+		offset = (offset + REQUEST_SIZE) % FILE_SIZE;
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * REQUEST_SIZE));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+
+// engine: 0 - pread/pwrite, 1 - io_uring
+void AddEngineArguments(benchmark::internal::Benchmark* benchmark, const int64_t cold)
+{
+	benchmark->Args({ 0, 1, cold });
+	for (const int64_t queueDepth : { 1, 8, 32 })
+	{
+		benchmark->Args({ 1, queueDepth, cold });
+	}
+}
+
+void ApplyReadArguments(benchmark::internal::Benchmark* benchmark)
+{
+	benchmark->ArgNames({ "engine", "queue_depth", "cold" })->UseRealTime();
+	AddEngineArguments(benchmark, 0);
+	AddEngineArguments(benchmark, 1);
+}
+
+// Записи оседают в страничном кэше ОС, холодный режим для них ничего не меняет
+void ApplyWriteArguments(benchmark::internal::Benchmark* benchmark)
+{
+	benchmark->ArgNames({ "engine", "queue_depth", "cold" })->UseRealTime();
+	AddEngineArguments(benchmark, 0);
+}
+}
+
+static void LargeReads(benchmark::State& state)
+{
+	RunLargeIo(state, false);
+}
+BENCHMARK(LargeReads)->Apply(ApplyReadArguments);
+
+static void LargeWrites(benchmark::State& state)
+{
+	RunLargeIo(state, true);
+}
+BENCHMARK(LargeWrites)->Apply(ApplyWriteArguments);
@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace
+{
+constexpr uint32_t MAX_FILES = 4096;
+constexpr uint32_t LIVE_FILES = 1024;
+constexpr uint64_t IMAGE_SIZE = 256ULL * 1024 * 1024;
+}
+
+// Шторм создания и удаления: каждая итерация создаёт файл и удаляет созданный LIVE_FILES итераций назад.
+// sync_every - через сколько операций вызывается Sync, 0 - только по интервалу фиксации
+static void CreateUnlinkStorm(benchmark::State& state)
+{
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-journal-benchmark.img";
+	FileSystemManager fs;
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, MAX_FILES))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	fs.SetCommitInterval(std::chrono::milliseconds(state.range(0)));
+	const auto syncEvery = static_cast<uint64_t>(state.range(1));
+
+	uint64_t operation = 0;
+	for (auto _ : state)
+	{
+		if (!fs.CreateFile("file" + std::to_string(operation)))
+		{
+			state.SkipWithError("Create failed");
+			break;
+		}
+		if (operation >= LIVE_FILES)
+		{
+			fs.RemoveFile("file" + std::to_string(operation - LIVE_FILES));
+		}
+		operation++;
+		if (syncEvery != 0 && operation % syncEvery == 0)
+		{
+			fs.Sync();
+		}
+	}
+	fs.Sync();
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(CreateUnlinkStorm)
+	->ArgNames({ "commit_ms", "sync_every" })
+	->ArgsProduct({ { 0, FileSystemManager::DEFAULT_COMMIT_INTERVAL.count() }, { 0, 1, 32 } });
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t DATA_SIZE = 16ULL * 1024 * 1024;
+
+// Таблица заполнена целиком, getattr в FUSE сводится к GetFileStat по имени
+void RunStatBenchmark(benchmark::State& state, const bool existing)
+{
+	const auto filesCount = static_cast<uint32_t>(state.range(0));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-lookup-benchmark.img";
+
+	FileSystemManager fs;
+	if (!fs.CreateImage(imagePath.string(), filesCount * sizeof(FileEntry) + DATA_SIZE, filesCount))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	std::vector<std::string> names;
+	names.reserve(filesCount);
+	for (uint32_t file = 0; file < filesCount; ++file)
+	{
+		names.push_back("file" + std::to_string(file) + (existing ? "" : ".missing"));
+		fs.CreateFile("file" + std::to_string(file));
+	}
+
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<uint32_t> fileDistribution(0, filesCount - 1);
+	FileEntry entry{};
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(fs.GetFileStat(names[fileDistribution(generator)], entry));
+	}
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+}
+
+static void StatExisting(benchmark::State& state)
+{
+	RunStatBenchmark(state, true);
+}
+BENCHMARK(StatExisting)->ArgName("files")->Arg(10000)->Arg(1000000);
+
+static void StatMissing(benchmark::State& state)
+{
+	RunStatBenchmark(state, false);
+}
+BENCHMARK(StatMissing)->ArgName("files")->Arg(10000)->Arg(1000000);
@@ -0,0 +1,235 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr uint64_t FILE_SIZE = 256ULL * 1024 * 1024;
+constexpr uint64_t IMAGE_SIZE = FILE_SIZE + 64ULL * 1024 * 1024;
+// Столько данных ядро по умолчанию передаёт в одном запросе read и write
+constexpr size_t REQUEST_SIZE = 128 * 1024;
+// Блок dd при замере через смонтированную систему
+constexpr size_t DD_BLOCK_SIZE = 1024 * 1024;
+
+// Канал, заменяющий /dev/fuse: обработчик кладёт в него ответ, а "ядро" сразу его забирает
+struct Channel
+{
+	Channel()
+	{
+		if (pipe(fds) == 0)
+		{
+			fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(REQUEST_SIZE));
+		}
+		devNull = open("/dev/null", O_WRONLY);
+	}
+
+	~Channel()
+	{
+		close(fds[0]);
+		close(fds[1]);
+		close(devNull);
+	}
+
+	bool Drain(const size_t size) const
+	{
+		for (size_t done = 0; done < size;)
+		{
+			const ssize_t moved = splice(fds[0], nullptr, devNull, nullptr, size - done, SPLICE_F_MOVE);
+			if (moved <= 0)
+			{
+				return false;
+			}
+			done += static_cast<size_t>(moved);
+		}
+		return true;
+	}
+
+	int fds[2] = { -1, -1 };
+	int devNull = -1;
+};
+
+bool SpliceRanges(const int from, const int to, const std::vector<FileSystemManager::DataRange>& ranges, const bool isRead)
+{
+	for (const auto& [imageOffset, length] : ranges)
+	{
+		auto position = static_cast<loff_t>(imageOffset);
+		for (uint64_t done = 0; done < length;)
+		{
+			const ssize_t moved = isRead ? splice(from, &position, to, nullptr, length - done, SPLICE_F_MOVE)
+										 : splice(from, nullptr, to, &position, length - done, SPLICE_F_MOVE);
+			if (moved <= 0)
+			{
+				return false;
+			}
+			done += static_cast<uint64_t>(moved);
+		}
+	}
+	return true;
+}
+
+bool PrepareFile(FileSystemManager& fs, const std::filesystem::path& imagePath, FileSystemManager::FileId& id)
+{
+	FileEntry entry{};
+	const std::vector<char> data(FILE_SIZE, 'm');
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, 16) || !fs.CreateFile("file")
+		|| fs.WriteData("file", data.data(), data.size(), 0) != static_cast<int>(data.size()))
+	{
+		return false;
+	}
+	id = fs.Lookup(FileSystemManager::ROOT_ID, "file", entry);
+	return id != FileSystemManager::NO_ID;
+}
+}
+
+// Последовательное чтение файла запросами по REQUEST_SIZE так, как его обслуживает монтирование.
+// zero_copy:0 - API с путями: данные копируются в буфер и из него в канал;
+// zero_copy:1 - низкоуровневый API: куски образа переносятся в канал через splice
+static void SequentialReadHandler(benchmark::State& state)
+{
+	const bool isZeroCopy = state.range(0) != 0;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-mount-benchmark.img";
+	FileSystemManager fs;
+	FileSystemManager::FileId id;
+	if (!PrepareFile(fs, imagePath, id))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	const Channel channel;
+	std::vector<char> buffer(REQUEST_SIZE);
+
+	for (auto _ : state)
+	{
+		bool isRead = true;
+		for (uint64_t offset = 0; isRead && offset < FILE_SIZE; offset += REQUEST_SIZE)
+		{
+			if (isZeroCopy)
+			{
+				isRead = fs.ReadDataDirect(id, offset, REQUEST_SIZE,
+					[&channel](const int imageFd, const std::vector<FileSystemManager::DataRange>& ranges) {
+						return SpliceRanges(imageFd, channel.fds[1], ranges, true);
+					}) == static_cast<int>(REQUEST_SIZE);
+			}
+			else
+			{
+				isRead = fs.ReadData("file", buffer.data(), buffer.size(), offset) == static_cast<int>(REQUEST_SIZE)
+					&& write(channel.fds[1], buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size());
+			}
+			isRead = isRead && channel.Drain(REQUEST_SIZE);
+		}
+		if (!isRead)
+		{
+			state.SkipWithError("Read failed");
+			break;
+		}
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * FILE_SIZE));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(SequentialReadHandler)->ArgName("zero_copy")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Последовательная перезапись файла запросами по REQUEST_SIZE: данные запроса приходят в канале.
+// zero_copy:0 - читаются из канала в буфер и пишутся через кэш блоков, zero_copy:1 - переносятся в образ через splice
+static void SequentialWriteHandler(benchmark::State& state)
+{
+	const bool isZeroCopy = state.range(0) != 0;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-mount-benchmark.img";
+	FileSystemManager fs;
+	FileSystemManager::FileId id;
+	if (!PrepareFile(fs, imagePath, id))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	const Channel channel;
+	const std::vector<char> request(REQUEST_SIZE, 'w');
+	std::vector<char> buffer(REQUEST_SIZE);
+
+	for (auto _ : state)
+	{
+		bool isWritten = true;
+		for (uint64_t offset = 0; isWritten && offset < FILE_SIZE; offset += REQUEST_SIZE)
+		{
+			isWritten = write(channel.fds[1], request.data(), request.size()) == static_cast<ssize_t>(request.size());
+			if (isZeroCopy)
+			{
+				isWritten = isWritten
+					&& fs.WriteDataDirect(id, offset, REQUEST_SIZE,
+						   [&channel](const int imageFd, const std::vector<FileSystemManager::DataRange>& ranges) {
+							   return SpliceRanges(channel.fds[0], imageFd, ranges, false);
+						   }) == static_cast<int>(REQUEST_SIZE);
+			}
+			else
+			{
+				isWritten = isWritten && read(channel.fds[0], buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size())
+					&& fs.WriteData("file", buffer.data(), buffer.size(), offset) == static_cast<int>(REQUEST_SIZE);
+			}
+		}
+		fs.Sync();
+		if (!isWritten)
+		{
+			state.SkipWithError("Write failed");
+			break;
+		}
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * FILE_SIZE));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(SequentialWriteHandler)->ArgName("zero_copy")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// dd через смонтированную MYFS: запись файла блоками по 1 МиБ с fsync, затем чтение мимо страничного кэша.
+// Точка монтирования задаётся переменной MYFS_MOUNT_POINT, режим монтирования выбирается при запуске myfs-mount
+static void SequentialThroughMount(benchmark::State& state)
+{
+	const bool isWrite = state.range(0) != 0;
+	const char* mountPoint = std::getenv("MYFS_MOUNT_POINT");
+	if (mountPoint == nullptr)
+	{
+		state.SkipWithError("MYFS_MOUNT_POINT is not set");
+		return;
+	}
+	const auto path = std::filesystem::path(mountPoint) / "dd-benchmark";
+	const std::vector<char> block(DD_BLOCK_SIZE, 'd');
+	std::vector<char> buffer(DD_BLOCK_SIZE);
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		const int fd = open(path.c_str(), O_RDWR | O_CREAT | (isWrite ? O_TRUNC : 0), 0644);
+		state.ResumeTiming();
+		bool isDone = fd != -1;
+		for (uint64_t offset = 0; isDone && offset < FILE_SIZE; offset += DD_BLOCK_SIZE)
+		{
+			isDone = isWrite ? write(fd, block.data(), block.size()) == static_cast<ssize_t>(block.size())
+							 : read(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size());
+		}
+		isDone = isDone && (!isWrite || fsync(fd) == 0);
+		state.PauseTiming();
+		// Следующее чтение должно дойти до файловой системы, а не до страничного кэша
+		if (fd != -1)
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+		state.ResumeTiming();
+		if (!isDone)
+		{
+			state.SkipWithError(isWrite ? "Write failed" : "Read failed");
+			break;
+		}
+	}
+
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * FILE_SIZE));
+}
+BENCHMARK(SequentialThroughMount)->ArgName("write")->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond)->Iterations(3);
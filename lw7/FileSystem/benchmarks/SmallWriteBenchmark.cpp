@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t FILES_COUNT = 100000;
+constexpr uint64_t IMAGE_SIZE = 1ULL << 30;
+constexpr size_t WRITE_SIZE = 512;
+}
+
+// Мелкие дозаписи в случайные файлы: каждая меняет размер файла, то есть запись таблицы.
+// Нулевой интервал фиксации соответствует прежней записи метаданных на каждую операцию
+static void SmallAppends(benchmark::State& state)
+{
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-small-write-benchmark.img";
+	FileSystemManager fs;
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, FILES_COUNT))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+	std::vector<std::string> names;
+	names.reserve(FILES_COUNT);
+	for (uint32_t file = 0; file < FILES_COUNT; ++file)
+	{
+		names.push_back("file" + std::to_string(file));
+		fs.CreateFile(names.back());
+	}
+	fs.SetCommitInterval(std::chrono::milliseconds(state.range(0)));
+
+	const std::vector<char> data(WRITE_SIZE, 'x');
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<uint32_t> fileDistribution(0, FILES_COUNT - 1);
+	std::vector<uint32_t> sizes(FILES_COUNT, 0);
+	for (auto _ : state)
+	{
+		const uint32_t file = fileDistribution(generator);
+		if (fs.WriteData(names[file], data.data(), WRITE_SIZE, sizes[file]) != WRITE_SIZE)
+		{
+			state.SkipWithError("Write failed");
+			break;
+		}
+		sizes[file] += WRITE_SIZE;
+	}
+	fs.Sync();
+
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(SmallAppends)
+	->ArgName("commit_ms")
+	->Arg(0)
+	->Arg(FileSystemManager::DEFAULT_COMMIT_INTERVAL.count());
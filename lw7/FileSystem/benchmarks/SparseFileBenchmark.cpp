@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+
+#include "FileSystemManager.h"
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+
+namespace
+{
+constexpr uint32_t MAX_FILES = 16;
+// Образ вмещает файл целиком, чтобы его можно было и полностью выделить
+constexpr uint64_t IMAGE_SIZE = 2ULL * 1024 * 1024 * 1024;
+constexpr uint64_t DISK_SIZE = 1ULL * 1024 * 1024 * 1024;
+}
+
+// ftruncate файла до size_mib и обратно до нуля; allocated_mib - место, выделенное файлу после увеличения
+static void TruncateToLargeSize(benchmark::State& state)
+{
+	const uint64_t size = static_cast<uint64_t>(state.range(0)) * 1024 * 1024;
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-sparse-benchmark.img";
+	FileSystemManager fs;
+	if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, MAX_FILES) || !fs.CreateFile("file"))
+	{
+		state.SkipWithError("Cannot create image");
+		return;
+	}
+
+	for (auto _ : state)
+	{
+		if (!fs.TruncateFile("file", size) || !fs.TruncateFile("file", 0))
+		{
+			state.SkipWithError("Truncate failed");
+			break;
+		}
+	}
+
+	FileEntry entry{};
+	fs.TruncateFile("file", size);
+	fs.GetFileStat("file", entry);
+	state.counters["allocated_mib"] = static_cast<double>(entry.blocksCount) * BLOCK_SIZE / (1024 * 1024);
+	fs.CloseImage();
+	std::filesystem::remove(imagePath);
+}
+BENCHMARK(TruncateToLargeSize)->ArgName("size_mib")->Arg(64)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+// Образ диска виртуальной машины: файл размером DISK_SIZE, в который записаны writes блоков вразброс.
+// allocated_mib - место, выделенное файлу, host_mib - место, занятое образом MYFS на диске хоста
+static void ScatteredWritesToDiskImage(benchmark::State& state)
+{
+	const auto writes = static_cast<uint32_t>(state.range(0));
+	const auto imagePath = std::filesystem::temp_directory_path() / "myfs-sparse-benchmark.img";
+	const std::string block(BLOCK_SIZE, 'v');
+	FileEntry entry{};
+	uint64_t hostBytes = 0;
+
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		FileSystemManager fs;
+		if (!fs.CreateImage(imagePath.string(), IMAGE_SIZE, MAX_FILES) || !fs.CreateFile("disk"))
+		{
+			state.SkipWithError("Cannot create image");
+			break;
+		}
+		std::mt19937 generator(42);
+		std::uniform_int_distribution<uint64_t> blockDistribution(0, DISK_SIZE / BLOCK_SIZE - 1);
+		state.ResumeTiming();
+
+		bool isWritten = fs.TruncateFile("disk", DISK_SIZE);
+		for (uint32_t i = 0; isWritten && i < writes; ++i)
+		{
+			isWritten = fs.WriteData("disk", block.data(), block.size(), blockDistribution(generator) * BLOCK_SIZE) == static_cast<int>(block.size());
+		}
+		fs.Sync();
+
+		state.PauseTiming();
+		if (!isWritten)
+		{
+			state.SkipWithError("Write failed");
+			break;
+		}
+		fs.GetFileStat("disk", entry);
+		fs.CloseImage();
+		struct stat imageStat{};
+		stat(imagePath.c_str(), &imageStat);
+		hostBytes = static_cast<uint64_t>(imageStat.st_blocks) * 512;
+		std::filesystem::remove(imagePath);
+		state.ResumeTiming();
+	}
+
+	state.counters["allocated_mib"] = static_cast<double>(entry.blocksCount) * BLOCK_SIZE / (1024 * 1024);
+	state.counters["host_mib"] = static_cast<double>(hostBytes) / (1024 * 1024);
+}
+BENCHMARK(ScatteredWritesToDiskImage)->ArgName("writes")->Arg(4096)->Unit(benchmark::kMillisecond)->Iterations(5);
@@ -0,0 +1,91 @@
+#ifndef FILESYSTEM_BLOCKCACHE_H
+#define FILESYSTEM_BLOCKCACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+struct BlockCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t readAheadBlocks = 0;
+	uint64_t writtenBackBlocks = 0;
+};
+
+// LRU-кэш блоков образа с упреждающим чтением и отложенной записью.
+// Смещения - байтовые смещения в образе, блоки нумеруются от начала образа.
+// Образ читается и пишется векторно, прямо в буферы кэша и из них
+class BlockCache
+{
+public:
+	using IoFunction = std::function<bool(iovec* vectors, int count, uint64_t offset)>;
+
+	BlockCache(size_t capacityBlocks, uint64_t blocksLimit, IoFunction read, IoFunction write);
+
+	bool Read(void* buffer, size_t size, uint64_t offset);
+	bool Write(const void* buffer, size_t size, uint64_t offset);
+	bool Flush();
+	// Перед чтением диапазона в обход кэша его изменённые блоки записываются на диск,
+	// перед записью в обход кэша они ещё и выбрасываются
+	bool FlushRange(uint64_t firstBlock, uint64_t blocksCount);
+	bool Evict(uint64_t firstBlock, uint64_t blocksCount);
+	// Освобождённые блоки выбрасываются без записи, чтобы старые данные не затёрли их нового владельца
+	void Invalidate(uint64_t firstBlock, uint64_t blocksCount);
+
+	BlockCacheStats GetStats() const;
+
+private:
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+	static constexpr uint32_t MAX_RUN_BLOCKS = 128;
+	static constexpr uint32_t MIN_READ_AHEAD_BLOCKS = 4;
+	static constexpr uint32_t MAX_READ_AHEAD_BLOCKS = 64;
+
+	struct Slot
+	{
+		uint64_t block = 0;
+		uint32_t prev = NO_SLOT;
+		uint32_t next = NO_SLOT;
+		bool isDirty = false;
+	};
+
+	uint32_t FindSlot(uint64_t block) const;
+	uint32_t InsertBlock(uint64_t block);
+	bool LoadRun(uint64_t firstBlock, uint32_t blocksCount);
+	bool MakeRoom();
+	void RemoveSlot(uint32_t slot);
+	void Unlink(uint32_t slot);
+	void PushFront(uint32_t slot);
+	void Touch(uint32_t slot);
+	char* GetSlotData(uint32_t slot);
+	std::vector<uint32_t> CollectSlots(uint64_t firstBlock, uint64_t blocksCount, bool onlyDirty) const;
+	bool WriteDirtyBlocks(uint64_t firstBlock = 0, uint64_t blocksCount = UINT64_MAX);
+	void DropBlocks(uint64_t firstBlock, uint64_t blocksCount);
+	uint32_t UpdateReadAhead(uint64_t firstBlock, uint64_t endBlock);
+
+	const uint64_t m_blocksLimit;
+	IoFunction m_read;
+	IoFunction m_write;
+
+	mutable std::mutex m_mutex;
+	std::vector<Slot> m_slots;
+	std::vector<char> m_data;
+	const uint32_t m_maxRunBlocks;
+	std::vector<iovec> m_readVectors;
+	std::vector<iovec> m_writeVectors;
+	std::vector<uint32_t> m_runSlots;
+	std::vector<uint32_t> m_freeSlots;
+	std::unordered_map<uint64_t, uint32_t> m_slotByBlock;
+	// Голова списка - последний использованный блок, хвост - кандидат на вытеснение
+	uint32_t m_head = NO_SLOT;
+	uint32_t m_tail = NO_SLOT;
+
+	uint64_t m_nextSequentialBlock = UINT64_MAX;
+	uint32_t m_readAheadBlocks = 0;
+	BlockCacheStats m_stats;
+};
+
+#endif // FILESYSTEM_BLOCKCACHE_H
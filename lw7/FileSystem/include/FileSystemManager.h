@@ -1,56 +1,354 @@
 #ifndef FILESYSTEM_FILESYSTEMMANAGER_H
 #define FILESYSTEM_FILESYSTEMMANAGER_H
 
+#include "BlockCache.h"
+#include "IoEngine.h"
+#include "Journal.h"
 #include "Structure.h"
 
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <fstream>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+struct FragmentationStats
+{
+	uint32_t freeBlocks = 0;
+	// Участки подряд идущих свободных блоков и длина самого длинного из них
+	uint32_t freeRuns = 0;
+	uint32_t largestFreeRun = 0;
+	uint32_t files = 0;
+	// Файлы, данные которых лежат в образе больше чем одним участком
+	uint32_t fragmentedFiles = 0;
+	uint64_t dataExtents = 0;
+	// Запас, выделенный за концом файлов
+	uint32_t tailBlocks = 0;
+};
+
+// Пути задаются относительно корня без ведущей косой черты: "dir/sub/file".
+// Методы можно вызывать из нескольких потоков: чтения разных файлов идут параллельно,
+// изменения таблицы файлов и карты блоков сериализуются блокировкой метаданных
 class FileSystemManager
 {
 public:
+	static constexpr std::chrono::milliseconds DEFAULT_COMMIT_INTERVAL{ 5000 };
+	static constexpr size_t DEFAULT_BLOCK_CACHE_BLOCKS = 1024;
+	static constexpr uint32_t DEFAULT_IO_QUEUE_DEPTH = 32;
+
+	// Идентификатор записи для обращения к ней без разбора пути: слот таблицы и номер его поколения.
+	// Поколение растёт при удалении записи, поэтому старый идентификатор не достаётся новому файлу в том же слоте
+	using FileId = uint64_t;
+	static constexpr FileId NO_ID = 0;
+	static constexpr FileId ROOT_ID = 1;
+	// Смещение в образе, которое передаётся для кусков файла, попавших в дыру
+	static constexpr uint64_t HOLE_OFFSET = UINT64_MAX;
+
+	struct DirectoryEntry
+	{
+		std::string name;
+		FileId id;
+		bool isDirectory;
+	};
+
+	// Непрерывный кусок диапазона файла в образе
+	struct DataRange
+	{
+		uint64_t imageOffset;
+		uint64_t length;
+	};
+	// Переносит данные между кусками образа и своим источником; вызывается под блокировкой файла
+	using DataTransfer = std::function<bool(int imageFd, const std::vector<DataRange>& ranges)>;
+
 	FileSystemManager() = default;
 	~FileSystemManager();
 
-	bool CreateImage(const std::string& path, uint64_t totalSize, uint32_t maxFiles);
+	// preallocate резервирует на диске место под весь образ, иначе образ остаётся разреженным
+	bool CreateImage(const std::string& path, uint64_t totalSize, uint32_t maxFiles, bool preallocate = false);
 	bool OpenImage(const std::string& path);
 	void CloseImage();
 
 	bool CreateFile(const std::string& name);
 	bool RemoveFile(const std::string& name);
+	// Увеличение размера не выделяет блоков: новая часть файла - дыра, читающаяся нулями
 	bool TruncateFile(const std::string& name, uint64_t newSize);
+	// Освобождает блоки диапазона, после чего он читается нулями; размер файла не меняется
+	bool PunchHole(const std::string& name, uint64_t offset, uint64_t length);
+	// Начало следующих данных или, если isHole, дыры не раньше offset (SEEK_DATA и SEEK_HOLE); -1, если его нет
+	int64_t SeekData(const std::string& name, uint64_t offset, bool isHole) const;
+	bool CreateDirectory(const std::string& path);
+	// Удаляет только пустой каталог
+	bool RemoveDirectory(const std::string& path);
+	// Существующий файл назначения заменяется файлом, пустой каталог - каталогом
+	bool Rename(const std::string& from, const std::string& to);
 
 	int ReadData(const std::string& name, char* buffer, size_t size, uint64_t offset);
 	int WriteData(const std::string& name, const char* buffer, size_t size, uint64_t offset);
 
 	std::vector<FileEntry> GetFileList() const;
 	bool GetFileStat(const std::string& name, FileEntry& entry) const;
+	// Имена записей каталога, пустой путь - корень
+	bool ReadDirectory(const std::string& path, std::vector<std::string>& names) const;
+
+	// Те же операции по идентификатору записи. Каталог задаётся идентификатором, имя в нём - отдельно
+	FileId Lookup(FileId parent, std::string_view name, FileEntry& entry) const;
+	bool GetFileStat(FileId id, FileEntry& entry) const;
+	bool GetPath(FileId id, std::string& path) const;
+	bool ReadDirectory(FileId directory, std::vector<DirectoryEntry>& entries) const;
+	bool TruncateFile(FileId id, uint64_t newSize);
+	bool PunchHole(FileId id, uint64_t offset, uint64_t length);
+	int64_t SeekData(FileId id, uint64_t offset, bool isHole) const;
+	int ReadData(FileId id, char* buffer, size_t size, uint64_t offset);
+	int WriteData(FileId id, const char* buffer, size_t size, uint64_t offset);
+	// Чтение и запись без промежуточного буфера: transfer получает куски образа, в которых лежит диапазон.
+	// При чтении дыры передаются с HOLE_OFFSET, при записи все куски уже выделены, а края блоков занулены
+	int ReadDataDirect(FileId id, uint64_t offset, size_t size, const DataTransfer& transfer);
+	int WriteDataDirect(FileId id, uint64_t offset, size_t size, const DataTransfer& transfer);
+
+	// Уплотнение без отключения образа: освобождает запас за концом файлов и переносит данные файлов
+	// в более ранние свободные участки, чтобы свободное место собралось в конце области данных.
+	// Возвращает число перенесённых блоков данных или -1; passes - сколько проходов по таблице что-то перенесли
+	int64_t Compact(uint32_t* passes = nullptr);
+	FragmentationStats GetFragmentationStats() const;
+
+	// Нулевой интервал - каждое изменение метаданных сразу отдаётся ядру, Sync дожидается записи на носитель
+	void SetCommitInterval(std::chrono::milliseconds interval);
+	bool Sync();
+
+	// Размер кэша блоков данных применяется при следующем открытии образа, 0 отключает кэш
+	void SetBlockCacheSize(size_t blocks);
+	BlockCacheStats GetBlockCacheStats() const;
+
+	// Исполнитель ввода-вывода образа тоже применяется при следующем открытии
+	void SetIoEngine(IoEngineKind kind, uint32_t queueDepth = DEFAULT_IO_QUEUE_DEPTH);
 
 private:
-	void ReadSuperblock();
+	bool ReadSuperblock();
 	void WriteSuperblock();
 	void ReadFileTable();
-	void WriteFileTable();
+	void StageDirtyEntries();
+	void MarkEntryDirty(int fileIndex);
+	void CommitIfDue();
+	bool WriteBack();
+	void CreateJournal();
+	size_t EstimateTransactionSize() const;
+	bool ReadAt(void* buffer, size_t size, uint64_t offset) const;
+	bool WriteAt(const void* buffer, size_t size, uint64_t offset) const;
+	bool ReadVectorAt(iovec* vectors, int count, uint64_t offset) const;
+	bool WriteVectorAt(iovec* vectors, int count, uint64_t offset) const;
+	void CreateBlockCache();
+	bool ReadDataRange(void* buffer, size_t size, uint64_t offset);
+	bool WriteDataRange(const void* buffer, size_t size, uint64_t offset);
+	void InvalidateCachedBlocks(uint32_t firstBlock, uint32_t blocksCount);
+	bool TransferDirect(int fileIndex, char* buffer, uint64_t size, uint64_t offset, bool isWrite);
+	bool TransferRanges(int fileIndex, uint64_t offset, uint64_t size, bool isWrite, const DataTransfer& transfer);
+	template <typename FileLock>
+	int LockFile(const std::string& name, FileLock& fileLock) const;
+	template <typename FileLock>
+	int LockEntry(FileId id, FileLock& fileLock) const;
+	int GetEntryIndex(FileId id) const;
+	FileId GetFileId(int fileIndex) const;
+	bool ResolveDirectory(FileId id, uint32_t& directory) const;
+	bool TruncateEntry(int fileIndex, uint64_t newSize);
+	bool PunchEntryHole(int fileIndex, uint64_t offset, uint64_t length);
+	int64_t SeekEntryData(int fileIndex, uint64_t offset, bool isHole) const;
+	int ReadEntryData(int fileIndex, char* buffer, size_t size, uint64_t offset);
+	int WriteEntryData(int fileIndex, const char* buffer, size_t size, uint64_t offset);
+	// Собирает данные файла в один участок и сдвигает его к началу области данных; moved - перенесённые блоки
+	bool RelocateFile(int fileIndex, uint32_t& moved);
+	// Копирует блоки данных [firstData, firstData + count) файла в участок с начала target и фиксирует новую раскладку.
+	// Вызывается под блокировкой файла и метаданных, на время копирования блокировка метаданных отпускается
+	bool MoveDataBlocks(int fileIndex, uint32_t firstData, uint32_t count, uint32_t target,
+		std::unique_lock<std::shared_mutex>& metadataLock);
+	bool CopyBlocks(uint32_t from, uint32_t to, uint32_t blocksCount, std::vector<char>& buffer) const;
+	// Выделяет блоки под запись и меняет размер; [writeBegin, writeEnd) - запись вместе с краями, которые надо занулить
+	bool PrepareWrite(int fileIndex, uint64_t offset, uint64_t size, uint64_t& writeBegin, uint64_t& writeEnd);
+	void ReadBitmap();
+	void StageDirtyBitmap();
+	void MarkBitmapDirty(size_t firstWord, size_t endWord);
 
-	static void InitializeEmptyStorage(const std::string& path, uint64_t size);
+	static bool InitializeEmptyStorage(const std::string& path, uint64_t size, bool preallocate);
 	bool InitializeSuperblock(uint32_t maxFiles, uint64_t totalSize);
 	void InitializeFileTable(uint32_t maxFiles);
-	void InitializeFileEntry(int freeEntryIndex, const std::string& name);
-
-	int FindConsecutiveBlocks(uint32_t neededBlocks) const;
-	int FindFreeFileTableEntry() const;
-	int GetFileIndex(const std::string& name) const;
-	uint32_t AlignUpToBlockSize(uint32_t maxFiles) const;
-	std::vector<bool> GetBlockMap() const;
-	bool EnsureSufficientBlocks(FileEntry& entry, uint64_t newSize);
-	void MoveFileData(const FileEntry& entry, uint64_t newStartBlock);
-	static uint32_t CalculateTargetBlockCount(const FileEntry& entry, uint32_t neededBlocks);
-
-	std::fstream m_imageStream;
+	void InitializeBitmap();
+	void InitializeFileEntry(int freeEntryIndex, uint32_t parent, std::string_view name, bool isDirectory);
+
+	// Все экстенты файла, включая хранящиеся в блоках переполнения
+	struct FileExtents
+	{
+		std::vector<Extent> extents;
+		std::vector<uint32_t> overflowBlocks;
+		// Экстенты начиная с этого изменены, но их блоки переполнения ещё не отданы в журнал
+		size_t firstDirtyExtent = SIZE_MAX;
+		size_t dirtyBlocks = 0;
+	};
+
+	Extent FindFreeRun(uint32_t neededBlocks) const;
+	uint32_t CountFreeBlocks(uint32_t firstBlock, uint32_t maxBlocks) const;
+	void MarkBlocks(uint32_t firstBlock, uint32_t blocksCount, bool used);
+	void BuildFileIndex();
+	void LinkEntry(int fileIndex);
+	void UnlinkEntry(int fileIndex);
+	void UpdateDirectoryPaths(uint32_t directory, const std::string& path, bool isIndexed);
+	bool SplitPath(std::string_view path, uint32_t& parent, std::string_view& name) const;
+	bool GetDirectoryIndex(std::string_view path, uint32_t& directory) const;
+	bool IsInSubtree(uint32_t entry, uint32_t directory) const;
+	size_t GetTreeSlot(uint32_t entry) const;
+	static std::string_view GetEntryName(const FileEntry& entry);
+	bool CreateEntry(const std::string& path, bool isDirectory);
+	void ReleaseEntry(int fileIndex);
+	int TakeFreeFileTableEntry();
+	int GetFileIndex(std::string_view path) const;
+	static uint64_t AlignUpToBlockSize(uint64_t offset);
+	// Выделяет блоки под дыры в [firstBlock, endBlock); reserve добавляет запас за концом
+	bool MapBlocks(int fileIndex, uint32_t firstBlock, uint32_t endBlock, bool reserve);
+	// Превращает [firstBlock, endBlock) в дыру и освобождает её блоки
+	bool UnmapBlocks(int fileIndex, uint32_t firstBlock, uint32_t endBlock);
+	// Заменяет replacedCount экстентов начиная с firstExtent и освобождает блоки released
+	bool UpdateLayout(int fileIndex, size_t firstExtent, size_t replacedCount,
+		const std::vector<Extent>& replacement, const std::vector<Extent>& released);
+	bool IsRangeMapped(int fileIndex, uint32_t firstBlock, uint32_t endBlock) const;
+	bool ZeroRange(int fileIndex, uint64_t offset, uint64_t size);
+	void FreeBlocks(int fileIndex);
+	// Блоки освобождаются в карте только после фиксации транзакции, которая их освобождает
+	void DeferFree(uint32_t firstBlock, uint32_t blocksCount);
+	bool CommitPendingFrees();
+	void ReadExtents(int fileIndex);
+	void WriteExtents(int fileIndex, size_t firstChangedExtent);
+	void StageOverflowBlocks(int fileIndex);
+	static size_t GetOverflowBlockIndex(size_t extentIndex);
+	template <typename Action>
+	void ForEachDiskRange(int fileIndex, uint64_t offset, uint64_t size, Action action) const;
+	uint64_t GetBlockOffset(uint32_t block) const;
+	static uint32_t CalculateTargetBlockCount(uint32_t coveredBlocks, uint32_t neededBlocks);
+	static uint32_t CountCoveredBlocks(const std::vector<Extent>& extents);
+	static size_t FindWindowStart(const std::vector<Extent>& extents, uint32_t block, uint32_t& windowStart);
+	static size_t FindWindowEnd(const std::vector<Extent>& extents, uint32_t endBlock);
+	static void SplitExtents(std::vector<Extent>& extents, uint32_t block);
+	static void NormalizeExtents(std::vector<Extent>& extents);
+	static size_t CountOverflowBlocks(size_t extentsCount);
+
+	// Ключ записи в индексе имён. Имя хранится в самом ключе, чтобы сравнение не обращалось к таблице;
+	// искать можно и по EntryKeyView, не копируя имя
+	struct EntryKey
+	{
+		uint32_t parent;
+		std::string name;
+	};
+
+	struct EntryKeyView
+	{
+		uint32_t parent;
+		std::string_view name;
+	};
+
+	struct EntryKeyHash
+	{
+		using is_transparent = void;
+
+		size_t operator()(const EntryKeyView& key) const noexcept
+		{
+			return std::hash<std::string_view>{}(key.name) ^ (key.parent * 0x9E3779B97F4A7C15ULL);
+		}
+
+		size_t operator()(const EntryKey& key) const noexcept
+		{
+			return (*this)(EntryKeyView{ key.parent, key.name });
+		}
+	};
+
+	struct EntryKeyEqual
+	{
+		using is_transparent = void;
+
+		static EntryKeyView View(const EntryKey& key)
+		{
+			return { key.parent, key.name };
+		}
+
+		static EntryKeyView View(const EntryKeyView& key)
+		{
+			return key;
+		}
+
+		template <typename Left, typename Right>
+		bool operator()(const Left& left, const Right& right) const noexcept
+		{
+			return View(left).parent == View(right).parent && View(left).name == View(right).name;
+		}
+	};
+
+	struct PathHash
+	{
+		using is_transparent = void;
+
+		size_t operator()(const std::string_view path) const noexcept
+		{
+			return std::hash<std::string_view>{}(path);
+		}
+	};
+
+	// Дети каталога связаны в список, чтобы добавление и удаление не зависели от размера каталога
+	struct TreeNode
+	{
+		int firstChild = -1;
+		int previousSibling = -1;
+		int nextSibling = -1;
+	};
+
+	// Блокировки файлов разделены по слотам таблицы на полосы, чтобы не держать по мьютексу на каждый слот
+	static constexpr size_t FILE_LOCK_STRIPES = 256;
+	// Запросы от этого размера идут мимо кэша блоков кусками, которые исполнитель держит в работе одновременно
+	static constexpr uint64_t DIRECT_IO_MIN_SIZE = 256 * 1024;
+	static constexpr uint64_t IO_CHUNK_SIZE = 128 * 1024;
+	// Уплотнение копирует данные кусками такого размера
+	static constexpr uint64_t COMPACTION_CHUNK_SIZE = 1024 * 1024;
+	// Слот 0 в идентификаторах - NO_ID, слот 1 - корень, записи таблицы идут со слота 2
+	static constexpr uint64_t FIRST_ENTRY_SLOT = 2;
+	// Карта блоков журналируется кусками по 8 слов, то есть по 512 блоков данных
+	static constexpr size_t BITMAP_CHUNK_WORDS = 8;
+	// Журнал занимает 1/16 места под данные, но не меньше 8 и не больше 4096 блоков
+	static constexpr uint32_t MIN_JOURNAL_BLOCKS = 8;
+	static constexpr uint32_t MAX_JOURNAL_BLOCKS = 4096;
+
+	int m_imageFd = -1;
+	mutable std::shared_mutex m_metadataMutex;
+	mutable std::array<std::shared_mutex, FILE_LOCK_STRIPES> m_fileLocks;
 	Superblock m_superblock;
 	std::vector<FileEntry> m_fileTable;
+	std::vector<FileExtents> m_fileExtents;
+	std::unordered_map<EntryKey, int, EntryKeyHash, EntryKeyEqual> m_fileIndexByKey;
+	// Пути всех каталогов: поиск по любому пути - это поиск каталога и имени в нём, независимо от глубины
+	std::unordered_map<std::string, uint32_t, PathHash, std::equal_to<>> m_directoryIndexByPath;
+	// Узел i - запись таблицы i, последний узел - корневой каталог
+	std::vector<TreeNode> m_tree;
+	// Поколения слотов таблицы для идентификаторов записей; на диске не хранятся
+	std::vector<uint32_t> m_generations;
+	std::vector<int> m_freeEntries;
+	std::vector<bool> m_isEntryDirty;
+	std::vector<uint32_t> m_dirtyEntries;
+	// Сколько блоков переполнения ждут журналирования у файлов из m_dirtyEntries
+	size_t m_dirtyOverflowBlocks = 0;
+	std::chrono::milliseconds m_commitInterval = DEFAULT_COMMIT_INTERVAL;
+	std::chrono::steady_clock::time_point m_lastCommit;
+	size_t m_blockCacheBlocks = DEFAULT_BLOCK_CACHE_BLOCKS;
+	std::unique_ptr<BlockCache> m_blockCache;
+	IoEngineKind m_ioEngineKind = IoEngineKind::Sync;
+	uint32_t m_ioQueueDepth = DEFAULT_IO_QUEUE_DEPTH;
+	std::unique_ptr<IoEngine> m_ioEngine;
+	std::unique_ptr<Journal> m_journal;
+	std::vector<uint64_t> m_blockBitmap;
+	// Слова карты до этого индекса заняты целиком, поиск свободных блоков начинается с него
+	size_t m_firstFreeWord = 0;
+	std::vector<bool> m_isBitmapChunkDirty;
+	std::vector<uint32_t> m_dirtyBitmapChunks;
+	// Освобождённые, но ещё занятые в карте блоки: до фиксации освобождения журнал может вернуть их прежнему владельцу
+	std::vector<Extent> m_pendingFreeBlocks;
 };
 
 #endif // FILESYSTEM_FILESYSTEMMANAGER_H
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef FILESYSTEM_IOENGINE_H
+#define FILESYSTEM_IOENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/uio.h>
+
+enum class IoEngineKind
+{
+	Sync,
+	Uring
+};
+
+// Векторы запроса сдвигаются по мере передачи, поэтому после выполнения их содержимое не определено
+struct IoRequest
+{
+	iovec* vectors = nullptr;
+	int count = 0;
+	uint64_t offset = 0;
+	bool isWrite = false;
+};
+
+// Исполнитель чтений и записей образа. Execute можно вызывать из нескольких потоков
+class IoEngine
+{
+public:
+	virtual ~IoEngine() = default;
+
+	// Выполняет все запросы пачки, держа в работе до queueDepth из них одновременно.
+	// false, если хотя бы один запрос не выполнен целиком
+	virtual bool Execute(IoRequest* requests, size_t count) = 0;
+
+	// Если io_uring недоступен, возвращается исполнитель на pread/pwrite
+	static std::unique_ptr<IoEngine> Create(int fd, IoEngineKind kind, uint32_t queueDepth);
+};
+
+#endif // FILESYSTEM_IOENGINE_H
@@ -0,0 +1,54 @@
+#ifndef FILESYSTEM_JOURNAL_H
+#define FILESYSTEM_JOURNAL_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Журнал упреждающей записи метаданных. Изменения копятся в открытой транзакции,
+// Commit дописывает её в область журнала одной последовательной записью, Checkpoint
+// переносит зафиксированные транзакции на их места в образе и очищает журнал.
+// Методы не потокобезопасны, их вызывают под блокировкой метаданных
+class Journal
+{
+public:
+	using ReadFunction = std::function<bool(void* buffer, size_t size, uint64_t offset)>;
+	using WriteFunction = std::function<bool(const void* buffer, size_t size, uint64_t offset)>;
+	using SyncFunction = std::function<bool()>;
+
+	// Записи транзакций допускаются только в диапазон [targetBegin, targetEnd) образа
+	Journal(uint64_t offset, uint32_t blocksCount, uint64_t targetBegin, uint64_t targetEnd,
+		ReadFunction read, WriteFunction write, SyncFunction sync);
+
+	bool Format();
+	// Воспроизводит транзакции, зафиксированные до сбоя; -1, если журнал не читается
+	int Recover();
+
+	void Stage(uint64_t offset, const void* data, size_t size);
+	size_t GetStagedSize() const;
+	size_t GetCapacity() const;
+	bool Commit();
+	bool Checkpoint();
+
+private:
+	bool Replay(const std::vector<char>& transactions, uint64_t& sequence, int& replayedCount) const;
+	bool ApplyRecords(const char* records, size_t size) const;
+	bool WriteHeader();
+
+	const uint64_t m_offset;
+	const uint32_t m_blocksCount;
+	const uint64_t m_targetBegin;
+	const uint64_t m_targetEnd;
+	ReadFunction m_read;
+	WriteFunction m_write;
+	SyncFunction m_sync;
+
+	// Транзакции с прошлой контрольной точки в том виде, в каком они лежат в журнале
+	std::vector<char> m_committed;
+	std::vector<char> m_staged;
+	uint32_t m_stagedRecords = 0;
+	uint64_t m_firstSequence = 1;
+	uint64_t m_nextSequence = 1;
+};
+
+#endif // FILESYSTEM_JOURNAL_H
@@ -0,0 +1,61 @@
+#ifndef FILESYSTEM_LOWLEVELMOUNTMANAGER_H
+#define FILESYSTEM_LOWLEVELMOUNTMANAGER_H
+
+#define FUSE_USE_VERSION 31
+#include "FileSystemManager.h"
+#include <fuse3/fuse_lowlevel.h>
+#include <string>
+
+// Монтирование через низкоуровневый API FUSE. Номера inode - идентификаторы записей FileSystemManager,
+// поэтому запросы к открытым файлам не разбирают путь, а данные идут между образом и ядром через splice
+class LowLevelMountManager
+{
+public:
+	static constexpr double DEFAULT_CACHE_TIMEOUT = 1.0;
+
+	explicit LowLevelMountManager(FileSystemManager& fsManager);
+	~LowLevelMountManager() = default;
+
+	int Run(int argc, char* argv[]) const;
+
+private:
+	// Общие данные сессии, обработчики получают их через fuse_req_userdata
+	struct Session
+	{
+		FileSystemManager* fileSystem;
+		// Сколько секунд ядро может не переспрашивать атрибуты и результаты lookup
+		double cacheTimeout;
+	};
+
+	static void Init(void* userdata, fuse_conn_info* conn);
+	static void Lookup(fuse_req_t req, fuse_ino_t parent, const char* name);
+	static void Forget(fuse_req_t req, fuse_ino_t ino, uint64_t lookupCount);
+	static void GetAttr(fuse_req_t req, fuse_ino_t ino, fuse_file_info* fi);
+	static void SetAttr(fuse_req_t req, fuse_ino_t ino, struct stat* attr, int toSet, fuse_file_info* fi);
+	static void Mkdir(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode);
+	static void Unlink(fuse_req_t req, fuse_ino_t parent, const char* name);
+	static void Rmdir(fuse_req_t req, fuse_ino_t parent, const char* name);
+	static void Rename(fuse_req_t req, fuse_ino_t parent, const char* name, fuse_ino_t newParent, const char* newName,
+		unsigned int flags);
+	static void Open(fuse_req_t req, fuse_ino_t ino, fuse_file_info* fi);
+	static void Read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, fuse_file_info* fi);
+	static void Fsync(fuse_req_t req, fuse_ino_t ino, int isDataSync, fuse_file_info* fi);
+	static void OpenDir(fuse_req_t req, fuse_ino_t ino, fuse_file_info* fi);
+	static void ReadDir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, fuse_file_info* fi);
+	static void ReleaseDir(fuse_req_t req, fuse_ino_t ino, fuse_file_info* fi);
+	static void Create(fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, fuse_file_info* fi);
+	static void WriteBuf(fuse_req_t req, fuse_ino_t ino, fuse_bufvec* source, off_t offset, fuse_file_info* fi);
+	static void Fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length, fuse_file_info* fi);
+	static void Lseek(fuse_req_t req, fuse_ino_t ino, off_t offset, int whence, fuse_file_info* fi);
+
+	static const Session& GetSession(fuse_req_t req);
+	static void FillStat(fuse_ino_t ino, const FileEntry& entry, struct stat& stat);
+	static bool GetChildPath(const FileSystemManager& fileSystem, fuse_ino_t parent, const char* name, std::string& path);
+	// Отвечает на lookup, mkdir и create записью name из каталога parent; для create fi - открытый файл
+	static void ReplyEntry(fuse_req_t req, fuse_ino_t parent, const char* name, fuse_file_info* fi, bool isLookup);
+
+	FileSystemManager& m_fileSystemManager;
+	static const fuse_lowlevel_ops m_operations;
+};
+
+#endif // FILESYSTEM_LOWLEVELMOUNTMANAGER_H
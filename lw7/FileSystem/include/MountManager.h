@@ -14,15 +14,24 @@ public:
 
 	int Run(int argc, char* argv[]) const;
 
+	// Разбирает параметр образа argv[index] вместе с его значением; false, если это параметр FUSE
+	static bool ParseImageOption(FileSystemManager& fileSystem, int argc, char* argv[], int& index);
+
 private:
 	static int GetAttr(const char* path, struct stat* stbuf, fuse_file_info* fi);
 	static int ReadDir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, fuse_file_info* fi, fuse_readdir_flags flags);
 	static int Create(const char* path, mode_t mode, fuse_file_info* fi);
 	static int Read(const char* path, char* buf, size_t size, off_t offset, fuse_file_info* fi);
 	static int Write(const char* path, const char* buf, size_t size, off_t offset, fuse_file_info* fi);
+	static int Fsync(const char* path, int isDataSync, fuse_file_info* fi);
+	static int Fallocate(const char* path, int mode, off_t offset, off_t length, fuse_file_info* fi);
+	static off_t Lseek(const char* path, off_t offset, int whence, fuse_file_info* fi);
 	static int Unlink(const char* path);
 	static int Truncate(const char* path, off_t size, fuse_file_info* fi);
 	static int Open(const char* path, fuse_file_info* fi);
+	static int Mkdir(const char* path, mode_t mode);
+	static int Rmdir(const char* path);
+	static int Rename(const char* from, const char* to, unsigned int flags);
 
 	static FileSystemManager* GetFileSystem();
 	static std::string ExtractFileName(const char* path);
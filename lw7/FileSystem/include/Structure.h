@@ -4,9 +4,21 @@
 #include <cstdint>
 
 constexpr char SIGNATURE[] = "MYFS1";
+// Версия 2: файлы хранятся списком экстентов вместо одного непрерывного участка
+// Версия 3: после таблицы файлов хранится битовая карта занятых блоков
+// Версия 4: между картой блоков и областью данных лежит журнал метаданных
+// Версия 5: записи таблицы образуют дерево каталогов, name - имя внутри родительского каталога
+// Версия 6: экстент с startBlock == NO_BLOCK - дыра, которая не занимает блоков и читается нулями
+constexpr uint32_t FS_VERSION = 6;
 constexpr uint32_t BLOCK_SIZE = 4096;
 constexpr uint32_t MAX_FILENAME = 255;
 constexpr uint32_t MAX_FILE_SIZE = 2UL * 1024 * 1024 * 1024;
+constexpr uint32_t NO_BLOCK = UINT32_MAX;
+constexpr uint32_t INLINE_EXTENTS = 4;
+// Корневой каталог не занимает запись в таблице, это значение parent у его детей
+constexpr uint32_t ROOT_DIRECTORY = UINT32_MAX;
+constexpr uint32_t JOURNAL_MAGIC = 0x4A53464D;
+constexpr uint32_t TRANSACTION_MAGIC = 0x5853464D;
 
 #pragma pack(push, 1)
 struct Superblock
@@ -18,16 +30,67 @@ struct Superblock
 	uint32_t totalBlocks{};
 	uint32_t fileTableOffset{};
 	uint32_t dataAreaOffset{};
+	// Бит i слова i / 64 установлен, если блок данных i занят
+	uint32_t bitmapOffset{};
+	uint32_t bitmapWords{};
+	uint32_t journalOffset{};
+	uint32_t journalBlocks{};
+};
+
+struct Extent
+{
+	uint32_t startBlock;
+	uint32_t blocksCount;
+};
+
+// Заголовок блока переполнения: экстенты, не поместившиеся в FileEntry, хранятся цепочкой блоков
+struct ExtentBlockHeader
+{
+	uint32_t nextBlock;
+	uint32_t extentsCount;
 };
 
 struct FileEntry
 {
 	char name[MAX_FILENAME + 1];
 	uint32_t size;
-	uint32_t startBlock;
+	// Сколько блоков данных выделено файлу во всех экстентах, не считая дыр
 	uint32_t blocksCount;
+	uint32_t extentsCount;
+	Extent extents[INLINE_EXTENTS];
+	uint32_t overflowBlock;
+	// Индекс записи родительского каталога или ROOT_DIRECTORY
+	uint32_t parent;
+	bool isDirectory;
 	bool isUsed;
 };
+// Первый блок журнала. Транзакции лежат за ним подряд, начиная с номера firstSequence;
+// воспроизведение останавливается на первой транзакции с чужим номером или неверной суммой
+struct JournalHeader
+{
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t firstSequence;
+};
+
+// За заголовком транзакции следуют recordsCount записей: JournalRecord и length байт для смещения offset.
+// checksum - CRC-32 заголовка с нулевым checksum и всех записей
+struct TransactionHeader
+{
+	uint32_t magic;
+	uint32_t recordsCount;
+	uint64_t sequence;
+	uint32_t payloadSize;
+	uint32_t checksum;
+};
+
+struct JournalRecord
+{
+	uint64_t offset;
+	uint32_t length;
+};
 #pragma pack(pop)
 
+constexpr uint32_t EXTENTS_PER_BLOCK = (BLOCK_SIZE - sizeof(ExtentBlockHeader)) / sizeof(Extent);
+
 #endif // FILESYSTEM_STRUCTURE_H
@@ -0,0 +1,357 @@
+#include "BlockCache.h"
+
+#include "Structure.h"
+
+#include <algorithm>
+#include <cstring>
+
+BlockCache::BlockCache(const size_t capacityBlocks, const uint64_t blocksLimit, IoFunction read, IoFunction write)
+	: m_blocksLimit(blocksLimit)
+	, m_read(std::move(read))
+	, m_write(std::move(write))
+	, m_slots(std::max<size_t>(capacityBlocks, 1))
+	, m_data(m_slots.size() * BLOCK_SIZE)
+	// Подгружаемый участок не длиннее половины кэша, иначе он вытеснял бы сам себя
+	, m_maxRunBlocks(static_cast<uint32_t>(std::clamp<size_t>(m_slots.size() / 2, 1, MAX_RUN_BLOCKS)))
+{
+	m_readVectors.reserve(m_maxRunBlocks);
+	m_writeVectors.reserve(m_maxRunBlocks);
+	m_runSlots.reserve(m_maxRunBlocks);
+	m_freeSlots.reserve(m_slots.size());
+	for (size_t slot = m_slots.size(); slot-- > 0;)
+	{
+		m_freeSlots.push_back(static_cast<uint32_t>(slot));
+	}
+	m_slotByBlock.reserve(m_slots.size());
+}
+
+bool BlockCache::Read(void* buffer, const size_t size, const uint64_t offset)
+{
+	if (size == 0)
+	{
+		return true;
+	}
+
+	std::lock_guard lock(m_mutex);
+	auto* out = static_cast<char*>(buffer);
+	const uint64_t firstBlock = offset / BLOCK_SIZE;
+	const uint64_t endBlock = (offset + size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const uint32_t readAheadBlocks = UpdateReadAhead(firstBlock, endBlock);
+
+	uint64_t loadedEnd = firstBlock;
+	for (uint64_t block = firstBlock; block < endBlock; ++block)
+	{
+		uint32_t slot = FindSlot(block);
+		if (slot == NO_SLOT)
+		{
+			// Промах подгружает одним чтением все отсутствующие блоки подряд,
+			// а если участок доходит до конца запроса - ещё и окно упреждения
+			uint32_t runBlocks = 1;
+			while (runBlocks < m_maxRunBlocks && block + runBlocks < endBlock && FindSlot(block + runBlocks) == NO_SLOT)
+			{
+				runBlocks++;
+			}
+			m_stats.misses += runBlocks;
+			if (block + runBlocks == endBlock)
+			{
+				uint32_t extraBlocks = 0;
+				while (extraBlocks < readAheadBlocks && runBlocks < m_maxRunBlocks
+					&& block + runBlocks < m_blocksLimit && FindSlot(block + runBlocks) == NO_SLOT)
+				{
+					runBlocks++;
+					extraBlocks++;
+				}
+				m_stats.readAheadBlocks += extraBlocks;
+			}
+
+			if (!LoadRun(block, runBlocks))
+			{
+				return false;
+			}
+			loadedEnd = block + runBlocks;
+			slot = FindSlot(block);
+		}
+		else
+		{
+			if (block >= loadedEnd)
+			{
+				m_stats.hits++;
+			}
+			Touch(slot);
+		}
+
+		const uint64_t blockStart = block * BLOCK_SIZE;
+		const uint64_t copyStart = std::max(offset, blockStart);
+		const uint64_t copyEnd = std::min(offset + size, blockStart + BLOCK_SIZE);
+		std::memcpy(out + (copyStart - offset), GetSlotData(slot) + (copyStart - blockStart), copyEnd - copyStart);
+	}
+	return true;
+}
+
+bool BlockCache::Write(const void* buffer, const size_t size, const uint64_t offset)
+{
+	if (size == 0)
+	{
+		return true;
+	}
+
+	std::lock_guard lock(m_mutex);
+	const auto* in = static_cast<const char*>(buffer);
+	const uint64_t firstBlock = offset / BLOCK_SIZE;
+	const uint64_t endBlock = (offset + size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	for (uint64_t block = firstBlock; block < endBlock; ++block)
+	{
+		const uint64_t blockStart = block * BLOCK_SIZE;
+		const uint64_t copyStart = std::max(offset, blockStart);
+		const uint64_t copyEnd = std::min(offset + size, blockStart + BLOCK_SIZE);
+
+		uint32_t slot = FindSlot(block);
+		if (slot == NO_SLOT)
+		{
+			// Блок, переписываемый целиком, читать с диска незачем
+			if (copyEnd - copyStart == BLOCK_SIZE)
+			{
+				slot = InsertBlock(block);
+			}
+			else if (LoadRun(block, 1))
+			{
+				slot = FindSlot(block);
+			}
+			if (slot == NO_SLOT)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			Touch(slot);
+		}
+
+		std::memcpy(GetSlotData(slot) + (copyStart - blockStart), in + (copyStart - offset), copyEnd - copyStart);
+		m_slots[slot].isDirty = true;
+	}
+	return true;
+}
+
+bool BlockCache::Flush()
+{
+	std::lock_guard lock(m_mutex);
+	return WriteDirtyBlocks();
+}
+
+bool BlockCache::FlushRange(const uint64_t firstBlock, const uint64_t blocksCount)
+{
+	std::lock_guard lock(m_mutex);
+	return WriteDirtyBlocks(firstBlock, blocksCount);
+}
+
+bool BlockCache::Evict(const uint64_t firstBlock, const uint64_t blocksCount)
+{
+	std::lock_guard lock(m_mutex);
+	if (!WriteDirtyBlocks(firstBlock, blocksCount))
+	{
+		return false;
+	}
+	DropBlocks(firstBlock, blocksCount);
+	return true;
+}
+
+void BlockCache::Invalidate(const uint64_t firstBlock, const uint64_t blocksCount)
+{
+	std::lock_guard lock(m_mutex);
+	DropBlocks(firstBlock, blocksCount);
+}
+
+BlockCacheStats BlockCache::GetStats() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_stats;
+}
+
+uint32_t BlockCache::FindSlot(const uint64_t block) const
+{
+	const auto it = m_slotByBlock.find(block);
+	return it == m_slotByBlock.end() ? NO_SLOT : it->second;
+}
+
+uint32_t BlockCache::InsertBlock(const uint64_t block)
+{
+	if (m_freeSlots.empty() && !MakeRoom())
+	{
+		return NO_SLOT;
+	}
+
+	const uint32_t slot = m_freeSlots.back();
+	m_freeSlots.pop_back();
+	m_slots[slot].block = block;
+	m_slots[slot].isDirty = false;
+	m_slotByBlock.emplace(block, slot);
+	PushFront(slot);
+	return slot;
+}
+
+bool BlockCache::LoadRun(const uint64_t firstBlock, const uint32_t blocksCount)
+{
+	// Слоты занимаются до чтения, и данные читаются сразу в них
+	m_runSlots.clear();
+	m_readVectors.clear();
+	for (uint32_t i = 0; i < blocksCount; ++i)
+	{
+		const uint32_t slot = InsertBlock(firstBlock + i);
+		if (slot == NO_SLOT)
+		{
+			break;
+		}
+		m_runSlots.push_back(slot);
+		m_readVectors.push_back({ GetSlotData(slot), BLOCK_SIZE });
+	}
+
+	if (m_runSlots.size() == blocksCount
+		&& m_read(m_readVectors.data(), static_cast<int>(m_readVectors.size()), firstBlock * BLOCK_SIZE))
+	{
+		return true;
+	}
+	for (const uint32_t slot : m_runSlots)
+	{
+		RemoveSlot(slot);
+	}
+	return false;
+}
+
+bool BlockCache::MakeRoom()
+{
+	// Если вытесняемый блок изменён, на диск уходят сразу все изменённые блоки:
+	// соседние сливаются в одну запись, и следующие вытеснения обходятся без записи
+	const uint32_t victim = m_tail;
+	if (m_slots[victim].isDirty && !WriteDirtyBlocks())
+	{
+		return false;
+	}
+	RemoveSlot(victim);
+	return true;
+}
+
+void BlockCache::RemoveSlot(const uint32_t slot)
+{
+	Unlink(slot);
+	m_slotByBlock.erase(m_slots[slot].block);
+	m_slots[slot].isDirty = false;
+	m_freeSlots.push_back(slot);
+}
+
+void BlockCache::Unlink(const uint32_t slot)
+{
+	Slot& entry = m_slots[slot];
+	(entry.prev == NO_SLOT ? m_head : m_slots[entry.prev].next) = entry.next;
+	(entry.next == NO_SLOT ? m_tail : m_slots[entry.next].prev) = entry.prev;
+	entry.prev = entry.next = NO_SLOT;
+}
+
+void BlockCache::PushFront(const uint32_t slot)
+{
+	m_slots[slot].prev = NO_SLOT;
+	m_slots[slot].next = m_head;
+	(m_head == NO_SLOT ? m_tail : m_slots[m_head].prev) = slot;
+	m_head = slot;
+}
+
+void BlockCache::Touch(const uint32_t slot)
+{
+	if (slot != m_head)
+	{
+		Unlink(slot);
+		PushFront(slot);
+	}
+}
+
+char* BlockCache::GetSlotData(const uint32_t slot)
+{
+	return m_data.data() + static_cast<size_t>(slot) * BLOCK_SIZE;
+}
+
+std::vector<uint32_t> BlockCache::CollectSlots(const uint64_t firstBlock, const uint64_t blocksCount, const bool onlyDirty) const
+{
+	// Короткий диапазон дешевле проверить поблочно, длинный - обходом всего кэша
+	std::vector<uint32_t> slots;
+	if (blocksCount <= m_slots.size())
+	{
+		for (uint64_t block = firstBlock; block < firstBlock + blocksCount; ++block)
+		{
+			const uint32_t slot = FindSlot(block);
+			if (slot != NO_SLOT && (!onlyDirty || m_slots[slot].isDirty))
+			{
+				slots.push_back(slot);
+			}
+		}
+		return slots;
+	}
+
+	const uint64_t lastBlock = blocksCount > UINT64_MAX - firstBlock ? UINT64_MAX : firstBlock + blocksCount - 1;
+	for (uint32_t slot = m_head; slot != NO_SLOT; slot = m_slots[slot].next)
+	{
+		if (m_slots[slot].block >= firstBlock && m_slots[slot].block <= lastBlock && (!onlyDirty || m_slots[slot].isDirty))
+		{
+			slots.push_back(slot);
+		}
+	}
+	return slots;
+}
+
+bool BlockCache::WriteDirtyBlocks(const uint64_t firstBlock, const uint64_t blocksCount)
+{
+	std::vector<uint32_t> dirtySlots = CollectSlots(firstBlock, blocksCount, true);
+	std::sort(dirtySlots.begin(), dirtySlots.end(), [this](const uint32_t left, const uint32_t right) {
+		return m_slots[left].block < m_slots[right].block;
+	});
+
+	for (size_t first = 0; first < dirtySlots.size();)
+	{
+		size_t count = 1;
+		while (first + count < dirtySlots.size() && count < m_maxRunBlocks
+			&& m_slots[dirtySlots[first + count]].block == m_slots[dirtySlots[first]].block + count)
+		{
+			count++;
+		}
+		m_writeVectors.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_writeVectors.push_back({ GetSlotData(dirtySlots[first + i]), BLOCK_SIZE });
+		}
+		if (!m_write(m_writeVectors.data(), static_cast<int>(count), m_slots[dirtySlots[first]].block * BLOCK_SIZE))
+		{
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_slots[dirtySlots[first + i]].isDirty = false;
+		}
+		m_stats.writtenBackBlocks += count;
+		first += count;
+	}
+	return true;
+}
+
+void BlockCache::DropBlocks(const uint64_t firstBlock, const uint64_t blocksCount)
+{
+	for (const uint32_t slot : CollectSlots(firstBlock, blocksCount, false))
+	{
+		RemoveSlot(slot);
+	}
+}
+
+uint32_t BlockCache::UpdateReadAhead(const uint64_t firstBlock, const uint64_t endBlock)
+{
+	// Запрос, начинающийся там, где кончился предыдущий, считается последовательным;
+	// окно упреждения удваивается с каждым таким запросом
+	const bool isSequential = firstBlock == m_nextSequentialBlock || firstBlock + 1 == m_nextSequentialBlock;
+	m_nextSequentialBlock = endBlock;
+	if (!isSequential)
+	{
+		m_readAheadBlocks = 0;
+		return 0;
+	}
+	m_readAheadBlocks = m_readAheadBlocks == 0
+		? MIN_READ_AHEAD_BLOCKS
+		: std::min(m_readAheadBlocks * 2, MAX_READ_AHEAD_BLOCKS);
+	return m_readAheadBlocks;
+}
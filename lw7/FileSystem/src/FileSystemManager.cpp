@@ -1,31 +1,45 @@
 #include "FileSystemManager.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
-
-// TODO два пользователя записывают данные - состояние гонки
+#include <mutex>
+#include <unistd.h>
 
 FileSystemManager::~FileSystemManager()
 {
 	CloseImage();
 }
 
-bool FileSystemManager::CreateImage(const std::string& path, const uint64_t totalSize, const uint32_t maxFiles)
+bool FileSystemManager::CreateImage(const std::string& path, const uint64_t totalSize, const uint32_t maxFiles,
+	const bool preallocate)
 {
-	InitializeEmptyStorage(path, totalSize);
+	if (!InitializeEmptyStorage(path, totalSize, preallocate))
+	{
+		return false;
+	}
 
-	m_imageStream.open(path, std::ios::in | std::ios::out | std::ios::binary);
-	if (!m_imageStream.is_open())
+	std::unique_lock metadataLock(m_metadataMutex);
+	m_imageFd = ::open(path.c_str(), O_RDWR);
+	if (m_imageFd == -1)
 	{
 		return false;
 	}
+	m_ioEngine = IoEngine::Create(m_imageFd, m_ioEngineKind, m_ioQueueDepth);
 
 	if (!InitializeSuperblock(maxFiles, totalSize))
 	{
 		return false;
 	}
 
+	CreateJournal();
+	m_journal->Format();
 	InitializeFileTable(maxFiles);
+	InitializeBitmap();
+	WriteBack();
+	CreateBlockCache();
 
 	std::cout << "FS created successfully" << std::endl;
 	return true;
@@ -33,419 +47,2350 @@ bool FileSystemManager::CreateImage(const std::string& path, const uint64_t tota
 
 bool FileSystemManager::OpenImage(const std::string& path)
 {
-	m_imageStream.open(path, std::ios::in | std::ios::out | std::ios::binary);
-	if (!m_imageStream.is_open())
+	std::unique_lock metadataLock(m_metadataMutex);
+	m_imageFd = ::open(path.c_str(), O_RDWR);
+	if (m_imageFd == -1)
 	{
 		return false;
 	}
+	m_ioEngine = IoEngine::Create(m_imageFd, m_ioEngineKind, m_ioQueueDepth);
 
-	ReadSuperblock();
-
-	if (std::memcmp(m_superblock.signature, SIGNATURE, 5) != 0)
+	if (!ReadSuperblock() || std::memcmp(m_superblock.signature, SIGNATURE, 5) != 0)
 	{
 		std::cerr << "Error: Invalid FS signature" << std::endl;
-		m_imageStream.close();
+		m_ioEngine.reset();
+		::close(m_imageFd);
+		m_imageFd = -1;
+		return false;
+	}
+
+	if (m_superblock.version != FS_VERSION)
+	{
+		std::cerr << "Error: Unsupported FS version " << m_superblock.version << std::endl;
+		m_ioEngine.reset();
+		::close(m_imageFd);
+		m_imageFd = -1;
+		return false;
+	}
+
+	CreateJournal();
+	const int replayedCount = m_journal->Recover();
+	if (replayedCount == -1)
+	{
+		m_journal.reset();
+		m_ioEngine.reset();
+		::close(m_imageFd);
+		m_imageFd = -1;
 		return false;
 	}
+	if (replayedCount > 0)
+	{
+		std::cout << "Recovered " << replayedCount << " journal transactions" << std::endl;
+	}
 
 	ReadFileTable();
+	ReadBitmap();
+	CreateBlockCache();
+	m_lastCommit = std::chrono::steady_clock::now();
 	return true;
 }
 
 void FileSystemManager::CloseImage()
 {
-	if (m_imageStream.is_open())
+	std::unique_lock metadataLock(m_metadataMutex);
+	if (m_imageFd != -1)
 	{
 		WriteSuperblock();
-		WriteFileTable();
-		m_imageStream.close();
+		WriteBack();
+		m_journal->Checkpoint();
+		m_journal.reset();
+		m_blockCache.reset();
+		m_ioEngine.reset();
+		::fdatasync(m_imageFd);
+		::close(m_imageFd);
+		m_imageFd = -1;
 	}
 }
 
 bool FileSystemManager::CreateFile(const std::string& name)
 {
-	if (name.empty() || name.length() > MAX_FILENAME)
-	{
-		return false;
-	}
+	return CreateEntry(name, false);
+}
 
-	if (GetFileIndex(name) != -1)
+bool FileSystemManager::RemoveFile(const std::string& name)
+{
+	std::unique_lock<std::shared_mutex> fileLock;
+	const int fileIndex = LockFile(name, fileLock);
+	if (fileIndex == -1)
 	{
-		std::cerr << "Error: File already exists" << std::endl;
 		return false;
 	}
 
-	const int freeEntryIndex = FindFreeFileTableEntry();
-	if (freeEntryIndex == -1)
+	std::unique_lock metadataLock(m_metadataMutex);
+	if (m_fileTable[fileIndex].isDirectory)
 	{
-		std::cerr << "Error: File table is full" << std::endl;
+		std::cerr << "Error: Is a directory" << std::endl;
 		return false;
 	}
-
-	InitializeFileEntry(freeEntryIndex, name);
-
+	ReleaseEntry(fileIndex);
+	CommitIfDue();
 	return true;
 }
 
-bool FileSystemManager::RemoveFile(const std::string& name)
+bool FileSystemManager::CreateDirectory(const std::string& path)
 {
-	const int fileIndex = GetFileIndex(name);
-	if (fileIndex == -1)
-	{
-		return false;
-	}
-	m_fileTable[fileIndex].isUsed = false;
-	WriteFileTable();
-	return true;
+	return CreateEntry(path, true);
 }
 
-bool FileSystemManager::TruncateFile(const std::string& name, const uint64_t newSize)
+bool FileSystemManager::RemoveDirectory(const std::string& path)
 {
-	if (newSize > MAX_FILE_SIZE)
+	// Блокировка берётся, как у файла: слот каталога после удаления может достаться файлу
+	std::unique_lock<std::shared_mutex> fileLock;
+	const int directory = LockFile(path, fileLock);
+	if (directory == -1)
 	{
 		return false;
 	}
 
-	const int fileIndex = GetFileIndex(name);
-	if (fileIndex == -1)
+	std::unique_lock metadataLock(m_metadataMutex);
+	if (!m_fileTable[directory].isDirectory)
 	{
+		std::cerr << "Error: Not a directory" << std::endl;
 		return false;
 	}
-
-	FileEntry& entry = m_fileTable[fileIndex];
-	if (!EnsureSufficientBlocks(entry, newSize))
+	if (m_tree[directory].firstChild != -1)
 	{
+		std::cerr << "Error: Directory is not empty" << std::endl;
 		return false;
 	}
-
-	entry.size = static_cast<uint32_t>(newSize);
-	WriteFileTable();
+	m_directoryIndexByPath.erase(path);
+	ReleaseEntry(directory);
+	CommitIfDue();
 	return true;
 }
 
-int FileSystemManager::ReadData(const std::string& name, char* buffer, const size_t size, const uint64_t offset)
+bool FileSystemManager::Rename(const std::string& from, const std::string& to)
 {
-	const int fileIndex = GetFileIndex(name);
-	if (fileIndex == -1)
+	// Заменяемая запись освобождается, поэтому её блокировка берётся так же, как в RemoveFile
+	std::unique_lock<std::shared_mutex> targetLock;
+	const int lockedTarget = LockFile(to, targetLock);
+
+	std::unique_lock metadataLock(m_metadataMutex);
+	const int source = GetFileIndex(from);
+	uint32_t parent;
+	std::string_view name;
+	if (source == -1 || !SplitPath(to, parent, name))
 	{
-		return -1;
+		return false;
 	}
-
-	const FileEntry& entry = m_fileTable[fileIndex];
-	if (offset >= entry.size)
+	const int target = GetFileIndex(to);
+	if (target != lockedTarget)
 	{
-		return 0;
+		std::cerr << "Error: Rename target changed concurrently" << std::endl;
+		return false;
+	}
+	if (target == source)
+	{
+		return true;
 	}
 
-	size_t bytesToRead = size;
-	if (offset + size > entry.size)
+	FileEntry& entry = m_fileTable[source];
+	if (entry.isDirectory && IsInSubtree(parent, static_cast<uint32_t>(source)))
 	{
-		bytesToRead = entry.size - offset;
+		std::cerr << "Error: Cannot move a directory into itself" << std::endl;
+		return false;
+	}
+	if (target != -1)
+	{
+		const FileEntry& replaced = m_fileTable[target];
+		if (replaced.isDirectory != entry.isDirectory || m_tree[target].firstChild != -1)
+		{
+			std::cerr << "Error: Rename target cannot be replaced" << std::endl;
+			return false;
+		}
+		if (replaced.isDirectory)
+		{
+			m_directoryIndexByPath.erase(to);
+		}
+		ReleaseEntry(target);
 	}
 
-	const uint64_t toReadOffset = m_superblock.dataAreaOffset
-		+ static_cast<uint64_t>(entry.startBlock) * BLOCK_SIZE + offset;
+	// Каталог переносится вместе с поддеревом, меняются только пути его каталогов в индексе
+	UnlinkEntry(source);
+	if (entry.isDirectory)
+	{
+		UpdateDirectoryPaths(static_cast<uint32_t>(source), from, false);
+	}
+	std::memset(entry.name, 0, MAX_FILENAME + 1);
+	std::memcpy(entry.name, name.data(), name.size());
+	entry.parent = parent;
+	LinkEntry(source);
+	if (entry.isDirectory)
+	{
+		UpdateDirectoryPaths(static_cast<uint32_t>(source), to, true);
+	}
+	MarkEntryDirty(source);
+	CommitIfDue();
+	return true;
+}
 
-	m_imageStream.seekg(static_cast<std::streamoff>(toReadOffset), std::ios::beg);
-	m_imageStream.read(buffer, static_cast<std::streamsize>(bytesToRead));
+bool FileSystemManager::TruncateFile(const std::string& name, const uint64_t newSize)
+{
+	std::unique_lock<std::shared_mutex> fileLock;
+	return TruncateEntry(LockFile(name, fileLock), newSize);
+}
 
-	return static_cast<int>(bytesToRead);
+bool FileSystemManager::TruncateFile(const FileId id, const uint64_t newSize)
+{
+	std::unique_lock<std::shared_mutex> fileLock;
+	return TruncateEntry(LockEntry(id, fileLock), newSize);
 }
 
-int FileSystemManager::WriteData(const std::string& name, const char* buffer, const size_t size, const uint64_t offset)
+bool FileSystemManager::TruncateEntry(const int fileIndex, const uint64_t newSize)
 {
-	const int fileIndex = GetFileIndex(name);
-	if (fileIndex == -1)
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory || newSize > MAX_FILE_SIZE)
 	{
-		return -1;
+		return false;
 	}
 
+	std::unique_lock metadataLock(m_metadataMutex);
 	FileEntry& entry = m_fileTable[fileIndex];
-	const uint64_t newSize = std::max(static_cast<uint64_t>(entry.size), offset + size);
-	if (newSize > MAX_FILE_SIZE || !EnsureSufficientBlocks(entry, newSize))
+	const uint64_t oldSize = entry.size;
+	if (newSize == oldSize)
 	{
-		return -1;
+		return true;
 	}
 
-	const uint64_t toWriteOffset = m_superblock.dataAreaOffset
-		+ static_cast<uint64_t>(entry.startBlock) * BLOCK_SIZE + offset;
-
-	m_imageStream.seekp(static_cast<std::streamoff>(toWriteOffset), std::ios::beg);
-	m_imageStream.write(buffer, static_cast<std::streamsize>(size));
-
-	entry.size = static_cast<uint32_t>(newSize);
-	WriteFileTable();
-
-	return static_cast<int>(size);
-}
-
-std::vector<FileEntry> FileSystemManager::GetFileList() const
-{
-	std::vector<FileEntry> result;
-	for (const auto& entry : m_fileTable)
+	// Блоки за концом файла освобождаются: при уменьшении - ставшие лишними, при увеличении - запас,
+	// в котором лежат чужие данные. Новая часть файла остаётся дырой и блоков не занимает
+	const auto oldBlocks = static_cast<uint32_t>(AlignUpToBlockSize(oldSize) / BLOCK_SIZE);
+	const auto newBlocks = static_cast<uint32_t>(AlignUpToBlockSize(newSize) / BLOCK_SIZE);
+	if (!UnmapBlocks(fileIndex, std::min(oldBlocks, newBlocks), UINT32_MAX))
 	{
-		if (entry.isUsed)
-		{
-			result.push_back(entry);
-		}
+		return false;
 	}
-	return result;
-}
-
-bool FileSystemManager::GetFileStat(const std::string& name, FileEntry& entry) const
-{
-	const int fileIndex = GetFileIndex(name);
-	if (fileIndex == -1)
+	if (newSize > oldSize && !ZeroRange(fileIndex, oldSize, std::min(AlignUpToBlockSize(oldSize), newSize) - oldSize))
 	{
 		return false;
 	}
-	entry = m_fileTable[fileIndex];
-	return true;
-}
-
-void FileSystemManager::WriteSuperblock()
-{
-	m_imageStream.seekp(0, std::ios::beg);
-	m_imageStream.write(reinterpret_cast<const char*>(&m_superblock), sizeof(Superblock));
-	m_imageStream.flush();
-}
 
-void FileSystemManager::ReadSuperblock()
-{
-	m_imageStream.seekg(0, std::ios::beg);
-	m_imageStream.read(reinterpret_cast<char*>(&m_superblock), sizeof(Superblock));
+	entry.size = static_cast<uint32_t>(newSize);
+	MarkEntryDirty(fileIndex);
+	CommitIfDue();
+	return true;
 }
 
-void FileSystemManager::WriteFileTable()
+bool FileSystemManager::PunchHole(const std::string& name, const uint64_t offset, const uint64_t length)
 {
-	m_imageStream.seekp(m_superblock.fileTableOffset, std::ios::beg);
-	m_imageStream.write(reinterpret_cast<const char*>(m_fileTable.data()),
-		static_cast<std::streamsize>(m_fileTable.size() * sizeof(FileEntry)));
-	m_imageStream.flush();
+	std::unique_lock<std::shared_mutex> fileLock;
+	return PunchEntryHole(LockFile(name, fileLock), offset, length);
 }
 
-void FileSystemManager::ReadFileTable()
+bool FileSystemManager::PunchHole(const FileId id, const uint64_t offset, const uint64_t length)
 {
-	m_fileTable.resize(m_superblock.maxFiles);
-	m_imageStream.seekg(m_superblock.fileTableOffset, std::ios::beg);
-	m_imageStream.read(reinterpret_cast<char*>(m_fileTable.data()),
-		static_cast<std::streamsize>(m_fileTable.size() * sizeof(FileEntry)));
+	std::unique_lock<std::shared_mutex> fileLock;
+	return PunchEntryHole(LockEntry(id, fileLock), offset, length);
 }
 
-void FileSystemManager::InitializeEmptyStorage(const std::string& path, const uint64_t size)
+bool FileSystemManager::PunchEntryHole(const int fileIndex, const uint64_t offset, const uint64_t length)
 {
-	std::ofstream ofs(path, std::ios::binary | std::ios::out);
-	constexpr char zeroBlock[BLOCK_SIZE] = {};
-
-	const uint64_t blocksNeeded = size / BLOCK_SIZE;
-	for (uint64_t i = 0; i < blocksNeeded; ++i)
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory)
 	{
-		ofs.write(zeroBlock, BLOCK_SIZE);
+		return false;
 	}
 
-	const uint64_t remainder = size % BLOCK_SIZE;
-	if (remainder > 0)
+	const uint64_t size = m_fileTable[fileIndex].size;
+	if (offset >= size || length == 0)
 	{
-		ofs.write(zeroBlock, static_cast<std::streamsize>(remainder));
+		return true;
 	}
-	ofs.close();
-}
+	const uint64_t end = offset + std::min(length, size - offset);
 
-bool FileSystemManager::InitializeSuperblock(const uint32_t maxFiles, const uint64_t totalSize)
-{
-	std::memcpy(m_superblock.signature, SIGNATURE, sizeof(SIGNATURE));
-	m_superblock.version = 1;
-	m_superblock.blockSize = BLOCK_SIZE;
-	m_superblock.maxFiles = maxFiles;
-	m_superblock.fileTableOffset = sizeof(Superblock);
-	m_superblock.dataAreaOffset = AlignUpToBlockSize(maxFiles);
-	if (totalSize < m_superblock.dataAreaOffset)
+	// Целые блоки освобождаются, края диапазона зануляются. Последний блок файла освобождается
+	// целиком: его байты за концом файла не читаются
+	const auto firstWhole = static_cast<uint32_t>(AlignUpToBlockSize(offset) / BLOCK_SIZE);
+	const auto endWhole = static_cast<uint32_t>((end == size ? AlignUpToBlockSize(end) : end) / BLOCK_SIZE);
+	if (firstWhole >= endWhole)
+	{
+		return ZeroRange(fileIndex, offset, end - offset);
+	}
+	const uint64_t wholeBegin = static_cast<uint64_t>(firstWhole) * BLOCK_SIZE;
+	const uint64_t wholeEnd = static_cast<uint64_t>(endWhole) * BLOCK_SIZE;
+	if (!ZeroRange(fileIndex, offset, wholeBegin - offset) || (wholeEnd < end && !ZeroRange(fileIndex, wholeEnd, end - wholeEnd)))
 	{
-		std::cerr << "Error: Image size is too small for metadata" << std::endl;
 		return false;
 	}
-	m_superblock.totalBlocks = (totalSize - m_superblock.dataAreaOffset) / BLOCK_SIZE;
-	WriteSuperblock();
 
-	return true;
-}
-void FileSystemManager::InitializeFileTable(const uint32_t maxFiles)
-{
-	m_fileTable.assign(maxFiles, FileEntry{});
-	for (auto& entry : m_fileTable)
+	std::unique_lock metadataLock(m_metadataMutex);
+	if (!UnmapBlocks(fileIndex, firstWhole, endWhole))
 	{
-		entry.isUsed = false;
+		return false;
 	}
-	WriteFileTable();
+	CommitIfDue();
+	return true;
 }
-void FileSystemManager::InitializeFileEntry(const int freeEntryIndex, const std::string& name)
-{
-	FileEntry& entry = m_fileTable[freeEntryIndex];
-	std::memset(entry.name, 0, MAX_FILENAME + 1);
-	std::strncpy(entry.name, name.c_str(), MAX_FILENAME);
 
-	entry.size = 0;
-	entry.startBlock = 0;
-	entry.blocksCount = 0;
-	entry.isUsed = true;
+int64_t FileSystemManager::SeekData(const std::string& name, const uint64_t offset, const bool isHole) const
+{
+	std::shared_lock<std::shared_mutex> fileLock;
+	return SeekEntryData(LockFile(name, fileLock), offset, isHole);
+}
 
-	WriteFileTable();
+int64_t FileSystemManager::SeekData(const FileId id, const uint64_t offset, const bool isHole) const
+{
+	std::shared_lock<std::shared_mutex> fileLock;
+	return SeekEntryData(LockEntry(id, fileLock), offset, isHole);
 }
 
-int FileSystemManager::FindConsecutiveBlocks(const uint32_t neededBlocks) const
+int64_t FileSystemManager::SeekEntryData(const int fileIndex, const uint64_t offset, const bool isHole) const
 {
-	if (neededBlocks == 0)
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory)
 	{
-		return 0;
+		return -1;
 	}
-	std::vector<bool> blockMap = GetBlockMap();
-	uint32_t consecutiveFound = 0;
-	for (uint32_t blockIndex = 0; blockIndex < m_superblock.totalBlocks; ++blockIndex)
+
+	const uint64_t size = m_fileTable[fileIndex].size;
+	if (offset >= size)
 	{
-		if (!blockMap[blockIndex])
-		{
-			consecutiveFound++;
-			if (consecutiveFound == neededBlocks)
-			{
-				return static_cast<int>(blockIndex - neededBlocks + 1);
-			}
-		}
-		else
-		{
-			consecutiveFound = 0;
-		}
+		return -1;
 	}
 
-	return -1;
-}
-
-int FileSystemManager::FindFreeFileTableEntry() const
-{
-	int freeEntryIndex = -1;
-	for (uint32_t i = 0; i < m_superblock.maxFiles; ++i)
+	// За последним экстентом файл продолжается дырой, а конец файла тоже считается началом дыры
+	uint64_t extentOffset = 0;
+	for (const auto& extent : m_fileExtents[fileIndex].extents)
 	{
-		if (!m_fileTable[i].isUsed)
+		const uint64_t extentEnd = extentOffset + static_cast<uint64_t>(extent.blocksCount) * BLOCK_SIZE;
+		if (extentEnd > offset && (extent.startBlock == NO_BLOCK) == isHole)
 		{
-			freeEntryIndex = static_cast<int>(i);
-			break;
+			const uint64_t found = std::max(extentOffset, offset);
+			return found < size ? static_cast<int64_t>(found) : (isHole ? static_cast<int64_t>(size) : -1);
 		}
+		extentOffset = extentEnd;
 	}
-
-	return freeEntryIndex;
+	return isHole ? static_cast<int64_t>(std::min(size, std::max(extentOffset, offset))) : -1;
 }
 
-int FileSystemManager::GetFileIndex(const std::string& name) const
+int FileSystemManager::ReadData(const std::string& name, char* buffer, const size_t size, const uint64_t offset)
 {
-	for (uint32_t i = 0; i < m_superblock.maxFiles; ++i)
-	{
-		if (m_fileTable[i].isUsed && name == m_fileTable[i].name)
-		{
-			return static_cast<int>(i);
-		}
-	}
-	return -1;
+	std::shared_lock<std::shared_mutex> fileLock;
+	return ReadEntryData(LockFile(name, fileLock), buffer, size, offset);
 }
 
-uint32_t FileSystemManager::AlignUpToBlockSize(const uint32_t maxFiles) const
+int FileSystemManager::ReadData(const FileId id, char* buffer, const size_t size, const uint64_t offset)
 {
-	const uint32_t fileTableSize = maxFiles * sizeof(FileEntry);
-	const uint64_t rawDataOffset = m_superblock.fileTableOffset + fileTableSize;
-	return ((rawDataOffset + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+	std::shared_lock<std::shared_mutex> fileLock;
+	return ReadEntryData(LockEntry(id, fileLock), buffer, size, offset);
 }
 
-std::vector<bool> FileSystemManager::GetBlockMap() const
+int FileSystemManager::ReadEntryData(const int fileIndex, char* buffer, const size_t size, const uint64_t offset)
 {
-	std::vector blockMap(m_superblock.totalBlocks, false);
+	// Запись таблицы и экстенты файла меняются только под исключительной блокировкой файла,
+	// поэтому под разделяемой их можно читать без блокировки метаданных
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory)
+	{
+		return -1;
+	}
 
-	for (const auto& entry : m_fileTable)
+	const FileEntry& entry = m_fileTable[fileIndex];
+	if (offset >= entry.size)
 	{
-		if (entry.isUsed && entry.blocksCount > 0)
-		{
-			for (uint32_t i = 0; i < entry.blocksCount; ++i)
-			{
-				const uint32_t blockIndex = entry.startBlock + i;
-				if (blockIndex < blockMap.size())
+		return 0;
+	}
+
+	size_t bytesToRead = size;
+	if (offset + size > entry.size)
+	{
+		bytesToRead = entry.size - offset;
+	}
+
+	bool isRead = true;
+	if (bytesToRead >= DIRECT_IO_MIN_SIZE)
+	{
+		isRead = TransferDirect(fileIndex, buffer, bytesToRead, offset, false);
+	}
+	else
+	{
+		ForEachDiskRange(fileIndex, offset, bytesToRead,
+			[this, buffer, &isRead](const uint64_t diskOffset, const uint64_t position, const uint64_t length) {
+				if (diskOffset == HOLE_OFFSET)
 				{
-					blockMap[blockIndex] = true;
+					std::memset(buffer + position, 0, length);
+					return;
 				}
-			}
-		}
+				isRead = isRead && ReadDataRange(buffer + position, length, diskOffset);
+			});
 	}
 
-	return blockMap;
+	return isRead ? static_cast<int>(bytesToRead) : -1;
 }
 
-bool FileSystemManager::EnsureSufficientBlocks(FileEntry& entry, const uint64_t newSize)
+int FileSystemManager::WriteData(const std::string& name, const char* buffer, const size_t size, const uint64_t offset)
 {
-	// TODO разделить метод на методы с единственной ответственностью
-	const auto neededBlocks = static_cast<uint32_t>((newSize + BLOCK_SIZE - 1) / BLOCK_SIZE);
-	if (neededBlocks <= entry.blocksCount)
-	{
-		return true;
-	}
+	std::unique_lock<std::shared_mutex> fileLock;
+	return WriteEntryData(LockFile(name, fileLock), buffer, size, offset);
+}
 
-	// TODO увеличивать размер дырки в два раза. сделать более эффективное распределение памяти
-	uint32_t targetBlocks = CalculateTargetBlockCount(entry, neededBlocks);
+int FileSystemManager::WriteData(const FileId id, const char* buffer, const size_t size, const uint64_t offset)
+{
+	std::unique_lock<std::shared_mutex> fileLock;
+	return WriteEntryData(LockEntry(id, fileLock), buffer, size, offset);
+}
 
-	int newStartBlock = FindConsecutiveBlocks(targetBlocks);
-	if (newStartBlock == -1 && targetBlocks > neededBlocks)
+int FileSystemManager::WriteEntryData(const int fileIndex, const char* buffer, const size_t size, const uint64_t offset)
+{
+	const uint64_t end = offset + size;
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory || end > MAX_FILE_SIZE)
 	{
-		targetBlocks = neededBlocks;
-		newStartBlock = FindConsecutiveBlocks(targetBlocks);
+		return -1;
 	}
-
-	if (newStartBlock == -1)
+	if (size == 0)
 	{
-		return false;
+		return 0;
 	}
 
-	if (entry.size > 0)
+	uint64_t writeBegin;
+	uint64_t writeEnd;
+	if (!PrepareWrite(fileIndex, offset, size, writeBegin, writeEnd))
 	{
-		MoveFileData(entry, newStartBlock);
+		return -1;
 	}
 
-	entry.startBlock = static_cast<uint32_t>(newStartBlock);
-	entry.blocksCount = targetBlocks;
+	std::vector<char> padded;
+	const char* source = buffer;
+	if (writeBegin != offset || writeEnd != end)
+	{
+		padded.assign(writeEnd - writeBegin, 0);
+		std::memcpy(padded.data() + (offset - writeBegin), buffer, size);
+		source = padded.data();
+	}
+	bool isWritten = true;
+	const uint64_t writeSize = writeEnd - writeBegin;
+	if (writeSize >= DIRECT_IO_MIN_SIZE)
+	{
+		isWritten = TransferDirect(fileIndex, const_cast<char*>(source), writeSize, writeBegin, true);
+	}
+	else
+	{
+		ForEachDiskRange(fileIndex, writeBegin, writeSize,
+			[this, source, &isWritten](const uint64_t diskOffset, const uint64_t position, const uint64_t length) {
+				isWritten = isWritten && WriteDataRange(source + position, length, diskOffset);
+			});
+	}
 
-	return true;
+	return isWritten ? static_cast<int>(size) : -1;
 }
 
-void FileSystemManager::MoveFileData(const FileEntry& entry, const uint64_t newStartBlock)
+int FileSystemManager::ReadDataDirect(const FileId id, const uint64_t offset, const size_t size, const DataTransfer& transfer)
 {
-	constexpr size_t bufferSize = 1024 * 1024;
-	std::vector<char> tempBuffer(bufferSize);
-
-	const uint64_t oldBaseOffset = m_superblock.dataAreaOffset + (static_cast<uint64_t>(entry.startBlock) * BLOCK_SIZE);
-	const uint64_t newBaseOffset = m_superblock.dataAreaOffset + (static_cast<uint64_t>(newStartBlock) * BLOCK_SIZE);
-
-	for (uint64_t moved = 0; moved < entry.size;)
+	std::shared_lock<std::shared_mutex> fileLock;
+	const int fileIndex = LockEntry(id, fileLock);
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory)
 	{
-		const uint64_t chunk = std::min(static_cast<uint64_t>(bufferSize), static_cast<uint64_t>(entry.size) - moved);
-
-		m_imageStream.seekg(static_cast<std::streamoff>(oldBaseOffset + moved), std::ios::beg);
-		m_imageStream.read(tempBuffer.data(), static_cast<std::streamsize>(chunk));
-
-		m_imageStream.seekp(static_cast<std::streamoff>(newBaseOffset + moved), std::ios::beg);
-		m_imageStream.write(tempBuffer.data(), static_cast<std::streamsize>(chunk));
+		return -1;
+	}
 
-		moved += chunk;
+	const uint64_t fileSize = m_fileTable[fileIndex].size;
+	if (offset >= fileSize || size == 0)
+	{
+		return 0;
 	}
+	const uint64_t bytesToRead = std::min<uint64_t>(size, fileSize - offset);
+	return TransferRanges(fileIndex, offset, bytesToRead, false, transfer) ? static_cast<int>(bytesToRead) : -1;
 }
-uint32_t FileSystemManager::CalculateTargetBlockCount(const FileEntry& entry, const uint32_t neededBlocks)
+
+int FileSystemManager::WriteDataDirect(const FileId id, const uint64_t offset, const size_t size, const DataTransfer& transfer)
 {
-	uint32_t targetBlocks;
-	if (entry.blocksCount == 0)
+	std::unique_lock<std::shared_mutex> fileLock;
+	const int fileIndex = LockEntry(id, fileLock);
+	const uint64_t end = offset + size;
+	if (fileIndex == -1 || m_fileTable[fileIndex].isDirectory || end > MAX_FILE_SIZE)
 	{
-		targetBlocks = 1;
+		return -1;
 	}
-	else
+	if (size == 0)
 	{
-		targetBlocks = entry.blocksCount * 2;
+		return 0;
 	}
-	if (targetBlocks < neededBlocks)
+
+	// Края крайних блоков зануляются через кэш, и TransferRanges отправит их на диск до передачи
+	uint64_t writeBegin;
+	uint64_t writeEnd;
+	if (!PrepareWrite(fileIndex, offset, size, writeBegin, writeEnd)
+		|| !ZeroRange(fileIndex, writeBegin, offset - writeBegin) || !ZeroRange(fileIndex, end, writeEnd - end))
 	{
-		targetBlocks = neededBlocks;
+		return -1;
 	}
+	return TransferRanges(fileIndex, offset, size, true, transfer) ? static_cast<int>(size) : -1;
+}
 
-	return targetBlocks;
-}
\ No newline at end of file
+bool FileSystemManager::RelocateFile(const int fileIndex, uint32_t& moved)
+{
+	// Файл переносится по шагам, блокировки между шагами отпускаются, и каждый шаг планируется по текущей раскладке
+	moved = 0;
+	constexpr auto CHUNK_BLOCKS = static_cast<uint32_t>(COMPACTION_CHUNK_SIZE / BLOCK_SIZE);
+	bool canPark = true;
+	for (;;)
+	{
+		std::unique_lock fileLock(m_fileLocks[static_cast<size_t>(fileIndex) % FILE_LOCK_STRIPES]);
+		std::unique_lock metadataLock(m_metadataMutex);
+		const FileEntry& entry = m_fileTable[fileIndex];
+		if (!entry.isUsed || entry.isDirectory || entry.blocksCount == 0)
+		{
+			return true;
+		}
+
+		// firstBlock - где лежит начало данных файла, prefixBlocks - сколько его блоков идёт оттуда подряд
+		const uint32_t blocksCount = entry.blocksCount;
+		uint32_t firstBlock = NO_BLOCK;
+		uint32_t prefixBlocks = 0;
+		bool isPrefix = true;
+		for (const auto& extent : m_fileExtents[fileIndex].extents)
+		{
+			if (extent.startBlock == NO_BLOCK)
+			{
+				continue;
+			}
+			if (firstBlock == NO_BLOCK)
+			{
+				firstBlock = extent.startBlock;
+			}
+			isPrefix = isPrefix && extent.startBlock == firstBlock + prefixBlocks;
+			prefixBlocks += isPrefix ? extent.blocksCount : 0;
+		}
+
+		// Переносятся блоки данных [firstData, firstData + count) в участок с начала target:
+		// - файл одним участком целиком переезжает ближе к началу, а если места не нашлось -
+		//   его начало сдвигается в свободные блоки прямо перед ним;
+		// - разбросанный файл целиком переезжает в любой подходящий участок, иначе к началу данных
+		//   дописываются следующие блоки. Безопасно сдвинуть за шаг можно не больше блоков, чем свободно
+		//   за началом, поэтому при узком промежутке следующий кусок сначала откладывается в свободное место
+		//   в другой части образа: промежуток расширяется на кусок, и следующим шагом кусок возвращается
+		//   вместе с блоками за ним
+		const Extent whole = FindFreeRun(blocksCount);
+		const bool hasWhole = whole.blocksCount == blocksCount;
+		uint32_t firstData = 0;
+		uint32_t count = 0;
+		uint32_t target = NO_BLOCK;
+		bool isParking = false;
+		if (prefixBlocks == blocksCount)
+		{
+			uint32_t gap = 0;
+			while (gap < blocksCount && gap < firstBlock && ((m_blockBitmap[(firstBlock - gap - 1) / 64] >> ((firstBlock - gap - 1) % 64)) & 1) == 0)
+			{
+				gap++;
+			}
+			count = hasWhole && whole.startBlock < firstBlock ? blocksCount : gap;
+			target = hasWhole && whole.startBlock < firstBlock ? whole.startBlock : firstBlock - gap;
+		}
+		else
+		{
+			const uint32_t remaining = blocksCount - prefixBlocks;
+			const uint32_t extension = CountFreeBlocks(firstBlock + prefixBlocks, remaining);
+			const uint32_t chunk = std::min(remaining, CHUNK_BLOCKS);
+			if (hasWhole && extension < remaining)
+			{
+				count = blocksCount;
+				target = whole.startBlock;
+			}
+			else if (canPark && extension < chunk)
+			{
+				const Extent spare = FindFreeRun(chunk);
+				isParking = spare.blocksCount > extension;
+				firstData = prefixBlocks;
+				count = isParking ? spare.blocksCount : 0;
+				target = spare.startBlock;
+			}
+			if (count == 0)
+			{
+				firstData = prefixBlocks;
+				count = extension;
+				target = firstBlock + prefixBlocks;
+			}
+		}
+		if (count == 0)
+		{
+			return true;
+		}
+		if (!MoveDataBlocks(fileIndex, firstData, count, target, metadataLock))
+		{
+			return false;
+		}
+		moved += count;
+		canPark = !isParking;
+	}
+}
+
+bool FileSystemManager::MoveDataBlocks(const int fileIndex, const uint32_t firstData, const uint32_t count, const uint32_t target,
+	std::unique_lock<std::shared_mutex>& metadataLock)
+{
+	MarkBlocks(target, count, true);
+
+	// Данные копируются без блокировки метаданных: раскладку файла меняют только под блокировкой файла,
+	// а целевой участок уже занят. Изменённые в кэше блоки файла сначала уходят на диск
+	const std::vector<Extent> extents = m_fileExtents[fileIndex].extents;
+	metadataLock.unlock();
+	std::vector<char> buffer(std::min<uint64_t>(COMPACTION_CHUNK_SIZE, static_cast<uint64_t>(count) * BLOCK_SIZE));
+	std::vector<Extent> relocated;
+	std::vector<Extent> released;
+	uint32_t dataIndex = 0;
+	bool isCopied = true;
+	for (const auto& extent : extents)
+	{
+		const uint32_t begin = std::max(dataIndex, firstData);
+		const uint32_t end = std::min(dataIndex + extent.blocksCount, firstData + count);
+		if (extent.startBlock == NO_BLOCK || begin >= end)
+		{
+			relocated.push_back(extent);
+			dataIndex += extent.startBlock == NO_BLOCK ? 0 : extent.blocksCount;
+			continue;
+		}
+
+		const Extent source{ extent.startBlock + begin - dataIndex, end - begin };
+		const uint32_t destination = target + begin - firstData;
+		isCopied = isCopied
+			&& (!m_blockCache || m_blockCache->FlushRange(GetBlockOffset(source.startBlock) / BLOCK_SIZE, source.blocksCount))
+			&& CopyBlocks(source.startBlock, destination, source.blocksCount, buffer);
+		if (begin > dataIndex)
+		{
+			relocated.push_back({ extent.startBlock, begin - dataIndex });
+		}
+		relocated.push_back({ destination, source.blocksCount });
+		if (end < dataIndex + extent.blocksCount)
+		{
+			relocated.push_back({ extent.startBlock + end - dataIndex, dataIndex + extent.blocksCount - end });
+		}
+		released.push_back(source);
+		dataIndex += extent.blocksCount;
+	}
+	// Копия ложится на носитель раньше, чем журнал начнёт на неё ссылаться
+	isCopied = isCopied && ::fdatasync(m_imageFd) == 0;
+
+	metadataLock.lock();
+	InvalidateCachedBlocks(target, count);
+	NormalizeExtents(relocated);
+	if (!isCopied || !UpdateLayout(fileIndex, 0, extents.size(), relocated, {}))
+	{
+		MarkBlocks(target, count, false);
+		return false;
+	}
+	// Старые блоки освобождаются только после того, как новая раскладка дошла до носителя.
+	// Иначе их могли бы отдать другому файлу, и после сбоя файл остался бы со старой раскладкой и чужими данными.
+	// Если зафиксировать не удалось, они так и остаются занятыми
+	if (!WriteBack() || ::fdatasync(m_imageFd) != 0)
+	{
+		std::cerr << "Error: Cannot commit relocated file" << std::endl;
+		return false;
+	}
+	for (const auto& run : released)
+	{
+		MarkBlocks(run.startBlock, run.blocksCount, false);
+		InvalidateCachedBlocks(run.startBlock, run.blocksCount);
+	}
+	return true;
+}
+
+bool FileSystemManager::CopyBlocks(const uint32_t from, const uint32_t to, const uint32_t blocksCount, std::vector<char>& buffer) const
+{
+	// Участки не пересекаются: целевой был свободен
+	const uint64_t size = static_cast<uint64_t>(blocksCount) * BLOCK_SIZE;
+	for (uint64_t done = 0; done < size; done += buffer.size())
+	{
+		const size_t chunk = std::min<uint64_t>(buffer.size(), size - done);
+		if (!ReadAt(buffer.data(), chunk, GetBlockOffset(from) + done) || !WriteAt(buffer.data(), chunk, GetBlockOffset(to) + done))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FileSystemManager::PrepareWrite(const int fileIndex, const uint64_t offset, const uint64_t size,
+	uint64_t& writeBegin, uint64_t& writeEnd)
+{
+	FileEntry& entry = m_fileTable[fileIndex];
+	const uint64_t oldSize = entry.size;
+	const uint64_t end = offset + size;
+	const uint64_t newSize = std::max(oldSize, end);
+
+	// Блоки из дыр и блоки за концом файла хранят чужие данные, поэтому недописанные части крайних
+	// блоков записи заполняются нулями. Целые блоки между старым концом и записью становятся дырой
+	const auto firstBlock = static_cast<uint32_t>(offset / BLOCK_SIZE);
+	const auto endBlock = static_cast<uint32_t>(AlignUpToBlockSize(end) / BLOCK_SIZE);
+	const auto validBlocks = static_cast<uint32_t>(AlignUpToBlockSize(oldSize) / BLOCK_SIZE);
+	writeBegin = offset;
+	if (firstBlock >= validBlocks || !IsRangeMapped(fileIndex, firstBlock, firstBlock + 1))
+	{
+		writeBegin = static_cast<uint64_t>(firstBlock) * BLOCK_SIZE;
+	}
+	else if (offset > oldSize)
+	{
+		writeBegin = oldSize;
+	}
+	writeEnd = end;
+	if (endBlock > validBlocks || !IsRangeMapped(fileIndex, endBlock - 1, endBlock))
+	{
+		writeEnd = static_cast<uint64_t>(endBlock) * BLOCK_SIZE;
+	}
+
+	// Блоки и размер меняются под блокировкой метаданных, сами данные пишутся уже без неё
+	const bool isMapped = IsRangeMapped(fileIndex, firstBlock, endBlock);
+	if (!isMapped || newSize != oldSize)
+	{
+		std::unique_lock metadataLock(m_metadataMutex);
+		const bool isGrowing = newSize > oldSize;
+		if ((firstBlock > validBlocks && !UnmapBlocks(fileIndex, validBlocks, firstBlock))
+			|| (!isMapped && !MapBlocks(fileIndex, firstBlock, endBlock, isGrowing)
+				&& !(isGrowing && MapBlocks(fileIndex, firstBlock, endBlock, false))))
+		{
+			return false;
+		}
+		entry.size = static_cast<uint32_t>(newSize);
+		MarkEntryDirty(fileIndex);
+		CommitIfDue();
+	}
+
+	return firstBlock < validBlocks || oldSize % BLOCK_SIZE == 0
+		|| ZeroRange(fileIndex, oldSize, AlignUpToBlockSize(oldSize) - oldSize);
+}
+
+std::vector<FileEntry> FileSystemManager::GetFileList() const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	std::vector<FileEntry> result;
+	for (const auto& entry : m_fileTable)
+	{
+		if (entry.isUsed)
+		{
+			result.push_back(entry);
+		}
+	}
+	return result;
+}
+
+bool FileSystemManager::GetFileStat(const std::string& name, FileEntry& entry) const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	const int fileIndex = GetFileIndex(name);
+	if (fileIndex == -1)
+	{
+		return false;
+	}
+	entry = m_fileTable[fileIndex];
+	return true;
+}
+
+bool FileSystemManager::ReadDirectory(const std::string& path, std::vector<std::string>& names) const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	uint32_t directory;
+	if (m_imageFd == -1 || !GetDirectoryIndex(path, directory))
+	{
+		return false;
+	}
+
+	names.clear();
+	for (int child = m_tree[GetTreeSlot(directory)].firstChild; child != -1; child = m_tree[child].nextSibling)
+	{
+		names.emplace_back(GetEntryName(m_fileTable[child]));
+	}
+	return true;
+}
+
+FileSystemManager::FileId FileSystemManager::Lookup(const FileId parent, const std::string_view name, FileEntry& entry) const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	uint32_t directory;
+	if (!ResolveDirectory(parent, directory))
+	{
+		return NO_ID;
+	}
+	const auto it = m_fileIndexByKey.find(EntryKeyView{ directory, name });
+	if (it == m_fileIndexByKey.end())
+	{
+		return NO_ID;
+	}
+	entry = m_fileTable[it->second];
+	return GetFileId(it->second);
+}
+
+bool FileSystemManager::GetFileStat(const FileId id, FileEntry& entry) const
+{
+	if (id == ROOT_ID)
+	{
+		entry = FileEntry{};
+		entry.isDirectory = true;
+		entry.isUsed = true;
+		return true;
+	}
+	std::shared_lock metadataLock(m_metadataMutex);
+	const int fileIndex = GetEntryIndex(id);
+	if (fileIndex == -1)
+	{
+		return false;
+	}
+	entry = m_fileTable[fileIndex];
+	return true;
+}
+
+bool FileSystemManager::GetPath(const FileId id, std::string& path) const
+{
+	path.clear();
+	if (id == ROOT_ID)
+	{
+		return true;
+	}
+	std::shared_lock metadataLock(m_metadataMutex);
+	const int fileIndex = GetEntryIndex(id);
+	if (fileIndex == -1)
+	{
+		return false;
+	}
+
+	// Имена собираются от записи к корню, а потом переставляются в обратном порядке
+	std::vector<std::string_view> names;
+	for (auto entry = static_cast<uint32_t>(fileIndex); entry != ROOT_DIRECTORY; entry = m_fileTable[entry].parent)
+	{
+		names.push_back(GetEntryName(m_fileTable[entry]));
+	}
+	for (auto it = names.rbegin(); it != names.rend(); ++it)
+	{
+		if (!path.empty())
+		{
+			path += '/';
+		}
+		path += *it;
+	}
+	return true;
+}
+
+bool FileSystemManager::ReadDirectory(const FileId directory, std::vector<DirectoryEntry>& entries) const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	uint32_t directoryIndex;
+	if (m_imageFd == -1 || !ResolveDirectory(directory, directoryIndex))
+	{
+		return false;
+	}
+
+	entries.clear();
+	for (int child = m_tree[GetTreeSlot(directoryIndex)].firstChild; child != -1; child = m_tree[child].nextSibling)
+	{
+		entries.push_back({ std::string(GetEntryName(m_fileTable[child])), GetFileId(child), m_fileTable[child].isDirectory });
+	}
+	return true;
+}
+
+int64_t FileSystemManager::Compact(uint32_t* passes)
+{
+	if (m_imageFd == -1)
+	{
+		return -1;
+	}
+
+	// Сначала у всех файлов освобождается запас за концом: он занимает место, но данных не хранит.
+	// Слот мог достаться другому файлу, пока ждали его блокировку, но освобождать запас можно у любого
+	for (size_t fileIndex = 0; fileIndex < m_fileTable.size(); ++fileIndex)
+	{
+		std::unique_lock fileLock(m_fileLocks[fileIndex % FILE_LOCK_STRIPES]);
+		std::unique_lock metadataLock(m_metadataMutex);
+		const FileEntry& entry = m_fileTable[fileIndex];
+		if (entry.isUsed && !entry.isDirectory
+			&& !UnmapBlocks(static_cast<int>(fileIndex), static_cast<uint32_t>(AlignUpToBlockSize(entry.size) / BLOCK_SIZE), UINT32_MAX))
+		{
+			return -1;
+		}
+		CommitIfDue();
+	}
+	// Запас становится свободным местом только после фиксации его освобождения
+	{
+		std::unique_lock metadataLock(m_metadataMutex);
+		if (!WriteBack())
+		{
+			return -1;
+		}
+	}
+
+	// Файлы обходятся от начала области данных: каждый сдвигается к уже уплотнённым перед ним,
+	// и промежутки собираются в свободный конец. Перенос не отодвигает файл одним участком дальше от начала,
+	// поэтому проходы повторяются, пока что-то меняется, и когда-нибудь заканчиваются
+	int64_t movedBlocks = 0;
+	if (passes != nullptr)
+	{
+		*passes = 0;
+	}
+	for (bool isMoved = true; isMoved;)
+	{
+		std::vector<std::pair<uint32_t, int>> order;
+		{
+			std::shared_lock metadataLock(m_metadataMutex);
+			for (size_t fileIndex = 0; fileIndex < m_fileTable.size(); ++fileIndex)
+			{
+				uint32_t lowestBlock = NO_BLOCK;
+				for (const auto& extent : m_fileExtents[fileIndex].extents)
+				{
+					lowestBlock = std::min(lowestBlock, extent.startBlock);
+				}
+				if (lowestBlock != NO_BLOCK)
+				{
+					order.emplace_back(lowestBlock, static_cast<int>(fileIndex));
+				}
+			}
+		}
+		std::sort(order.begin(), order.end());
+
+		isMoved = false;
+		for (const auto& [lowestBlock, fileIndex] : order)
+		{
+			uint32_t moved = 0;
+			if (!RelocateFile(fileIndex, moved))
+			{
+				return -1;
+			}
+			movedBlocks += moved;
+			isMoved = isMoved || moved != 0;
+		}
+		if (isMoved && passes != nullptr)
+		{
+			++*passes;
+		}
+	}
+	return movedBlocks;
+}
+
+FragmentationStats FileSystemManager::GetFragmentationStats() const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	FragmentationStats stats;
+	if (m_imageFd == -1)
+	{
+		return stats;
+	}
+
+	// Биты за последним блоком заняты, поэтому участок не выходит за область данных
+	uint32_t runLength = 0;
+	const auto closeRun = [&stats, &runLength] {
+		if (runLength != 0)
+		{
+			stats.freeRuns++;
+			stats.largestFreeRun = std::max(stats.largestFreeRun, runLength);
+			runLength = 0;
+		}
+	};
+	for (uint64_t block = 0; block < m_superblock.totalBlocks;)
+	{
+		const uint32_t bit = block % 64;
+		const uint64_t rest = m_blockBitmap[block / 64] >> bit;
+		if ((rest & 1) != 0)
+		{
+			closeRun();
+			block += std::countr_one(rest);
+			continue;
+		}
+		const uint32_t freeBits = rest == 0 ? 64 - bit : std::countr_zero(rest);
+		stats.freeBlocks += freeBits;
+		runLength += freeBits;
+		block += freeBits;
+	}
+	closeRun();
+
+	for (size_t fileIndex = 0; fileIndex < m_fileTable.size(); ++fileIndex)
+	{
+		const FileEntry& entry = m_fileTable[fileIndex];
+		if (!entry.isUsed || entry.isDirectory)
+		{
+			continue;
+		}
+		stats.files++;
+		const auto sizeBlocks = static_cast<uint32_t>(AlignUpToBlockSize(entry.size) / BLOCK_SIZE);
+		uint32_t position = 0;
+		uint32_t expectedBlock = NO_BLOCK;
+		uint32_t runs = 0;
+		for (const auto& extent : m_fileExtents[fileIndex].extents)
+		{
+			if (extent.startBlock != NO_BLOCK)
+			{
+				stats.dataExtents++;
+				// Дыры между экстентами не мешают данным лежать в образе одним участком
+				runs += extent.startBlock != expectedBlock ? 1 : 0;
+				expectedBlock = extent.startBlock + extent.blocksCount;
+				if (position + extent.blocksCount > sizeBlocks)
+				{
+					stats.tailBlocks += position + extent.blocksCount - std::max(position, sizeBlocks);
+				}
+			}
+			position += extent.blocksCount;
+		}
+		stats.fragmentedFiles += runs > 1 ? 1 : 0;
+	}
+	return stats;
+}
+
+void FileSystemManager::SetCommitInterval(const std::chrono::milliseconds interval)
+{
+	std::unique_lock metadataLock(m_metadataMutex);
+	m_commitInterval = interval;
+	CommitIfDue();
+}
+
+bool FileSystemManager::Sync()
+{
+	std::unique_lock metadataLock(m_metadataMutex);
+	if (m_imageFd == -1)
+	{
+		return false;
+	}
+	const bool isWritten = WriteBack();
+	const int imageFd = m_imageFd;
+	metadataLock.unlock();
+	if (::fdatasync(imageFd) != 0)
+	{
+		std::cerr << "Error: Cannot sync image" << std::endl;
+		return false;
+	}
+	return isWritten;
+}
+
+bool FileSystemManager::WriteBack()
+{
+	if (m_imageFd == -1)
+	{
+		return false;
+	}
+	// Метаданные не должны ссылаться на блоки, данные которых не дошли до образа:
+	// после сбоя файл показал бы то, что лежало в них у прежнего владельца
+	if (m_blockCache && !m_blockCache->Flush())
+	{
+		std::cerr << "Error: Cannot flush block cache" << std::endl;
+		return false;
+	}
+	// Все изменения метаданных с прошлой фиксации уходят в журнал одной транзакцией.
+	// Отложенные блоки освобождаются в той же транзакции, а занять их можно только после её фиксации
+	StageDirtyEntries();
+	for (const auto& run : m_pendingFreeBlocks)
+	{
+		MarkBlocks(run.startBlock, run.blocksCount, false);
+	}
+	StageDirtyBitmap();
+	if (!m_journal->Commit())
+	{
+		for (const auto& run : m_pendingFreeBlocks)
+		{
+			MarkBlocks(run.startBlock, run.blocksCount, true);
+		}
+		return false;
+	}
+	m_pendingFreeBlocks.clear();
+	m_lastCommit = std::chrono::steady_clock::now();
+	return true;
+}
+
+void FileSystemManager::CommitIfDue()
+{
+	// Изменения метаданных копятся в памяти и отдаются ядру не чаще раза в m_commitInterval.
+	// На носитель их гарантированно переносит только Sync. Транзакция фиксируется и раньше,
+	// если иначе она переросла бы половину журнала
+	if (std::chrono::steady_clock::now() - m_lastCommit >= m_commitInterval
+		|| EstimateTransactionSize() >= m_journal->GetCapacity() / 2)
+	{
+		WriteBack();
+	}
+}
+
+void FileSystemManager::CreateJournal()
+{
+	const uint64_t imageEnd = GetBlockOffset(m_superblock.totalBlocks);
+	m_journal = std::make_unique<Journal>(m_superblock.journalOffset, m_superblock.journalBlocks,
+		m_superblock.fileTableOffset, imageEnd,
+		[this](void* buffer, const size_t size, const uint64_t offset) {
+			return ReadAt(buffer, size, offset);
+		},
+		[this](const void* buffer, const size_t size, const uint64_t offset) {
+			return WriteAt(buffer, size, offset);
+		},
+		[this] {
+			return ::fdatasync(m_imageFd) == 0;
+		});
+}
+
+size_t FileSystemManager::EstimateTransactionSize() const
+{
+	return m_journal->GetStagedSize()
+		+ m_dirtyEntries.size() * (sizeof(JournalRecord) + sizeof(FileEntry))
+		+ m_dirtyOverflowBlocks * (sizeof(JournalRecord) + BLOCK_SIZE)
+		+ m_dirtyBitmapChunks.size() * (sizeof(JournalRecord) + BITMAP_CHUNK_WORDS * sizeof(uint64_t));
+}
+
+bool FileSystemManager::ReadAt(void* buffer, const size_t size, const uint64_t offset) const
+{
+	iovec vector{ buffer, size };
+	return ReadVectorAt(&vector, 1, offset);
+}
+
+bool FileSystemManager::WriteAt(const void* buffer, const size_t size, const uint64_t offset) const
+{
+	iovec vector{ const_cast<void*>(buffer), size };
+	return WriteVectorAt(&vector, 1, offset);
+}
+
+bool FileSystemManager::ReadVectorAt(iovec* vectors, const int count, const uint64_t offset) const
+{
+	IoRequest request{ vectors, count, offset, false };
+	return m_ioEngine->Execute(&request, 1);
+}
+
+bool FileSystemManager::WriteVectorAt(iovec* vectors, const int count, const uint64_t offset) const
+{
+	IoRequest request{ vectors, count, offset, true };
+	return m_ioEngine->Execute(&request, 1);
+}
+
+void FileSystemManager::SetBlockCacheSize(const size_t blocks)
+{
+	std::unique_lock metadataLock(m_metadataMutex);
+	m_blockCacheBlocks = blocks;
+}
+
+BlockCacheStats FileSystemManager::GetBlockCacheStats() const
+{
+	std::shared_lock metadataLock(m_metadataMutex);
+	return m_blockCache ? m_blockCache->GetStats() : BlockCacheStats{};
+}
+
+void FileSystemManager::SetIoEngine(const IoEngineKind kind, const uint32_t queueDepth)
+{
+	std::unique_lock metadataLock(m_metadataMutex);
+	m_ioEngineKind = kind;
+	m_ioQueueDepth = queueDepth;
+}
+
+void FileSystemManager::CreateBlockCache()
+{
+	m_blockCache.reset();
+	if (m_blockCacheBlocks == 0)
+	{
+		return;
+	}
+	const uint64_t blocksLimit = m_superblock.dataAreaOffset / BLOCK_SIZE + m_superblock.totalBlocks;
+	m_blockCache = std::make_unique<BlockCache>(m_blockCacheBlocks, blocksLimit,
+		[this](iovec* vectors, const int count, const uint64_t offset) {
+			return ReadVectorAt(vectors, count, offset);
+		},
+		[this](iovec* vectors, const int count, const uint64_t offset) {
+			return WriteVectorAt(vectors, count, offset);
+		});
+}
+
+bool FileSystemManager::ReadDataRange(void* buffer, const size_t size, const uint64_t offset)
+{
+	return m_blockCache ? m_blockCache->Read(buffer, size, offset) : ReadAt(buffer, size, offset);
+}
+
+bool FileSystemManager::WriteDataRange(const void* buffer, const size_t size, const uint64_t offset)
+{
+	return m_blockCache ? m_blockCache->Write(buffer, size, offset) : WriteAt(buffer, size, offset);
+}
+
+void FileSystemManager::InvalidateCachedBlocks(const uint32_t firstBlock, const uint32_t blocksCount)
+{
+	if (m_blockCache)
+	{
+		m_blockCache->Invalidate(GetBlockOffset(firstBlock) / BLOCK_SIZE, blocksCount);
+	}
+}
+
+bool FileSystemManager::TransferDirect(const int fileIndex, char* buffer, const uint64_t size, const uint64_t offset, const bool isWrite)
+{
+	return TransferRanges(fileIndex, offset, size, isWrite,
+		[this, buffer, isWrite](int, const std::vector<DataRange>& ranges) {
+			std::vector<iovec> vectors;
+			std::vector<IoRequest> requests;
+			uint64_t position = 0;
+			for (const auto& [imageOffset, length] : ranges)
+			{
+				// Запись идёт только в выделенные блоки, а дыры при чтении просто заполняются нулями
+				if (imageOffset == HOLE_OFFSET)
+				{
+					if (!isWrite)
+					{
+						std::memset(buffer + position, 0, length);
+					}
+				}
+				else
+				{
+					for (uint64_t chunk = 0; chunk < length; chunk += IO_CHUNK_SIZE)
+					{
+						vectors.push_back({ buffer + position + chunk, std::min(IO_CHUNK_SIZE, length - chunk) });
+						requests.push_back({ nullptr, 1, imageOffset + chunk, isWrite });
+					}
+				}
+				position += length;
+			}
+			for (size_t i = 0; i < requests.size(); ++i)
+			{
+				requests[i].vectors = &vectors[i];
+			}
+			return m_ioEngine->Execute(requests.data(), requests.size());
+		});
+}
+
+bool FileSystemManager::TransferRanges(const int fileIndex, const uint64_t offset, const uint64_t size, const bool isWrite,
+	const DataTransfer& transfer)
+{
+	std::vector<DataRange> ranges;
+	ForEachDiskRange(fileIndex, offset, size,
+		[&ranges](const uint64_t diskOffset, uint64_t, const uint64_t length) {
+			ranges.push_back({ diskOffset, length });
+		});
+	if (!m_blockCache)
+	{
+		return transfer(m_imageFd, ranges);
+	}
+
+	// Изменённые блоки диапазона уходят на диск до передачи. После записи диапазон выбрасывается ещё раз:
+	// упреждающее чтение соседнего файла могло успеть подгрузить в кэш старое содержимое
+	std::vector<std::pair<uint64_t, uint64_t>> blockRanges;
+	for (const auto& [imageOffset, length] : ranges)
+	{
+		if (imageOffset != HOLE_OFFSET)
+		{
+			const uint64_t firstBlock = imageOffset / BLOCK_SIZE;
+			blockRanges.emplace_back(firstBlock, (imageOffset + length + BLOCK_SIZE - 1) / BLOCK_SIZE - firstBlock);
+		}
+	}
+	for (const auto& [firstBlock, blocksCount] : blockRanges)
+	{
+		if (!(isWrite ? m_blockCache->Evict(firstBlock, blocksCount) : m_blockCache->FlushRange(firstBlock, blocksCount)))
+		{
+			return false;
+		}
+	}
+	const bool isDone = transfer(m_imageFd, ranges);
+	if (isWrite)
+	{
+		for (const auto& [firstBlock, blocksCount] : blockRanges)
+		{
+			m_blockCache->Invalidate(firstBlock, blocksCount);
+		}
+	}
+	return isDone;
+}
+
+template <typename FileLock>
+int FileSystemManager::LockFile(const std::string& name, FileLock& fileLock) const
+{
+	// Пока ждём блокировку файла, его могут удалить и отдать слот другому файлу,
+	// поэтому после её получения индекс проверяется ещё раз
+	while (true)
+	{
+		int fileIndex;
+		{
+			std::shared_lock metadataLock(m_metadataMutex);
+			fileIndex = GetFileIndex(name);
+		}
+		if (fileIndex == -1)
+		{
+			return -1;
+		}
+
+		fileLock = FileLock(m_fileLocks[static_cast<size_t>(fileIndex) % FILE_LOCK_STRIPES]);
+		std::shared_lock metadataLock(m_metadataMutex);
+		if (GetFileIndex(name) == fileIndex)
+		{
+			return fileIndex;
+		}
+		fileLock.unlock();
+	}
+}
+
+template <typename FileLock>
+int FileSystemManager::LockEntry(const FileId id, FileLock& fileLock) const
+{
+	// Слот записан в самом идентификаторе, поэтому искать его заново не нужно:
+	// после получения блокировки достаточно убедиться, что запись не удалили
+	const uint64_t slot = id & UINT32_MAX;
+	if (slot < FIRST_ENTRY_SLOT)
+	{
+		return -1;
+	}
+	fileLock = FileLock(m_fileLocks[(slot - FIRST_ENTRY_SLOT) % FILE_LOCK_STRIPES]);
+	std::shared_lock metadataLock(m_metadataMutex);
+	return GetEntryIndex(id);
+}
+
+int FileSystemManager::GetEntryIndex(const FileId id) const
+{
+	const uint64_t slot = id & UINT32_MAX;
+	if (slot < FIRST_ENTRY_SLOT || slot - FIRST_ENTRY_SLOT >= m_fileTable.size())
+	{
+		return -1;
+	}
+	const auto fileIndex = static_cast<size_t>(slot - FIRST_ENTRY_SLOT);
+	if (!m_fileTable[fileIndex].isUsed || m_generations[fileIndex] != id >> 32)
+	{
+		return -1;
+	}
+	return static_cast<int>(fileIndex);
+}
+
+FileSystemManager::FileId FileSystemManager::GetFileId(const int fileIndex) const
+{
+	return (static_cast<FileId>(m_generations[fileIndex]) << 32) | (static_cast<FileId>(fileIndex) + FIRST_ENTRY_SLOT);
+}
+
+bool FileSystemManager::ResolveDirectory(const FileId id, uint32_t& directory) const
+{
+	if (id == ROOT_ID)
+	{
+		directory = ROOT_DIRECTORY;
+		return true;
+	}
+	const int fileIndex = GetEntryIndex(id);
+	if (fileIndex == -1 || !m_fileTable[fileIndex].isDirectory)
+	{
+		return false;
+	}
+	directory = static_cast<uint32_t>(fileIndex);
+	return true;
+}
+
+void FileSystemManager::WriteSuperblock()
+{
+	WriteAt(&m_superblock, sizeof(Superblock), 0);
+}
+
+bool FileSystemManager::ReadSuperblock()
+{
+	return ReadAt(&m_superblock, sizeof(Superblock), 0);
+}
+
+void FileSystemManager::StageDirtyEntries()
+{
+	// Соседние изменённые записи попадают в журнал одной записью
+	std::sort(m_dirtyEntries.begin(), m_dirtyEntries.end());
+	for (const uint32_t entry : m_dirtyEntries)
+	{
+		StageOverflowBlocks(static_cast<int>(entry));
+	}
+	for (size_t first = 0; first < m_dirtyEntries.size();)
+	{
+		size_t last = first;
+		while (last + 1 < m_dirtyEntries.size() && m_dirtyEntries[last + 1] == m_dirtyEntries[last] + 1)
+		{
+			last++;
+		}
+
+		const uint32_t firstEntry = m_dirtyEntries[first];
+		const uint64_t entryOffset = m_superblock.fileTableOffset + static_cast<uint64_t>(firstEntry) * sizeof(FileEntry);
+		m_journal->Stage(entryOffset, &m_fileTable[firstEntry], (last - first + 1) * sizeof(FileEntry));
+		first = last + 1;
+	}
+
+	for (const uint32_t entry : m_dirtyEntries)
+	{
+		m_isEntryDirty[entry] = false;
+	}
+	m_dirtyEntries.clear();
+}
+
+void FileSystemManager::MarkEntryDirty(const int fileIndex)
+{
+	if (!m_isEntryDirty[fileIndex])
+	{
+		m_isEntryDirty[fileIndex] = true;
+		m_dirtyEntries.push_back(static_cast<uint32_t>(fileIndex));
+	}
+}
+
+void FileSystemManager::ReadFileTable()
+{
+	m_fileTable.resize(m_superblock.maxFiles);
+	ReadAt(m_fileTable.data(), m_fileTable.size() * sizeof(FileEntry), m_superblock.fileTableOffset);
+
+	m_fileExtents.assign(m_superblock.maxFiles, {});
+	m_generations.assign(m_superblock.maxFiles, 0);
+	m_isEntryDirty.assign(m_superblock.maxFiles, false);
+	m_dirtyEntries.clear();
+	m_dirtyOverflowBlocks = 0;
+	for (uint32_t i = 0; i < m_superblock.maxFiles; ++i)
+	{
+		if (m_fileTable[i].isUsed)
+		{
+			ReadExtents(static_cast<int>(i));
+		}
+	}
+	BuildFileIndex();
+}
+
+void FileSystemManager::ReadBitmap()
+{
+	m_blockBitmap.resize(m_superblock.bitmapWords);
+	ReadAt(m_blockBitmap.data(), m_blockBitmap.size() * sizeof(uint64_t), m_superblock.bitmapOffset);
+
+	m_firstFreeWord = 0;
+	while (m_firstFreeWord < m_blockBitmap.size() && m_blockBitmap[m_firstFreeWord] == ~0ULL)
+	{
+		m_firstFreeWord++;
+	}
+	m_isBitmapChunkDirty.assign((m_blockBitmap.size() + BITMAP_CHUNK_WORDS - 1) / BITMAP_CHUNK_WORDS, false);
+	m_dirtyBitmapChunks.clear();
+	m_pendingFreeBlocks.clear();
+}
+
+void FileSystemManager::StageDirtyBitmap()
+{
+	// В журнал попадают только куски карты, изменённые с прошлой фиксации; соседние - одной записью
+	std::sort(m_dirtyBitmapChunks.begin(), m_dirtyBitmapChunks.end());
+	for (size_t first = 0; first < m_dirtyBitmapChunks.size();)
+	{
+		size_t last = first;
+		while (last + 1 < m_dirtyBitmapChunks.size() && m_dirtyBitmapChunks[last + 1] == m_dirtyBitmapChunks[last] + 1)
+		{
+			last++;
+		}
+
+		const size_t firstWord = m_dirtyBitmapChunks[first] * BITMAP_CHUNK_WORDS;
+		const size_t endWord = std::min<size_t>((m_dirtyBitmapChunks[last] + 1) * BITMAP_CHUNK_WORDS, m_blockBitmap.size());
+		m_journal->Stage(m_superblock.bitmapOffset + firstWord * sizeof(uint64_t),
+			m_blockBitmap.data() + firstWord, (endWord - firstWord) * sizeof(uint64_t));
+		first = last + 1;
+	}
+
+	for (const uint32_t chunk : m_dirtyBitmapChunks)
+	{
+		m_isBitmapChunkDirty[chunk] = false;
+	}
+	m_dirtyBitmapChunks.clear();
+}
+
+void FileSystemManager::MarkBitmapDirty(const size_t firstWord, const size_t endWord)
+{
+	for (size_t chunk = firstWord / BITMAP_CHUNK_WORDS; chunk * BITMAP_CHUNK_WORDS < endWord; ++chunk)
+	{
+		if (!m_isBitmapChunkDirty[chunk])
+		{
+			m_isBitmapChunkDirty[chunk] = true;
+			m_dirtyBitmapChunks.push_back(static_cast<uint32_t>(chunk));
+		}
+	}
+}
+
+bool FileSystemManager::InitializeEmptyStorage(const std::string& path, const uint64_t size, const bool preallocate)
+{
+	// Образ создаётся разреженным: непрочитанные места читаются нулями, а на диск ложатся только метаданные.
+	// С предвыделением место под весь образ резервируется сразу, без записи нулей
+	const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		std::cerr << "Error: Cannot create image file" << std::endl;
+		return false;
+	}
+
+	bool isCreated = ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+	if (isCreated && preallocate)
+	{
+		const int error = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+		if (error != 0)
+		{
+			std::cerr << "Error: Cannot preallocate image: " << std::strerror(error) << std::endl;
+			isCreated = false;
+		}
+	}
+	::close(fd);
+	if (!isCreated)
+	{
+		::unlink(path.c_str());
+	}
+	return isCreated;
+}
+
+bool FileSystemManager::InitializeSuperblock(const uint32_t maxFiles, const uint64_t totalSize)
+{
+	std::memcpy(m_superblock.signature, SIGNATURE, sizeof(SIGNATURE));
+	m_superblock.version = FS_VERSION;
+	m_superblock.blockSize = BLOCK_SIZE;
+	m_superblock.maxFiles = maxFiles;
+	m_superblock.fileTableOffset = sizeof(Superblock);
+	const uint64_t fileTableEnd = m_superblock.fileTableOffset + static_cast<uint64_t>(maxFiles) * sizeof(FileEntry);
+	if (totalSize < AlignUpToBlockSize(fileTableEnd))
+	{
+		std::cerr << "Error: Image size is too small for metadata" << std::endl;
+		return false;
+	}
+
+	// Карта рассчитана на всё место за таблицей файлов, поэтому её хватает и после того,
+	// как она сама займёт часть этого места
+	const uint64_t maxBlocks = (totalSize - AlignUpToBlockSize(fileTableEnd)) / BLOCK_SIZE;
+	m_superblock.bitmapOffset = static_cast<uint32_t>(fileTableEnd);
+	m_superblock.bitmapWords = static_cast<uint32_t>((maxBlocks + 63) / 64);
+	m_superblock.journalOffset = static_cast<uint32_t>(
+		AlignUpToBlockSize(fileTableEnd + static_cast<uint64_t>(m_superblock.bitmapWords) * sizeof(uint64_t)));
+	m_superblock.journalBlocks = static_cast<uint32_t>(std::clamp<uint64_t>(maxBlocks / 16, MIN_JOURNAL_BLOCKS, MAX_JOURNAL_BLOCKS));
+	m_superblock.dataAreaOffset = m_superblock.journalOffset + m_superblock.journalBlocks * BLOCK_SIZE;
+	if (totalSize < m_superblock.dataAreaOffset)
+	{
+		std::cerr << "Error: Image size is too small for metadata" << std::endl;
+		return false;
+	}
+	m_superblock.totalBlocks = (totalSize - m_superblock.dataAreaOffset) / BLOCK_SIZE;
+	WriteSuperblock();
+
+	return true;
+}
+void FileSystemManager::InitializeFileTable(const uint32_t maxFiles)
+{
+	m_fileTable.assign(maxFiles, FileEntry{});
+	for (auto& entry : m_fileTable)
+	{
+		entry.isUsed = false;
+	}
+	m_fileExtents.assign(maxFiles, {});
+	m_generations.assign(maxFiles, 0);
+	m_isEntryDirty.assign(maxFiles, false);
+	m_dirtyEntries.clear();
+	m_dirtyOverflowBlocks = 0;
+	// Пустая запись целиком из нулей, а именно такой читается ещё не записанный образ
+	BuildFileIndex();
+}
+void FileSystemManager::InitializeBitmap()
+{
+	m_blockBitmap.assign(m_superblock.bitmapWords, 0);
+	// Биты за последним блоком считаются занятыми, чтобы поиск их не выдавал. На диск пишутся
+	// только слова с ними: остальная карта на чистом образе и так читается нулями
+	const size_t lastWord = m_superblock.totalBlocks / 64;
+	if (lastWord < m_blockBitmap.size())
+	{
+		m_blockBitmap[lastWord] = ~0ULL << (m_superblock.totalBlocks % 64);
+		std::fill(m_blockBitmap.begin() + static_cast<std::ptrdiff_t>(lastWord) + 1, m_blockBitmap.end(), ~0ULL);
+		WriteAt(m_blockBitmap.data() + lastWord, (m_blockBitmap.size() - lastWord) * sizeof(uint64_t),
+			m_superblock.bitmapOffset + lastWord * sizeof(uint64_t));
+	}
+	m_firstFreeWord = 0;
+	m_isBitmapChunkDirty.assign((m_blockBitmap.size() + BITMAP_CHUNK_WORDS - 1) / BITMAP_CHUNK_WORDS, false);
+	m_dirtyBitmapChunks.clear();
+	m_pendingFreeBlocks.clear();
+}
+void FileSystemManager::InitializeFileEntry(const int freeEntryIndex, const uint32_t parent, const std::string_view name,
+	const bool isDirectory)
+{
+	FileEntry& entry = m_fileTable[freeEntryIndex];
+	std::memset(entry.name, 0, MAX_FILENAME + 1);
+	std::memcpy(entry.name, name.data(), name.size());
+
+	entry.size = 0;
+	entry.blocksCount = 0;
+	entry.extentsCount = 0;
+	std::memset(entry.extents, 0, sizeof(entry.extents));
+	entry.overflowBlock = NO_BLOCK;
+	entry.parent = parent;
+	entry.isDirectory = isDirectory;
+	entry.isUsed = true;
+	m_fileExtents[freeEntryIndex] = {};
+	LinkEntry(freeEntryIndex);
+	MarkEntryDirty(freeEntryIndex);
+}
+
+Extent FileSystemManager::FindFreeRun(const uint32_t neededBlocks) const
+{
+	// Первый участок нужной длины, а если такого нет - самый длинный.
+	// Карта просматривается по 64 блока за шаг, занятые слова пропускаются целиком
+	Extent longest{ 0, 0 };
+	uint32_t runStart = 0;
+	uint32_t runLength = 0;
+	for (size_t wordIndex = m_firstFreeWord; wordIndex < m_blockBitmap.size(); ++wordIndex)
+	{
+		const uint64_t word = m_blockBitmap[wordIndex];
+		if (word == ~0ULL)
+		{
+			runLength = 0;
+			continue;
+		}
+
+		uint32_t bit = 0;
+		while (bit < 64)
+		{
+			const uint64_t rest = word >> bit;
+			if ((rest & 1) != 0)
+			{
+				runLength = 0;
+				bit += std::countr_one(rest);
+				continue;
+			}
+
+			const uint32_t freeBits = rest == 0 ? 64 - bit : std::countr_zero(rest);
+			if (runLength == 0)
+			{
+				runStart = static_cast<uint32_t>(wordIndex * 64 + bit);
+			}
+			runLength += freeBits;
+			bit += freeBits;
+			if (runLength >= neededBlocks)
+			{
+				return { runStart, neededBlocks };
+			}
+			if (runLength > longest.blocksCount)
+			{
+				longest = { runStart, runLength };
+			}
+		}
+	}
+
+	return longest;
+}
+
+uint32_t FileSystemManager::CountFreeBlocks(const uint32_t firstBlock, const uint32_t maxBlocks) const
+{
+	uint32_t count = 0;
+	uint64_t block = firstBlock;
+	while (count < maxBlocks && block < m_superblock.totalBlocks)
+	{
+		const uint32_t bit = block % 64;
+		const uint64_t rest = m_blockBitmap[block / 64] >> bit;
+		const uint32_t freeBits = rest == 0 ? 64 - bit : std::countr_zero(rest);
+		count += freeBits;
+		block += freeBits;
+		if (freeBits < 64 - bit)
+		{
+			break;
+		}
+	}
+	return std::min(count, maxBlocks);
+}
+
+void FileSystemManager::MarkBlocks(const uint32_t firstBlock, const uint32_t blocksCount, const bool used)
+{
+	if (blocksCount == 0)
+	{
+		return;
+	}
+
+	const uint64_t endBlock = static_cast<uint64_t>(firstBlock) + blocksCount;
+	for (uint64_t block = firstBlock; block < endBlock;)
+	{
+		const uint32_t bit = block % 64;
+		const auto bits = static_cast<uint32_t>(std::min<uint64_t>(64 - bit, endBlock - block));
+		const uint64_t mask = (bits == 64 ? ~0ULL : (1ULL << bits) - 1) << bit;
+		uint64_t& word = m_blockBitmap[block / 64];
+		word = used ? word | mask : word & ~mask;
+		block += bits;
+	}
+
+	const size_t firstWord = firstBlock / 64;
+	const size_t endWord = (endBlock + 63) / 64;
+	MarkBitmapDirty(firstWord, endWord);
+
+	if (!used)
+	{
+		m_firstFreeWord = std::min(m_firstFreeWord, firstWord);
+		return;
+	}
+	while (m_firstFreeWord < m_blockBitmap.size() && m_blockBitmap[m_firstFreeWord] == ~0ULL)
+	{
+		m_firstFreeWord++;
+	}
+}
+
+void FileSystemManager::BuildFileIndex()
+{
+	m_fileIndexByKey.clear();
+	m_fileIndexByKey.reserve(m_fileTable.size());
+	m_directoryIndexByPath.clear();
+	m_tree.assign(m_fileTable.size() + 1, {});
+	m_freeEntries.clear();
+	// Свободные записи лежат по убыванию, чтобы новые файлы занимали начало таблицы
+	for (size_t i = m_fileTable.size(); i-- > 0;)
+	{
+		FileEntry& entry = m_fileTable[i];
+		if (!entry.isUsed)
+		{
+			m_freeEntries.push_back(static_cast<int>(i));
+			continue;
+		}
+
+		// Запись с испорченной ссылкой на родителя показывается в корне, чтобы её можно было удалить
+		if (entry.parent != ROOT_DIRECTORY
+			&& (entry.parent >= m_fileTable.size() || !m_fileTable[entry.parent].isUsed || !m_fileTable[entry.parent].isDirectory))
+		{
+			entry.parent = ROOT_DIRECTORY;
+		}
+		LinkEntry(static_cast<int>(i));
+	}
+	UpdateDirectoryPaths(ROOT_DIRECTORY, "", true);
+}
+
+void FileSystemManager::LinkEntry(const int fileIndex)
+{
+	const FileEntry& entry = m_fileTable[fileIndex];
+	m_fileIndexByKey.insert_or_assign(EntryKey{ entry.parent, std::string(GetEntryName(entry)) }, fileIndex);
+
+	TreeNode& parentNode = m_tree[GetTreeSlot(entry.parent)];
+	TreeNode& node = m_tree[fileIndex];
+	node.previousSibling = -1;
+	node.nextSibling = parentNode.firstChild;
+	if (parentNode.firstChild != -1)
+	{
+		m_tree[parentNode.firstChild].previousSibling = fileIndex;
+	}
+	parentNode.firstChild = fileIndex;
+}
+
+void FileSystemManager::UnlinkEntry(const int fileIndex)
+{
+	const FileEntry& entry = m_fileTable[fileIndex];
+	const auto it = m_fileIndexByKey.find(EntryKeyView{ entry.parent, GetEntryName(entry) });
+	if (it != m_fileIndexByKey.end() && it->second == fileIndex)
+	{
+		m_fileIndexByKey.erase(it);
+	}
+
+	TreeNode& node = m_tree[fileIndex];
+	if (node.previousSibling != -1)
+	{
+		m_tree[node.previousSibling].nextSibling = node.nextSibling;
+	}
+	else
+	{
+		m_tree[GetTreeSlot(entry.parent)].firstChild = node.nextSibling;
+	}
+	if (node.nextSibling != -1)
+	{
+		m_tree[node.nextSibling].previousSibling = node.previousSibling;
+	}
+	node.previousSibling = -1;
+	node.nextSibling = -1;
+}
+
+void FileSystemManager::UpdateDirectoryPaths(const uint32_t directory, const std::string& path, const bool isIndexed)
+{
+	// Добавляет в индекс путей или убирает из него каталог path и все каталоги под ним
+	if (directory != ROOT_DIRECTORY)
+	{
+		if (isIndexed)
+		{
+			m_directoryIndexByPath.insert_or_assign(path, directory);
+		}
+		else
+		{
+			m_directoryIndexByPath.erase(path);
+		}
+	}
+
+	for (int child = m_tree[GetTreeSlot(directory)].firstChild; child != -1; child = m_tree[child].nextSibling)
+	{
+		if (m_fileTable[child].isDirectory)
+		{
+			const std::string_view name = GetEntryName(m_fileTable[child]);
+			UpdateDirectoryPaths(static_cast<uint32_t>(child), path.empty() ? std::string(name) : path + '/' + std::string(name), isIndexed);
+		}
+	}
+}
+
+bool FileSystemManager::SplitPath(const std::string_view path, uint32_t& parent, std::string_view& name) const
+{
+	const size_t slash = path.rfind('/');
+	name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+	return !name.empty() && name.length() <= MAX_FILENAME
+		&& GetDirectoryIndex(slash == std::string_view::npos ? std::string_view{} : path.substr(0, slash), parent);
+}
+
+bool FileSystemManager::GetDirectoryIndex(const std::string_view path, uint32_t& directory) const
+{
+	if (path.empty())
+	{
+		directory = ROOT_DIRECTORY;
+		return true;
+	}
+	const auto it = m_directoryIndexByPath.find(path);
+	if (it == m_directoryIndexByPath.end())
+	{
+		return false;
+	}
+	directory = it->second;
+	return true;
+}
+
+bool FileSystemManager::IsInSubtree(uint32_t entry, const uint32_t directory) const
+{
+	for (; entry != ROOT_DIRECTORY; entry = m_fileTable[entry].parent)
+	{
+		if (entry == directory)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t FileSystemManager::GetTreeSlot(const uint32_t entry) const
+{
+	return entry == ROOT_DIRECTORY ? m_fileTable.size() : entry;
+}
+
+std::string_view FileSystemManager::GetEntryName(const FileEntry& entry)
+{
+	return { entry.name, strnlen(entry.name, MAX_FILENAME + 1) };
+}
+
+bool FileSystemManager::CreateEntry(const std::string& path, const bool isDirectory)
+{
+	std::unique_lock metadataLock(m_metadataMutex);
+	uint32_t parent;
+	std::string_view name;
+	if (!SplitPath(path, parent, name))
+	{
+		return false;
+	}
+	if (m_fileIndexByKey.contains(EntryKeyView{ parent, name }))
+	{
+		std::cerr << "Error: File already exists" << std::endl;
+		return false;
+	}
+
+	const int freeEntryIndex = TakeFreeFileTableEntry();
+	if (freeEntryIndex == -1)
+	{
+		std::cerr << "Error: File table is full" << std::endl;
+		return false;
+	}
+
+	InitializeFileEntry(freeEntryIndex, parent, name, isDirectory);
+	if (isDirectory)
+	{
+		m_directoryIndexByPath.emplace(path, static_cast<uint32_t>(freeEntryIndex));
+	}
+	CommitIfDue();
+	return true;
+}
+
+void FileSystemManager::ReleaseEntry(const int fileIndex)
+{
+	// Освобождённый блок переполнения может достаться данным, а в журнале остались его образы.
+	// Журнал переносится на место до освобождения, чтобы восстановление не затёрло ими данные
+	if (!m_fileExtents[fileIndex].overflowBlocks.empty())
+	{
+		WriteBack();
+		m_journal->Checkpoint();
+	}
+	FreeBlocks(fileIndex);
+	UnlinkEntry(fileIndex);
+	m_fileTable[fileIndex].isUsed = false;
+	m_fileExtents[fileIndex] = {};
+	++m_generations[fileIndex];
+	m_freeEntries.push_back(fileIndex);
+	MarkEntryDirty(fileIndex);
+}
+
+int FileSystemManager::TakeFreeFileTableEntry()
+{
+	if (m_freeEntries.empty())
+	{
+		return -1;
+	}
+	const int freeEntryIndex = m_freeEntries.back();
+	m_freeEntries.pop_back();
+	return freeEntryIndex;
+}
+
+int FileSystemManager::GetFileIndex(const std::string_view path) const
+{
+	uint32_t parent;
+	std::string_view name;
+	if (!SplitPath(path, parent, name))
+	{
+		return -1;
+	}
+	const auto it = m_fileIndexByKey.find(EntryKeyView{ parent, name });
+	return it == m_fileIndexByKey.end() ? -1 : it->second;
+}
+
+uint64_t FileSystemManager::AlignUpToBlockSize(const uint64_t offset)
+{
+	return ((offset + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+}
+
+bool FileSystemManager::MapBlocks(const int fileIndex, const uint32_t firstBlock, const uint32_t endBlock, const bool reserve)
+{
+	const std::vector<Extent>& extents = m_fileExtents[fileIndex].extents;
+	const uint32_t coveredBlocks = CountCoveredBlocks(extents);
+	// Запас удваивается, чтобы последовательная дозапись выделяла новые экстенты редко.
+	// Он берётся, только когда запись выходит за покрытую экстентами часть файла
+	const uint32_t mapEnd = reserve && endBlock > coveredBlocks ? CalculateTargetBlockCount(coveredBlocks, endBlock) : endBlock;
+
+	// Меняются только экстенты диапазона и их соседи, с которыми могут слиться новые блоки
+	uint32_t windowStart;
+	const size_t first = FindWindowStart(extents, firstBlock, windowStart);
+	const size_t last = FindWindowEnd(extents, mapEnd);
+	std::vector<Extent> window(extents.begin() + static_cast<std::ptrdiff_t>(first), extents.begin() + static_cast<std::ptrdiff_t>(last));
+	if (mapEnd > coveredBlocks)
+	{
+		window.push_back({ NO_BLOCK, mapEnd - coveredBlocks });
+	}
+	SplitExtents(window, firstBlock - windowStart);
+	SplitExtents(window, mapEnd - windowStart);
+
+	// Занятые блоки отмечаются в карте сразу; если места не хватило, отметки снимаются
+	std::vector<Extent> allocated;
+	const auto take = [this, &allocated](const Extent run) {
+		MarkBlocks(run.startBlock, run.blocksCount, true);
+		allocated.push_back(run);
+	};
+	const auto rollback = [this, &allocated] {
+		for (const auto& run : allocated)
+		{
+			MarkBlocks(run.startBlock, run.blocksCount, false);
+		}
+		return false;
+	};
+
+	std::vector<Extent> mapped;
+	mapped.reserve(window.size() + 1);
+	uint32_t block = windowStart;
+	for (const auto& extent : window)
+	{
+		const uint32_t extentStart = block;
+		block += extent.blocksCount;
+		if (extent.startBlock != NO_BLOCK || extentStart < firstBlock || extentStart >= mapEnd)
+		{
+			mapped.push_back(extent);
+			continue;
+		}
+
+		// Дыра заполняется сначала продолжением предыдущего экстента, чтобы файл не дробился без необходимости
+		uint32_t remaining = extent.blocksCount;
+		if (!mapped.empty() && mapped.back().startBlock != NO_BLOCK)
+		{
+			Extent& previous = mapped.back();
+			const uint32_t grown = CountFreeBlocks(previous.startBlock + previous.blocksCount, remaining);
+			if (grown > 0)
+			{
+				take({ previous.startBlock + previous.blocksCount, grown });
+				previous.blocksCount += grown;
+				remaining -= grown;
+			}
+		}
+		while (remaining > 0)
+		{
+			const Extent run = FindFreeRun(remaining);
+			if (run.blocksCount == 0)
+			{
+				rollback();
+				return CommitPendingFrees() && MapBlocks(fileIndex, firstBlock, endBlock, reserve);
+			}
+			take(run);
+			mapped.push_back(run);
+			remaining -= run.blocksCount;
+		}
+	}
+
+	NormalizeExtents(mapped);
+	return UpdateLayout(fileIndex, first, last - first, mapped, {}) || rollback();
+}
+
+bool FileSystemManager::UnmapBlocks(const int fileIndex, const uint32_t firstBlock, const uint32_t endBlock)
+{
+	const std::vector<Extent>& extents = m_fileExtents[fileIndex].extents;
+	if (firstBlock >= std::min(endBlock, CountCoveredBlocks(extents)))
+	{
+		return true;
+	}
+	uint32_t windowStart;
+	const size_t first = FindWindowStart(extents, firstBlock, windowStart);
+	const size_t last = FindWindowEnd(extents, endBlock);
+	std::vector<Extent> window(extents.begin() + static_cast<std::ptrdiff_t>(first), extents.begin() + static_cast<std::ptrdiff_t>(last));
+	SplitExtents(window, firstBlock - windowStart);
+	SplitExtents(window, endBlock - windowStart);
+
+	std::vector<Extent> released;
+	uint32_t block = windowStart;
+	for (auto& extent : window)
+	{
+		if (block >= firstBlock && block < endBlock && extent.startBlock != NO_BLOCK)
+		{
+			released.push_back(extent);
+			extent.startBlock = NO_BLOCK;
+		}
+		block += extent.blocksCount;
+	}
+	if (released.empty())
+	{
+		return true;
+	}
+
+	NormalizeExtents(window);
+	// Дыра в конце файла не хранится
+	if (last == extents.size())
+	{
+		while (!window.empty() && window.back().startBlock == NO_BLOCK)
+		{
+			window.pop_back();
+		}
+	}
+	return UpdateLayout(fileIndex, first, last - first, window, released);
+}
+
+bool FileSystemManager::UpdateLayout(const int fileIndex, const size_t firstExtent, const size_t replacedCount,
+	const std::vector<Extent>& replacement, const std::vector<Extent>& released)
+{
+	FileExtents& layout = m_fileExtents[fileIndex];
+
+	// Блоков переполнения становится столько, сколько нужно новому списку экстентов
+	const size_t neededOverflowBlocks = CountOverflowBlocks(layout.extents.size() - replacedCount + replacement.size());
+	const size_t oldOverflowBlocks = layout.overflowBlocks.size();
+	while (layout.overflowBlocks.size() < neededOverflowBlocks)
+	{
+		const Extent block = FindFreeRun(1);
+		if (block.blocksCount == 0)
+		{
+			for (size_t i = oldOverflowBlocks; i < layout.overflowBlocks.size(); ++i)
+			{
+				MarkBlocks(layout.overflowBlocks[i], 1, false);
+			}
+			layout.overflowBlocks.resize(oldOverflowBlocks);
+			return false;
+		}
+		MarkBlocks(block.startBlock, 1, true);
+		layout.overflowBlocks.push_back(block.startBlock);
+	}
+	std::vector<uint32_t> surplusOverflowBlocks;
+	if (layout.overflowBlocks.size() > neededOverflowBlocks)
+	{
+		surplusOverflowBlocks.assign(layout.overflowBlocks.begin() + static_cast<std::ptrdiff_t>(neededOverflowBlocks), layout.overflowBlocks.end());
+		layout.overflowBlocks.resize(neededOverflowBlocks);
+	}
+
+	const auto countDataBlocks = [](const auto begin, const auto end) {
+		uint32_t blocks = 0;
+		for (auto it = begin; it != end; ++it)
+		{
+			blocks += it->startBlock == NO_BLOCK ? 0 : it->blocksCount;
+		}
+		return blocks;
+	};
+	const auto replacedBegin = layout.extents.begin() + static_cast<std::ptrdiff_t>(firstExtent);
+	const auto replacedEnd = replacedBegin + static_cast<std::ptrdiff_t>(replacedCount);
+	FileEntry& entry = m_fileTable[fileIndex];
+	entry.blocksCount = entry.blocksCount - countDataBlocks(replacedBegin, replacedEnd) + countDataBlocks(replacement.begin(), replacement.end());
+	const auto insertAt = layout.extents.erase(replacedBegin, replacedEnd);
+	layout.extents.insert(insertAt, replacement.begin(), replacement.end());
+
+	// Переписываются экстенты начиная с первого изменённого; если длина цепочки блоков переполнения
+	// изменилась, переписывается и её последний сохранившийся блок со ссылкой на следующий
+	size_t firstChangedExtent = firstExtent;
+	const size_t keptOverflowBlocks = std::min(oldOverflowBlocks, neededOverflowBlocks);
+	if (oldOverflowBlocks != neededOverflowBlocks && keptOverflowBlocks > 0)
+	{
+		firstChangedExtent = std::min<size_t>(firstChangedExtent, INLINE_EXTENTS + (keptOverflowBlocks - 1) * EXTENTS_PER_BLOCK);
+	}
+	WriteExtents(fileIndex, firstChangedExtent);
+
+	// Образы освобождаемых блоков переполнения остаются в журнале, поэтому сначала он переносится на место
+	// вместе с новой раскладкой. Если сбой случится раньше, чем уйдёт освобождение, блоки лишь останутся занятыми
+	if (!surplusOverflowBlocks.empty())
+	{
+		WriteBack();
+		m_journal->Checkpoint();
+	}
+	for (const auto& run : released)
+	{
+		DeferFree(run.startBlock, run.blocksCount);
+	}
+	for (const uint32_t overflowBlock : surplusOverflowBlocks)
+	{
+		DeferFree(overflowBlock, 1);
+	}
+	return true;
+}
+
+size_t FileSystemManager::FindWindowStart(const std::vector<Extent>& extents, const uint32_t block, uint32_t& windowStart)
+{
+	// Окно начинается с соседа слева от экстента с block, чтобы новые блоки могли продлить его или слиться с ним
+	size_t index = 0;
+	uint32_t extentStart = 0;
+	windowStart = 0;
+	while (index < extents.size() && extentStart + extents[index].blocksCount <= block)
+	{
+		windowStart = extentStart;
+		extentStart += extents[index].blocksCount;
+		index++;
+	}
+	return index == 0 ? 0 : index - 1;
+}
+
+size_t FileSystemManager::FindWindowEnd(const std::vector<Extent>& extents, const uint32_t endBlock)
+{
+	// Окно заканчивается соседом справа от последнего экстента диапазона
+	size_t index = 0;
+	uint64_t extentStart = 0;
+	while (index < extents.size() && extentStart < endBlock)
+	{
+		extentStart += extents[index].blocksCount;
+		index++;
+	}
+	return std::min(index + 1, extents.size());
+}
+
+bool FileSystemManager::IsRangeMapped(const int fileIndex, const uint32_t firstBlock, const uint32_t endBlock) const
+{
+	uint32_t block = 0;
+	for (const auto& extent : m_fileExtents[fileIndex].extents)
+	{
+		if (block >= endBlock)
+		{
+			return true;
+		}
+		const uint32_t extentEnd = block + extent.blocksCount;
+		if (extentEnd > firstBlock && extent.startBlock == NO_BLOCK)
+		{
+			return false;
+		}
+		block = extentEnd;
+	}
+	return block >= endBlock;
+}
+
+bool FileSystemManager::ZeroRange(const int fileIndex, const uint64_t offset, const uint64_t size)
+{
+	// Зануляет выделенные части диапазона; дыры и так читаются нулями
+	if (size == 0)
+	{
+		return true;
+	}
+	const std::vector<char> zeros(size, 0);
+	bool isWritten = true;
+	ForEachDiskRange(fileIndex, offset, size,
+		[this, &zeros, &isWritten](const uint64_t diskOffset, const uint64_t position, const uint64_t length) {
+			if (diskOffset != HOLE_OFFSET)
+			{
+				isWritten = isWritten && WriteDataRange(zeros.data() + position, length, diskOffset);
+			}
+		});
+	return isWritten;
+}
+
+void FileSystemManager::FreeBlocks(const int fileIndex)
+{
+	for (const auto& extent : m_fileExtents[fileIndex].extents)
+	{
+		if (extent.startBlock != NO_BLOCK)
+		{
+			DeferFree(extent.startBlock, extent.blocksCount);
+		}
+	}
+	for (const uint32_t overflowBlock : m_fileExtents[fileIndex].overflowBlocks)
+	{
+		DeferFree(overflowBlock, 1);
+	}
+}
+
+void FileSystemManager::DeferFree(const uint32_t firstBlock, const uint32_t blocksCount)
+{
+	m_pendingFreeBlocks.push_back({ firstBlock, blocksCount });
+	InvalidateCachedBlocks(firstBlock, blocksCount);
+}
+
+bool FileSystemManager::CommitPendingFrees()
+{
+	// Место кончилось, но часть блоков ждёт фиксации освобождения: фиксация возвращает их в карту
+	return !m_pendingFreeBlocks.empty() && WriteBack();
+}
+
+void FileSystemManager::ReadExtents(const int fileIndex)
+{
+	const FileEntry& entry = m_fileTable[fileIndex];
+	FileExtents& layout = m_fileExtents[fileIndex];
+	layout = {};
+
+	const uint32_t extentsCount = entry.extentsCount;
+	const uint32_t inlineCount = std::min(extentsCount, INLINE_EXTENTS);
+	layout.extents.assign(entry.extents, entry.extents + inlineCount);
+
+	std::vector<char> block(BLOCK_SIZE);
+	for (uint32_t overflowBlock = entry.overflowBlock;
+		overflowBlock != NO_BLOCK && layout.extents.size() < extentsCount;)
+	{
+		if (!ReadAt(block.data(), BLOCK_SIZE, GetBlockOffset(overflowBlock)))
+		{
+			break;
+		}
+
+		ExtentBlockHeader header{};
+		std::memcpy(&header, block.data(), sizeof(header));
+		const uint32_t count = std::min(static_cast<uint32_t>(header.extentsCount), EXTENTS_PER_BLOCK);
+		const auto* extents = reinterpret_cast<const Extent*>(block.data() + sizeof(header));
+		layout.extents.insert(layout.extents.end(), extents, extents + count);
+		layout.overflowBlocks.push_back(overflowBlock);
+		overflowBlock = header.nextBlock;
+	}
+}
+
+void FileSystemManager::WriteExtents(const int fileIndex, const size_t firstChangedExtent)
+{
+	FileEntry& entry = m_fileTable[fileIndex];
+	FileExtents& layout = m_fileExtents[fileIndex];
+	MarkEntryDirty(fileIndex);
+	entry.extentsCount = static_cast<uint32_t>(layout.extents.size());
+	std::copy_n(layout.extents.begin(), std::min<size_t>(layout.extents.size(), INLINE_EXTENTS), entry.extents);
+	entry.overflowBlock = layout.overflowBlocks.empty() ? NO_BLOCK : layout.overflowBlocks.front();
+
+	// Блоки переполнения уходят в журнал вместе с записью таблицы при фиксации,
+	// так что блок, менявшийся много раз за интервал фиксации, журналируется однажды
+	layout.firstDirtyExtent = std::min(layout.firstDirtyExtent, firstChangedExtent);
+	const size_t dirtyBlocks = layout.overflowBlocks.size() - std::min(layout.overflowBlocks.size(), GetOverflowBlockIndex(layout.firstDirtyExtent));
+	m_dirtyOverflowBlocks = m_dirtyOverflowBlocks - layout.dirtyBlocks + dirtyBlocks;
+	layout.dirtyBlocks = dirtyBlocks;
+}
+
+size_t FileSystemManager::GetOverflowBlockIndex(const size_t extentIndex)
+{
+	return extentIndex < INLINE_EXTENTS ? 0 : (extentIndex - INLINE_EXTENTS) / EXTENTS_PER_BLOCK;
+}
+
+void FileSystemManager::StageOverflowBlocks(const int fileIndex)
+{
+	FileExtents& layout = m_fileExtents[fileIndex];
+	if (layout.firstDirtyExtent == SIZE_MAX)
+	{
+		return;
+	}
+
+	// Переписываются только блоки переполнения, в которые попали изменённые экстенты
+	const size_t firstChangedBlock = GetOverflowBlockIndex(layout.firstDirtyExtent);
+	layout.firstDirtyExtent = SIZE_MAX;
+	m_dirtyOverflowBlocks -= layout.dirtyBlocks;
+	layout.dirtyBlocks = 0;
+	std::vector<char> block(BLOCK_SIZE);
+	for (size_t blockIndex = firstChangedBlock; blockIndex < layout.overflowBlocks.size(); ++blockIndex)
+	{
+		const size_t first = INLINE_EXTENTS + blockIndex * EXTENTS_PER_BLOCK;
+		ExtentBlockHeader header{};
+		header.nextBlock = blockIndex + 1 < layout.overflowBlocks.size() ? layout.overflowBlocks[blockIndex + 1] : NO_BLOCK;
+		header.extentsCount = static_cast<uint32_t>(std::min<size_t>(EXTENTS_PER_BLOCK, layout.extents.size() - first));
+
+		std::fill(block.begin(), block.end(), 0);
+		std::memcpy(block.data(), &header, sizeof(header));
+		std::memcpy(block.data() + sizeof(header), layout.extents.data() + first, header.extentsCount * sizeof(Extent));
+
+		m_journal->Stage(GetBlockOffset(layout.overflowBlocks[blockIndex]), block.data(), BLOCK_SIZE);
+	}
+}
+
+template <typename Action>
+void FileSystemManager::ForEachDiskRange(const int fileIndex, const uint64_t offset, const uint64_t size, Action action) const
+{
+	// action(смещение в образе, смещение в буфере, длина) для каждого непрерывного куска диапазона;
+	// для дыр и части за последним экстентом вместо смещения в образе передаётся HOLE_OFFSET
+	uint64_t extentFileOffset = 0;
+	uint64_t done = 0;
+	for (const auto& extent : m_fileExtents[fileIndex].extents)
+	{
+		if (done == size)
+		{
+			break;
+		}
+		const uint64_t extentSize = static_cast<uint64_t>(extent.blocksCount) * BLOCK_SIZE;
+		const uint64_t position = offset + done;
+		if (position < extentFileOffset + extentSize)
+		{
+			const uint64_t inExtent = position - extentFileOffset;
+			const uint64_t length = std::min(extentSize - inExtent, size - done);
+			action(extent.startBlock == NO_BLOCK ? HOLE_OFFSET : GetBlockOffset(extent.startBlock) + inExtent, done, length);
+			done += length;
+		}
+		extentFileOffset += extentSize;
+	}
+	if (done < size)
+	{
+		action(HOLE_OFFSET, done, size - done);
+	}
+}
+
+uint64_t FileSystemManager::GetBlockOffset(const uint32_t block) const
+{
+	return m_superblock.dataAreaOffset + static_cast<uint64_t>(block) * BLOCK_SIZE;
+}
+
+uint32_t FileSystemManager::CalculateTargetBlockCount(const uint32_t coveredBlocks, const uint32_t neededBlocks)
+{
+	uint32_t targetBlocks;
+	if (coveredBlocks == 0)
+	{
+		targetBlocks = 1;
+	}
+	else
+	{
+		targetBlocks = std::min(coveredBlocks * 2, MAX_FILE_SIZE / BLOCK_SIZE);
+	}
+	if (targetBlocks < neededBlocks)
+	{
+		targetBlocks = neededBlocks;
+	}
+
+	return targetBlocks;
+}
+
+uint32_t FileSystemManager::CountCoveredBlocks(const std::vector<Extent>& extents)
+{
+	uint32_t blocks = 0;
+	for (const auto& extent : extents)
+	{
+		blocks += extent.blocksCount;
+	}
+	return blocks;
+}
+
+void FileSystemManager::SplitExtents(std::vector<Extent>& extents, const uint32_t block)
+{
+	// Делит экстент, внутрь которого попадает block, так чтобы block начинал отдельный экстент
+	uint32_t extentStart = 0;
+	for (size_t i = 0; i < extents.size(); ++i)
+	{
+		if (block <= extentStart)
+		{
+			return;
+		}
+		Extent& extent = extents[i];
+		if (block < extentStart + extent.blocksCount)
+		{
+			const uint32_t head = block - extentStart;
+			const Extent tail{ extent.startBlock == NO_BLOCK ? NO_BLOCK : extent.startBlock + head, extent.blocksCount - head };
+			extent.blocksCount = head;
+			extents.insert(extents.begin() + static_cast<std::ptrdiff_t>(i) + 1, tail);
+			return;
+		}
+		extentStart += extent.blocksCount;
+	}
+}
+
+void FileSystemManager::NormalizeExtents(std::vector<Extent>& extents)
+{
+	// Соседние дыры и физически смежные экстенты сливаются
+	std::vector<Extent> merged;
+	merged.reserve(extents.size());
+	for (const auto& extent : extents)
+	{
+		if (extent.blocksCount == 0)
+		{
+			continue;
+		}
+		if (!merged.empty())
+		{
+			Extent& last = merged.back();
+			const bool isHole = extent.startBlock == NO_BLOCK;
+			if (isHole == (last.startBlock == NO_BLOCK) && (isHole || last.startBlock + last.blocksCount == extent.startBlock))
+			{
+				last.blocksCount += extent.blocksCount;
+				continue;
+			}
+		}
+		merged.push_back(extent);
+	}
+	extents = std::move(merged);
+}
+
+size_t FileSystemManager::CountOverflowBlocks(const size_t extentsCount)
+{
+	if (extentsCount <= INLINE_EXTENTS)
+	{
+		return 0;
+	}
+	return (extentsCount - INLINE_EXTENTS + EXTENTS_PER_BLOCK - 1) / EXTENTS_PER_BLOCK;
+}
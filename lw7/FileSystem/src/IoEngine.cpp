@@ -0,0 +1,357 @@
+#include "IoEngine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define MYFS_HAS_IO_URING
+#endif
+
+namespace
+{
+// После частичной передачи запрос сдвигается на переданные байты
+void AdvanceRequest(IoRequest& request, size_t transferred)
+{
+	request.offset += transferred;
+	while (request.count > 0 && transferred >= request.vectors->iov_len)
+	{
+		transferred -= request.vectors->iov_len;
+		++request.vectors;
+		--request.count;
+	}
+	if (request.count > 0)
+	{
+		request.vectors->iov_base = static_cast<char*>(request.vectors->iov_base) + transferred;
+		request.vectors->iov_len -= transferred;
+	}
+}
+
+void PrintIoError(const IoRequest& request, const int error)
+{
+	std::cerr << "Error: Image " << (request.isWrite ? "write" : "read")
+			  << " failed: " << (error == 0 ? "unexpected end of image" : std::strerror(error)) << std::endl;
+}
+
+bool ExecuteSync(const int fd, IoRequest& request)
+{
+	while (request.count > 0)
+	{
+		const ssize_t result = request.isWrite
+			? ::pwritev(fd, request.vectors, request.count, static_cast<off_t>(request.offset))
+			: ::preadv(fd, request.vectors, request.count, static_cast<off_t>(request.offset));
+		if (result == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			PrintIoError(request, result == 0 ? 0 : errno);
+			return false;
+		}
+		AdvanceRequest(request, static_cast<size_t>(result));
+	}
+	return true;
+}
+
+class SyncIoEngine final : public IoEngine
+{
+public:
+	explicit SyncIoEngine(const int fd)
+		: m_fd(fd)
+	{
+	}
+
+	bool Execute(IoRequest* requests, const size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!ExecuteSync(m_fd, requests[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	const int m_fd;
+};
+
+#ifdef MYFS_HAS_IO_URING
+// Кольцо io_uring на прямых системных вызовах, без liburing
+class UringRing
+{
+public:
+	~UringRing()
+	{
+		if (m_sqes != MAP_FAILED)
+		{
+			::munmap(m_sqes, m_sqesSize);
+		}
+		if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+		{
+			::munmap(m_cqRing, m_cqRingSize);
+		}
+		if (m_sqRing != MAP_FAILED)
+		{
+			::munmap(m_sqRing, m_sqRingSize);
+		}
+		if (m_ringFd != -1)
+		{
+			::close(m_ringFd);
+		}
+	}
+
+	static std::unique_ptr<UringRing> Create(const uint32_t entries)
+	{
+		auto ring = std::unique_ptr<UringRing>(new UringRing());
+		io_uring_params params{};
+		ring->m_ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+		if (ring->m_ringFd == -1)
+		{
+			return nullptr;
+		}
+
+		ring->m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		ring->m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool isSingleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (isSingleMmap)
+		{
+			ring->m_sqRingSize = ring->m_cqRingSize = std::max(ring->m_sqRingSize, ring->m_cqRingSize);
+		}
+		ring->m_sqRing = ::mmap(nullptr, ring->m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring->m_ringFd, IORING_OFF_SQ_RING);
+		if (ring->m_sqRing == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		ring->m_cqRing = isSingleMmap
+			? ring->m_sqRing
+			: ::mmap(nullptr, ring->m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				  ring->m_ringFd, IORING_OFF_CQ_RING);
+		if (ring->m_cqRing == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		ring->m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		ring->m_sqes = ::mmap(nullptr, ring->m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring->m_ringFd, IORING_OFF_SQES);
+		if (ring->m_sqes == MAP_FAILED)
+		{
+			return nullptr;
+		}
+
+		auto* sq = static_cast<char*>(ring->m_sqRing);
+		ring->m_sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+		ring->m_sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+		ring->m_sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+		auto* cq = static_cast<char*>(ring->m_cqRing);
+		ring->m_cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+		ring->m_cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+		ring->m_cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+		ring->m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		// Ядро округляет размер очереди до степени двойки, в работе держится не больше запрошенного
+		ring->m_entries = entries;
+		return ring;
+	}
+
+	bool Execute(const int fd, IoRequest* requests, const size_t count)
+	{
+		// Очередь индексов запросов к отправке; недочитанные и прерванные запросы встают в неё снова
+		std::vector<size_t> queue(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			queue[i] = i;
+		}
+		size_t queued = 0;
+		uint32_t inFlight = 0;
+		uint32_t toSubmit = 0;
+		int error = -1;
+
+		while (inFlight > 0 || (error == -1 && (toSubmit > 0 || queued < queue.size())))
+		{
+			while (error == -1 && queued < queue.size() && inFlight + toSubmit < m_entries)
+			{
+				PushRequest(fd, requests[queue[queued]], queue[queued]);
+				queued++;
+				toSubmit++;
+			}
+
+			// После ошибки новые запросы не отправляются, но уже отправленные
+			// ещё работают с буферами, и их нужно дождаться
+			const uint32_t submitNow = error == -1 ? toSubmit : 0;
+			const int submitted = static_cast<int>(
+				::syscall(__NR_io_uring_enter, m_ringFd, submitNow, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+			if (submitted == -1)
+			{
+				if (errno != EINTR && errno != EAGAIN && errno != EBUSY && error == -1)
+				{
+					error = errno;
+					std::cerr << "Error: io_uring_enter failed: " << std::strerror(error) << std::endl;
+				}
+				if (error != -1 && inFlight == 0)
+				{
+					break;
+				}
+				continue;
+			}
+			toSubmit -= static_cast<uint32_t>(submitted);
+			inFlight += static_cast<uint32_t>(submitted);
+
+			uint32_t head = *m_cqHead;
+			const uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+			for (; head != tail; ++head)
+			{
+				const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+				IoRequest& request = requests[cqe.user_data];
+				inFlight--;
+				if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+				{
+					queue.push_back(cqe.user_data);
+				}
+				else if (cqe.res <= 0)
+				{
+					if (error == -1)
+					{
+						error = -cqe.res;
+						PrintIoError(request, error);
+					}
+				}
+				else
+				{
+					AdvanceRequest(request, static_cast<size_t>(cqe.res));
+					if (request.count > 0)
+					{
+						queue.push_back(cqe.user_data);
+					}
+				}
+			}
+			__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		}
+		if (error != -1 && toSubmit > 0)
+		{
+			// Неотправленные записи очереди отменяются откатом её хвоста
+			__atomic_store_n(m_sqTail, *m_sqTail - toSubmit, __ATOMIC_RELEASE);
+		}
+		return error == -1;
+	}
+
+private:
+	UringRing() = default;
+
+	void PushRequest(const int fd, const IoRequest& request, const uint64_t userData)
+	{
+		const uint32_t tail = *m_sqTail;
+		const uint32_t index = tail & m_sqMask;
+		io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_sqes)[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = request.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe.fd = fd;
+		sqe.off = request.offset;
+		sqe.addr = reinterpret_cast<uint64_t>(request.vectors);
+		sqe.len = static_cast<uint32_t>(request.count);
+		sqe.user_data = userData;
+		m_sqArray[index] = index;
+		__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+	}
+
+	int m_ringFd = -1;
+	uint32_t m_entries = 0;
+	void* m_sqRing = MAP_FAILED;
+	void* m_cqRing = MAP_FAILED;
+	void* m_sqes = MAP_FAILED;
+	size_t m_sqRingSize = 0;
+	size_t m_cqRingSize = 0;
+	size_t m_sqesSize = 0;
+	uint32_t* m_sqTail = nullptr;
+	uint32_t m_sqMask = 0;
+	uint32_t* m_sqArray = nullptr;
+	uint32_t* m_cqHead = nullptr;
+	uint32_t* m_cqTail = nullptr;
+	uint32_t m_cqMask = 0;
+	io_uring_cqe* m_cqes = nullptr;
+};
+
+// Кольцо не разделяется между потоками: каждый Execute берёт свободное кольцо из пула
+// или заводит новое, так что пул растёт до числа одновременно работающих потоков
+class UringIoEngine final : public IoEngine
+{
+public:
+	UringIoEngine(const int fd, const uint32_t queueDepth, std::unique_ptr<UringRing> ring)
+		: m_fd(fd)
+		, m_queueDepth(queueDepth)
+	{
+		m_idleRings.push_back(std::move(ring));
+	}
+
+	bool Execute(IoRequest* requests, const size_t count) override
+	{
+		// Одиночный запрос не с чем перекрывать, системный вызов pread обходится дешевле кольца
+		if (count == 1)
+		{
+			return ExecuteSync(m_fd, requests[0]);
+		}
+
+		std::unique_ptr<UringRing> ring = TakeRing();
+		if (!ring)
+		{
+			SyncIoEngine engine(m_fd);
+			return engine.Execute(requests, count);
+		}
+		const bool isDone = ring->Execute(m_fd, requests, count);
+		std::lock_guard lock(m_mutex);
+		m_idleRings.push_back(std::move(ring));
+		return isDone;
+	}
+
+private:
+	std::unique_ptr<UringRing> TakeRing()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			if (!m_idleRings.empty())
+			{
+				std::unique_ptr<UringRing> ring = std::move(m_idleRings.back());
+				m_idleRings.pop_back();
+				return ring;
+			}
+		}
+		return UringRing::Create(m_queueDepth);
+	}
+
+	const int m_fd;
+	const uint32_t m_queueDepth;
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<UringRing>> m_idleRings;
+};
+#endif
+}
+
+std::unique_ptr<IoEngine> IoEngine::Create(const int fd, const IoEngineKind kind, const uint32_t queueDepth)
+{
+#ifdef MYFS_HAS_IO_URING
+	if (kind == IoEngineKind::Uring)
+	{
+		const uint32_t depth = std::max<uint32_t>(queueDepth, 1);
+		if (auto ring = UringRing::Create(depth))
+		{
+			return std::make_unique<UringIoEngine>(fd, depth, std::move(ring));
+		}
+		std::cerr << "Warning: io_uring is unavailable (" << std::strerror(errno) << "), using pread/pwrite" << std::endl;
+	}
+#else
+	if (kind == IoEngineKind::Uring)
+	{
+		std::cerr << "Warning: built without io_uring, using pread/pwrite" << std::endl;
+	}
+#endif
+	return std::make_unique<SyncIoEngine>(fd);
+}
@@ -0,0 +1,244 @@
+#include "Journal.h"
+
+#include "Structure.h"
+
+#include <array>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+constexpr std::array<uint32_t, 256> CRC32_TABLE = [] {
+	std::array<uint32_t, 256> table{};
+	for (uint32_t i = 0; i < table.size(); ++i)
+	{
+		uint32_t value = i;
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			value = (value & 1) != 0 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+		}
+		table[i] = value;
+	}
+	return table;
+}();
+
+uint32_t Crc32(const void* data, const size_t size, const uint32_t previous = 0)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	uint32_t crc = ~previous;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = CRC32_TABLE[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+uint32_t CalculateChecksum(TransactionHeader header, const char* payload)
+{
+	header.checksum = 0;
+	return Crc32(payload, header.payloadSize, Crc32(&header, sizeof(header)));
+}
+}
+
+Journal::Journal(const uint64_t offset, const uint32_t blocksCount, const uint64_t targetBegin, const uint64_t targetEnd,
+	ReadFunction read, WriteFunction write, SyncFunction sync)
+	: m_offset(offset)
+	, m_blocksCount(blocksCount)
+	, m_targetBegin(targetBegin)
+	, m_targetEnd(targetEnd)
+	, m_read(std::move(read))
+	, m_write(std::move(write))
+	, m_sync(std::move(sync))
+{
+}
+
+bool Journal::Format()
+{
+	m_committed.clear();
+	m_firstSequence = m_nextSequence;
+	return WriteHeader();
+}
+
+int Journal::Recover()
+{
+	JournalHeader header{};
+	if (!m_read(&header, sizeof(header), m_offset) || header.magic != JOURNAL_MAGIC)
+	{
+		std::cerr << "Error: Invalid journal header" << std::endl;
+		return -1;
+	}
+
+	std::vector<char> transactions(GetCapacity());
+	if (!m_read(transactions.data(), transactions.size(), m_offset + BLOCK_SIZE))
+	{
+		return -1;
+	}
+
+	uint64_t sequence = header.firstSequence;
+	int replayedCount = 0;
+	if (!Replay(transactions, sequence, replayedCount) || (replayedCount > 0 && !m_sync()))
+	{
+		return -1;
+	}
+
+	// Новые транзакции продолжают нумерацию, поэтому воспроизведённые уже не примут за действующие
+	m_committed.clear();
+	m_staged.clear();
+	m_stagedRecords = 0;
+	m_firstSequence = m_nextSequence = sequence;
+	return WriteHeader() ? replayedCount : -1;
+}
+
+void Journal::Stage(const uint64_t offset, const void* data, const size_t size)
+{
+	const JournalRecord record{ offset, static_cast<uint32_t>(size) };
+	const auto* recordBytes = reinterpret_cast<const char*>(&record);
+	m_staged.insert(m_staged.end(), recordBytes, recordBytes + sizeof(record));
+	m_staged.insert(m_staged.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	m_stagedRecords++;
+}
+
+size_t Journal::GetStagedSize() const
+{
+	return m_staged.size();
+}
+
+size_t Journal::GetCapacity() const
+{
+	return static_cast<size_t>(m_blocksCount - 1) * BLOCK_SIZE;
+}
+
+bool Journal::Commit()
+{
+	if (m_stagedRecords == 0)
+	{
+		return true;
+	}
+
+	TransactionHeader header{ TRANSACTION_MAGIC, m_stagedRecords, m_nextSequence, static_cast<uint32_t>(m_staged.size()), 0 };
+	header.checksum = CalculateChecksum(header, m_staged.data());
+	const size_t transactionSize = sizeof(header) + m_staged.size();
+
+	bool isCommitted;
+	if (transactionSize > GetCapacity())
+	{
+		// Транзакция не влезает даже в пустой журнал и пишется прямо на место, без атомарности
+		std::cerr << "Warning: Metadata transaction exceeds the journal, writing it in place" << std::endl;
+		isCommitted = Checkpoint() && ApplyRecords(m_staged.data(), m_staged.size());
+	}
+	else if (m_committed.size() + transactionSize > GetCapacity() && !Checkpoint())
+	{
+		isCommitted = false;
+	}
+	else
+	{
+		const size_t position = m_committed.size();
+		const auto* headerBytes = reinterpret_cast<const char*>(&header);
+		m_committed.insert(m_committed.end(), headerBytes, headerBytes + sizeof(header));
+		m_committed.insert(m_committed.end(), m_staged.begin(), m_staged.end());
+		isCommitted = m_write(m_committed.data() + position, transactionSize, m_offset + BLOCK_SIZE + position);
+		if (isCommitted)
+		{
+			m_nextSequence++;
+		}
+		else
+		{
+			m_committed.resize(position);
+		}
+	}
+
+	if (isCommitted)
+	{
+		m_staged.clear();
+		m_stagedRecords = 0;
+	}
+	return isCommitted;
+}
+
+bool Journal::Checkpoint()
+{
+	if (m_committed.empty())
+	{
+		return true;
+	}
+
+	// Журнал ложится на носитель раньше, чем его записи начинают менять образ на месте,
+	// а заголовок очищается только после того, как на носитель легли и они
+	uint64_t sequence = m_firstSequence;
+	int replayedCount = 0;
+	if (!m_sync() || !Replay(m_committed, sequence, replayedCount) || !m_sync())
+	{
+		return false;
+	}
+	m_committed.clear();
+	m_firstSequence = m_nextSequence;
+	return WriteHeader();
+}
+
+bool Journal::Replay(const std::vector<char>& transactions, uint64_t& sequence, int& replayedCount) const
+{
+	size_t position = 0;
+	while (transactions.size() - position >= sizeof(TransactionHeader))
+	{
+		TransactionHeader header{};
+		std::memcpy(&header, transactions.data() + position, sizeof(header));
+		const char* payload = transactions.data() + position + sizeof(header);
+		if (header.magic != TRANSACTION_MAGIC || header.sequence != sequence
+			|| header.payloadSize > transactions.size() - position - sizeof(header)
+			|| header.checksum != CalculateChecksum(header, payload))
+		{
+			break;
+		}
+
+		if (!ApplyRecords(payload, header.payloadSize))
+		{
+			return false;
+		}
+		position += sizeof(header) + header.payloadSize;
+		sequence++;
+		replayedCount++;
+	}
+	return true;
+}
+
+bool Journal::ApplyRecords(const char* records, const size_t size) const
+{
+	// Транзакция проверяется целиком до первой записи, чтобы не применить её наполовину
+	for (size_t position = 0; position < size;)
+	{
+		JournalRecord record{};
+		if (size - position < sizeof(record))
+		{
+			std::cerr << "Error: Malformed journal record" << std::endl;
+			return false;
+		}
+		std::memcpy(&record, records + position, sizeof(record));
+		position += sizeof(record);
+		if (record.length > size - position || record.offset < m_targetBegin || record.offset > m_targetEnd
+			|| record.length > m_targetEnd - record.offset)
+		{
+			std::cerr << "Error: Malformed journal record" << std::endl;
+			return false;
+		}
+		position += record.length;
+	}
+
+	for (size_t position = 0; position < size;)
+	{
+		JournalRecord record{};
+		std::memcpy(&record, records + position, sizeof(record));
+		position += sizeof(record);
+		if (!m_write(records + position, record.length, record.offset))
+		{
+			return false;
+		}
+		position += record.length;
+	}
+	return true;
+}
+
+bool Journal::WriteHeader()
+{
+	const JournalHeader header{ JOURNAL_MAGIC, 0, m_firstSequence };
+	return m_write(&header, sizeof(header), m_offset);
+}
@@ -0,0 +1,528 @@
+#include "LowLevelMountManager.h"
+#include "MountManager.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+using FileId = FileSystemManager::FileId;
+using DataRange = FileSystemManager::DataRange;
+
+// Снимок каталога, сделанный в opendir: readdir отдаёт его частями по смещению
+using DirectorySnapshot = std::vector<FileSystemManager::DirectoryEntry>;
+
+DirectorySnapshot* GetSnapshot(const fuse_file_info* fi)
+{
+	return reinterpret_cast<DirectorySnapshot*>(fi->fh);
+}
+}
+
+const fuse_lowlevel_ops LowLevelMountManager::m_operations = {
+	.init = Init,
+	.lookup = Lookup,
+	.forget = Forget,
+	.getattr = GetAttr,
+	.setattr = SetAttr,
+	.mkdir = Mkdir,
+	.unlink = Unlink,
+	.rmdir = Rmdir,
+	.rename = Rename,
+	.open = Open,
+	.read = Read,
+	.fsync = Fsync,
+	.opendir = OpenDir,
+	.readdir = ReadDir,
+	.releasedir = ReleaseDir,
+	.create = Create,
+	.write_buf = WriteBuf,
+	.fallocate = Fallocate,
+	.lseek = Lseek
+};
+
+LowLevelMountManager::LowLevelMountManager(FileSystemManager& fsManager)
+	: m_fileSystemManager(fsManager)
+{
+}
+
+int LowLevelMountManager::Run(const int argc, char* argv[]) const
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: ./myfs-mount <image_path> --low-level [--cache-timeout <s>] [--commit-interval <ms>] [--io-uring <queue_depth>] <mount_point>" << std::endl;
+		return 1;
+	}
+
+	Session session{ &m_fileSystemManager, DEFAULT_CACHE_TIMEOUT };
+	std::vector<char*> fuseArgs;
+	fuseArgs.push_back(argv[0]);
+	for (int i = 2; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--low-level") == 0)
+		{
+			continue;
+		}
+		if (std::strcmp(argv[i], "--cache-timeout") == 0 && i + 1 < argc)
+		{
+			session.cacheTimeout = std::stod(argv[++i]);
+			continue;
+		}
+		if (!MountManager::ParseImageOption(m_fileSystemManager, argc, argv, i))
+		{
+			fuseArgs.push_back(argv[i]);
+		}
+	}
+
+	fuse_args args = FUSE_ARGS_INIT(static_cast<int>(fuseArgs.size()), fuseArgs.data());
+	fuse_cmdline_opts options{};
+	if (fuse_parse_cmdline(&args, &options) != 0)
+	{
+		fuse_opt_free_args(&args);
+		return 1;
+	}
+	if (options.show_help || options.mountpoint == nullptr)
+	{
+		fuse_cmdline_help();
+		fuse_lowlevel_help();
+		free(options.mountpoint);
+		fuse_opt_free_args(&args);
+		return options.show_help ? 0 : 1;
+	}
+
+	int result = 1;
+	const std::string imagePath = argv[1];
+	if (m_fileSystemManager.OpenImage(imagePath))
+	{
+		fuse_session* fuseSession = fuse_session_new(&args, &m_operations, sizeof(m_operations), &session);
+		if (fuseSession != nullptr)
+		{
+			if (fuse_set_signal_handlers(fuseSession) == 0)
+			{
+				if (fuse_session_mount(fuseSession, options.mountpoint) == 0)
+				{
+					fuse_daemonize(options.foreground);
+					result = options.singlethread ? fuse_session_loop(fuseSession) : fuse_session_loop_mt(fuseSession, options.clone_fd);
+					fuse_session_unmount(fuseSession);
+				}
+				fuse_remove_signal_handlers(fuseSession);
+			}
+			fuse_session_destroy(fuseSession);
+		}
+	}
+
+	free(options.mountpoint);
+	fuse_opt_free_args(&args);
+	return result == 0 ? 0 : 1;
+}
+
+const LowLevelMountManager::Session& LowLevelMountManager::GetSession(fuse_req_t req)
+{
+	return *static_cast<const Session*>(fuse_req_userdata(req));
+}
+
+void LowLevelMountManager::FillStat(const fuse_ino_t ino, const FileEntry& entry, struct stat& stat)
+{
+	std::memset(&stat, 0, sizeof(struct stat));
+	stat.st_ino = ino;
+	if (entry.isDirectory)
+	{
+		stat.st_mode = S_IFDIR | 0755;
+		stat.st_nlink = 2;
+		return;
+	}
+	stat.st_mode = S_IFREG | 0644;
+	stat.st_nlink = 1;
+	stat.st_size = entry.size;
+	stat.st_blocks = static_cast<blkcnt_t>(entry.blocksCount) * (BLOCK_SIZE / 512);
+}
+
+bool LowLevelMountManager::GetChildPath(const FileSystemManager& fileSystem, const fuse_ino_t parent, const char* name,
+	std::string& path)
+{
+	if (!fileSystem.GetPath(parent, path))
+	{
+		return false;
+	}
+	if (!path.empty())
+	{
+		path += '/';
+	}
+	path += name;
+	return true;
+}
+
+void LowLevelMountManager::ReplyEntry(fuse_req_t req, const fuse_ino_t parent, const char* name, fuse_file_info* fi,
+	const bool isLookup)
+{
+	const Session& session = GetSession(req);
+	FileEntry entry{};
+	fuse_entry_param entryParam{};
+	entryParam.ino = session.fileSystem->Lookup(parent, name, entry);
+	entryParam.attr_timeout = session.cacheTimeout;
+	entryParam.entry_timeout = session.cacheTimeout;
+	if (entryParam.ino == FileSystemManager::NO_ID)
+	{
+		// Отсутствие записи ядро тоже запоминает: создать её можно только через него же
+		if (isLookup)
+		{
+			fuse_reply_entry(req, &entryParam);
+			return;
+		}
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	FillStat(entryParam.ino, entry, entryParam.attr);
+
+	if (fi == nullptr)
+	{
+		fuse_reply_entry(req, &entryParam);
+		return;
+	}
+	fi->fh = entryParam.ino;
+	fi->keep_cache = 1;
+	fuse_reply_create(req, &entryParam, fi);
+}
+
+void LowLevelMountManager::Init(void* userdata, fuse_conn_info* conn)
+{
+	(void)userdata;
+	// Чтение отдаёт ядру куски образа, а запись забирает данные из канала FUSE, не копируя их в память процесса
+	conn->want |= conn->capable & (FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE);
+}
+
+void LowLevelMountManager::Lookup(fuse_req_t req, const fuse_ino_t parent, const char* name)
+{
+	ReplyEntry(req, parent, name, nullptr, true);
+}
+
+void LowLevelMountManager::Forget(fuse_req_t req, const fuse_ino_t ino, const uint64_t lookupCount)
+{
+	// Идентификатор сам проверяет, жива ли запись, поэтому счётчики lookup не нужны
+	(void)ino;
+	(void)lookupCount;
+	fuse_reply_none(req);
+}
+
+void LowLevelMountManager::GetAttr(fuse_req_t req, const fuse_ino_t ino, fuse_file_info* fi)
+{
+	(void)fi;
+	const Session& session = GetSession(req);
+	FileEntry entry{};
+	if (!session.fileSystem->GetFileStat(static_cast<FileId>(ino), entry))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	struct stat stat{};
+	FillStat(ino, entry, stat);
+	fuse_reply_attr(req, &stat, session.cacheTimeout);
+}
+
+void LowLevelMountManager::SetAttr(fuse_req_t req, const fuse_ino_t ino, struct stat* attr, const int toSet, fuse_file_info* fi)
+{
+	// Права, владельцы и времена не хранятся, поэтому меняется только размер
+	if ((toSet & FUSE_SET_ATTR_SIZE) != 0
+		&& !GetSession(req).fileSystem->TruncateFile(static_cast<FileId>(ino), static_cast<uint64_t>(attr->st_size)))
+	{
+		fuse_reply_err(req, EIO);
+		return;
+	}
+	GetAttr(req, ino, fi);
+}
+
+void LowLevelMountManager::Mkdir(fuse_req_t req, const fuse_ino_t parent, const char* name, const mode_t mode)
+{
+	(void)mode;
+	FileSystemManager& fileSystem = *GetSession(req).fileSystem;
+	std::string path;
+	if (!GetChildPath(fileSystem, parent, name, path))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	if (!fileSystem.CreateDirectory(path))
+	{
+		FileEntry entry{};
+		fuse_reply_err(req, fileSystem.GetFileStat(path, entry) ? EEXIST : ENOSPC);
+		return;
+	}
+	ReplyEntry(req, parent, name, nullptr, false);
+}
+
+void LowLevelMountManager::Unlink(fuse_req_t req, const fuse_ino_t parent, const char* name)
+{
+	FileSystemManager& fileSystem = *GetSession(req).fileSystem;
+	std::string path;
+	fuse_reply_err(req, GetChildPath(fileSystem, parent, name, path) && fileSystem.RemoveFile(path) ? 0 : ENOENT);
+}
+
+void LowLevelMountManager::Rmdir(fuse_req_t req, const fuse_ino_t parent, const char* name)
+{
+	FileSystemManager& fileSystem = *GetSession(req).fileSystem;
+	FileEntry entry{};
+	std::string path;
+	if (fileSystem.Lookup(parent, name, entry) == FileSystemManager::NO_ID || !GetChildPath(fileSystem, parent, name, path))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	if (!entry.isDirectory)
+	{
+		fuse_reply_err(req, ENOTDIR);
+		return;
+	}
+	fuse_reply_err(req, fileSystem.RemoveDirectory(path) ? 0 : ENOTEMPTY);
+}
+
+void LowLevelMountManager::Rename(fuse_req_t req, const fuse_ino_t parent, const char* name, const fuse_ino_t newParent,
+	const char* newName, const unsigned int flags)
+{
+	// RENAME_NOREPLACE и RENAME_EXCHANGE не поддерживаются
+	if (flags != 0)
+	{
+		fuse_reply_err(req, EINVAL);
+		return;
+	}
+	FileSystemManager& fileSystem = *GetSession(req).fileSystem;
+	std::string from;
+	std::string to;
+	if (!GetChildPath(fileSystem, parent, name, from) || !GetChildPath(fileSystem, newParent, newName, to))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	FileEntry entry{};
+	if (!fileSystem.GetFileStat(from, entry))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	fuse_reply_err(req, fileSystem.Rename(from, to) ? 0 : EINVAL);
+}
+
+void LowLevelMountManager::Open(fuse_req_t req, const fuse_ino_t ino, fuse_file_info* fi)
+{
+	FileEntry entry{};
+	if (!GetSession(req).fileSystem->GetFileStat(static_cast<FileId>(ino), entry))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	if (entry.isDirectory)
+	{
+		fuse_reply_err(req, EISDIR);
+		return;
+	}
+	// Данные меняются только через это монтирование, поэтому страничный кэш ядра можно не сбрасывать при открытии
+	fi->fh = ino;
+	fi->keep_cache = 1;
+	fuse_reply_open(req, fi);
+}
+
+void LowLevelMountManager::Read(fuse_req_t req, const fuse_ino_t ino, const size_t size, const off_t offset, fuse_file_info* fi)
+{
+	(void)ino;
+	// Ответ собирается из кусков образа, и libfuse переносит их в канал FUSE через splice.
+	// Дыры отдаются из буфера нулей. fuse_reply_data завершает запрос, даже если передать данные не удалось
+	bool isReplied = false;
+	const int result = GetSession(req).fileSystem->ReadDataDirect(fi->fh, static_cast<uint64_t>(offset), size,
+		[req, &isReplied](const int imageFd, const std::vector<DataRange>& ranges) {
+			const size_t vectorSize = sizeof(fuse_bufvec) + (ranges.size() - 1) * sizeof(fuse_buf);
+			const std::unique_ptr<char[]> storage(new char[vectorSize]);
+			auto* bufferVector = reinterpret_cast<fuse_bufvec*>(storage.get());
+			bufferVector->count = ranges.size();
+			bufferVector->idx = 0;
+			bufferVector->off = 0;
+
+			uint64_t zerosSize = 0;
+			for (const auto& [imageOffset, length] : ranges)
+			{
+				if (imageOffset == FileSystemManager::HOLE_OFFSET)
+				{
+					zerosSize = std::max(zerosSize, length);
+				}
+			}
+			std::vector<char> zeros(zerosSize, 0);
+
+			for (size_t i = 0; i < ranges.size(); ++i)
+			{
+				fuse_buf& buffer = bufferVector->buf[i];
+				buffer = {};
+				buffer.size = ranges[i].length;
+				if (ranges[i].imageOffset == FileSystemManager::HOLE_OFFSET)
+				{
+					buffer.mem = zeros.data();
+					continue;
+				}
+				buffer.flags = static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+				buffer.fd = imageFd;
+				buffer.pos = static_cast<off_t>(ranges[i].imageOffset);
+			}
+			isReplied = true;
+			return fuse_reply_data(req, bufferVector, FUSE_BUF_SPLICE_MOVE) == 0;
+		});
+
+	if (isReplied)
+	{
+		return;
+	}
+	if (result == -1)
+	{
+		fuse_reply_err(req, EIO);
+		return;
+	}
+	// Чтение за концом файла
+	fuse_reply_buf(req, nullptr, 0);
+}
+
+void LowLevelMountManager::WriteBuf(fuse_req_t req, const fuse_ino_t ino, fuse_bufvec* source, const off_t offset,
+	fuse_file_info* fi)
+{
+	(void)ino;
+	// Если данные пришли в канале, fuse_buf_copy переносит их в образ через splice. Копирование
+	// сдвигает позицию в source, поэтому каждый кусок образа получает следующую часть данных
+	const size_t size = fuse_buf_size(source);
+	const int result = GetSession(req).fileSystem->WriteDataDirect(fi->fh, static_cast<uint64_t>(offset), size,
+		[source](const int imageFd, const std::vector<DataRange>& ranges) {
+			for (const auto& [imageOffset, length] : ranges)
+			{
+				fuse_bufvec destination = FUSE_BUFVEC_INIT(length);
+				destination.buf[0].flags = static_cast<fuse_buf_flags>(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+				destination.buf[0].fd = imageFd;
+				destination.buf[0].pos = static_cast<off_t>(imageOffset);
+				if (fuse_buf_copy(&destination, source, static_cast<fuse_buf_copy_flags>(0)) != static_cast<ssize_t>(length))
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+
+	if (result == -1)
+	{
+		fuse_reply_err(req, ENOSPC);
+		return;
+	}
+	fuse_reply_write(req, static_cast<size_t>(result));
+}
+
+void LowLevelMountManager::Fsync(fuse_req_t req, const fuse_ino_t ino, const int isDataSync, fuse_file_info* fi)
+{
+	(void)ino;
+	(void)isDataSync;
+	(void)fi;
+	fuse_reply_err(req, GetSession(req).fileSystem->Sync() ? 0 : EIO);
+}
+
+void LowLevelMountManager::OpenDir(fuse_req_t req, const fuse_ino_t ino, fuse_file_info* fi)
+{
+	auto snapshot = std::make_unique<DirectorySnapshot>();
+	if (!GetSession(req).fileSystem->ReadDirectory(static_cast<FileId>(ino), *snapshot))
+	{
+		fuse_reply_err(req, ENOTDIR);
+		return;
+	}
+	fi->fh = reinterpret_cast<uint64_t>(snapshot.release());
+	if (fuse_reply_open(req, fi) != 0)
+	{
+		delete GetSnapshot(fi);
+	}
+}
+
+void LowLevelMountManager::ReadDir(fuse_req_t req, const fuse_ino_t ino, const size_t size, const off_t offset,
+	fuse_file_info* fi)
+{
+	// Смещения 0 и 1 - "." и "..", дальше записи снимка по порядку
+	const DirectorySnapshot& snapshot = *GetSnapshot(fi);
+	std::vector<char> buffer(size);
+	size_t used = 0;
+	for (auto position = static_cast<size_t>(offset); position < snapshot.size() + 2; ++position)
+	{
+		struct stat stat{};
+		const char* name;
+		if (position < 2)
+		{
+			name = position == 0 ? "." : "..";
+			stat.st_ino = ino;
+			stat.st_mode = S_IFDIR;
+		}
+		else
+		{
+			const auto& entry = snapshot[position - 2];
+			name = entry.name.c_str();
+			stat.st_ino = entry.id;
+			stat.st_mode = entry.isDirectory ? S_IFDIR : S_IFREG;
+		}
+
+		const size_t entrySize = fuse_add_direntry(req, buffer.data() + used, size - used, name, &stat,
+			static_cast<off_t>(position + 1));
+		if (entrySize > size - used)
+		{
+			break;
+		}
+		used += entrySize;
+	}
+	fuse_reply_buf(req, buffer.data(), used);
+}
+
+void LowLevelMountManager::ReleaseDir(fuse_req_t req, const fuse_ino_t ino, fuse_file_info* fi)
+{
+	(void)ino;
+	delete GetSnapshot(fi);
+	fuse_reply_err(req, 0);
+}
+
+void LowLevelMountManager::Create(fuse_req_t req, const fuse_ino_t parent, const char* name, const mode_t mode,
+	fuse_file_info* fi)
+{
+	(void)mode;
+	FileSystemManager& fileSystem = *GetSession(req).fileSystem;
+	std::string path;
+	if (!GetChildPath(fileSystem, parent, name, path))
+	{
+		fuse_reply_err(req, ENOENT);
+		return;
+	}
+	if (!fileSystem.CreateFile(path))
+	{
+		FileEntry entry{};
+		fuse_reply_err(req, fileSystem.GetFileStat(path, entry) ? EEXIST : ENOSPC);
+		return;
+	}
+	ReplyEntry(req, parent, name, fi, false);
+}
+
+void LowLevelMountManager::Fallocate(fuse_req_t req, const fuse_ino_t ino, const int mode, const off_t offset,
+	const off_t length, fuse_file_info* fi)
+{
+	(void)ino;
+	// Поддерживается только освобождение диапазона без изменения размера
+	if (mode != (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE))
+	{
+		fuse_reply_err(req, EOPNOTSUPP);
+		return;
+	}
+	const bool isPunched = GetSession(req).fileSystem->PunchHole(fi->fh, static_cast<uint64_t>(offset), static_cast<uint64_t>(length));
+	fuse_reply_err(req, isPunched ? 0 : EIO);
+}
+
+void LowLevelMountManager::Lseek(fuse_req_t req, const fuse_ino_t ino, const off_t offset, const int whence, fuse_file_info* fi)
+{
+	(void)ino;
+	// Остальные whence ядро обрабатывает само
+	if (whence != SEEK_DATA && whence != SEEK_HOLE)
+	{
+		fuse_reply_err(req, EINVAL);
+		return;
+	}
+	const int64_t result = GetSession(req).fileSystem->SeekData(fi->fh, static_cast<uint64_t>(offset), whence == SEEK_HOLE);
+	if (result == -1)
+	{
+		fuse_reply_err(req, ENXIO);
+		return;
+	}
+	fuse_reply_lseek(req, static_cast<off_t>(result));
+}
@@ -1,16 +1,23 @@
 #include "MountManager.h"
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 
 fuse_operations MountManager::m_fuseOperators = {
 	.getattr = GetAttr,
+	.mkdir = Mkdir,
 	.unlink = Unlink,
+	.rmdir = Rmdir,
+	.rename = Rename,
 	.truncate = Truncate,
 	.open = Open,
 	.read = Read,
 	.write = Write,
+	.fsync = Fsync,
 	.readdir = ReadDir,
-	.create = Create
+	.create = Create,
+	.fallocate = Fallocate,
+	.lseek = Lseek
 };
 
 MountManager::MountManager(FileSystemManager& fsManager)
@@ -22,24 +29,43 @@ int MountManager::Run(const int argc, char* argv[]) const
 {
 	if (argc < 3)
 	{
-		std::cerr << "Usage: ./myfs-mount <image_path> <mount_point>" << std::endl;
+		std::cerr << "Usage: ./myfs-mount <image_path> [--low-level [--cache-timeout <s>]] [--commit-interval <ms>] [--io-uring <queue_depth>] <mount_point>" << std::endl;
 		return 1;
 	}
 
+	// Параметры образа разбираются до его открытия: исполнитель ввода-вывода создаётся при открытии
+	std::vector<char*> fuseArgs;
+	fuseArgs.push_back(argv[0]);
+	for (int i = 2; i < argc; ++i)
+	{
+		if (!ParseImageOption(m_fileSystemManager, argc, argv, i))
+		{
+			fuseArgs.push_back(argv[i]);
+		}
+	}
+
 	const std::string imagePath = argv[1];
 	if (!m_fileSystemManager.OpenImage(imagePath))
 	{
 		return 1;
 	}
 
-	std::vector<char*> fuseArgs;
-	fuseArgs.push_back(argv[0]);
-	for (int i = 2; i < argc; ++i)
+	return fuse_main(static_cast<int>(fuseArgs.size()), fuseArgs.data(), &m_fuseOperators, &m_fileSystemManager);
+}
+
+bool MountManager::ParseImageOption(FileSystemManager& fileSystem, const int argc, char* argv[], int& index)
+{
+	if (std::strcmp(argv[index], "--commit-interval") == 0 && index + 1 < argc)
 	{
-		fuseArgs.push_back(argv[i]);
+		fileSystem.SetCommitInterval(std::chrono::milliseconds(std::stoul(argv[++index])));
+		return true;
 	}
-
-	return fuse_main(static_cast<int>(fuseArgs.size()), fuseArgs.data(), &m_fuseOperators, &m_fileSystemManager);
+	if (std::strcmp(argv[index], "--io-uring") == 0 && index + 1 < argc)
+	{
+		fileSystem.SetIoEngine(IoEngineKind::Uring, static_cast<uint32_t>(std::stoul(argv[++index])));
+		return true;
+	}
+	return false;
 }
 
 FileSystemManager* MountManager::GetFileSystem()
@@ -72,9 +98,17 @@ int MountManager::GetAttr(const char* path, struct stat* stbuf, fuse_file_info*
 	FileEntry entry{};
 	if (GetFileSystem()->GetFileStat(fileName, entry))
 	{
+		if (entry.isDirectory)
+		{
+			stbuf->st_mode = S_IFDIR | 0755;
+			stbuf->st_nlink = 2;
+			return 0;
+		}
 		stbuf->st_mode = S_IFREG | 0644;
 		stbuf->st_nlink = 1;
 		stbuf->st_size = entry.size;
+		// Дыры блоков не занимают, поэтому du показывает только выделенное место
+		stbuf->st_blocks = static_cast<blkcnt_t>(entry.blocksCount) * (BLOCK_SIZE / 512);
 		return 0;
 	}
 	return -ENOENT;
@@ -112,6 +146,29 @@ int MountManager::Write(
 	return result;
 }
 
+int MountManager::Fsync(const char* path, const int isDataSync, fuse_file_info* fi)
+{
+	(void)path;
+	(void)isDataSync;
+	(void)fi;
+	return GetFileSystem()->Sync() ? 0 : -EIO;
+}
+
+int MountManager::Fallocate(const char* path, const int mode, const off_t offset, const off_t length, fuse_file_info* fi)
+{
+	(void)fi;
+	// Поддерживается только освобождение диапазона без изменения размера
+	if (mode != (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE))
+	{
+		return -EOPNOTSUPP;
+	}
+	if (!GetFileSystem()->PunchHole(ExtractFileName(path), static_cast<uint64_t>(offset), static_cast<uint64_t>(length)))
+	{
+		return -EIO;
+	}
+	return 0;
+}
+
 int MountManager::ReadDir(
 	const char* path,
 	void* buf,
@@ -123,7 +180,9 @@ int MountManager::ReadDir(
 	(void)offset;
 	(void)fi;
 	(void)flags;
-	if (ExtractFileName(path) != "/")
+	const std::string directoryName = ExtractFileName(path);
+	std::vector<std::string> names;
+	if (!GetFileSystem()->ReadDirectory(directoryName == "/" ? "" : directoryName, names))
 	{
 		return -ENOENT;
 	}
@@ -131,9 +190,9 @@ int MountManager::ReadDir(
 	filler(buf, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
 	filler(buf, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
 
-	for (const auto& file : GetFileSystem()->GetFileList())
+	for (const auto& name : names)
 	{
-		filler(buf, file.name, nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+		filler(buf, name.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
 	}
 	return 0;
 }
@@ -149,6 +208,22 @@ int MountManager::Create(const char* path, mode_t mode, fuse_file_info* fi)
 	return 0;
 }
 
+off_t MountManager::Lseek(const char* path, const off_t offset, const int whence, fuse_file_info* fi)
+{
+	(void)fi;
+	// Остальные whence ядро обрабатывает само
+	if (whence != SEEK_DATA && whence != SEEK_HOLE)
+	{
+		return -EINVAL;
+	}
+	const int64_t result = GetFileSystem()->SeekData(ExtractFileName(path), static_cast<uint64_t>(offset), whence == SEEK_HOLE);
+	if (result == -1)
+	{
+		return -ENXIO;
+	}
+	return static_cast<off_t>(result);
+}
+
 int MountManager::Unlink(const char* path)
 {
 	if (!GetFileSystem()->RemoveFile(ExtractFileName(path)))
@@ -177,4 +252,55 @@ int MountManager::Open(const char* path, fuse_file_info* fi)
 		return -ENOENT;
 	}
 	return 0;
+}
+
+int MountManager::Mkdir(const char* path, mode_t mode)
+{
+	(void)mode;
+	const std::string directoryName = ExtractFileName(path);
+	if (!GetFileSystem()->CreateDirectory(directoryName))
+	{
+		FileEntry entry{};
+		return GetFileSystem()->GetFileStat(directoryName, entry) ? -EEXIST : -ENOSPC;
+	}
+	return 0;
+}
+
+int MountManager::Rmdir(const char* path)
+{
+	const std::string directoryName = ExtractFileName(path);
+	FileEntry entry{};
+	if (!GetFileSystem()->GetFileStat(directoryName, entry))
+	{
+		return -ENOENT;
+	}
+	if (!entry.isDirectory)
+	{
+		return -ENOTDIR;
+	}
+	if (!GetFileSystem()->RemoveDirectory(directoryName))
+	{
+		return -ENOTEMPTY;
+	}
+	return 0;
+}
+
+int MountManager::Rename(const char* from, const char* to, const unsigned int flags)
+{
+	// RENAME_NOREPLACE и RENAME_EXCHANGE не поддерживаются
+	if (flags != 0)
+	{
+		return -EINVAL;
+	}
+	const std::string fromName = ExtractFileName(from);
+	FileEntry entry{};
+	if (!GetFileSystem()->GetFileStat(fromName, entry))
+	{
+		return -ENOENT;
+	}
+	if (!GetFileSystem()->Rename(fromName, ExtractFileName(to)))
+	{
+		return -EINVAL;
+	}
+	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "FileSystemManager.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+void PrintStats(const std::string& title, const FragmentationStats& stats)
+{
+	std::cout << title << ": free blocks " << stats.freeBlocks << " in " << stats.freeRuns << " runs, largest run "
+			  << stats.largestFreeRun << "; files " << stats.files << ", fragmented " << stats.fragmentedFiles
+			  << ", data extents " << stats.dataExtents << ", tail blocks " << stats.tailBlocks << std::endl;
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: defrag <image_path> [--stats]" << std::endl;
+		return 1;
+	}
+
+	const std::string path = argv[1];
+	const bool statsOnly = argc > 2 && std::string(argv[2]) == "--stats";
+
+	FileSystemManager fs;
+	if (!fs.OpenImage(path))
+	{
+		return 1;
+	}
+	PrintStats("Before", fs.GetFragmentationStats());
+	if (statsOnly)
+	{
+		return 0;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	uint32_t passes = 0;
+	const int64_t movedBlocks = fs.Compact(&passes);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	if (movedBlocks == -1)
+	{
+		std::cerr << "Error: Compaction failed" << std::endl;
+		return 1;
+	}
+	PrintStats("After", fs.GetFragmentationStats());
+	fs.CloseImage();
+	std::cout << "Moved " << movedBlocks << " blocks in " << passes << " passes, " << elapsed.count() << " ms" << std::endl;
+	return 0;
+}
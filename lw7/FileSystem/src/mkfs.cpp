@@ -1,4 +1,6 @@
 #include "FileSystemManager.h"
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -20,19 +22,23 @@ int main(const int argc, char* argv[])
 {
 	if (argc < 6)
 	{
-		std::cout << "Usage: mkfs <image_path> --size <size> --max-files <count>" << std::endl;
+		std::cout << "Usage: mkfs <image_path> --size <size> --max-files <count> [--preallocate]" << std::endl;
 		return 1;
 	}
 
 	const std::string path = argv[1];
 	const uint64_t size = ParseSize(argv[3]);
 	const uint32_t maxFiles = std::stoul(argv[5]);
+	const bool preallocate = argc > 6 && std::strcmp(argv[6], "--preallocate") == 0;
 
+	const auto start = std::chrono::steady_clock::now();
 	FileSystemManager fs;
-	if (!fs.CreateImage(path, size, maxFiles))
+	if (!fs.CreateImage(path, size, maxFiles, preallocate))
 	{
 		return 1;
 	}
-	std::cout << "Image created successfully: " << path << std::endl;
+	fs.CloseImage();
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	std::cout << "Image created successfully: " << path << " in " << elapsed.count() << " ms" << std::endl;
 	return 0;
 }
\ No newline at end of file
@@ -1,9 +1,20 @@
 #include "FileSystemManager.h"
+#include "LowLevelMountManager.h"
 #include "MountManager.h"
 
+#include <algorithm>
+#include <cstring>
+
 int main(const int argc, char* argv[])
 {
 	FileSystemManager fsManager;
+
+	// --low-level монтирует через низкоуровневый API FUSE, иначе используется API с путями
+	if (std::any_of(argv + 1, argv + argc, [](const char* arg) { return std::strcmp(arg, "--low-level") == 0; }))
+	{
+		const LowLevelMountManager mountManager(fsManager);
+		return mountManager.Run(argc, argv);
+	}
 	const MountManager mountManager(fsManager);
 
 	return mountManager.Run(argc, argv);
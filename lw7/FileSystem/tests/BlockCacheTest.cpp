@@ -0,0 +1,205 @@
+#include "gtest/gtest.h"
+
+#include "../include/BlockCache.h"
+#include "../include/Structure.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Кэш работает поверх образа в памяти, все обращения к которому записываются
+class BlockCacheTest : public ::testing::Test
+{
+protected:
+	static constexpr uint64_t DISK_BLOCKS = 64;
+
+	struct IoRecord
+	{
+		uint64_t firstBlock;
+		int blocksCount;
+	};
+
+	BlockCacheTest()
+		: m_disk(DISK_BLOCKS * BLOCK_SIZE, '\0')
+	{
+	}
+
+	// Чтение за пределами образа не выполняется, как и у настоящего образа
+	void CreateCache(const size_t capacityBlocks, const uint64_t blocksLimit = DISK_BLOCKS)
+	{
+		m_cache = std::make_unique<BlockCache>(
+			capacityBlocks, blocksLimit,
+			[this, blocksLimit](iovec* vectors, const int count, const uint64_t offset) {
+				return Transfer(vectors, count, offset, blocksLimit, false);
+			},
+			[this](iovec* vectors, const int count, const uint64_t offset) {
+				return Transfer(vectors, count, offset, DISK_BLOCKS, true);
+			});
+	}
+
+	bool Transfer(const iovec* vectors, const int count, uint64_t offset, const uint64_t blocksLimit, const bool isWrite)
+	{
+		(isWrite ? m_writes : m_reads).push_back({ offset / BLOCK_SIZE, count });
+		for (int i = 0; i < count; ++i)
+		{
+			if (offset + vectors[i].iov_len > blocksLimit * BLOCK_SIZE)
+			{
+				return false;
+			}
+			char* disk = m_disk.data() + offset;
+			isWrite ? std::memcpy(disk, vectors[i].iov_base, vectors[i].iov_len)
+					: std::memcpy(vectors[i].iov_base, disk, vectors[i].iov_len);
+			offset += vectors[i].iov_len;
+		}
+		return true;
+	}
+
+	void WriteBlock(const uint64_t block, const char fill)
+	{
+		const std::string data(BLOCK_SIZE, fill);
+		ASSERT_TRUE(m_cache->Write(data.data(), data.size(), block * BLOCK_SIZE));
+	}
+
+	std::string ReadBlock(const uint64_t block)
+	{
+		std::string data(BLOCK_SIZE, '\0');
+		EXPECT_TRUE(m_cache->Read(data.data(), data.size(), block * BLOCK_SIZE));
+		return data;
+	}
+
+	// Перенос в обход кэша
+	void WriteDisk(const uint64_t block, const char fill)
+	{
+		std::memset(m_disk.data() + block * BLOCK_SIZE, fill, BLOCK_SIZE);
+	}
+
+	std::string ReadDisk(const uint64_t block) const
+	{
+		return m_disk.substr(block * BLOCK_SIZE, BLOCK_SIZE);
+	}
+
+	static std::string Filled(const char fill)
+	{
+		return std::string(BLOCK_SIZE, fill);
+	}
+
+	std::string m_disk;
+	std::vector<IoRecord> m_reads;
+	std::vector<IoRecord> m_writes;
+	std::unique_ptr<BlockCache> m_cache;
+};
+
+TEST_F(BlockCacheTest, EvictingDirtyBlockWritesBackAllDirtyBlocks)
+{
+	CreateCache(6);
+	WriteBlock(3, 'c');
+	WriteBlock(1, 'a');
+	WriteBlock(2, 'b');
+	for (const uint64_t block : { 10, 20, 30 })
+	{
+		EXPECT_EQ(ReadBlock(block), Filled('\0'));
+	}
+	EXPECT_TRUE(m_writes.empty());
+
+	// Вытесняется блок 3, использованный раньше всех, и с ним на диск одной записью уходят соседи
+	WriteBlock(5, 'e');
+	ASSERT_EQ(m_writes.size(), 1u);
+	EXPECT_EQ(m_writes[0].firstBlock, 1u);
+	EXPECT_EQ(m_writes[0].blocksCount, 3);
+	EXPECT_EQ(ReadDisk(1) + ReadDisk(2) + ReadDisk(3), Filled('a') + Filled('b') + Filled('c'));
+	EXPECT_EQ(ReadDisk(5), Filled('\0'));
+
+	// Следующим вытесняется уже чистый блок 1, без записи
+	WriteBlock(6, 'f');
+	EXPECT_EQ(m_writes.size(), 1u);
+	const size_t reads = m_reads.size();
+	EXPECT_EQ(ReadBlock(2), Filled('b'));
+	EXPECT_EQ(m_reads.size(), reads);
+	EXPECT_EQ(ReadBlock(1), Filled('a'));
+	EXPECT_EQ(m_reads.size(), reads + 1);
+	EXPECT_EQ(m_reads.back().firstBlock, 1u);
+}
+
+TEST_F(BlockCacheTest, ReadAheadStopsAtBlocksLimit)
+{
+	CreateCache(64, 10);
+	EXPECT_EQ(ReadBlock(6), Filled('\0'));
+	// Последовательное чтение открывает окно упреждения, но за конец образа оно не заходит
+	EXPECT_EQ(ReadBlock(7), Filled('\0'));
+	ASSERT_EQ(m_reads.size(), 2u);
+	EXPECT_EQ(m_reads[1].firstBlock, 7u);
+	EXPECT_EQ(m_reads[1].blocksCount, 3);
+	EXPECT_EQ(m_cache->GetStats().readAheadBlocks, 2u);
+
+	EXPECT_EQ(ReadBlock(8), Filled('\0'));
+	EXPECT_EQ(ReadBlock(9), Filled('\0'));
+	EXPECT_EQ(m_reads.size(), 2u);
+}
+
+TEST_F(BlockCacheTest, InvalidatedBlocksAreNotWrittenBack)
+{
+	CreateCache(8);
+	WriteDisk(1, 'o');
+	WriteDisk(2, 'o');
+	for (uint64_t block = 0; block < 4; ++block)
+	{
+		WriteBlock(block, 'n');
+	}
+	m_cache->Invalidate(1, 2);
+	ASSERT_TRUE(m_cache->Flush());
+
+	ASSERT_EQ(m_writes.size(), 2u);
+	EXPECT_EQ(m_writes[0].firstBlock, 0u);
+	EXPECT_EQ(m_writes[1].firstBlock, 3u);
+	EXPECT_EQ(ReadDisk(1), Filled('o'));
+	EXPECT_EQ(ReadDisk(2), Filled('o'));
+	EXPECT_EQ(ReadBlock(1), Filled('o'));
+
+	// Вытеснение тоже не должно их записывать
+	WriteBlock(5, 'n');
+	m_cache->Invalidate(5, 1);
+	for (uint64_t block = 10; block < 20; ++block)
+	{
+		ReadBlock(block);
+	}
+	EXPECT_EQ(m_writes.size(), 2u);
+	EXPECT_EQ(ReadDisk(5), Filled('\0'));
+}
+
+TEST_F(BlockCacheTest, FlushRangeAndEvictPrepareDirectTransfers)
+{
+	CreateCache(8);
+	WriteBlock(2, 'c');
+	WriteBlock(3, 'c');
+	WriteBlock(7, 'x');
+
+	// Перед чтением в обход кэша изменённые блоки диапазона записываются, но остаются в кэше
+	ASSERT_TRUE(m_cache->FlushRange(2, 2));
+	ASSERT_EQ(m_writes.size(), 1u);
+	EXPECT_EQ(m_writes[0].firstBlock, 2u);
+	EXPECT_EQ(m_writes[0].blocksCount, 2);
+	EXPECT_EQ(ReadDisk(2) + ReadDisk(3), Filled('c') + Filled('c'));
+	EXPECT_EQ(ReadDisk(7), Filled('\0'));
+	EXPECT_TRUE(m_reads.empty());
+	EXPECT_EQ(ReadBlock(3), Filled('c'));
+	EXPECT_TRUE(m_reads.empty());
+
+	// Перед записью в обход кэша блоки ещё и выбрасываются, и следующее чтение видит новые данные
+	WriteBlock(3, 'd');
+	ASSERT_TRUE(m_cache->Evict(2, 2));
+	ASSERT_EQ(m_writes.size(), 2u);
+	EXPECT_EQ(ReadDisk(3), Filled('d'));
+	WriteDisk(2, 'e');
+	WriteDisk(3, 'e');
+	EXPECT_EQ(ReadBlock(2), Filled('e'));
+	EXPECT_EQ(ReadBlock(3), Filled('e'));
+
+	// Диапазон длиннее кэша обходится по списку блоков
+	ASSERT_TRUE(m_cache->FlushRange(0, DISK_BLOCKS));
+	EXPECT_EQ(ReadDisk(7), Filled('x'));
+	ASSERT_TRUE(m_cache->Evict(0, DISK_BLOCKS));
+	WriteDisk(7, 'y');
+	EXPECT_EQ(ReadBlock(7), Filled('y'));
+}
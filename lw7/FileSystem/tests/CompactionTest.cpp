@@ -0,0 +1,139 @@
+#include "ImageTest.h"
+
+#include <string>
+
+class CompactionTest : public ImageTest
+{
+protected:
+	CompactionTest()
+		: ImageTest("compaction", 64)
+	{
+	}
+
+	// Дозапись маленькими кусками оставляет за концом файла запас
+	void Append(const std::string& path, const std::string& data)
+	{
+		for (size_t offset = 0; offset < data.size(); offset += 1000)
+		{
+			const std::string piece = data.substr(offset, 1000);
+			ASSERT_EQ(m_fs->WriteData(path, piece.data(), piece.size(), offset), static_cast<int>(piece.size()));
+		}
+	}
+
+	static std::string Content(const int file, const size_t size)
+	{
+		std::string data(size, static_cast<char>('a' + file % 26));
+		data.replace(0, std::to_string(file).size(), std::to_string(file));
+		return data;
+	}
+};
+
+TEST_F(CompactionTest, TrimsTailsAndGathersFreeSpace)
+{
+	constexpr int FILES = 32;
+	constexpr size_t FILE_SIZE = 9 * BLOCK_SIZE + 100;
+	for (int file = 0; file < FILES; ++file)
+	{
+		ASSERT_TRUE(m_fs->CreateFile("f" + std::to_string(file)));
+		Append("f" + std::to_string(file), Content(file, FILE_SIZE));
+	}
+	for (int file = 0; file < FILES; file += 2)
+	{
+		ASSERT_TRUE(m_fs->RemoveFile("f" + std::to_string(file)));
+	}
+	// Блоки удалённых файлов становятся свободными после фиксации
+	ASSERT_TRUE(m_fs->Sync());
+	const FragmentationStats before = m_fs->GetFragmentationStats();
+	EXPECT_GT(before.tailBlocks, 0u);
+	EXPECT_GT(before.freeRuns, 1u);
+
+	ASSERT_GT(m_fs->Compact(), 0);
+	const FragmentationStats after = m_fs->GetFragmentationStats();
+	EXPECT_EQ(after.tailBlocks, 0u);
+	EXPECT_EQ(after.freeBlocks, before.freeBlocks + before.tailBlocks);
+	EXPECT_EQ(after.freeRuns, 1u);
+	EXPECT_EQ(after.largestFreeRun, after.freeBlocks);
+	EXPECT_EQ(after.files, static_cast<uint32_t>(FILES / 2));
+
+	Reopen();
+	EXPECT_EQ(m_fs->GetFragmentationStats().largestFreeRun, after.freeBlocks);
+	for (int file = 1; file < FILES; file += 2)
+	{
+		EXPECT_EQ(Read("f" + std::to_string(file), 0, FILE_SIZE + 1), Content(file, FILE_SIZE));
+	}
+}
+
+TEST_F(CompactionTest, MakesFragmentedFilesContiguous)
+{
+	// Попеременная запись в два файла перемежает их блоки
+	ASSERT_TRUE(m_fs->CreateFile("kept"));
+	ASSERT_TRUE(m_fs->CreateFile("removed"));
+	std::string kept;
+	for (uint64_t block = 0; block < 64; ++block)
+	{
+		const std::string data(BLOCK_SIZE, static_cast<char>('a' + block % 26));
+		ASSERT_EQ(m_fs->WriteData("kept", data.data(), data.size(), block * BLOCK_SIZE), static_cast<int>(data.size()));
+		ASSERT_EQ(m_fs->WriteData("removed", data.data(), data.size(), block * BLOCK_SIZE), static_cast<int>(data.size()));
+		kept += data;
+	}
+	// Дыра в середине остаётся дырой и после переноса
+	ASSERT_TRUE(m_fs->PunchHole("kept", 16 * BLOCK_SIZE, 8 * BLOCK_SIZE));
+	kept.replace(16 * BLOCK_SIZE, 8 * BLOCK_SIZE, 8 * BLOCK_SIZE, '\0');
+	ASSERT_TRUE(m_fs->RemoveFile("removed"));
+	ASSERT_TRUE(m_fs->TruncateFile("kept", kept.size()));
+	ASSERT_EQ(m_fs->GetFragmentationStats().fragmentedFiles, 1u);
+
+	ASSERT_GT(m_fs->Compact(), 0);
+	const FragmentationStats stats = m_fs->GetFragmentationStats();
+	EXPECT_EQ(stats.fragmentedFiles, 0u);
+	EXPECT_EQ(stats.largestFreeRun, stats.freeBlocks);
+	EXPECT_EQ(Read("kept", 0, kept.size()), kept);
+	EXPECT_EQ(m_fs->SeekData("kept", 16 * BLOCK_SIZE, false), static_cast<int64_t>(24 * BLOCK_SIZE));
+
+	Reopen();
+	EXPECT_EQ(Read("kept", 0, kept.size()), kept);
+}
+
+TEST_F(CompactionTest, SlidesFileWhenThereIsNoRoomForCopy)
+{
+	ASSERT_TRUE(m_fs->CreateFile("small"));
+	ASSERT_EQ(m_fs->WriteData("small", std::string(BLOCK_SIZE, 's').data(), BLOCK_SIZE, 0), static_cast<int>(BLOCK_SIZE));
+	ASSERT_TRUE(m_fs->TruncateFile("small", BLOCK_SIZE));
+	// Большой файл занимает почти всё место, целиком его переложить некуда
+	constexpr uint32_t SPARE_BLOCKS = 64;
+	const uint32_t blocks = m_fs->GetFragmentationStats().freeBlocks - SPARE_BLOCKS;
+	std::string big(static_cast<size_t>(blocks) * BLOCK_SIZE, '\0');
+	for (size_t block = 0; block < blocks; ++block)
+	{
+		big[block * BLOCK_SIZE] = static_cast<char>(block % 251);
+	}
+	ASSERT_TRUE(m_fs->CreateFile("big"));
+	ASSERT_EQ(m_fs->WriteData("big", big.data(), big.size(), 0), static_cast<int>(big.size()));
+	ASSERT_TRUE(m_fs->RemoveFile("small"));
+	ASSERT_TRUE(m_fs->Sync());
+	ASSERT_EQ(m_fs->GetFragmentationStats().freeRuns, 2u);
+
+	// Промежуток в один блок: файл сдвигается целиком за один проход, куски по SPARE_BLOCKS
+	// откладываются в свободный конец и возвращаются, поэтому каждый блок копируется не больше двух раз
+	uint32_t passes = 0;
+	const int64_t moved = m_fs->Compact(&passes);
+	EXPECT_EQ(passes, 1u);
+	EXPECT_GE(moved, static_cast<int64_t>(blocks));
+	EXPECT_LE(moved, 2 * static_cast<int64_t>(blocks));
+	const FragmentationStats stats = m_fs->GetFragmentationStats();
+	EXPECT_EQ(stats.freeRuns, 1u);
+	EXPECT_EQ(stats.fragmentedFiles, 0u);
+	Reopen();
+	EXPECT_EQ(Read("big", 0, big.size()), big);
+}
+
+TEST_F(CompactionTest, CompactImageIsLeftAlone)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	const std::string data(8 * BLOCK_SIZE, 'x');
+	ASSERT_EQ(m_fs->WriteData("file", data.data(), data.size(), 0), static_cast<int>(data.size()));
+	ASSERT_TRUE(m_fs->TruncateFile("file", data.size()));
+
+	EXPECT_EQ(m_fs->Compact(), 0);
+	EXPECT_EQ(Read("file", 0, data.size()), data);
+}
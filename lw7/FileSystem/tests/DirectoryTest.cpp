@@ -0,0 +1,226 @@
+#include "ImageTest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class DirectoryTest : public ImageTest
+{
+protected:
+	DirectoryTest()
+		: ImageTest("directory", 64, IMAGE_SIZE)
+	{
+	}
+
+	bool Exists(const std::string& path) const
+	{
+		FileEntry entry{};
+		return m_fs->GetFileStat(path, entry);
+	}
+
+	bool IsDirectory(const std::string& path) const
+	{
+		FileEntry entry{};
+		return m_fs->GetFileStat(path, entry) && entry.isDirectory;
+	}
+
+	std::vector<std::string> List(const std::string& path) const
+	{
+		std::vector<std::string> names;
+		EXPECT_TRUE(m_fs->ReadDirectory(path, names));
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	std::string ReadAll(const std::string& path) const
+	{
+		FileEntry entry{};
+		EXPECT_TRUE(m_fs->GetFileStat(path, entry));
+		std::string data(entry.size, '\0');
+		EXPECT_EQ(m_fs->ReadData(path, data.data(), data.size(), 0), static_cast<int>(data.size()));
+		return data;
+	}
+
+	static constexpr uint64_t IMAGE_SIZE = 4ULL * 1024 * 1024;
+};
+
+TEST_F(DirectoryTest, CreatesFilesInNestedDirectories)
+{
+	const std::string data = "nested";
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b"));
+	ASSERT_TRUE(m_fs->CreateFile("a/b/file"));
+	ASSERT_EQ(m_fs->WriteData("a/b/file", data.data(), data.size(), 0), static_cast<int>(data.size()));
+
+	EXPECT_TRUE(IsDirectory("a"));
+	EXPECT_TRUE(IsDirectory("a/b"));
+	EXPECT_FALSE(IsDirectory("a/b/file"));
+	EXPECT_EQ(ReadAll("a/b/file"), data);
+	EXPECT_FALSE(Exists("file"));
+	EXPECT_FALSE(Exists("b/file"));
+}
+
+TEST_F(DirectoryTest, SameNameInDifferentDirectories)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("b"));
+	ASSERT_TRUE(m_fs->CreateFile("a/file"));
+	ASSERT_TRUE(m_fs->CreateFile("b/file"));
+	ASSERT_EQ(m_fs->WriteData("a/file", "1", 1, 0), 1);
+	ASSERT_EQ(m_fs->WriteData("b/file", "22", 2, 0), 2);
+
+	EXPECT_EQ(ReadAll("a/file"), "1");
+	EXPECT_EQ(ReadAll("b/file"), "22");
+	EXPECT_FALSE(m_fs->CreateFile("a/file"));
+}
+
+TEST_F(DirectoryTest, RejectsMissingParentAndFileParent)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	EXPECT_FALSE(m_fs->CreateFile("missing/file"));
+	EXPECT_FALSE(m_fs->CreateDirectory("missing/dir"));
+	EXPECT_FALSE(m_fs->CreateFile("file/child"));
+	EXPECT_FALSE(m_fs->CreateFile(""));
+	EXPECT_FALSE(m_fs->CreateDirectory("dir/"));
+}
+
+TEST_F(DirectoryTest, ListsOnlyDirectChildren)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b"));
+	ASSERT_TRUE(m_fs->CreateFile("a/x"));
+	ASSERT_TRUE(m_fs->CreateFile("a/b/y"));
+	ASSERT_TRUE(m_fs->CreateFile("z"));
+
+	EXPECT_EQ(List(""), (std::vector<std::string>{ "a", "z" }));
+	EXPECT_EQ(List("a"), (std::vector<std::string>{ "b", "x" }));
+	EXPECT_EQ(List("a/b"), (std::vector<std::string>{ "y" }));
+
+	std::vector<std::string> names;
+	EXPECT_FALSE(m_fs->ReadDirectory("z", names));
+	EXPECT_FALSE(m_fs->ReadDirectory("missing", names));
+}
+
+TEST_F(DirectoryTest, RemovesOnlyEmptyDirectories)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateFile("a/file"));
+
+	EXPECT_FALSE(m_fs->RemoveDirectory("a"));
+	EXPECT_FALSE(m_fs->RemoveFile("a"));
+	EXPECT_FALSE(m_fs->RemoveDirectory("a/file"));
+
+	ASSERT_TRUE(m_fs->RemoveFile("a/file"));
+	ASSERT_TRUE(m_fs->RemoveDirectory("a"));
+	EXPECT_FALSE(Exists("a"));
+	EXPECT_FALSE(m_fs->CreateFile("a/file"));
+	EXPECT_TRUE(List("").empty());
+}
+
+TEST_F(DirectoryTest, DirectoriesHaveNoData)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	char byte = 0;
+	EXPECT_EQ(m_fs->WriteData("a", "x", 1, 0), -1);
+	EXPECT_EQ(m_fs->ReadData("a", &byte, 1, 0), -1);
+	EXPECT_FALSE(m_fs->TruncateFile("a", 10));
+}
+
+TEST_F(DirectoryTest, RenameMovesFileBetweenDirectories)
+{
+	const std::string data = "moved";
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("b"));
+	ASSERT_TRUE(m_fs->CreateFile("a/file"));
+	ASSERT_EQ(m_fs->WriteData("a/file", data.data(), data.size(), 0), static_cast<int>(data.size()));
+
+	ASSERT_TRUE(m_fs->Rename("a/file", "b/renamed"));
+	EXPECT_FALSE(Exists("a/file"));
+	EXPECT_EQ(ReadAll("b/renamed"), data);
+	EXPECT_TRUE(List("a").empty());
+	EXPECT_EQ(List("b"), (std::vector<std::string>{ "renamed" }));
+	EXPECT_FALSE(m_fs->Rename("a/file", "b/other"));
+	EXPECT_FALSE(m_fs->Rename("b/renamed", "missing/file"));
+}
+
+TEST_F(DirectoryTest, RenameReplacesExistingFile)
+{
+	const std::string big(64 * 1024, 'b');
+	ASSERT_TRUE(m_fs->CreateFile("source"));
+	ASSERT_TRUE(m_fs->CreateFile("target"));
+	ASSERT_EQ(m_fs->WriteData("source", "s", 1, 0), 1);
+	ASSERT_EQ(m_fs->WriteData("target", big.data(), big.size(), 0), static_cast<int>(big.size()));
+
+	ASSERT_TRUE(m_fs->Rename("source", "target"));
+	EXPECT_FALSE(Exists("source"));
+	EXPECT_EQ(ReadAll("target"), "s");
+	EXPECT_EQ(List(""), (std::vector<std::string>{ "target" }));
+
+	// Блоки заменённого файла освобождены: их хватает на файл того же размера
+	ASSERT_TRUE(m_fs->CreateFile("again"));
+	EXPECT_TRUE(m_fs->TruncateFile("again", big.size()));
+}
+
+TEST_F(DirectoryTest, RenameDoesNotMixFilesAndDirectories)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("dir"));
+	ASSERT_TRUE(m_fs->CreateDirectory("full"));
+	ASSERT_TRUE(m_fs->CreateFile("full/file"));
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+
+	EXPECT_FALSE(m_fs->Rename("file", "dir"));
+	EXPECT_FALSE(m_fs->Rename("dir", "file"));
+	EXPECT_FALSE(m_fs->Rename("dir", "full"));
+
+	ASSERT_TRUE(m_fs->CreateDirectory("empty"));
+	ASSERT_TRUE(m_fs->Rename("full", "empty"));
+	EXPECT_TRUE(Exists("empty/file"));
+	EXPECT_FALSE(Exists("full"));
+}
+
+TEST_F(DirectoryTest, RenameDirectoryMovesSubtree)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b/c"));
+	ASSERT_TRUE(m_fs->CreateFile("a/b/c/file"));
+	ASSERT_TRUE(m_fs->CreateDirectory("x"));
+
+	ASSERT_TRUE(m_fs->Rename("a/b", "x/moved"));
+	EXPECT_FALSE(Exists("a/b"));
+	EXPECT_FALSE(Exists("a/b/c/file"));
+	EXPECT_TRUE(IsDirectory("x/moved/c"));
+	EXPECT_TRUE(Exists("x/moved/c/file"));
+	EXPECT_TRUE(m_fs->CreateFile("x/moved/c/new"));
+	EXPECT_FALSE(m_fs->CreateFile("a/b/c/new"));
+	EXPECT_TRUE(m_fs->CreateDirectory("a/b"));
+	EXPECT_TRUE(List("a/b").empty());
+}
+
+TEST_F(DirectoryTest, RenameRejectsMoveIntoOwnSubtree)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b"));
+
+	EXPECT_FALSE(m_fs->Rename("a", "a/b/a"));
+	EXPECT_FALSE(m_fs->Rename("a", "a/self"));
+	EXPECT_TRUE(IsDirectory("a/b"));
+}
+
+TEST_F(DirectoryTest, TreeSurvivesReopen)
+{
+	const std::string data = "persistent";
+	ASSERT_TRUE(m_fs->CreateDirectory("a"));
+	ASSERT_TRUE(m_fs->CreateDirectory("a/b"));
+	ASSERT_TRUE(m_fs->CreateFile("a/b/file"));
+	ASSERT_EQ(m_fs->WriteData("a/b/file", data.data(), data.size(), 0), static_cast<int>(data.size()));
+	ASSERT_TRUE(m_fs->CreateDirectory("c"));
+	ASSERT_TRUE(m_fs->Rename("a/b", "c/b"));
+	m_fs->CloseImage();
+
+	Reopen();
+	EXPECT_EQ(List(""), (std::vector<std::string>{ "a", "c" }));
+	EXPECT_TRUE(List("a").empty());
+	EXPECT_EQ(List("c/b"), (std::vector<std::string>{ "file" }));
+	EXPECT_EQ(ReadAll("c/b/file"), data);
+}
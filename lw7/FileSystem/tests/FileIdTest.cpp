@@ -0,0 +1,162 @@
+#include "ImageTest.h"
+
+#include <string>
+#include <unistd.h>
+
+using FileId = FileSystemManager::FileId;
+using DataRange = FileSystemManager::DataRange;
+
+class FileIdTest : public ImageTest
+{
+protected:
+	FileIdTest()
+		: ImageTest("id", 16)
+	{
+	}
+
+	FileId Lookup(const FileId parent, const std::string& name) const
+	{
+		FileEntry entry{};
+		return m_fs->Lookup(parent, name, entry);
+	}
+
+	std::string Read(const FileId id, const uint64_t offset, const size_t size)
+	{
+		std::string data(size, '\0');
+		const int read = m_fs->ReadData(id, data.data(), data.size(), offset);
+		EXPECT_GE(read, 0);
+		data.resize(read < 0 ? 0 : read);
+		return data;
+	}
+
+	// Читает диапазон так же, как низкоуровневое монтирование: прямо из кусков образа
+	std::string ReadDirect(const FileId id, const uint64_t offset, const size_t size)
+	{
+		std::string data;
+		const int read = m_fs->ReadDataDirect(id, offset, size,
+			[&data](const int imageFd, const std::vector<DataRange>& ranges) {
+				for (const auto& [imageOffset, length] : ranges)
+				{
+					std::string chunk(length, '\0');
+					if (imageOffset != FileSystemManager::HOLE_OFFSET
+						&& pread(imageFd, chunk.data(), length, static_cast<off_t>(imageOffset)) != static_cast<ssize_t>(length))
+					{
+						return false;
+					}
+					data += chunk;
+				}
+				return true;
+			});
+		EXPECT_EQ(read, static_cast<int>(data.size()));
+		return data;
+	}
+
+	void WriteDirect(const FileId id, const std::string& data, const uint64_t offset)
+	{
+		const int written = m_fs->WriteDataDirect(id, offset, data.size(),
+			[&data](const int imageFd, const std::vector<DataRange>& ranges) {
+				size_t position = 0;
+				for (const auto& [imageOffset, length] : ranges)
+				{
+					if (imageOffset == FileSystemManager::HOLE_OFFSET
+						|| pwrite(imageFd, data.data() + position, length, static_cast<off_t>(imageOffset)) != static_cast<ssize_t>(length))
+					{
+						return false;
+					}
+					position += length;
+				}
+				return true;
+			});
+		ASSERT_EQ(written, static_cast<int>(data.size()));
+	}
+
+};
+
+TEST_F(FileIdTest, LooksUpEntriesByParent)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("dir"));
+	ASSERT_TRUE(m_fs->CreateFile("dir/file"));
+
+	const FileId directory = Lookup(FileSystemManager::ROOT_ID, "dir");
+	ASSERT_NE(directory, FileSystemManager::NO_ID);
+	const FileId file = Lookup(directory, "file");
+	ASSERT_NE(file, FileSystemManager::NO_ID);
+	EXPECT_EQ(Lookup(FileSystemManager::ROOT_ID, "file"), FileSystemManager::NO_ID);
+	EXPECT_EQ(Lookup(file, "file"), FileSystemManager::NO_ID);
+
+	std::string path;
+	ASSERT_TRUE(m_fs->GetPath(file, path));
+	EXPECT_EQ(path, "dir/file");
+
+	std::vector<FileSystemManager::DirectoryEntry> entries;
+	ASSERT_TRUE(m_fs->ReadDirectory(directory, entries));
+	ASSERT_EQ(entries.size(), 1u);
+	EXPECT_EQ(entries[0].name, "file");
+	EXPECT_EQ(entries[0].id, file);
+	EXPECT_FALSE(entries[0].isDirectory);
+	EXPECT_FALSE(m_fs->ReadDirectory(file, entries));
+}
+
+TEST_F(FileIdTest, IdFollowsRenameAndDiesWithEntry)
+{
+	ASSERT_TRUE(m_fs->CreateDirectory("dir"));
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	const FileId file = Lookup(FileSystemManager::ROOT_ID, "file");
+	ASSERT_EQ(m_fs->WriteData(file, "data", 4, 0), 4);
+
+	ASSERT_TRUE(m_fs->Rename("file", "dir/moved"));
+	std::string path;
+	ASSERT_TRUE(m_fs->GetPath(file, path));
+	EXPECT_EQ(path, "dir/moved");
+	EXPECT_EQ(Read(file, 0, 4), "data");
+
+	// Новый файл занимает освободившийся слот, но старый идентификатор к нему не ведёт
+	ASSERT_TRUE(m_fs->RemoveFile("dir/moved"));
+	ASSERT_TRUE(m_fs->CreateFile("other"));
+	FileEntry entry{};
+	EXPECT_FALSE(m_fs->GetFileStat(file, entry));
+	EXPECT_EQ(m_fs->ReadData(file, path.data(), 1, 0), -1);
+	EXPECT_NE(Lookup(FileSystemManager::ROOT_ID, "other"), file);
+}
+
+TEST_F(FileIdTest, DirectReadSeesCachedWritesAndHoles)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	const FileId file = Lookup(FileSystemManager::ROOT_ID, "file");
+	ASSERT_TRUE(m_fs->TruncateFile(file, 8 * BLOCK_SIZE));
+	// Маленькая запись остаётся в кэше блоков, прямое чтение должно её увидеть
+	ASSERT_EQ(m_fs->WriteData(file, "cached", 6, 3 * BLOCK_SIZE + 10), 6);
+
+	std::string expected(8 * BLOCK_SIZE, '\0');
+	expected.replace(3 * BLOCK_SIZE + 10, 6, "cached");
+	EXPECT_EQ(ReadDirect(file, 0, 16 * BLOCK_SIZE), expected);
+	EXPECT_EQ(ReadDirect(file, 3 * BLOCK_SIZE + 10, 6), "cached");
+}
+
+TEST_F(FileIdTest, DirectWriteZeroesBlockEdges)
+{
+	// Чужие данные в блоках, которые достанутся файлу
+	ASSERT_TRUE(m_fs->CreateFile("old"));
+	ASSERT_EQ(m_fs->WriteData("old", std::string(8 * BLOCK_SIZE, 's').data(), 8 * BLOCK_SIZE, 0), static_cast<int>(8 * BLOCK_SIZE));
+	ASSERT_TRUE(m_fs->RemoveFile("old"));
+
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	const FileId file = Lookup(FileSystemManager::ROOT_ID, "file");
+	const std::string data(2 * BLOCK_SIZE, 'd');
+	WriteDirect(file, data, 5 * BLOCK_SIZE + 100);
+	// Запись поверх уже записанного блока не трогает его остальные байты
+	WriteDirect(file, "xy", 5 * BLOCK_SIZE + 200);
+
+	std::string expected(5 * BLOCK_SIZE + 100, '\0');
+	expected += data;
+	expected.replace(5 * BLOCK_SIZE + 200, 2, "xy");
+	FileEntry entry{};
+	ASSERT_TRUE(m_fs->GetFileStat(file, entry));
+	EXPECT_EQ(entry.size, expected.size());
+	EXPECT_EQ(Read(file, 0, 16 * BLOCK_SIZE), expected);
+	EXPECT_EQ(m_fs->SeekData(file, 0, false), static_cast<int64_t>(5 * BLOCK_SIZE));
+
+	// После увеличения файла его продолжение за концом записи читается нулями
+	ASSERT_TRUE(m_fs->TruncateFile(file, 8 * BLOCK_SIZE));
+	EXPECT_EQ(Read(file, 7 * BLOCK_SIZE + 100, BLOCK_SIZE), std::string(BLOCK_SIZE - 100, '\0'));
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include "../include/FileSystemManager.h"
+
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+
+class ImageCreationTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		const std::string testName = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+		m_imagePath = std::filesystem::temp_directory_path() / ("myfs-creation-" + testName + ".img");
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove(m_imagePath);
+	}
+
+	uint64_t GetAllocatedBytes() const
+	{
+		struct stat imageStat{};
+		EXPECT_EQ(::stat(m_imagePath.c_str(), &imageStat), 0);
+		return static_cast<uint64_t>(imageStat.st_blocks) * 512;
+	}
+
+	static constexpr uint64_t IMAGE_SIZE = 256ULL * 1024 * 1024;
+	static constexpr uint32_t MAX_FILES = 1024;
+
+	std::filesystem::path m_imagePath;
+};
+
+TEST_F(ImageCreationTest, CreatesSparseImage)
+{
+	FileSystemManager fs;
+	ASSERT_TRUE(fs.CreateImage(m_imagePath.string(), IMAGE_SIZE, MAX_FILES));
+	fs.CloseImage();
+
+	EXPECT_EQ(std::filesystem::file_size(m_imagePath), IMAGE_SIZE);
+	EXPECT_LT(GetAllocatedBytes(), IMAGE_SIZE / 16);
+}
+
+TEST_F(ImageCreationTest, PreallocatesImage)
+{
+	FileSystemManager fs;
+	ASSERT_TRUE(fs.CreateImage(m_imagePath.string(), IMAGE_SIZE, MAX_FILES, true));
+	fs.CloseImage();
+
+	EXPECT_EQ(std::filesystem::file_size(m_imagePath), IMAGE_SIZE);
+	EXPECT_GE(GetAllocatedBytes(), IMAGE_SIZE);
+}
+
+TEST_F(ImageCreationTest, ReplacesExistingImage)
+{
+	{
+		FileSystemManager fs;
+		ASSERT_TRUE(fs.CreateImage(m_imagePath.string(), IMAGE_SIZE, MAX_FILES));
+		ASSERT_TRUE(fs.CreateFile("old"));
+		const std::string data(100000, 'o');
+		ASSERT_EQ(fs.WriteData("old", data.data(), data.size(), 0), static_cast<int>(data.size()));
+	}
+
+	FileSystemManager fs;
+	ASSERT_TRUE(fs.CreateImage(m_imagePath.string(), IMAGE_SIZE / 2, MAX_FILES));
+	fs.CloseImage();
+	ASSERT_TRUE(fs.OpenImage(m_imagePath.string()));
+	EXPECT_TRUE(fs.GetFileList().empty());
+	EXPECT_EQ(std::filesystem::file_size(m_imagePath), IMAGE_SIZE / 2);
+}
+
+TEST_F(ImageCreationTest, FreshImageIsUsableToTheLastBlock)
+{
+	{
+		FileSystemManager fs;
+		ASSERT_TRUE(fs.CreateImage(m_imagePath.string(), IMAGE_SIZE, MAX_FILES));
+	}
+
+	FileSystemManager fs;
+	ASSERT_TRUE(fs.OpenImage(m_imagePath.string()));
+	ASSERT_TRUE(fs.CreateFile("file"));
+	// Биты карты за последним блоком заняты, поэтому файл не выходит за образ.
+	// Увеличение размера блоков не выделяет, так что образ заполняется записью
+	uint64_t size = 0;
+	const std::string chunk(1024 * 1024, 'f');
+	for (uint64_t step = chunk.size(); step >= BLOCK_SIZE; step /= 2)
+	{
+		while (fs.WriteData("file", chunk.data(), step, size) == static_cast<int>(step))
+		{
+			size += step;
+		}
+	}
+	EXPECT_GT(size, IMAGE_SIZE / 2);
+	EXPECT_LT(size, IMAGE_SIZE);
+
+	std::string data(BLOCK_SIZE, 't');
+	EXPECT_EQ(fs.WriteData("file", data.data(), data.size(), size - BLOCK_SIZE), static_cast<int>(BLOCK_SIZE));
+	EXPECT_EQ(fs.ReadData("file", data.data(), data.size(), size - BLOCK_SIZE), static_cast<int>(BLOCK_SIZE));
+	EXPECT_EQ(data, std::string(BLOCK_SIZE, 't'));
+}
@@ -0,0 +1,71 @@
+#ifndef FILESYSTEM_IMAGETEST_H
+#define FILESYSTEM_IMAGETEST_H
+
+#include "gtest/gtest.h"
+
+#include "../include/FileSystemManager.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Основа тестов, которым нужен образ: он создаётся под именем "myfs-<prefix>-<тест>.img" и удаляется после теста
+class ImageTest : public ::testing::Test
+{
+protected:
+	static constexpr uint64_t IMAGE_SIZE = 16ULL * 1024 * 1024;
+
+	ImageTest(std::string prefix, const uint32_t maxFiles, const uint64_t imageSize = IMAGE_SIZE)
+		: m_prefix(std::move(prefix))
+		, m_maxFiles(maxFiles)
+		, m_imageSize(imageSize)
+	{
+	}
+
+	void SetUp() override
+	{
+		m_imagePath = GetTempPath(".img");
+		m_fs = std::make_unique<FileSystemManager>();
+		ASSERT_TRUE(m_fs->CreateImage(m_imagePath.string(), m_imageSize, m_maxFiles));
+	}
+
+	void TearDown() override
+	{
+		m_fs.reset();
+		std::filesystem::remove(m_imagePath);
+	}
+
+	virtual void Reopen()
+	{
+		m_fs->CloseImage();
+		m_fs = std::make_unique<FileSystemManager>();
+		ASSERT_TRUE(m_fs->OpenImage(m_imagePath.string()));
+	}
+
+	// Путь во временном каталоге с именем теста и окончанием suffix
+	std::filesystem::path GetTempPath(const std::string& suffix) const
+	{
+		const std::string testName = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+		return std::filesystem::temp_directory_path() / ("myfs-" + m_prefix + "-" + testName + suffix);
+	}
+
+	std::string Read(const std::string& path, const uint64_t offset, const size_t size) const
+	{
+		std::string data(size, '\0');
+		const int read = m_fs->ReadData(path, data.data(), data.size(), offset);
+		EXPECT_GE(read, 0);
+		data.resize(read < 0 ? 0 : read);
+		return data;
+	}
+
+	std::filesystem::path m_imagePath;
+	std::unique_ptr<FileSystemManager> m_fs;
+
+private:
+	std::string m_prefix;
+	uint32_t m_maxFiles;
+	uint64_t m_imageSize;
+};
+
+#endif // FILESYSTEM_IMAGETEST_H
@@ -0,0 +1,122 @@
+#include "ImageTest.h"
+
+#include "../include/IoEngine.h"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Образ открывается с io_uring и очередью меньше числа кусков в одной передаче,
+// так что запросы идут несколькими волнами
+class IoEngineTest : public ImageTest
+{
+protected:
+	static constexpr uint32_t QUEUE_DEPTH = 8;
+
+	IoEngineTest()
+		: ImageTest("io-engine", 16)
+	{
+	}
+
+	void SetUp() override
+	{
+		ImageTest::SetUp();
+		Reopen();
+	}
+
+	void TearDown() override
+	{
+		ImageTest::TearDown();
+		std::filesystem::remove(GetTempPath(".dat"));
+	}
+
+	// Исполнитель выбирается при открытии образа
+	void Reopen() override
+	{
+		m_fs->CloseImage();
+		m_fs = std::make_unique<FileSystemManager>();
+		m_fs->SetIoEngine(IoEngineKind::Uring, QUEUE_DEPTH);
+		ASSERT_TRUE(m_fs->OpenImage(m_imagePath.string()));
+	}
+
+	static std::string MakePattern(const size_t size)
+	{
+		std::string data(size, '\0');
+		for (size_t i = 0; i < size; ++i)
+		{
+			data[i] = static_cast<char>('a' + (i * 7 + i / 4096) % 26);
+		}
+		return data;
+	}
+
+	// Запросы по requestSize байт, каждый разбит на два вектора неравной длины
+	static std::vector<IoRequest> MakeRequests(std::string& data, const size_t requestSize,
+		std::vector<iovec>& vectors, const bool isWrite)
+	{
+		const size_t count = data.size() / requestSize;
+		vectors.resize(count * 2);
+		std::vector<IoRequest> requests(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			char* base = data.data() + i * requestSize;
+			vectors[i * 2] = { base, requestSize / 3 };
+			vectors[i * 2 + 1] = { base + requestSize / 3, requestSize - requestSize / 3 };
+			requests[i] = { &vectors[i * 2], 2, i * requestSize, isWrite };
+		}
+		return requests;
+	}
+};
+
+TEST_F(IoEngineTest, LargeUnalignedRoundTrip)
+{
+	const uint64_t offset = 777;
+	const std::string data = MakePattern(3 * 1024 * 1024 + 123);
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	ASSERT_EQ(m_fs->WriteData("file", data.data(), data.size(), offset), static_cast<int>(data.size()));
+
+	EXPECT_EQ(Read("file", offset, data.size()), data);
+	EXPECT_EQ(Read("file", 0, offset), std::string(offset, '\0'));
+
+	Reopen();
+	EXPECT_EQ(Read("file", offset, data.size()), data);
+	// Середина файла, начало и конец которой не совпадают с границами блоков и кусков
+	EXPECT_EQ(Read("file", offset + 300001, 1024 * 1024 + 5), data.substr(300001, 1024 * 1024 + 5));
+}
+
+TEST_F(IoEngineTest, BatchFailsAtEndOfFileAndRingStaysUsable)
+{
+	const std::string path = GetTempPath(".dat").string();
+	const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_NE(fd, -1);
+	const auto engine = IoEngine::Create(fd, IoEngineKind::Uring, QUEUE_DEPTH);
+
+	const size_t requestSize = 64 * 1024 + 11;
+	std::string data = MakePattern(requestSize * 40);
+	std::vector<iovec> vectors;
+	std::vector<IoRequest> requests = MakeRequests(data, requestSize, vectors, true);
+	EXPECT_TRUE(engine->Execute(requests.data(), requests.size()));
+
+	std::string copy(data.size(), '\0');
+	requests = MakeRequests(copy, requestSize, vectors, false);
+	EXPECT_TRUE(engine->Execute(requests.data(), requests.size()));
+	EXPECT_EQ(copy, data);
+
+	// Последний запрос заходит за конец файла: сначала он дочитывается не целиком,
+	// а повтор упирается в конец. Пачка не выполнена, но остальные запросы дожидаются
+	std::string tail(data.size() + requestSize, '\0');
+	requests = MakeRequests(tail, requestSize, vectors, false);
+	requests.back().offset -= requestSize / 2;
+	EXPECT_FALSE(engine->Execute(requests.data(), requests.size()));
+
+	// После ошибки то же кольцо снова отдаётся из пула и должно работать как прежде
+	std::string again(data.size(), '\0');
+	requests = MakeRequests(again, requestSize, vectors, false);
+	EXPECT_TRUE(engine->Execute(requests.data(), requests.size()));
+	EXPECT_EQ(again, data);
+
+	::close(fd);
+}
@@ -0,0 +1,341 @@
+#include "ImageTest.h"
+
+#include "../include/Structure.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Сбой имитируется копией образа, снятой, пока файловая система открыта:
+// в копии есть всё, что отдано ядру, но нет контрольной точки, которую сделал бы CloseImage
+class JournalRecoveryTest : public ImageTest
+{
+protected:
+	JournalRecoveryTest()
+		: ImageTest("journal", 64)
+	{
+	}
+
+	void SetUp() override
+	{
+		m_crashPath = GetTempPath("-crash.img");
+		ImageTest::SetUp();
+		m_fs->SetCommitInterval(std::chrono::hours(1));
+	}
+
+	void TearDown() override
+	{
+		ImageTest::TearDown();
+		std::filesystem::remove(m_crashPath);
+	}
+
+	void Crash() const
+	{
+		std::filesystem::copy_file(m_imagePath, m_crashPath, std::filesystem::copy_options::overwrite_existing);
+	}
+
+	void Reopen() override
+	{
+		ImageTest::Reopen();
+		m_fs->SetCommitInterval(std::chrono::hours(1));
+	}
+
+	bool Exists(FileSystemManager& fs, const std::string& name) const
+	{
+		FileEntry entry{};
+		return fs.GetFileStat(name, entry);
+	}
+
+	Superblock ReadCrashSuperblock() const
+	{
+		Superblock superblock{};
+		std::ifstream image(m_crashPath, std::ios::binary);
+		image.read(reinterpret_cast<char*>(&superblock), sizeof(superblock));
+		return superblock;
+	}
+
+	// Смещения и размеры транзакций в журнале копии
+	std::vector<std::pair<uint64_t, uint64_t>> FindCrashTransactions() const
+	{
+		const Superblock superblock = ReadCrashSuperblock();
+		std::ifstream image(m_crashPath, std::ios::binary);
+		JournalHeader journalHeader{};
+		image.seekg(superblock.journalOffset);
+		image.read(reinterpret_cast<char*>(&journalHeader), sizeof(journalHeader));
+
+		std::vector<std::pair<uint64_t, uint64_t>> transactions;
+		uint64_t offset = superblock.journalOffset + BLOCK_SIZE;
+		const uint64_t journalEnd = superblock.journalOffset + static_cast<uint64_t>(superblock.journalBlocks) * BLOCK_SIZE;
+		while (offset + sizeof(TransactionHeader) <= journalEnd)
+		{
+			TransactionHeader header{};
+			image.seekg(static_cast<std::streamoff>(offset));
+			image.read(reinterpret_cast<char*>(&header), sizeof(header));
+			if (header.magic != TRANSACTION_MAGIC || header.sequence != journalHeader.firstSequence + transactions.size())
+			{
+				break;
+			}
+			transactions.emplace_back(offset, sizeof(header) + header.payloadSize);
+			offset += sizeof(header) + header.payloadSize;
+		}
+		return transactions;
+	}
+
+	// Обнуляет журнал копии начиная со смещения offset, как если бы запись оборвалась на нём
+	void TruncateCrashJournal(const uint64_t offset) const
+	{
+		const Superblock superblock = ReadCrashSuperblock();
+		const uint64_t journalEnd = superblock.journalOffset + static_cast<uint64_t>(superblock.journalBlocks) * BLOCK_SIZE;
+		const std::vector<char> zeros(journalEnd - offset, 0);
+		std::fstream image(m_crashPath, std::ios::binary | std::ios::in | std::ios::out);
+		image.seekp(static_cast<std::streamoff>(offset));
+		image.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+	}
+
+	void CorruptCrashByte(const uint64_t offset) const
+	{
+		std::fstream image(m_crashPath, std::ios::binary | std::ios::in | std::ios::out);
+		image.seekg(static_cast<std::streamoff>(offset));
+		char value = 0;
+		image.read(&value, 1);
+		value = static_cast<char>(~value);
+		image.seekp(static_cast<std::streamoff>(offset));
+		image.write(&value, 1);
+	}
+
+	std::filesystem::path m_crashPath;
+};
+
+TEST_F(JournalRecoveryTest, ReplaysCommittedTransactions)
+{
+	const std::string data(10000, 'd');
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	ASSERT_TRUE(m_fs->CreateFile("b"));
+	ASSERT_EQ(m_fs->WriteData("a", data.data(), data.size(), 0), static_cast<int>(data.size()));
+	ASSERT_TRUE(m_fs->Sync());
+	Crash();
+
+	ASSERT_FALSE(FindCrashTransactions().empty());
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	ASSERT_TRUE(Exists(recovered, "a"));
+	ASSERT_TRUE(Exists(recovered, "b"));
+
+	std::string back(data.size(), '\0');
+	ASSERT_EQ(recovered.ReadData("a", back.data(), back.size(), 0), static_cast<int>(data.size()));
+	EXPECT_EQ(back, data);
+}
+
+TEST_F(JournalRecoveryTest, UncommittedChangesAreLost)
+{
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	m_fs->Sync();
+	ASSERT_TRUE(m_fs->CreateFile("b"));
+	Crash();
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	EXPECT_TRUE(Exists(recovered, "a"));
+	EXPECT_FALSE(Exists(recovered, "b"));
+}
+
+TEST_F(JournalRecoveryTest, FreedBlocksAreNotReusedBeforeCommit)
+{
+	// Запись такого размера идёт мимо кэша блоков и сразу попадает в образ
+	const std::string secret(256 * 1024, 's');
+	const std::string other(256 * 1024, 'o');
+	ASSERT_TRUE(m_fs->CreateFile("truncated"));
+	ASSERT_TRUE(m_fs->CreateFile("removed"));
+	ASSERT_EQ(m_fs->WriteData("truncated", secret.data(), secret.size(), 0), static_cast<int>(secret.size()));
+	ASSERT_EQ(m_fs->WriteData("removed", secret.data(), secret.size(), 0), static_cast<int>(secret.size()));
+	ASSERT_TRUE(m_fs->Sync());
+
+	// Освобождения ещё не зафиксированы, и после сбоя журнал вернёт блоки прежним файлам
+	ASSERT_TRUE(m_fs->TruncateFile("truncated", 0));
+	ASSERT_TRUE(m_fs->RemoveFile("removed"));
+	for (const std::string name : { "a", "b" })
+	{
+		ASSERT_TRUE(m_fs->CreateFile(name));
+		ASSERT_EQ(m_fs->WriteData(name, other.data(), other.size(), 0), static_cast<int>(other.size()));
+	}
+	Crash();
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	for (const std::string name : { "truncated", "removed" })
+	{
+		std::string data(secret.size(), '\0');
+		ASSERT_EQ(recovered.ReadData(name, data.data(), data.size(), 0), static_cast<int>(data.size()));
+		EXPECT_EQ(data, secret) << name;
+	}
+
+	// После фиксации освобождённые блоки снова идут в дело
+	ASSERT_TRUE(m_fs->Sync());
+	const uint32_t freeBlocks = m_fs->GetFragmentationStats().freeBlocks;
+	ASSERT_TRUE(m_fs->CreateFile("c"));
+	ASSERT_EQ(m_fs->WriteData("c", other.data(), other.size(), 0), static_cast<int>(other.size()));
+	EXPECT_EQ(m_fs->GetFragmentationStats().freeBlocks, freeBlocks - other.size() / BLOCK_SIZE);
+}
+
+TEST_F(JournalRecoveryTest, DropsTruncatedLastTransaction)
+{
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	m_fs->Sync();
+	ASSERT_TRUE(m_fs->CreateFile("b"));
+	m_fs->Sync();
+	Crash();
+
+	const auto transactions = FindCrashTransactions();
+	ASSERT_EQ(transactions.size(), 2U);
+	TruncateCrashJournal(transactions[1].first + transactions[1].second / 2);
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	EXPECT_TRUE(Exists(recovered, "a"));
+	EXPECT_FALSE(Exists(recovered, "b"));
+}
+
+TEST_F(JournalRecoveryTest, TruncationAfterTransactionHeaderDropsIt)
+{
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	m_fs->Sync();
+	Crash();
+
+	const auto transactions = FindCrashTransactions();
+	ASSERT_EQ(transactions.size(), 1U);
+	TruncateCrashJournal(transactions[0].first + sizeof(TransactionHeader));
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	EXPECT_FALSE(Exists(recovered, "a"));
+	EXPECT_TRUE(recovered.CreateFile("a"));
+}
+
+TEST_F(JournalRecoveryTest, StopsAtTransactionWithBadChecksum)
+{
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	m_fs->Sync();
+	ASSERT_TRUE(m_fs->CreateFile("b"));
+	m_fs->Sync();
+	ASSERT_TRUE(m_fs->CreateFile("c"));
+	m_fs->Sync();
+	Crash();
+
+	const auto transactions = FindCrashTransactions();
+	ASSERT_EQ(transactions.size(), 3U);
+	CorruptCrashByte(transactions[1].first + transactions[1].second - 1);
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	EXPECT_TRUE(Exists(recovered, "a"));
+	EXPECT_FALSE(Exists(recovered, "b"));
+	EXPECT_FALSE(Exists(recovered, "c"));
+}
+
+TEST_F(JournalRecoveryTest, DoesNotReplayTransactionsBeforeCheckpoint)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+		ASSERT_TRUE(m_fs->CreateFile("f" + std::to_string(i)));
+		m_fs->Sync();
+	}
+	m_fs->CloseImage();
+	Reopen();
+
+	// Новая транзакция короче старых, и за ней в журнале лежат транзакции прошлого поколения
+	ASSERT_TRUE(m_fs->RemoveFile("f5"));
+	m_fs->Sync();
+	Crash();
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	EXPECT_FALSE(Exists(recovered, "f5"));
+	EXPECT_TRUE(Exists(recovered, "f9"));
+	EXPECT_EQ(recovered.GetFileList().size(), 9U);
+}
+
+TEST_F(JournalRecoveryTest, RecoveredImageKeepsWorking)
+{
+	const std::string data(5000, 'x');
+	ASSERT_TRUE(m_fs->CreateFile("a"));
+	ASSERT_EQ(m_fs->WriteData("a", data.data(), data.size(), 0), static_cast<int>(data.size()));
+	m_fs->Sync();
+	Crash();
+
+	{
+		FileSystemManager recovered;
+		ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+		recovered.SetCommitInterval(std::chrono::hours(1));
+		ASSERT_TRUE(recovered.CreateFile("b"));
+		ASSERT_EQ(recovered.WriteData("b", data.data(), data.size(), 0), static_cast<int>(data.size()));
+		recovered.Sync();
+		// Второй сбой сразу после восстановления
+		std::filesystem::copy_file(m_crashPath, m_imagePath, std::filesystem::copy_options::overwrite_existing);
+	}
+
+	m_fs.reset();
+	FileSystemManager twiceRecovered;
+	ASSERT_TRUE(twiceRecovered.OpenImage(m_imagePath.string()));
+	EXPECT_TRUE(Exists(twiceRecovered, "a"));
+	EXPECT_TRUE(Exists(twiceRecovered, "b"));
+	std::string back(data.size(), '\0');
+	ASSERT_EQ(twiceRecovered.ReadData("b", back.data(), back.size(), 0), static_cast<int>(data.size()));
+	EXPECT_EQ(back, data);
+}
+
+TEST_F(JournalRecoveryTest, ReplaysOverflowExtentBlocks)
+{
+	// Образ заполняется целиком, и после удаления чётных файлов свободны только одиночные блоки,
+	// так что "big" дробится на экстенты, не помещающиеся в запись таблицы
+	const std::string block(BLOCK_SIZE, 'b');
+	for (int i = 0; i < 40; ++i)
+	{
+		ASSERT_TRUE(m_fs->CreateFile("s" + std::to_string(i)));
+		ASSERT_EQ(m_fs->WriteData("s" + std::to_string(i), block.data(), BLOCK_SIZE, 0), static_cast<int>(BLOCK_SIZE));
+	}
+	ASSERT_TRUE(m_fs->CreateFile("fill"));
+	for (uint64_t offset = 0; m_fs->WriteData("fill", block.data(), BLOCK_SIZE, offset) != -1; offset += BLOCK_SIZE)
+	{
+	}
+	for (int i = 0; i < 40; i += 2)
+	{
+		ASSERT_TRUE(m_fs->RemoveFile("s" + std::to_string(i)));
+	}
+	m_fs->CloseImage();
+	Reopen();
+
+	std::string data(16 * BLOCK_SIZE, '\0');
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<char>(i * 7 + i / BLOCK_SIZE);
+	}
+	ASSERT_TRUE(m_fs->CreateFile("big"));
+	for (size_t offset = 0; offset < data.size(); offset += BLOCK_SIZE)
+	{
+		ASSERT_EQ(m_fs->WriteData("big", data.data() + offset, BLOCK_SIZE, offset), static_cast<int>(BLOCK_SIZE));
+	}
+	FileEntry entry{};
+	ASSERT_TRUE(m_fs->GetFileStat("big", entry));
+	ASSERT_GT(entry.extentsCount, INLINE_EXTENTS);
+	m_fs->Sync();
+	Crash();
+
+	FileSystemManager recovered;
+	ASSERT_TRUE(recovered.OpenImage(m_crashPath.string()));
+	std::string back(data.size(), '\0');
+	ASSERT_EQ(recovered.ReadData("big", back.data(), back.size(), 0), static_cast<int>(data.size()));
+	EXPECT_EQ(back, data);
+}
+
+TEST_F(JournalRecoveryTest, RejectsCorruptJournalHeader)
+{
+	m_fs->Sync();
+	Crash();
+	CorruptCrashByte(ReadCrashSuperblock().journalOffset);
+
+	FileSystemManager recovered;
+	EXPECT_FALSE(recovered.OpenImage(m_crashPath.string()));
+}
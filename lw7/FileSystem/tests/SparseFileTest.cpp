@@ -0,0 +1,175 @@
+#include "ImageTest.h"
+
+#include <string>
+
+class SparseFileTest : public ImageTest
+{
+protected:
+	SparseFileTest()
+		: ImageTest("sparse", 16)
+	{
+	}
+
+	FileEntry Stat(const std::string& path) const
+	{
+		FileEntry entry{};
+		EXPECT_TRUE(m_fs->GetFileStat(path, entry));
+		return entry;
+	}
+
+	void Write(const std::string& path, const std::string& data, const uint64_t offset)
+	{
+		ASSERT_EQ(m_fs->WriteData(path, data.data(), data.size(), offset), static_cast<int>(data.size()));
+	}
+
+	// Больше, чем помещается в образ: у разреженного файла это не ошибка
+	static constexpr uint64_t LARGE_SIZE = 64ULL * 1024 * 1024;
+};
+
+TEST_F(SparseFileTest, TruncateToLargeSizeAllocatesNothing)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	ASSERT_TRUE(m_fs->TruncateFile("file", LARGE_SIZE));
+
+	const FileEntry entry = Stat("file");
+	EXPECT_EQ(entry.size, LARGE_SIZE);
+	EXPECT_EQ(entry.blocksCount, 0u);
+	EXPECT_EQ(Read("file", LARGE_SIZE - 1024 * 1024, 1024 * 1024), std::string(1024 * 1024, '\0'));
+}
+
+TEST_F(SparseFileTest, WriteIntoHoleKeepsZerosAround)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	ASSERT_TRUE(m_fs->TruncateFile("file", LARGE_SIZE));
+	const uint64_t offset = LARGE_SIZE / 2 + 100;
+	Write("file", "data", offset);
+
+	EXPECT_EQ(Stat("file").size, LARGE_SIZE);
+	EXPECT_EQ(Stat("file").blocksCount, 1u);
+	EXPECT_EQ(Read("file", offset - 100, 108), std::string(100, '\0') + "data" + std::string(4, '\0'));
+}
+
+TEST_F(SparseFileTest, WritePastEndLeavesHole)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	Write("file", "head", 0);
+	Write("file", "tail", LARGE_SIZE - 4);
+
+	EXPECT_EQ(Stat("file").size, LARGE_SIZE);
+	EXPECT_LE(Stat("file").blocksCount, 2u);
+	EXPECT_EQ(Read("file", 0, 8), std::string("head") + std::string(4, '\0'));
+	EXPECT_EQ(Read("file", LARGE_SIZE - 8, 8), std::string(4, '\0') + "tail");
+}
+
+TEST_F(SparseFileTest, PunchHoleFreesBlocksAndReadsZeros)
+{
+	const std::string data(16 * BLOCK_SIZE, 'x');
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	Write("file", data, 0);
+	const uint32_t blocksBefore = Stat("file").blocksCount;
+
+	ASSERT_TRUE(m_fs->PunchHole("file", BLOCK_SIZE + 10, 4 * BLOCK_SIZE));
+	EXPECT_EQ(Stat("file").size, data.size());
+	EXPECT_EQ(Stat("file").blocksCount, blocksBefore - 3);
+
+	std::string expected = data;
+	expected.replace(BLOCK_SIZE + 10, 4 * BLOCK_SIZE, 4 * BLOCK_SIZE, '\0');
+	EXPECT_EQ(Read("file", 0, data.size()), expected);
+
+	// Дыра внутри одного блока только зануляется
+	ASSERT_TRUE(m_fs->PunchHole("file", 10 * BLOCK_SIZE + 1, 2));
+	expected.replace(10 * BLOCK_SIZE + 1, 2, 2, '\0');
+	EXPECT_EQ(Read("file", 0, data.size()), expected);
+}
+
+TEST_F(SparseFileTest, SeeksDataAndHoles)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	ASSERT_TRUE(m_fs->TruncateFile("file", 64 * BLOCK_SIZE));
+	Write("file", std::string(2 * BLOCK_SIZE, 'a'), 8 * BLOCK_SIZE);
+	Write("file", "b", 20 * BLOCK_SIZE);
+
+	EXPECT_EQ(m_fs->SeekData("file", 0, false), 8 * BLOCK_SIZE);
+	EXPECT_EQ(m_fs->SeekData("file", 0, true), 0);
+	EXPECT_EQ(m_fs->SeekData("file", 9 * BLOCK_SIZE, false), 9 * BLOCK_SIZE);
+	EXPECT_EQ(m_fs->SeekData("file", 8 * BLOCK_SIZE, true), 10 * BLOCK_SIZE);
+	EXPECT_EQ(m_fs->SeekData("file", 11 * BLOCK_SIZE, false), 20 * BLOCK_SIZE);
+	EXPECT_EQ(m_fs->SeekData("file", 21 * BLOCK_SIZE, false), -1);
+	EXPECT_EQ(m_fs->SeekData("file", 21 * BLOCK_SIZE, true), 21 * BLOCK_SIZE);
+	EXPECT_EQ(m_fs->SeekData("file", 64 * BLOCK_SIZE, true), -1);
+}
+
+TEST_F(SparseFileTest, NoStaleDataAfterShrinkAndGrow)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	Write("file", std::string(4 * BLOCK_SIZE, 'x'), 0);
+	ASSERT_TRUE(m_fs->TruncateFile("file", 100));
+	ASSERT_TRUE(m_fs->TruncateFile("file", 4 * BLOCK_SIZE));
+	EXPECT_EQ(Read("file", 0, 4 * BLOCK_SIZE), std::string(100, 'x') + std::string(4 * BLOCK_SIZE - 100, '\0'));
+
+	ASSERT_TRUE(m_fs->TruncateFile("file", 100));
+	Write("file", "y", 3 * BLOCK_SIZE);
+	EXPECT_EQ(Read("file", 0, 3 * BLOCK_SIZE + 1), std::string(100, 'x') + std::string(3 * BLOCK_SIZE - 100, '\0') + "y");
+}
+
+TEST_F(SparseFileTest, NoStaleDataInReusedBlocks)
+{
+	const std::string secret(8 * BLOCK_SIZE, 's');
+	ASSERT_TRUE(m_fs->CreateFile("old"));
+	Write("old", secret, 0);
+	ASSERT_TRUE(m_fs->RemoveFile("old"));
+
+	ASSERT_TRUE(m_fs->CreateFile("new"));
+	Write("new", "a", 0);
+	Write("new", "b", 7 * BLOCK_SIZE + 5);
+	EXPECT_EQ(Read("new", 0, 7 * BLOCK_SIZE + 6), "a" + std::string(7 * BLOCK_SIZE + 4, '\0') + "b");
+}
+
+TEST_F(SparseFileTest, LayoutSurvivesReopen)
+{
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	ASSERT_TRUE(m_fs->TruncateFile("file", LARGE_SIZE));
+	for (uint64_t offset = 0; offset < LARGE_SIZE; offset += LARGE_SIZE / 32)
+	{
+		Write("file", std::to_string(offset), offset);
+	}
+	const uint32_t blocks = Stat("file").blocksCount;
+	Reopen();
+
+	EXPECT_EQ(Stat("file").size, LARGE_SIZE);
+	EXPECT_EQ(Stat("file").blocksCount, blocks);
+	for (uint64_t offset = 0; offset < LARGE_SIZE; offset += LARGE_SIZE / 32)
+	{
+		const std::string expected = std::to_string(offset);
+		EXPECT_EQ(Read("file", offset, expected.size() + 1), expected + '\0');
+	}
+	EXPECT_EQ(m_fs->SeekData("file", BLOCK_SIZE, false), static_cast<int64_t>(LARGE_SIZE / 32));
+}
+
+TEST_F(SparseFileTest, FragmentedLayoutSurvivesReopen)
+{
+	// Дыра в каждом втором блоке даёт экстенты, ровно заполняющие три блока переполнения
+	constexpr uint32_t BLOCKS = INLINE_EXTENTS + 3 * EXTENTS_PER_BLOCK + 1;
+	std::string data(BLOCKS * BLOCK_SIZE, 'f');
+	ASSERT_TRUE(m_fs->CreateFile("file"));
+	Write("file", data, 0);
+	for (uint32_t block = 1; block < BLOCKS; block += 2)
+	{
+		ASSERT_TRUE(m_fs->PunchHole("file", static_cast<uint64_t>(block) * BLOCK_SIZE, BLOCK_SIZE));
+		data.replace(static_cast<size_t>(block) * BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, '\0');
+	}
+	EXPECT_EQ(Stat("file").extentsCount, INLINE_EXTENTS + 3 * EXTENTS_PER_BLOCK);
+
+	// Запись за концом добавляет четвёртый блок в цепочку
+	data += std::string(64 * BLOCK_SIZE, '\0') + "tail";
+	Write("file", "tail", data.size() - 4);
+	Reopen();
+	EXPECT_EQ(Read("file", 0, data.size()), data);
+
+	// Уменьшение файла сокращает цепочку блоков переполнения до двух
+	data.resize(data.size() / 2);
+	ASSERT_TRUE(m_fs->TruncateFile("file", data.size()));
+	EXPECT_LT(Stat("file").extentsCount, INLINE_EXTENTS + 2 * EXTENTS_PER_BLOCK);
+	Reopen();
+	EXPECT_EQ(Read("file", 0, data.size()), data);
+}